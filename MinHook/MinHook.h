@@ -99,6 +99,35 @@ extern "C" {
 	//   pTarget [in] A pointer to the target function.
 	MH_STATUS WINAPI MH_DisableHook(void* pTarget);
 
+	// Disables the hook if needed and removes it. Its trampoline memory is
+	// reused by later hooks, so no thread may still be running through it.
+	// Parameters:
+	//   pTarget [in] A pointer to the target function.
+	MH_STATUS WINAPI MH_RemoveHook(void* pTarget);
+
+	// Queues the already created hook to be enabled by the next MH_ApplyQueued.
+	// Parameters:
+	//   pTarget [in] A pointer to the target function.
+	MH_STATUS WINAPI MH_QueueEnableHook(void* pTarget);
+
+	// Queues the already created hook to be disabled by the next MH_ApplyQueued.
+	// Parameters:
+	//   pTarget [in] A pointer to the target function.
+	MH_STATUS WINAPI MH_QueueDisableHook(void* pTarget);
+
+	// Applies all queued changes while the other threads are suspended only once,
+	// instead of once per MH_EnableHook/MH_DisableHook call.
+	MH_STATUS WINAPI MH_ApplyQueued();
+
+	// Tells whether the hook is currently enabled. Returns MH_ERROR_NOT_CREATED
+	// when there is no hook for the target, including before MH_Initialize.
+	// Like every other MinHook call it takes the global lock, so it waits for
+	// a call in progress on another thread, MH_ApplyQueued included.
+	// Parameters:
+	//   pTarget  [in]  A pointer to the target function.
+	//   pEnabled [out] Receives TRUE when the hook is enabled.
+	MH_STATUS WINAPI MH_IsHookEnabled(void* pTarget, BOOL* pEnabled);
+
 #if defined __cplusplus
 }
 #endif
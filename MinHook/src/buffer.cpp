@@ -27,243 +27,110 @@
  */
 
 #include <cassert>
-#include <vector>
-#include <algorithm>
 #include <Windows.h>
 
 #include "buffer.h"
+#include "slab.h"
 
 namespace MinHook { namespace
 {
-	struct MEMORY_BLOCK
+	// Trampoline memory straight from the process address space.
+	class VirtualMemoryProvider : public PageProvider
 	{
-		void*	pAddress;
-		DWORD	protect;
-		size_t	usedSize;
-		size_t	fixedSize;
-	};
+	public:
+		bool Query(uintptr_t address, PAGE_REGION& region)
+		{
+			MEMORY_BASIC_INFORMATION mi = { 0 };
+			if (VirtualQuery(reinterpret_cast<void*>(address), &mi, sizeof(mi)) == 0)
+			{
+				return false;
+			}
 
-	template <typename T>
-	bool operator <(const MEMORY_BLOCK& lhs, const T& rhs);
-	template <typename T>
-	bool operator <(const T& lhs, const MEMORY_BLOCK& rhs);
-	bool operator <(const MEMORY_BLOCK& lhs, const MEMORY_BLOCK& rhs);
+			region.base = reinterpret_cast<uintptr_t>(mi.BaseAddress);
+			region.size = mi.RegionSize;
+			region.isFree = (mi.State == MEM_FREE);
+			return true;
+		}
 
-	void*			AllocateBuffer(void* const pOrigin, DWORD protect, size_t size);
-	MEMORY_BLOCK*	GetMemoryBlock(void* const pOrigin, DWORD protect, size_t capacity);
+		void* Reserve(uintptr_t address, size_t size)
+		{
+			return VirtualAlloc(reinterpret_cast<void*>(address), size, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READ);
+		}
+
+		void Release(void* pAddress, size_t)
+		{
+			VirtualFree(pAddress, 0, MEM_RELEASE);
+		}
+	};
 
 	const size_t BlockSize = 0x10000;
 
 #if defined _M_X64
-	intptr_t gMinAddress;
-	intptr_t gMaxAddress;
+	// Relays and trampolines are reached with 32-bit displacements.
+	const uintptr_t MaxDistance = 0x20000000;
 #endif
-	std::vector<MEMORY_BLOCK> gMemoryBlocks;
+
+	VirtualMemoryProvider gPages;
+	SlabAllocator gSlots(gPages, MEMORY_SLOT_SIZE, BlockSize);
 }}
 
 namespace MinHook 
 {
 	void InitializeBuffer()
 	{
-#if defined _M_X64
 		SYSTEM_INFO si;
 		GetSystemInfo(&si);
-		
-		gMinAddress = reinterpret_cast<intptr_t>(si.lpMinimumApplicationAddress);
-		gMaxAddress = reinterpret_cast<intptr_t>(si.lpMaximumApplicationAddress);
-#endif
-	}
-
-	void UninitializeBuffer()
-	{
-		for (std::vector<MEMORY_BLOCK>::iterator block = gMemoryBlocks.begin();
-			block != gMemoryBlocks.end(); block++)
-		{
-			VirtualFree(block->pAddress, 0, MEM_RELEASE);
-		}
-
-		std::vector<MEMORY_BLOCK> v;
-		gMemoryBlocks.swap(v);
-	}
-
-	void* AllocateCodeBuffer(void* const pOrigin, size_t size)
-	{
-		assert(("AllocateBuffer", (size > 0)));
 
-		return AllocateBuffer(pOrigin, PAGE_EXECUTE_READ, size);
-	}
-
-	void* AllocateDataBuffer(void* const pOrigin, size_t size)
-	{
-		assert(("AllocateBuffer", (size > 0)));
-
-		return AllocateBuffer(pOrigin, PAGE_READONLY, size);
-	}
-
-	void RollbackBuffer()
-	{
-		for (std::vector<MEMORY_BLOCK>::iterator block = gMemoryBlocks.begin();
-			block != gMemoryBlocks.end(); block++)
-		{
-			block->usedSize = block->fixedSize;
-		}
+		gSlots.SetAddressLimits(
+			reinterpret_cast<uintptr_t>(si.lpMinimumApplicationAddress),
+			reinterpret_cast<uintptr_t>(si.lpMaximumApplicationAddress));
 	}
 
-	void CommitBuffer()
+	void UninitializeBuffer()
 	{
-		for (std::vector<MEMORY_BLOCK>::iterator block = gMemoryBlocks.begin();
-			block != gMemoryBlocks.end(); block++)
-		{
-			if (block->usedSize == block->fixedSize)
-			{
-				continue;
-			}
-
-			void* pBuffer = reinterpret_cast<char*>(block->pAddress) + block->fixedSize;
-			size_t size = block->usedSize - block->fixedSize;
-			DWORD op;
-			VirtualProtect(pBuffer, size, block->protect, &op);
-		}
+		gSlots.ReleaseAll();
 	}
-}
 
-namespace MinHook { namespace
-{
-	void* AllocateBuffer(void* const pOrigin, DWORD protect, size_t size)
+	void* AllocateBuffer(void* const pOrigin)
 	{
-		assert(("AllocateBuffer", (protect == PAGE_EXECUTE_READ || protect == PAGE_READONLY)));
-		assert(("AllocateBuffer", (size > 0)));
-
-		// ACgEɐ؂グ
-		size = (size + TYPE_ALIGNMENT(void*) - 1) & ~(TYPE_ALIGNMENT(void*) - 1);
-
-		MEMORY_BLOCK* pBlock = GetMemoryBlock(pOrigin, protect, size);
-		if (pBlock == NULL)
-		{
-			return NULL;
-		}
-
-		void* pBuffer = reinterpret_cast<char*>(pBlock->pAddress) + pBlock->usedSize;
-		if (VirtualAlloc(pBuffer, size, MEM_COMMIT, pBlock->protect) == NULL)
+#if defined _M_X64
+		void* pBuffer = gSlots.Allocate(reinterpret_cast<uintptr_t>(pOrigin), MaxDistance);
+#elif defined _M_IX86
+		// In x86 mode, the distance does not matter.
+		(void)pOrigin;
+		void* pBuffer = gSlots.Allocate(0, 0);
+#endif
+		if (pBuffer == NULL)
 		{
 			return NULL;
 		}
 
 		DWORD oldProtect;
-		// PAGE_EXECUTE_READ -> PAGE_EXECUTE_READWRITE, PAGE_READONLY -> PAGE_READWRITE
-		if (!VirtualProtect(pBuffer, size, (pBlock->protect << 1), &oldProtect))
+		if (!VirtualProtect(pBuffer, MEMORY_SLOT_SIZE, PAGE_EXECUTE_READWRITE, &oldProtect))
 		{
+			gSlots.Free(pBuffer);
 			return NULL;
 		}
 
-		pBlock->usedSize += size;
 		return pBuffer;
 	}
 
-	MEMORY_BLOCK* GetMemoryBlock(void* const pOrigin, DWORD protect, size_t capacity)
+	bool CommitBuffer(void* pBuffer)
 	{
-		assert(("GetMemoryBlock", (protect == PAGE_EXECUTE_READ || protect == PAGE_READONLY)));
-		assert(("GetMemoryBlock", (capacity > 0)));
-
-		typedef std::vector<MEMORY_BLOCK>::iterator mb_iter;
-
-#if defined _M_X64
-		intptr_t minAddr = gMinAddress;
-		intptr_t maxAddr = gMaxAddress; 
-		if (pOrigin != NULL)
-		{
-			// pOrigin } 512MB ͈̔ 
-			minAddr = std::max<intptr_t>(minAddr, reinterpret_cast<intptr_t>(pOrigin) - 0x20000000);
-			maxAddr = std::min<intptr_t>(maxAddr, reinterpret_cast<intptr_t>(pOrigin) + 0x20000000);
-		}
-#endif
-
-		// łɓo^ς݂̗̈̒gp\Ȃ̂΁AԂ
-		MEMORY_BLOCK* pBlock = NULL;
-		{
-			mb_iter ib = gMemoryBlocks.begin();
-			mb_iter ie = gMemoryBlocks.end();
-#if defined _M_X64
-			if (pOrigin != NULL)
-			{
-				// OɃAhX͈͂ōi荞
-				ib = std::lower_bound(ib, ie, minAddr);
-				ie = std::lower_bound(ib, ie, maxAddr);
-			}
-#endif
-			for (mb_iter i = ib; i != ie; ++i)
-			{
-				if (i->protect == protect && i->usedSize + capacity <= BlockSize)
-				{
-					return &(*i);
-				}
-			}
-		}
+		assert(("CommitBuffer", (pBuffer != NULL)));
 
-		// Ȃ΁AVȃAhẌm
-		void* pAlloc = NULL;
-#if defined _M_X64
-		if (pOrigin != NULL)
-		{
-			// ͈͂̒SO֋󂫗̈TĂ
-			intptr_t min = minAddr / BlockSize;
-			intptr_t max = maxAddr / BlockSize;
-			int rel = 0;
-			MEMORY_BASIC_INFORMATION mi = { 0 };
-			for (int i = 0; i < (max - min + 1); ++i)
-			{
-				rel = -rel + (i & 1);
-				void* pQuery = reinterpret_cast<void*>(((min + max) / 2 + rel) * BlockSize);
-				VirtualQuery(pQuery, &mi, sizeof(mi));
-				if (mi.State == MEM_FREE)
-				{
-					pAlloc = VirtualAlloc(pQuery, BlockSize, MEM_RESERVE, protect);
-					if (pAlloc != NULL)
-					{
-						break;
-					}
-				}
-			}
-		}
-		else
-#endif		// X86[hł́AAhX͖ɂȂȂ
-		{
-			pAlloc = VirtualAlloc(NULL, BlockSize, MEM_RESERVE, protect);
-		}
-
-		if (pAlloc != NULL)
+		DWORD oldProtect;
+		if (!VirtualProtect(pBuffer, MEMORY_SLOT_SIZE, PAGE_EXECUTE_READ, &oldProtect))
 		{
-			MEMORY_BLOCK block = { 0 };
-			block.pAddress = pAlloc;
-			block.protect = protect;
-
-#if defined _M_X64
-			mb_iter i = std::lower_bound(gMemoryBlocks.begin(), gMemoryBlocks.end(), pAlloc);
-#elif defined _M_IX86
-			mb_iter i = gMemoryBlocks.begin();
-#endif
-			i = gMemoryBlocks.insert(i, block);
-
-			return &(*i);
+			return false;
 		}
 
-		return NULL;
+		FlushInstructionCache(GetCurrentProcess(), pBuffer, MEMORY_SLOT_SIZE);
+		return true;
 	}
 
-	template <typename T>
-	bool operator <(const MEMORY_BLOCK& lhs, const T& rhs) 
-	{ 
-		return lhs.pAddress < reinterpret_cast<void*>(rhs); 
-	}
-
-	template <typename T>
-	bool operator <(const T& lhs, const MEMORY_BLOCK& rhs) 
-	{ 
-		return reinterpret_cast<void*>(lhs) < rhs.pAddress; 
-	}
-
-	bool operator <(const MEMORY_BLOCK& lhs, const MEMORY_BLOCK& rhs)
-	{ 
-		return lhs.pAddress < rhs.pAddress;
+	void FreeBuffer(void* pBuffer)
+	{
+		gSlots.Free(pBuffer);
 	}
-}}
\ No newline at end of file
+}
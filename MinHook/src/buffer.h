@@ -30,10 +30,15 @@
 
 namespace MinHook
 {	
+	// Every hook gets one slot for its trampoline, relay, address table and
+	// the backup of the target's head.
+	const size_t MEMORY_SLOT_SIZE = 256;
+
 	void    InitializeBuffer();
 	void    UninitializeBuffer();
-	void*	AllocateCodeBuffer(void* const pOrigin, size_t size);
-	void*	AllocateDataBuffer(void* const pOrigin, size_t size);
-	void	RollbackBuffer();
-	void	CommitBuffer();
+	// Returns a writable slot near pOrigin (anywhere when NULL), or NULL.
+	void*	AllocateBuffer(void* const pOrigin);
+	// Makes the slot executable and read-only once it has been filled in.
+	bool	CommitBuffer(void* pBuffer);
+	void	FreeBuffer(void* pBuffer);
 }
@@ -0,0 +1,292 @@
+/* 
+ *  MinHook - Minimalistic API Hook Library	
+ *  Copyright (C) 2022 Tsuda Kageyu, indiff. All rights reserved.
+ *  
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include "decode.h"
+
+namespace MinHook { namespace
+{
+	// Operand layout of one-byte opcodes, without prefixes.
+	enum OPCODE_PROPS
+	{
+		XX  = 0x00,		// Left to HDE
+		PL  = 0x01,		// No operands
+		MR  = 0x02,		// ModR/M
+		I1  = 0x04,		// imm8
+		I2  = 0x08,		// imm16
+		I4  = 0x10,		// imm32
+		J1  = 0x20,		// rel8
+		J4  = 0x40,		// rel32
+		MO  = 0x80,		// ModR/M must address memory
+		MM  = MR | MO,
+		MI1 = MR | I1,
+		MI4 = MR | I4
+	};
+
+	// The instructions compilers put in prologues and the branches that may
+	// follow them. Opcodes whose operands depend on prefixes or on the ModR/M
+	// reg field are left to HDE, apart from the groups handled in DecodeFast.
+	const uint8_t OpcodeProps[256] =
+	{
+		MR,  MR,  MR,  MR,  I1,  I4,  XX,  XX,  MR,  MR,  MR,  MR,  I1,  I4,  XX,  XX,	// 00
+		MR,  MR,  MR,  MR,  I1,  I4,  XX,  XX,  MR,  MR,  MR,  MR,  I1,  I4,  XX,  XX,	// 10
+		MR,  MR,  MR,  MR,  I1,  I4,  XX,  XX,  MR,  MR,  MR,  MR,  I1,  I4,  XX,  XX,	// 20
+		MR,  MR,  MR,  MR,  I1,  I4,  XX,  XX,  MR,  MR,  MR,  MR,  I1,  I4,  XX,  XX,	// 30
+#if defined _M_X64
+		XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,	// 40
+#elif defined _M_IX86
+		PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,	// 40
+#endif
+		PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,	// 50
+#if defined _M_X64
+		XX,  XX,  XX,  MR,  XX,  XX,  XX,  XX,  I4,  MI4, I1,  MI1, XX,  XX,  XX,  XX,	// 60
+#elif defined _M_IX86
+		XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  I4,  MI4, I1,  MI1, XX,  XX,  XX,  XX,	// 60
+#endif
+		J1,  J1,  J1,  J1,  J1,  J1,  J1,  J1,  J1,  J1,  J1,  J1,  J1,  J1,  J1,  J1,	// 70
+		MI1, MI4, XX,  MI1, MR,  MR,  MR,  MR,  MR,  MR,  MR,  MR,  XX,  MM,  XX,  XX,	// 80
+		PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  PL,  XX,  XX,  PL,  PL,  XX,  XX,	// 90
+		XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  I1,  I4,  XX,  XX,  XX,  XX,  XX,  XX,	// A0
+		I1,  I1,  I1,  I1,  I1,  I1,  I1,  I1,  I4,  I4,  I4,  I4,  I4,  I4,  I4,  I4,	// B0
+		MI1, MI1, I2,  PL,  XX,  XX,  MI1, MI4, XX,  PL,  XX,  XX,  PL,  XX,  XX,  XX,	// C0
+		MR,  MR,  MR,  MR,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,	// D0
+		XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  J4,  J4,  XX,  J1,  XX,  XX,  XX,  XX,	// E0
+		XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  XX,  MR,	// F0
+	};
+
+	// HDE results for instructions the table does not cover, looked up by
+	// their bytes. Sets are picked by the first byte.
+	struct DECODED
+	{
+		uint8_t		bytes[15];
+		hde_t		hs;			// hs.len is 0 while unused
+	};
+
+	const size_t CacheSets = 64;
+	const size_t CacheWays = 4;
+
+	DECODED	gCache[CacheSets][CacheWays];
+	uint8_t	gNextWay[CacheSets];
+
+	bool DecodeFast(const uint8_t* pCode, hde_t* hs);
+	bool LookupCache(const uint8_t* pCode, hde_t* hs);
+	void StoreCache(const uint8_t* pCode, const hde_t& hs);
+}}
+
+namespace MinHook
+{
+	unsigned int DecodeInstruction(const void* code, hde_t* hs)
+	{
+		const uint8_t* pCode = reinterpret_cast<const uint8_t*>(code);
+		if (DecodeFast(pCode, hs) || LookupCache(pCode, hs))
+		{
+			return hs->len;
+		}
+
+#if defined _M_X64
+		hde64_disasm(code, hs);
+#elif defined _M_IX86
+		hde32_disasm(code, hs);
+#endif
+		if ((hs->flags & F_ERROR) == 0)
+		{
+			StoreCache(pCode, *hs);
+		}
+
+		return hs->len;
+	}
+}
+
+namespace MinHook { namespace
+{
+	// Produces exactly what HDE would for the opcodes in OpcodeProps, or
+	// returns false to hand the instruction over.
+	bool DecodeFast(const uint8_t* pCode, hde_t* hs)
+	{
+		const uint8_t* p = pCode;
+		memset(hs, 0, sizeof(hde_t));
+
+#if defined _M_X64
+		if ((*p & 0xF0) == 0x40)
+		{
+			uint8_t rex = *p++;
+			hs->flags |= F_PREFIX_REX;
+			hs->rex_w = (rex & 0x0F) >> 3;
+			hs->rex_r = (rex & 0x07) >> 2;
+			hs->rex_x = (rex & 0x03) >> 1;
+			hs->rex_b = rex & 0x01;
+
+			// MOV r64, imm64
+			if (hs->rex_w && (*p & 0xF8) == 0xB8)
+			{
+				return false;
+			}
+		}
+#endif
+
+		uint8_t opcode = *p++;
+		uint8_t props = OpcodeProps[ opcode ];
+		if (props == XX)
+		{
+			return false;
+		}
+
+		hs->opcode = opcode;
+
+		if (props & MR)
+		{
+			uint8_t modrm = *p++;
+			uint8_t mod = modrm >> 6;
+			uint8_t reg = (modrm & 0x3F) >> 3;
+			uint8_t rm  = modrm & 0x07;
+
+			if ((props & MO) && mod == 3)
+			{
+				return false;
+			}
+
+			// Group members HDE rejects or decodes with other operands.
+			switch (opcode)
+			{
+			case 0xC6: case 0xC7:	// MOV r/m, imm
+				if (reg != 0)
+				{
+					return false;
+				}
+				break;
+			case 0xFF:				// INC, DEC, CALL, JMP, PUSH
+				if (reg == 3 || reg == 5 || reg == 7)
+				{
+					return false;
+				}
+				break;
+			}
+
+			hs->flags |= F_MODRM;
+			hs->modrm = modrm;
+			hs->modrm_mod = mod;
+			hs->modrm_reg = reg;
+			hs->modrm_rm = rm;
+
+			size_t dispSize = 0;
+			if (mod == 0 && rm == 5)
+			{
+				dispSize = 4;
+			}
+			else if (mod == 1)
+			{
+				dispSize = 1;
+			}
+			else if (mod == 2)
+			{
+				dispSize = 4;
+			}
+
+			if (mod != 3 && rm == 4)
+			{
+				uint8_t sib = *p++;
+				hs->flags |= F_SIB;
+				hs->sib = sib;
+				hs->sib_scale = sib >> 6;
+				hs->sib_index = (sib & 0x3F) >> 3;
+				hs->sib_base = sib & 0x07;
+				if (hs->sib_base == 5 && (mod & 1) == 0)
+				{
+					dispSize = 4;
+				}
+			}
+
+			if (dispSize == 1)
+			{
+				hs->flags |= F_DISP8;
+				hs->disp.disp8 = *p;
+			}
+			else if (dispSize == 4)
+			{
+				hs->flags |= F_DISP32;
+				memcpy(&hs->disp.disp32, p, sizeof(uint32_t));
+			}
+			p += dispSize;
+		}
+
+		if (props & I2)
+		{
+			hs->flags |= F_IMM16;
+			memcpy(&hs->imm.imm16, p, sizeof(uint16_t));
+			p += sizeof(uint16_t);
+		}
+		else if (props & (I1 | J1))
+		{
+			hs->flags |= F_IMM8 | ((props & J1) ? F_RELATIVE : 0);
+			hs->imm.imm8 = *p++;
+		}
+		else if (props & (I4 | J4))
+		{
+			hs->flags |= F_IMM32 | ((props & J4) ? F_RELATIVE : 0);
+			memcpy(&hs->imm.imm32, p, sizeof(uint32_t));
+			p += sizeof(uint32_t);
+		}
+
+		hs->len = static_cast<uint8_t>(p - pCode);
+		return true;
+	}
+
+	// A cached entry matches when its bytes start the code. Bytes are compared
+	// one at a time, so nothing is read that decoding would not read as well.
+	bool LookupCache(const uint8_t* pCode, hde_t* hs)
+	{
+		DECODED* set = gCache[ *pCode % CacheSets ];
+		for (size_t way = 0; way < CacheWays; ++way)
+		{
+			const DECODED& entry = set[ way ];
+			size_t i = 0;
+			while (i < entry.hs.len && entry.bytes[ i ] == pCode[ i ])
+			{
+				++i;
+			}
+
+			if (entry.hs.len != 0 && i == entry.hs.len)
+			{
+				*hs = entry.hs;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void StoreCache(const uint8_t* pCode, const hde_t& hs)
+	{
+		size_t index = *pCode % CacheSets;
+		DECODED& entry = gCache[ index ][ gNextWay[ index ] ];
+		gNextWay[ index ] = (gNextWay[ index ] + 1) % CacheWays;
+
+		memcpy(entry.bytes, pCode, hs.len);
+		entry.hs = hs;
+	}
+}}
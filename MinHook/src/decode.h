@@ -0,0 +1,54 @@
+/* 
+ *  MinHook - Minimalistic API Hook Library	
+ *  Copyright (C) 2022 Tsuda Kageyu, indiff. All rights reserved.
+ *  
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Instruction length decoding for trampoline construction. Common prologue
+// instructions are decoded from a flat opcode table; everything else goes
+// through HDE, whose results are cached by instruction bytes.
+
+#include "pstdint.h"
+
+#if defined _M_X64
+#include "hde64/include/hde64.h"
+#elif defined _M_IX86
+#include "hde32/hde32.h"
+#endif
+
+namespace MinHook
+{
+#if defined _M_X64
+	typedef hde64s hde_t;
+#elif defined _M_IX86
+	typedef hde32s hde_t;
+#endif
+
+	// Same contract as hde64_disasm/hde32_disasm: fills hs and returns the
+	// instruction length. Not thread safe; MinHook only decodes under its lock.
+	unsigned int DecodeInstruction(const void* code, hde_t* hs);
+}
@@ -56,3 +56,28 @@ MH_STATUS WINAPI MH_DisableHook(void* pTarget)
 {
 	return DisableHook(pTarget);
 }
+
+MH_STATUS WINAPI MH_RemoveHook(void* pTarget)
+{
+	return RemoveHook(pTarget);
+}
+
+MH_STATUS WINAPI MH_QueueEnableHook(void* pTarget)
+{
+	return QueueEnableHook(pTarget);
+}
+
+MH_STATUS WINAPI MH_QueueDisableHook(void* pTarget)
+{
+	return QueueDisableHook(pTarget);
+}
+
+MH_STATUS WINAPI MH_ApplyQueued()
+{
+	return ApplyQueued();
+}
+
+MH_STATUS WINAPI MH_IsHookEnabled(void* pTarget, BOOL* pEnabled)
+{
+	return IsHookEnabled(pTarget, pEnabled);
+}
@@ -38,6 +38,8 @@
 #include "buffer.h"
 #include "trampoline.h"
 #include "thread.h"
+#include "queue.h"
+#include "hookindex.h"
 
 namespace MinHook { namespace
 {
@@ -51,8 +53,10 @@ namespace MinHook { namespace
 		void*	pTrampoline;
 		void*	pBackup;
 		bool	isEnabled;
-		std::vector<uintptr_t>	oldIPs;
-		std::vector<uintptr_t>	newIPs;
+		bool	queueEnable;	// State to switch to on the next ApplyQueued
+		uint8_t	nIP;
+		uint8_t	oldIPs[ MAX_TRAMPOLINE_IPS ];	// Offsets into the target
+		uint8_t	newIPs[ MAX_TRAMPOLINE_IPS ];	// Offsets into the trampoline
 	};
 
 	// ߏݗp\
@@ -71,18 +75,16 @@ namespace MinHook { namespace
 #pragma pack(pop)
 
 	HOOK_ENTRY* FindHook(void* const pTarget);
+	MH_STATUS	PatchHook(HOOK_ENTRY* pHook, bool enable);
+	MH_STATUS	PatchHookExclusive(HOOK_ENTRY* pHook, bool enable);
+	MH_STATUS	QueueHook(void* pTarget, bool enable);
+	MH_STATUS	ApplyQueuedHooks();
 	bool		IsExecutableAddress(void* pAddress);
 	void		WriteRelativeJump(void* pFrom, void* const pTo);
 	void		WriteAbsoluteJump(void* pFrom, void* const pTo, void* pTable);
 
-	template <typename T>
-	bool operator <(const HOOK_ENTRY& lhs, const T& rhs) ;
-	template <typename T>
-	bool operator <(const T& lhs, const HOOK_ENTRY& rhs) ;
-	bool operator <(const HOOK_ENTRY& lhs, const HOOK_ENTRY& rhs);
-
 	CriticalSection gCS;
-	std::vector<HOOK_ENTRY> gHooks;
+	HookIndex<HOOK_ENTRY> gHooks;
 	bool gIsInitialized = false;
 }}
 
@@ -114,23 +116,19 @@ namespace MinHook
 		}
 
 		// ׂẴtbN
-		for (std::vector<HOOK_ENTRY>::const_iterator hook = gHooks.begin();
-			hook != gHooks.end(); hook++)
+		// Disable every hook under a single thread freeze.
+		gHooks.ForEach([](HOOK_ENTRY& hook)
 		{
-			if (!hook->isEnabled)
-			{
-				continue;
-			}
-			
-			MH_STATUS status = DisableHook(hook->pTarget);
-			if (status != MH_OK)
-			{
-				return status;
-			}
+			hook.queueEnable = false;
+		});
+
+		MH_STATUS status = ApplyQueuedHooks();
+		if (status != MH_OK)
+		{
+			return status;
 		}
 
-		std::vector<HOOK_ENTRY> v;
-		gHooks.swap(v);
+		gHooks.Clear();
 
 		// ֐obt@̊J
 		UninitializeBuffer();
@@ -166,23 +164,33 @@ namespace MinHook
 			ct.pTarget = pTarget;
 			if (!CreateTrampolineFunction(ct))
 			{
-				RollbackBuffer();
 				return MH_ERROR_UNSUPPORTED_FUNCTION;
 			}
 
-			void* pTrampoline = AllocateCodeBuffer(pTarget, ct.trampoline.size());
-			if (pTrampoline == NULL)
+			// One slot holds the trampoline, on x64 the relay and the address
+			// table after it, and the backup of the target's head at the end.
+			size_t trampolineSize = ct.trampoline.size();
+#if defined _M_X64
+			size_t relayOffset = trampolineSize;
+			size_t tableOffset = (relayOffset + sizeof(JMP_ABS) + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+			size_t backupOffset = tableOffset + (ct.table.size() + 1) * sizeof(uintptr_t);
+#elif defined _M_IX86
+			size_t backupOffset = trampolineSize;
+#endif
+			if (backupOffset + sizeof(JMP_REL) > MEMORY_SLOT_SIZE)
 			{
-				RollbackBuffer();
-				return MH_ERROR_MEMORY_ALLOC;
+				return MH_ERROR_UNSUPPORTED_FUNCTION;
 			}
-#if defined _M_X64
-			void* pTable = AllocateDataBuffer(pTrampoline, (ct.table.size() + 1) * sizeof(uintptr_t));
-			if (pTable == NULL)
+
+			char* pSlot = static_cast<char*>(AllocateBuffer(pTarget));
+			if (pSlot == NULL)
 			{
-				RollbackBuffer();
 				return MH_ERROR_MEMORY_ALLOC;
 			}
+
+			void* pTrampoline = pSlot;
+#if defined _M_X64
+			void* pTable = pSlot + tableOffset;
 #endif
 
 			ct.pTrampoline = pTrampoline;
@@ -191,7 +199,7 @@ namespace MinHook
 #endif
 			if (!ResolveTemporaryAddresses(ct))
 			{
-				RollbackBuffer();
+				FreeBuffer(pSlot);
 				return MH_ERROR_UNSUPPORTED_FUNCTION;
 			}
 
@@ -204,27 +212,19 @@ namespace MinHook
 #endif
 
 			// ^[Qbg֐̃obNAbvƂ
-			void* pBackup = AllocateDataBuffer(NULL, sizeof(JMP_REL));
-			if (pBackup == NULL)
-			{
-				RollbackBuffer();
-				return MH_ERROR_MEMORY_ALLOC;
-			}
-
+			void* pBackup = pSlot + backupOffset;
 			memcpy(pBackup, pTarget, sizeof(JMP_REL));
 
 			// p֐쐬
 #if defined _M_X64
-			void* pRelay = AllocateCodeBuffer(pTarget, sizeof(JMP_ABS));
-			if (pRelay == NULL)
-			{
-				RollbackBuffer();
-				return MH_ERROR_MEMORY_ALLOC;
-			}
-
+			void* pRelay = pSlot + relayOffset;
 			WriteAbsoluteJump(pRelay, pDetour, reinterpret_cast<uintptr_t*>(pTable) + ct.table.size());
 #endif
-			CommitBuffer();
+			if (!CommitBuffer(pSlot))
+			{
+				FreeBuffer(pSlot);
+				return MH_ERROR_MEMORY_PROTECT;
+			}
 
 			// tbN̓o^
 			HOOK_ENTRY hook = { 0 };
@@ -236,13 +236,15 @@ namespace MinHook
 			hook.pTrampoline = pTrampoline;
 			hook.pBackup = pBackup;
 			hook.isEnabled = false;
-			hook.oldIPs = ct.oldIPs;
-			hook.newIPs = ct.newIPs;
-
-			std::vector<HOOK_ENTRY>::iterator i	= std::lower_bound(gHooks.begin(), gHooks.end(), hook);
-			i = gHooks.insert(i, hook);
-			pHook = &(*i);
+			hook.queueEnable = false;
+			hook.nIP = static_cast<uint8_t>(ct.oldIPs.size());
+			for (size_t i = 0; i < ct.oldIPs.size(); ++i)
+			{
+				hook.oldIPs[ i ] = static_cast<uint8_t>(ct.oldIPs[ i ] - reinterpret_cast<uintptr_t>(pTarget));
+				hook.newIPs[ i ] = static_cast<uint8_t>(ct.newIPs[ i ] - reinterpret_cast<uintptr_t>(pTrampoline));
+			}
 
+			pHook = gHooks.Insert(pTarget, hook);
 		}
 
 		// OUT̏
@@ -271,27 +273,7 @@ namespace MinHook
 			return MH_ERROR_ENABLED;
 		}
 
-		// ^[Qbg֐̖`ɁAp֐܂̓tbN֐ւ̃Wv
-		{
-			ScopedThreadExclusive tex(pHook->oldIPs, pHook->newIPs);
-
-			DWORD oldProtect;
-			if (!VirtualProtect(pHook->pTarget, sizeof(JMP_REL), PAGE_EXECUTE_READWRITE, &oldProtect))
-			{
-				return MH_ERROR_MEMORY_PROTECT;
-			}
-
-#if defined _M_X64
-			WriteRelativeJump(pHook->pTarget, pHook->pRelay);
-#elif defined _M_IX86
-			WriteRelativeJump(pHook->pTarget, pHook->pDetour);
-#endif
-			VirtualProtect(pHook->pTarget, sizeof(JMP_REL), oldProtect, &oldProtect);
-		}
-
-		pHook->isEnabled = true;
-
-		return MH_OK;
+		return PatchHookExclusive(pHook, true);
 	}
 
 	MH_STATUS DisableHook(void* pTarget)
@@ -314,23 +296,72 @@ namespace MinHook
 			return MH_ERROR_DISABLED;
 		}
 
-		// ^[Qbg֐̖`߂B͍ėp̂ߎcĂ
+		return PatchHookExclusive(pHook, false);
+	}
+
+	MH_STATUS RemoveHook(void* pTarget)
+	{
+		CriticalSection::ScopedLock lock(gCS);
+
+		if (!gIsInitialized)
 		{
-			ScopedThreadExclusive tex(pHook->oldIPs, pHook->newIPs);
+			return MH_ERROR_NOT_INITIALIZED;
+		}
 
-			DWORD oldProtect;
-			if (!VirtualProtect(pHook->pTarget, sizeof(JMP_REL), PAGE_EXECUTE_READWRITE, &oldProtect))
+		HOOK_ENTRY *pHook = FindHook(pTarget);
+		if (pHook == NULL)
+		{
+			return MH_ERROR_NOT_CREATED;
+		}
+
+		if (pHook->isEnabled)
+		{
+			MH_STATUS status = PatchHookExclusive(pHook, false);
+			if (status != MH_OK)
 			{
-				return MH_ERROR_MEMORY_PROTECT;
+				return status;
 			}
+		}
 
-			memcpy(pHook->pTarget, pHook->pBackup, sizeof(JMP_REL));
+		// The slot goes back to its region's free list for the next hook.
+		FreeBuffer(pHook->pTrampoline);
+		gHooks.Remove(pTarget);
+		return MH_OK;
+	}
 
-			VirtualProtect(pHook->pTarget, sizeof(JMP_REL), oldProtect, &oldProtect);
+	MH_STATUS QueueEnableHook(void* pTarget)
+	{
+		return QueueHook(pTarget, true);
+	}
+
+	MH_STATUS QueueDisableHook(void* pTarget)
+	{
+		return QueueHook(pTarget, false);
+	}
+
+	MH_STATUS ApplyQueued()
+	{
+		CriticalSection::ScopedLock lock(gCS);
+
+		if (!gIsInitialized)
+		{
+			return MH_ERROR_NOT_INITIALIZED;
 		}
 
-		pHook->isEnabled = false;
+		return ApplyQueuedHooks();
+	}
 
+	MH_STATUS IsHookEnabled(void* pTarget, BOOL* pEnabled)
+	{
+		CriticalSection::ScopedLock lock(gCS);
+
+		HOOK_ENTRY *pHook = FindHook(pTarget);
+		if (pHook == NULL)
+		{
+			return MH_ERROR_NOT_CREATED;
+		}
+
+		*pEnabled = pHook->isEnabled ? TRUE : FALSE;
 		return MH_OK;
 	}
 }
@@ -338,14 +369,97 @@ namespace MinHook { namespace
 {
 	HOOK_ENTRY* FindHook(void* const pTarget)
 	{
-		std::vector<HOOK_ENTRY>::iterator i 
-			= std::lower_bound(gHooks.begin(), gHooks.end(), pTarget);
-		if (i != gHooks.end() && i->pTarget == pTarget)
+		return gHooks.Find(pTarget);
+	}
+
+	// Writes or removes the jump at the head of the target. The caller must
+	// hold gCS and have the other threads frozen.
+	MH_STATUS PatchHook(HOOK_ENTRY* pHook, bool enable)
+	{
+		DWORD oldProtect;
+		if (!VirtualProtect(pHook->pTarget, sizeof(JMP_REL), PAGE_EXECUTE_READWRITE, &oldProtect))
+		{
+			return MH_ERROR_MEMORY_PROTECT;
+		}
+
+		if (enable)
+		{
+			// ^[Qbg֐̖`ɁAp֐܂̓tbN֐ւ̃Wv
+#if defined _M_X64
+			WriteRelativeJump(pHook->pTarget, pHook->pRelay);
+#elif defined _M_IX86
+			WriteRelativeJump(pHook->pTarget, pHook->pDetour);
+#endif
+		}
+		else
+		{
+			// ^[Qbg֐̖`߂B͍ėp̂ߎcĂ
+			memcpy(pHook->pTarget, pHook->pBackup, sizeof(JMP_REL));
+		}
+
+		VirtualProtect(pHook->pTarget, sizeof(JMP_REL), oldProtect, &oldProtect);
+		FlushInstructionCache(GetCurrentProcess(), pHook->pTarget, sizeof(JMP_REL));
+
+		pHook->isEnabled = enable;
+		pHook->queueEnable = enable;
+		return MH_OK;
+	}
+
+	// Patches a single hook under its own thread freeze.
+	MH_STATUS PatchHookExclusive(HOOK_ENTRY* pHook, bool enable)
+	{
+		IPTranslation ips;
+		AddHookIPs(*pHook, ips);
+		ips.Seal();
+
+		ScopedThreadExclusive tex(ips);
+		return PatchHook(pHook, enable);
+	}
+
+	// Records the state a hook should have after the next ApplyQueued.
+	MH_STATUS QueueHook(void* pTarget, bool enable)
+	{
+		CriticalSection::ScopedLock lock(gCS);
+
+		if (!gIsInitialized)
 		{
-			return &(*i);
+			return MH_ERROR_NOT_INITIALIZED;
 		}
 
-		return NULL;
+		HOOK_ENTRY *pHook = FindHook(pTarget);
+		if (pHook == NULL)
+		{
+			return MH_ERROR_NOT_CREATED;
+		}
+
+		pHook->queueEnable = enable;
+		return MH_OK;
+	}
+
+	// Patches every hook whose queued state differs from its current one
+	// while the other threads are frozen once. The caller must hold gCS.
+	MH_STATUS ApplyQueuedHooks()
+	{
+		std::vector<HOOK_ENTRY*> pending;
+		IPTranslation ips;
+		PlanQueuedHooks(gHooks, pending, ips);
+		if (pending.empty())
+		{
+			return MH_OK;
+		}
+
+		ScopedThreadExclusive tex(ips);
+		for (std::vector<HOOK_ENTRY*>::const_iterator hook = pending.begin();
+			hook != pending.end(); hook++)
+		{
+			MH_STATUS status = PatchHook(*hook, (*hook)->queueEnable);
+			if (status != MH_OK)
+			{
+				return status;
+			}
+		}
+
+		return MH_OK;
 	}
 
 	bool IsExecutableAddress(void* pAddress)
@@ -378,21 +492,4 @@ namespace MinHook { namespace
 		memcpy(pFrom,  &jmp, sizeof(jmp));
 		memcpy(pTable, &pTo, sizeof(pTo));
 	}
-
-	template <typename T>
-	bool operator <(const HOOK_ENTRY& lhs, const T& rhs) 
-	{ 
-		return lhs.pTarget < reinterpret_cast<void*>(rhs); 
-	}
-
-	template <typename T>
-	bool operator <(const T& lhs, const HOOK_ENTRY& rhs) 
-	{ 
-		return reinterpret_cast<void*>(lhs) < rhs.pTarget; 
-	}
-
-	bool operator <(const HOOK_ENTRY& lhs, const HOOK_ENTRY& rhs)
-	{ 
-		return lhs.pTarget < rhs.pTarget;
-	}
 }}
@@ -37,4 +37,9 @@ namespace MinHook
 	MH_STATUS CreateHook(void* pTarget, void* const pDetour, void** ppOriginal);
 	MH_STATUS EnableHook(void* pTarget);
 	MH_STATUS DisableHook(void* pTarget);
+	MH_STATUS RemoveHook(void* pTarget);
+	MH_STATUS QueueEnableHook(void* pTarget);
+	MH_STATUS QueueDisableHook(void* pTarget);
+	MH_STATUS ApplyQueued();
+	MH_STATUS IsHookEnabled(void* pTarget, BOOL* pEnabled);
 }
@@ -0,0 +1,257 @@
+/* 
+ *  MinHook - Minimalistic API Hook Library	
+ *  Copyright (C) 2022 Tsuda Kageyu, indiff. All rights reserved.
+ *  
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Open-addressing index of hook entries keyed by target address. Kept free of
+// Windows headers so it can be built and checked on any platform.
+//
+// Not thread-safe: every call, Find included, must be serialized by the
+// caller. Entries never move, so a pointer returned by Find or Insert stays
+// valid until the entry is removed.
+//
+// hook.cpp calls it under gCS only, MH_IsHookEnabled included. Reading it
+// without the lock would need removed entries and rehashed tables to stay
+// allocated and the keys and isEnabled to be atomic, which a status query
+// that is not on any hot path does not pay for.
+
+#include <vector>
+#include <cstddef>
+
+namespace MinHook
+{
+	template <typename Entry>
+	class HookIndex
+	{
+	private:
+		// Slot keys 0 and 1 cannot be code addresses.
+		static const size_t EmptyKey = 0;
+		static const size_t RemovedKey = 1;
+		static const size_t MinCapacity = 16;
+		static const size_t EntriesPerChunk = 64;
+
+		struct SLOT
+		{
+			size_t	key;
+			Entry*	entry;
+		};
+
+		std::vector<SLOT>	slots_;
+		size_t				used_;		// Live and removed slots
+		std::vector<Entry*>	chunks_;
+		std::vector<Entry*>	free_;
+		size_t				size_;
+	public:
+		HookIndex()
+			: used_(0), size_(0)
+		{
+		}
+
+		~HookIndex()
+		{
+			Clear();
+		}
+
+		// Returns NULL when no entry has this target.
+		Entry* Find(const void* pTarget) const
+		{
+			if (slots_.empty())
+			{
+				return NULL;
+			}
+
+			size_t mask = slots_.size() - 1;
+			size_t key = reinterpret_cast<size_t>(pTarget);
+			for (size_t i = Hash(key) & mask; ; i = (i + 1) & mask)
+			{
+				if (slots_[ i ].key == key)
+				{
+					return slots_[ i ].entry;
+				}
+				if (slots_[ i ].key == EmptyKey)
+				{
+					return NULL;
+				}
+			}
+		}
+
+		// Adds a copy of value under pTarget, which must not be present yet.
+		Entry* Insert(const void* pTarget, const Entry& value)
+		{
+			if (slots_.empty() || (used_ + 1) * 2 > slots_.size())
+			{
+				Rehash();
+			}
+
+			Entry* pEntry = AllocateEntry();
+			*pEntry = value;
+
+			size_t mask = slots_.size() - 1;
+			size_t key = reinterpret_cast<size_t>(pTarget);
+			for (size_t i = Hash(key) & mask; ; i = (i + 1) & mask)
+			{
+				SLOT& slot = slots_[ i ];
+				if (slot.key == EmptyKey || slot.key == RemovedKey)
+				{
+					if (slot.key == EmptyKey)
+					{
+						used_++;
+					}
+					slot.key = key;
+					slot.entry = pEntry;
+					break;
+				}
+			}
+
+			size_++;
+			return pEntry;
+		}
+
+		bool Remove(const void* pTarget)
+		{
+			if (slots_.empty())
+			{
+				return false;
+			}
+
+			size_t mask = slots_.size() - 1;
+			size_t key = reinterpret_cast<size_t>(pTarget);
+			for (size_t i = Hash(key) & mask; ; i = (i + 1) & mask)
+			{
+				SLOT& slot = slots_[ i ];
+				if (slot.key == key)
+				{
+					free_.push_back(slot.entry);
+					slot.entry = NULL;
+					slot.key = RemovedKey;
+					size_--;
+					return true;
+				}
+				if (slot.key == EmptyKey)
+				{
+					return false;
+				}
+			}
+		}
+
+		// Calls fn(Entry&) for every entry, in no particular order.
+		template <typename Fn>
+		void ForEach(Fn fn)
+		{
+			for (size_t i = 0; i < slots_.size(); ++i)
+			{
+				if (slots_[ i ].key != EmptyKey && slots_[ i ].key != RemovedKey)
+				{
+					fn(*slots_[ i ].entry);
+				}
+			}
+		}
+
+		// Frees every entry.
+		void Clear()
+		{
+			for (size_t i = 0; i < chunks_.size(); ++i)
+			{
+				delete[] chunks_[ i ];
+			}
+
+			std::vector<SLOT>().swap(slots_);
+			std::vector<Entry*>().swap(chunks_);
+			std::vector<Entry*>().swap(free_);
+			used_ = 0;
+			size_ = 0;
+		}
+
+		size_t size() const
+		{
+			return size_;
+		}
+	private:
+		static size_t Hash(size_t key)
+		{
+			// Functions are aligned, so the low bits carry little information.
+			unsigned long long x = static_cast<unsigned long long>(key);
+			x ^= x >> 33;
+			x *= 0xFF51AFD7ED558CCDULL;
+			x ^= x >> 33;
+			return static_cast<size_t>(x);
+		}
+
+		Entry* AllocateEntry()
+		{
+			if (free_.empty())
+			{
+				Entry* chunk = new Entry[ EntriesPerChunk ];
+				chunks_.push_back(chunk);
+				for (size_t i = EntriesPerChunk; i > 0; --i)
+				{
+					free_.push_back(&chunk[ i - 1 ]);
+				}
+			}
+
+			Entry* pEntry = free_.back();
+			free_.pop_back();
+			return pEntry;
+		}
+
+		// Rebuilds the slots with room for one more entry and no removed slots.
+		void Rehash()
+		{
+			size_t capacity = MinCapacity;
+			while (capacity < (size_ + 1) * 4)
+			{
+				capacity *= 2;
+			}
+
+			SLOT empty = { EmptyKey, NULL };
+			std::vector<SLOT> slots(capacity, empty);
+			size_t mask = capacity - 1;
+			for (size_t i = 0; i < slots_.size(); ++i)
+			{
+				size_t key = slots_[ i ].key;
+				if (key == EmptyKey || key == RemovedKey)
+				{
+					continue;
+				}
+
+				size_t j = Hash(key) & mask;
+				while (slots[ j ].key != EmptyKey)
+				{
+					j = (j + 1) & mask;
+				}
+				slots[ j ] = slots_[ i ];
+			}
+
+			slots_.swap(slots);
+			used_ = size_;
+		}
+
+		HookIndex(const HookIndex&);
+		const HookIndex& operator=(const HookIndex&);
+	};
+}
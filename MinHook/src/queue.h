@@ -0,0 +1,144 @@
+/* 
+ *  MinHook - Minimalistic API Hook Library	
+ *  Copyright (C) 2022 Tsuda Kageyu, indiff. All rights reserved.
+ *  
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Planning of queued hook changes. Kept free of Windows headers so it can be
+// built and checked on any platform.
+
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include "pstdint.h"
+
+namespace MinHook
+{
+	// Instruction pointer fix-up table for one thread freeze, merged from the
+	// oldIPs/newIPs pairs of every hook patched under it.
+	class IPTranslation
+	{
+	private:
+		struct ENTRY
+		{
+			uintptr_t	oldIP;
+			uintptr_t	newIP;
+		};
+
+		std::vector<ENTRY> entries_;
+		bool sealed_;
+	public:
+		IPTranslation()
+			: sealed_(true)
+		{
+		}
+
+		// Maps oldBase + oldIPs[ i ] to newBase + newIPs[ i ] for i < count.
+		void Add(uintptr_t oldBase, const uint8_t* oldIPs, uintptr_t newBase, const uint8_t* newIPs, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				ENTRY entry = { oldBase + oldIPs[ i ], newBase + newIPs[ i ] };
+				entries_.push_back(entry);
+			}
+			sealed_ = false;
+		}
+
+		// Sorts the table for lookup. When an address was added more than once,
+		// the first mapping wins, as it did with a per-hook linear scan.
+		void Seal()
+		{
+			std::stable_sort(entries_.begin(), entries_.end(), LessOldIP);
+			entries_.erase(std::unique(entries_.begin(), entries_.end(), SameOldIP), entries_.end());
+			sealed_ = true;
+		}
+
+		bool Translate(uintptr_t ip, uintptr_t& newIP) const
+		{
+			assert(("IPTranslation::Translate", sealed_));
+
+			ENTRY key = { ip, 0 };
+			std::vector<ENTRY>::const_iterator i = std::lower_bound(entries_.begin(), entries_.end(), key, LessOldIP);
+			if (i == entries_.end() || i->oldIP != ip)
+			{
+				return false;
+			}
+
+			newIP = i->newIP;
+			return true;
+		}
+
+		bool empty() const
+		{
+			return entries_.empty();
+		}
+
+		size_t size() const
+		{
+			return entries_.size();
+		}
+	private:
+		static bool LessOldIP(const ENTRY& lhs, const ENTRY& rhs)
+		{
+			return lhs.oldIP < rhs.oldIP;
+		}
+
+		static bool SameOldIP(const ENTRY& lhs, const ENTRY& rhs)
+		{
+			return lhs.oldIP == rhs.oldIP;
+		}
+	};
+
+	// Adds the fix-ups that move a thread from the head of the target into the
+	// trampoline. Hook must provide pTarget, pTrampoline, nIP, oldIPs and newIPs.
+	template <typename Hook>
+	void AddHookIPs(const Hook& hook, IPTranslation& ips)
+	{
+		ips.Add(reinterpret_cast<uintptr_t>(hook.pTarget), hook.oldIPs,
+			reinterpret_cast<uintptr_t>(hook.pTrampoline), hook.newIPs, hook.nIP);
+	}
+
+	// Collects the hooks whose queued state differs from their current one and
+	// merges their IP fix-ups, so that all of them can be patched while the
+	// other threads are frozen once. Hook must also provide isEnabled and
+	// queueEnable; hooks.ForEach(fn) must call fn(Hook&) for every hook.
+	template <typename HookTable, typename Hook>
+	void PlanQueuedHooks(HookTable& hooks, std::vector<Hook*>& pending, IPTranslation& ips)
+	{
+		hooks.ForEach([&](Hook& hook)
+		{
+			if (hook.queueEnable == hook.isEnabled)
+			{
+				return;
+			}
+
+			pending.push_back(&hook);
+			AddHookIPs(hook, ips);
+		});
+		ips.Seal();
+	}
+}
@@ -0,0 +1,263 @@
+/* 
+ *  MinHook - Minimalistic API Hook Library	
+ *  Copyright (C) 2022 Tsuda Kageyu, indiff. All rights reserved.
+ *  
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cassert>
+#include <iterator>
+#include <utility>
+#include "slab.h"
+
+namespace MinHook
+{
+	SlabAllocator::SlabAllocator(PageProvider& pages, size_t slotSize, size_t regionSize)
+		: pages_(pages)
+		, slotSize_(slotSize)
+		, regionSize_(regionSize)
+		, minAddress_(regionSize)
+		, maxAddress_(~static_cast<uintptr_t>(0))
+	{
+		assert(("SlabAllocator::ctor", (slotSize > 0 && regionSize % slotSize == 0)));
+		assert(("SlabAllocator::ctor", (regionSize / slotSize <= 0xFFFF)));
+	}
+
+	SlabAllocator::~SlabAllocator()
+	{
+		// Regions are returned only by ReleaseAll; hooks may still run through
+		// them while the process shuts down.
+	}
+
+	void SlabAllocator::SetAddressLimits(uintptr_t minAddress, uintptr_t maxAddress)
+	{
+		minAddress_ = minAddress;
+		maxAddress_ = maxAddress;
+	}
+
+	void* SlabAllocator::Allocate(uintptr_t origin, uintptr_t maxDistance)
+	{
+		if (origin == 0)
+		{
+			if (!available_.empty())
+			{
+				return Carve(regions_.find(*available_.begin()));
+			}
+
+			void* pRegion = pages_.Reserve(0, regionSize_);
+			if (pRegion == NULL)
+			{
+				return NULL;
+			}
+
+			uintptr_t base = reinterpret_cast<uintptr_t>(pRegion);
+			available_.insert(base);
+			return Carve(regions_.insert(std::make_pair(base, REGION())).first);
+		}
+
+		uintptr_t low = (origin - minAddress_ > maxDistance && origin > minAddress_) ? origin - maxDistance : minAddress_;
+		uintptr_t high = (maxAddress_ - origin > maxDistance && origin < maxAddress_) ? origin + maxDistance : maxAddress_;
+
+		// The closest regions with room on either side of the origin. Anything
+		// further out on a side is no closer, so two probes settle it.
+		std::set<uintptr_t>::iterator next = available_.lower_bound(origin);
+		uintptr_t best = 0;
+		if (next != available_.end() && Fits(*next, low, high))
+		{
+			best = *next;
+		}
+		if (next != available_.begin())
+		{
+			uintptr_t prev = *std::prev(next);
+			if (Fits(prev, low, high) && (best == 0 || origin - prev < best - origin))
+			{
+				best = prev;
+			}
+		}
+		if (best != 0)
+		{
+			return Carve(regions_.find(best));
+		}
+
+		// Otherwise reserve the free region nearest to the origin.
+		uintptr_t belowFrom = AlignDown(origin);
+		uintptr_t aboveFrom = belowFrom + regionSize_;
+		uintptr_t below = 0;
+		uintptr_t above = 0;
+		bool hasBelow = belowFrom >= low && FindFreeBelow(belowFrom, low, below);
+		bool hasAbove = aboveFrom > belowFrom && FindFreeAbove(aboveFrom, high, above);
+		while (hasBelow || hasAbove)
+		{
+			bool useBelow = hasBelow && (!hasAbove || origin - below <= above - origin);
+			void* pRegion = pages_.Reserve(useBelow ? below : above, regionSize_);
+			if (pRegion != NULL)
+			{
+				uintptr_t base = reinterpret_cast<uintptr_t>(pRegion);
+				available_.insert(base);
+				return Carve(regions_.insert(std::make_pair(base, REGION())).first);
+			}
+
+			// Taken in the meantime; keep looking past it.
+			if (useBelow)
+			{
+				hasBelow = below >= low + regionSize_ && FindFreeBelow(below - regionSize_, low, below);
+			}
+			else
+			{
+				hasAbove = above + regionSize_ > above && FindFreeAbove(above + regionSize_, high, above);
+			}
+		}
+
+		return NULL;
+	}
+
+	void SlabAllocator::Free(void* pSlot)
+	{
+		uintptr_t address = reinterpret_cast<uintptr_t>(pSlot);
+		std::map<uintptr_t, REGION>::iterator region = regions_.upper_bound(address);
+		assert(("SlabAllocator::Free", (region != regions_.begin())));
+		--region;
+		assert(("SlabAllocator::Free", (address - region->first < regionSize_)));
+		assert(("SlabAllocator::Free", ((address - region->first) % slotSize_ == 0)));
+
+		REGION& r = region->second;
+		r.freeSlots.push_back(static_cast<uint16_t>((address - region->first) / slotSize_));
+		r.live--;
+		available_.insert(region->first);
+	}
+
+	void SlabAllocator::ReleaseAll()
+	{
+		for (std::map<uintptr_t, REGION>::iterator region = regions_.begin();
+			region != regions_.end(); region++)
+		{
+			pages_.Release(reinterpret_cast<void*>(region->first), regionSize_);
+		}
+
+		regions_.clear();
+		available_.clear();
+	}
+
+	bool SlabAllocator::Fits(uintptr_t base, uintptr_t low, uintptr_t high) const
+	{
+		return base >= low && base + (regionSize_ - 1) <= high;
+	}
+
+	void* SlabAllocator::Carve(std::map<uintptr_t, REGION>::iterator region)
+	{
+		REGION& r = region->second;
+		size_t index;
+		if (!r.freeSlots.empty())
+		{
+			index = r.freeSlots.back();
+			r.freeSlots.pop_back();
+		}
+		else
+		{
+			index = r.carved++;
+		}
+		r.live++;
+
+		if (r.freeSlots.empty() && r.carved == regionSize_ / slotSize_)
+		{
+			available_.erase(region->first);
+		}
+
+		return reinterpret_cast<void*>(region->first + index * slotSize_);
+	}
+
+	// Walks down from `from` (aligned) to the first aligned free region not
+	// below `low`, skipping whole allocations at a time.
+	bool SlabAllocator::FindFreeBelow(uintptr_t from, uintptr_t low, uintptr_t& found)
+	{
+		uintptr_t candidate = from;
+		while (candidate >= low)
+		{
+			PAGE_REGION region;
+			if (!pages_.Query(candidate, region))
+			{
+				return false;
+			}
+
+			if (region.isFree && candidate + regionSize_ <= region.base + region.size)
+			{
+				found = candidate;
+				return true;
+			}
+
+			uintptr_t next = region.isFree ? candidate : AlignDown(region.base);
+			if (next >= candidate)
+			{
+				if (candidate < low + regionSize_)
+				{
+					return false;
+				}
+				next = candidate - regionSize_;
+			}
+			candidate = next;
+		}
+
+		return false;
+	}
+
+	// Walks up from `from` (aligned) to the first aligned free region that
+	// ends at or below `high`.
+	bool SlabAllocator::FindFreeAbove(uintptr_t from, uintptr_t high, uintptr_t& found)
+	{
+		uintptr_t candidate = from;
+		while (candidate <= high && high - candidate >= regionSize_ - 1)
+		{
+			PAGE_REGION region;
+			if (!pages_.Query(candidate, region))
+			{
+				return false;
+			}
+
+			if (region.isFree && candidate + regionSize_ <= region.base + region.size)
+			{
+				found = candidate;
+				return true;
+			}
+
+			uintptr_t end = region.base + region.size;
+			uintptr_t next = AlignDown(end + regionSize_ - 1);
+			if (end == 0 || next <= candidate)
+			{
+				next = candidate + regionSize_;
+			}
+			if (next < candidate)
+			{
+				return false;
+			}
+			candidate = next;
+		}
+
+		return false;
+	}
+
+	uintptr_t SlabAllocator::AlignDown(uintptr_t address) const
+	{
+		return address - address % regionSize_;
+	}
+}
@@ -0,0 +1,114 @@
+/* 
+ *  MinHook - Minimalistic API Hook Library	
+ *  Copyright (C) 2022 Tsuda Kageyu, indiff. All rights reserved.
+ *  
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *  
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// Fixed-size slot allocator for trampoline memory. The address space is
+// reached only through PageProvider, so the allocator can be built and
+// exercised on any platform against a simulated address space.
+
+#include <vector>
+#include <map>
+#include <set>
+#include <cstddef>
+#include "pstdint.h"
+
+namespace MinHook
+{
+	struct PAGE_REGION
+	{
+		uintptr_t	base;
+		size_t		size;
+		bool		isFree;		// Neither reserved nor committed
+	};
+
+	class PageProvider
+	{
+	public:
+		virtual ~PageProvider() {}
+
+		// Describes the run of pages with the same state that contains address.
+		// Returns false when the address cannot be queried.
+		virtual bool	Query(uintptr_t address, PAGE_REGION& region) = 0;
+		// Reserves and commits size bytes as executable code at address, or
+		// anywhere when address is 0. Returns NULL on failure.
+		virtual void*	Reserve(uintptr_t address, size_t size) = 0;
+		virtual void	Release(void* pAddress, size_t size) = 0;
+	};
+
+	// Carves regionSize regions obtained from a PageProvider into slotSize
+	// slots. Each region keeps its own list of freed slots; regions with room
+	// are indexed by address, so finding one near a target is logarithmic and
+	// reusing a freed slot makes no calls to the provider. Not thread safe.
+	class SlabAllocator
+	{
+	private:
+		struct REGION
+		{
+			size_t				carved;		// Slots handed out at least once
+			size_t				live;		// Slots currently allocated
+			std::vector<uint16_t>	freeSlots;
+		};
+
+		PageProvider&	pages_;
+		size_t			slotSize_;
+		size_t			regionSize_;
+		uintptr_t		minAddress_;
+		uintptr_t		maxAddress_;
+		std::map<uintptr_t, REGION>	regions_;
+		std::set<uintptr_t>			available_;	// Regions with room left
+	public:
+		SlabAllocator(PageProvider& pages, size_t slotSize, size_t regionSize);
+		~SlabAllocator();
+
+		// Regions are only placed inside [minAddress, maxAddress].
+		void	SetAddressLimits(uintptr_t minAddress, uintptr_t maxAddress);
+
+		// Returns a slot whose whole region lies within maxDistance of origin,
+		// or anywhere when origin is 0. Returns NULL when no such memory can
+		// be reserved.
+		void*	Allocate(uintptr_t origin, uintptr_t maxDistance);
+		void	Free(void* pSlot);
+		// Returns every region to the provider.
+		void	ReleaseAll();
+
+		size_t	regionCount() const
+		{
+			return regions_.size();
+		}
+	private:
+		bool	Fits(uintptr_t base, uintptr_t low, uintptr_t high) const;
+		void*	Carve(std::map<uintptr_t, REGION>::iterator region);
+		bool	FindFreeBelow(uintptr_t from, uintptr_t low, uintptr_t& found);
+		bool	FindFreeAbove(uintptr_t from, uintptr_t high, uintptr_t& found);
+		uintptr_t	AlignDown(uintptr_t address) const;
+
+		SlabAllocator(const SlabAllocator&);
+		const SlabAllocator& operator=(const SlabAllocator&);
+	};
+}
@@ -101,12 +101,10 @@ namespace MinHook
 // ScopedThreadExclusive ̎
 namespace MinHook
 {
-	ScopedThreadExclusive::ScopedThreadExclusive(const std::vector<uintptr_t>& oldIPs, const std::vector<uintptr_t>& newIPs)
+	ScopedThreadExclusive::ScopedThreadExclusive(const IPTranslation& ips)
 	{
-		assert(("ScopedThreadExclusive::ctor", (oldIPs.size() == newIPs.size())));
-
 		GetThreads(threads_);
-		Freeze(threads_, oldIPs, newIPs);
+		Freeze(threads_, ips);
 	}
 
 	ScopedThreadExclusive::~ScopedThreadExclusive()
@@ -137,11 +135,8 @@ namespace MinHook
 		}
 	}
 
-	void ScopedThreadExclusive::Freeze(
-		const std::vector<DWORD>& threads, const std::vector<uintptr_t>& oldIPs, const std::vector<uintptr_t>& newIPs)
+	void ScopedThreadExclusive::Freeze(const std::vector<DWORD>& threads, const IPTranslation& ips)
 	{
-		assert(("ScopedThreadExclusive::freeze", (oldIPs.size() == newIPs.size())));
-
 		static const DWORD ThreadAccess 
 			= THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION | THREAD_SET_CONTEXT;
 		
@@ -156,7 +151,7 @@ namespace MinHook
 			c.ContextFlags = CONTEXT_CONTROL;
 			if (!GetThreadContext(hThread, &c))
 			{
-				return;
+				continue;
 			}
 
 #if defined _M_X64
@@ -164,16 +159,12 @@ namespace MinHook
 #elif defined _M_IX86
 			DWORD& ip = c.Eip;
 #endif
-			for (size_t i = 0; i < oldIPs.size(); ++i)
+			uintptr_t newIP;
+			if (ips.Translate(static_cast<uintptr_t>(ip), newIP))
 			{
-				if (ip == oldIPs[ i ])
-				{
-					ip = newIPs[ i ];
-					break;
-				}
+				ip = newIP;
+				SetThreadContext(hThread, &c);
 			}
-
-			SetThreadContext(hThread, &c);
 		}
 	}
 
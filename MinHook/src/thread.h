@@ -32,6 +32,7 @@
 #include <windows.h>
 
 #include "trampoline.h"
+#include "queue.h"
 
 namespace MinHook
 {
@@ -69,12 +70,12 @@ namespace MinHook
 	private:
 		std::vector<DWORD> threads_;
 	public:
-		ScopedThreadExclusive(const std::vector<uintptr_t>& oldIPs, const std::vector<uintptr_t>& newIPs);
+		// ips holds the fix-ups of every hook patched under this freeze.
+		explicit ScopedThreadExclusive(const IPTranslation& ips);
 		~ScopedThreadExclusive();
 	private:
 		static void GetThreads(std::vector<DWORD>& threads);
-		static void Freeze(
-			const std::vector<DWORD>& threads, const std::vector<uintptr_t>& oldIPs, const std::vector<uintptr_t>& newIPs);
+		static void Freeze(const std::vector<DWORD>& threads, const IPTranslation& ips);
 		static void Unfreeze(const std::vector<DWORD>& threads);
 	};
 }
@@ -29,25 +29,11 @@
 #include <cassert>
 #include <vector>
 #include "pstdint.h"
-
-#if defined _M_X64
-#include "hde64/include/hde64.h"
-#elif defined _M_IX86
-#include "hde32/hde32.h"
-#endif
-
+#include "decode.h"
 #include "trampoline.h"
 
 namespace MinHook { namespace
 {
-#if defined _M_X64
-	typedef hde64s hde_t;
-	inline unsigned int hde_disasm(const void* code, hde_t* hs) { return hde64_disasm(code, hs); }
-#elif defined _M_IX86
-	typedef hde32s hde_t;
-	inline unsigned int hde_disasm(const void* code, hde_t* hs) { return hde32_disasm(code, hs); }
-#endif
-
 	// ߏݗp\
 #pragma pack(push, 1)
 	struct JMP_REL
@@ -111,7 +97,7 @@ namespace MinHook
 		{
 			uint8_t *pInst = reinterpret_cast<uint8_t*>(ct.pTarget) + oldPos;
 			hde_t hs;
-			hde_disasm(pInst, &hs);
+			DecodeInstruction(pInst, &hs);
 			if ((hs.flags & F_ERROR) == F_ERROR)
 			{
 				return false;
@@ -206,6 +192,11 @@ namespace MinHook
 				return false;
 			}
 
+			if (ct.oldIPs.size() >= MAX_TRAMPOLINE_IPS)
+			{
+				return false;
+			}
+
 			ct.trampoline.resize(newPos + copySize);
 			memcpy(&ct.trampoline[ newPos ], pCopySrc, copySize);
 
@@ -32,6 +32,10 @@
 
 namespace MinHook
 {
+	// Most instructions a trampoline may hold; oldIPs/newIPs never exceed it,
+	// and each offset fits in a byte.
+	const size_t MAX_TRAMPOLINE_IPS = 8;
+
 	struct TEMP_ADDR
 	{
 		uintptr_t	address;
@@ -0,0 +1,242 @@
+//    This file is part of QTTabBar, a shell extension for Microsoft
+//    Windows Explorer.
+//
+//    QTTabBar is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+#include "BackgroundLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const int kWeightBits = 14;
+const int kWeightOne = 1 << kWeightBits;
+// Vertical sums keep 8 fractional bits so the horizontal pass fits in 32 bits.
+const int kVerticalShift = kWeightBits - 8;
+const int kFinalShift = kWeightBits + 8;
+
+int RoundToInt(double r) {
+    return (r > 0.0) ? static_cast<int>(r + 0.5) : static_cast<int>(r - 0.5);
+}
+
+struct Tap {
+    int index;
+    int weight;
+};
+
+// Filter taps for output positions [from, to) of one axis. taps[first[i]..first[i + 1])
+// belong to output from + i.
+struct AxisFilter {
+    std::vector<int> first;
+    std::vector<Tap> taps;
+    int minIndex = 0;
+    int maxIndex = 0;
+};
+
+void AddNormalized(AxisFilter& filter, const double* weights, const int* indices, int count) {
+    double total = 0;
+    for(int i = 0; i < count; ++i) {
+        total += weights[i];
+    }
+    std::size_t begin = filter.taps.size();
+    int sum = 0;
+    std::size_t largest = begin;
+    for(int i = 0; i < count; ++i) {
+        int weight = total > 0 ? RoundToInt(weights[i] / total * kWeightOne) : (i == 0 ? kWeightOne : 0);
+        if(weight == 0) {
+            continue;
+        }
+        filter.taps.push_back({indices[i], weight});
+        sum += weight;
+        if(filter.taps[largest].weight < weight) {
+            largest = filter.taps.size() - 1;
+        }
+    }
+    if(filter.taps.size() == begin) {
+        filter.taps.push_back({indices[0], kWeightOne});
+        return;
+    }
+    // Rounding must not change overall brightness.
+    filter.taps[largest].weight += kWeightOne - sum;
+}
+
+AxisFilter BuildAxisFilter(int srcLength, int dstLength, int from, int to) {
+    AxisFilter filter;
+    filter.minIndex = srcLength;
+    filter.maxIndex = -1;
+    double scale = static_cast<double>(srcLength) / dstLength;
+    std::vector<double> weights;
+    std::vector<int> indices;
+    for(int o = from; o < to; ++o) {
+        filter.first.push_back(static_cast<int>(filter.taps.size()));
+        weights.clear();
+        indices.clear();
+        if(scale >= 1.0) {
+            // Box filter over the source span this output pixel covers.
+            double lo = o * scale;
+            double hi = lo + scale;
+            int i0 = static_cast<int>(std::floor(lo));
+            int i1 = std::min(static_cast<int>(std::ceil(hi)), srcLength);
+            for(int i = i0; i < i1; ++i) {
+                weights.push_back(std::min(hi, i + 1.0) - std::max(lo, static_cast<double>(i)));
+                indices.push_back(i);
+            }
+        } else {
+            double center = (o + 0.5) * scale - 0.5;
+            int i0 = static_cast<int>(std::floor(center));
+            double fraction = center - i0;
+            weights.push_back(1.0 - fraction);
+            indices.push_back(std::max(0, std::min(i0, srcLength - 1)));
+            weights.push_back(fraction);
+            indices.push_back(std::max(0, std::min(i0 + 1, srcLength - 1)));
+        }
+        if(indices.empty()) {
+            weights.push_back(1.0);
+            indices.push_back(std::min(std::max(0, static_cast<int>(o * scale)), srcLength - 1));
+        }
+        AddNormalized(filter, weights.data(), indices.data(), static_cast<int>(indices.size()));
+    }
+    filter.first.push_back(static_cast<int>(filter.taps.size()));
+    for(const Tap& tap : filter.taps) {
+        filter.minIndex = std::min(filter.minIndex, tap.index);
+        filter.maxIndex = std::max(filter.maxIndex, tap.index);
+    }
+    return filter;
+}
+
+} // namespace
+
+namespace qttabbar {
+
+ImageRect ComputeImagePlacement(int mode, int imageWidth, int imageHeight, int windowWidth, int windowHeight) {
+    ImageRect rect = {0, 0, 0, 0};
+    if(imageWidth <= 0 || imageHeight <= 0) {
+        return rect;
+    }
+    int x = 0;
+    int y = 0;
+    int width = imageWidth;
+    int height = imageHeight;
+    switch(mode) {
+    case ImagePosLeftTop:
+        break;
+    case ImagePosRightTop:
+        x = windowWidth - imageWidth;
+        break;
+    case ImagePosLeftBottom:
+        y = windowHeight - imageHeight;
+        break;
+    case ImagePosCenter:
+        x = (windowWidth - imageWidth) >> 1;
+        y = (windowHeight - imageHeight) >> 1;
+        break;
+    case ImagePosZoom:
+        width = windowWidth;
+        height = windowHeight;
+        break;
+    case ImagePosZoomFill:
+        // Scale to the window height and centre horizontally; if that leaves the
+        // sides uncovered, scale to the width and centre vertically instead.
+        width = RoundToInt(static_cast<float>(imageWidth) * (static_cast<float>(windowHeight) / static_cast<float>(imageHeight)));
+        height = windowHeight;
+        x = -((width - windowWidth) / 2);
+        if(width < windowWidth) {
+            width = windowWidth;
+            height = RoundToInt(static_cast<float>(imageHeight) * (static_cast<float>(windowWidth) / static_cast<float>(imageWidth)));
+            x = 0;
+            y = -((height - windowHeight) / 2);
+        }
+        break;
+    case ImagePosRightBottom:
+    default:
+        x = windowWidth - imageWidth;
+        y = windowHeight - imageHeight;
+        break;
+    }
+    rect.left = x;
+    rect.top = y;
+    rect.right = x + width;
+    rect.bottom = y + height;
+    return rect;
+}
+
+bool ImagePosModeScales(int mode) {
+    return mode == ImagePosZoom || mode == ImagePosZoomFill;
+}
+
+ImageRect IntersectImageRects(const ImageRect& a, const ImageRect& b) {
+    ImageRect rect;
+    rect.left = std::max(a.left, b.left);
+    rect.top = std::max(a.top, b.top);
+    rect.right = std::min(a.right, b.right);
+    rect.bottom = std::min(a.bottom, b.bottom);
+    if(rect.IsEmpty()) {
+        rect.right = rect.left;
+        rect.bottom = rect.top;
+    }
+    return rect;
+}
+
+void ScalePremultiplied(const std::uint32_t* src, int srcWidth, int srcHeight, std::ptrdiff_t srcStride,
+                        int dstWidth, int dstHeight, const ImageRect& region,
+                        std::uint32_t* dst, std::ptrdiff_t dstStride) {
+    ImageRect full = {0, 0, dstWidth, dstHeight};
+    ImageRect area = IntersectImageRects(region, full);
+    if(area.IsEmpty() || srcWidth <= 0 || srcHeight <= 0) {
+        return;
+    }
+
+    AxisFilter columns = BuildAxisFilter(srcWidth, dstWidth, area.left, area.right);
+    AxisFilter rows = BuildAxisFilter(srcHeight, dstHeight, area.top, area.bottom);
+    int spanBegin = columns.minIndex;
+    int spanWidth = columns.maxIndex - columns.minIndex + 1;
+    // Vertically filtered source row, four channels per column.
+    std::vector<std::uint32_t> accum(static_cast<std::size_t>(spanWidth) * 4);
+
+    for(int y = 0; y < area.Height(); ++y) {
+        std::fill(accum.begin(), accum.end(), 0u);
+        for(int t = rows.first[y]; t < rows.first[y + 1]; ++t) {
+            // Channels are summed bytewise; the order is the same on both sides.
+            const std::uint8_t* line = reinterpret_cast<const std::uint8_t*>(src + rows.taps[t].index * srcStride + spanBegin);
+            std::uint32_t weight = static_cast<std::uint32_t>(rows.taps[t].weight);
+            std::uint32_t* out = accum.data();
+            std::size_t count = accum.size();
+            for(std::size_t i = 0; i < count; ++i) {
+                out[i] += line[i] * weight;
+            }
+        }
+        for(std::uint32_t& value : accum) {
+            value = (value + (1u << (kVerticalShift - 1))) >> kVerticalShift;
+        }
+
+        std::uint32_t* target = dst + y * dstStride;
+        for(int x = 0; x < area.Width(); ++x) {
+            std::uint32_t sum[4] = {0, 0, 0, 0};
+            for(int t = columns.first[x]; t < columns.first[x + 1]; ++t) {
+                const std::uint32_t* in = accum.data() + static_cast<std::size_t>(columns.taps[t].index - spanBegin) * 4;
+                std::uint32_t weight = static_cast<std::uint32_t>(columns.taps[t].weight);
+                sum[0] += in[0] * weight;
+                sum[1] += in[1] * weight;
+                sum[2] += in[2] * weight;
+                sum[3] += in[3] * weight;
+            }
+            std::uint8_t channel[4];
+            for(int c = 0; c < 4; ++c) {
+                channel[c] = static_cast<std::uint8_t>(std::min<std::uint32_t>((sum[c] + (1u << (kFinalShift - 1))) >> kFinalShift, 255u));
+            }
+            // Keep the premultiplied invariant despite rounding; alpha is the last byte.
+            for(int c = 0; c < 3; ++c) {
+                channel[c] = std::min(channel[c], channel[3]);
+            }
+            std::memcpy(target + x, channel, sizeof(channel));
+        }
+    }
+}
+
+} // namespace qttabbar
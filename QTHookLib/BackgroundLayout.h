@@ -0,0 +1,66 @@
+//    This file is part of QTTabBar, a shell extension for Microsoft
+//    Windows Explorer.
+//
+//    QTTabBar is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+#pragma once
+
+// Placement and resampling of the folder view background image. This file has
+// no Windows dependencies so the math can be checked off-target.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace qttabbar {
+
+/* 0 = Left top
+*  1 = Right top
+*  2 = Left bottom
+*  3 = Right bottom
+*  4 = Center
+*  5 = Zoom
+*  6 = Zoom Fill
+*/
+enum ImagePosMode {
+    ImagePosLeftTop = 0,
+    ImagePosRightTop = 1,
+    ImagePosLeftBottom = 2,
+    ImagePosRightBottom = 3,
+    ImagePosCenter = 4,
+    ImagePosZoom = 5,
+    ImagePosZoomFill = 6,
+};
+
+struct ImageRect {
+    int left;
+    int top;
+    int right;
+    int bottom;
+
+    int Width() const { return right - left; }
+    int Height() const { return bottom - top; }
+    bool IsEmpty() const { return right <= left || bottom <= top; }
+};
+
+// Where the image lands in window coordinates; may extend past the window.
+// Unknown modes fall back to right-bottom, as they always have.
+ImageRect ComputeImagePlacement(int mode, int imageWidth, int imageHeight, int windowWidth, int windowHeight);
+
+// True when the mode draws the image at a size other than its own.
+bool ImagePosModeScales(int mode);
+
+ImageRect IntersectImageRects(const ImageRect& a, const ImageRect& b);
+
+// Resamples premultiplied 32bpp pixels (BGRA or RGBA; channels are treated
+// alike). The source is scaled to dstWidth x dstHeight and only `region` of
+// that scaled image is written, top-down, to `dst` with `dstStride` pixels per
+// row. Downscaling averages the covered area; upscaling interpolates linearly.
+// Strides are in pixels.
+void ScalePremultiplied(const std::uint32_t* src, int srcWidth, int srcHeight, std::ptrdiff_t srcStride,
+                        int dstWidth, int dstHeight, const ImageRect& region,
+                        std::uint32_t* dst, std::ptrdiff_t dstStride);
+
+} // namespace qttabbar
@@ -0,0 +1,102 @@
+//    This file is part of QTTabBar, a shell extension for Microsoft
+//    Windows Explorer.
+//
+//    QTTabBar is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+#pragma once
+
+// Lock-free registry of per-thread records. Each thread claims at most one
+// slot, keeps the pointer in thread-local storage and touches only its own
+// slot afterwards, so the hot path is a TLS load. The registry itself is only
+// walked when a slot is claimed and at shutdown.
+
+#include <atomic>
+#include <cstdint>
+
+namespace qttabbar {
+
+template <typename T>
+class ThreadSlotRegistry {
+public:
+    struct Slot {
+        // Thread id of the owner, 0 while the slot is free.
+        std::atomic<std::uint32_t> owner;
+        T value;
+        Slot* next;
+
+        Slot() : owner(0), value(), next(nullptr) {}
+    };
+
+    ThreadSlotRegistry() : m_head(nullptr) {}
+
+    ~ThreadSlotRegistry() {
+        Slot* slot = m_head.load(std::memory_order_acquire);
+        while(slot) {
+            Slot* next = slot->next;
+            delete slot;
+            slot = next;
+        }
+    }
+
+    ThreadSlotRegistry(const ThreadSlotRegistry&) = delete;
+    ThreadSlotRegistry& operator=(const ThreadSlotRegistry&) = delete;
+
+    // Returns the slot for threadId (non-zero). A slot still owned by the same
+    // id is handed back as is; it was left behind by a thread that ended
+    // without releasing it, and its value is the caller's to clean up.
+    // Otherwise a free slot is claimed or a new one is linked in. Slots are
+    // never unlinked, so concurrent walkers always see valid nodes.
+    Slot* Acquire(std::uint32_t threadId) {
+        Slot* head = m_head.load(std::memory_order_acquire);
+        for(Slot* slot = head; slot; slot = slot->next) {
+            if(slot->owner.load(std::memory_order_acquire) == threadId) {
+                return slot;
+            }
+        }
+        for(Slot* slot = head; slot; slot = slot->next) {
+            std::uint32_t expected = 0;
+            if(slot->owner.load(std::memory_order_relaxed) == 0
+               && slot->owner.compare_exchange_strong(expected, threadId, std::memory_order_acq_rel)) {
+                return slot;
+            }
+        }
+        Slot* slot = new Slot();
+        slot->owner.store(threadId, std::memory_order_relaxed);
+        slot->next = head;
+        while(!m_head.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_acquire)) {
+        }
+        return slot;
+    }
+
+    // Hands the slot back. The value is left as is for the next owner, so
+    // release anything it holds first; the slot must not be used afterwards.
+    void Release(Slot* slot) {
+        slot->owner.store(0, std::memory_order_release);
+    }
+
+    // Visits every slot that currently has an owner. Values are only safe to
+    // touch when their owners can no longer run, e.g. at process detach.
+    template <typename Fn>
+    void ForEachOwned(Fn fn) {
+        for(Slot* slot = m_head.load(std::memory_order_acquire); slot; slot = slot->next) {
+            if(slot->owner.load(std::memory_order_acquire) != 0) {
+                fn(slot->value);
+            }
+        }
+    }
+
+    // Frees every slot; only valid once no thread can use the registry.
+    void ReleaseAll() {
+        for(Slot* slot = m_head.load(std::memory_order_acquire); slot; slot = slot->next) {
+            slot->owner.store(0, std::memory_order_release);
+        }
+    }
+
+private:
+    std::atomic<Slot*> m_head;
+};
+
+} // namespace qttabbar
@@ -21,7 +21,6 @@
 #include <UIAutomationCore.h>
 #include <algorithm>
 #include <time.h>
-#include <map>
 
 //GDI 相关 Using GDI
 #include <comdef.h>
@@ -35,6 +34,8 @@
 #pragma comment(lib, "GdiPlus.lib")
 
 #include "CComPtr.h"
+#include "BackgroundLayout.h"
+#include "ThreadSlotRegistry.h"
 #include "..\MinHook\MinHook.h"
 
 
@@ -126,6 +127,23 @@ void Log1(std::wstring log)
 #define CREATE_COM_HOOK(punk, idx, name) \
     CREATE_HOOK((*(void***)((IUnknown*)(punk)))[idx], name)
 
+// Queued variants: the hooks are enabled together by APPLY_QUEUED_HOOKS, which
+// suspends Explorer's threads once instead of once per hook.
+#define QUEUE_HOOK(address, name) {                                                             \
+    MH_STATUS ret = MH_CreateHook(address, &Detour##name, reinterpret_cast<void**>(&fp##name)); \
+    if(ret == MH_OK) ret = MH_QueueEnableHook(address);                                         \
+    if(ret == MH_OK) queuedHooks.push_back(hook##name);                                         \
+    else { Box(L"MH_CreateHook fail"); callbacks.fpHookResult(hook##name, ret); }                \
+}
+#define QUEUE_COM_HOOK(punk, idx, name) \
+    QUEUE_HOOK((*(void***)((IUnknown*)(punk)))[idx], name)
+#define APPLY_QUEUED_HOOKS() {                                                                  \
+    MH_STATUS ret = MH_ApplyQueued();                                                           \
+    if(ret != MH_OK) { Box(L"MH_ApplyQueued fail"); }                                           \
+    for(size_t i = 0; i < queuedHooks.size(); ++i) callbacks.fpHookResult(queuedHooks[i], ret); \
+    queuedHooks.clear();                                                                        \
+}
+
 // A few undocumented interfaces and classes, of which we only really need the IIDs.
 MIDL_INTERFACE("0B907F92-1B63-40C6-AA54-0D3117F03578") IListControlHost     : public IUnknown {};
 MIDL_INTERFACE("66A9CB08-4802-11d2-A561-00A0C92DBFE8") ITravelLog           : public IUnknown {};
@@ -281,15 +299,37 @@ bool m_isInitHook = false;          //Hook初始化标志 Hook init flag
 
 ULONG_PTR m_gdiplusToken;           //GDI初始化标志 GDI Init flag
 
+/*按窗口大小和定位方式缩放好的背景图
+* Background image scaled once for a window size and position mode,
+* so FillRect only has to blit the clipped part 1:1*/
+struct BackgroundSurface
+{
+    bool valid = false;
+    SIZE wndSize = { 0, 0 };
+    int imgIndex = -1;
+    int posMode = -1;
+    HDC hDC = NULL;                     //缩放模式下的缓存 cache for the scaling modes
+    HBITMAP hBmp = NULL;
+    HGDIOBJ hOldBmp = NULL;
+    qttabbar::ImageRect rect = { 0, 0, 0, 0 };  //图片所在的窗口区域 window area the image covers
+};
+
+void ReleaseBackgroundSurface(BackgroundSurface& surface);
+
 struct MyData
 {
     HWND hWnd ;
     HDC hDC ;
     SIZE size ;
     int ImgIndex ;
+    BackgroundSurface surface;
 };
-//First ThreadID
-std::map<DWORD, MyData> m_duiList;//dui句柄列表 dui handle list
+/*dui句柄列表，每个线程最多一个窗口。绘制钩子只读本线程的槽位，不查表也不加锁
+* dui handle list, at most one window per thread. The paint detours only read
+* the calling thread's slot through TLS, with no lookup and no lock*/
+typedef qttabbar::ThreadSlotRegistry<MyData> DuiRegistry;
+DuiRegistry m_duiList;
+thread_local DuiRegistry::Slot* t_duiSlot = NULL;
 
 struct Config
 {
@@ -307,6 +347,8 @@ struct Config
     std::vector<BitmapGDI*> imageList;  //背景图列表 background image list
 } m_config;                             //配置信息 config
 
+SRWLOCK m_imageLock = SRWLOCK_INIT;     //GDI+ 图片不能并发锁定 GDI+ bitmaps cannot be locked concurrently
+
 #pragma endregion
 
 // 获取 DLL 文件的目录
@@ -637,7 +679,8 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReser
 		}
    
         m_config.imageList.clear();
-        m_duiList.clear();
+        m_duiList.ForEachOwned([](MyData& dui) { ReleaseBackgroundSurface(dui.surface); });
+        m_duiList.ReleaseAll();
     }
     return true;
 }
@@ -679,20 +722,22 @@ int Initialize(CallbackStruct* cb) {
 
     // Create and enable the CoCreateInstance, RegisterDragDrop, and SHCreateShellFolderView hooks.
 	Box(L"CREATE_HOOK start");
-    CREATE_HOOK(&CoCreateInstance, CoCreateInstance)
-    CREATE_HOOK(&RegisterDragDrop, RegisterDragDrop)
+    std::vector<int> queuedHooks;
+    QUEUE_HOOK(&CoCreateInstance, CoCreateInstance)
+    QUEUE_HOOK(&RegisterDragDrop, RegisterDragDrop)
 	// 创建默认 Shell 文件夹视图对象的新实例。
 	// 对应微信打开文件、qq打开文件、钉钉打开文件会打开新的窗体  这里发现不是调用该函数，只有打开文件位置会调用这个方法
-    CREATE_HOOK(&SHCreateShellFolderView, SHCreateShellFolderView) 
+    QUEUE_HOOK(&SHCreateShellFolderView, SHCreateShellFolderView) 
 	// 定位文件函数
-    CREATE_HOOK(&SHOpenFolderAndSelectItems, SHOpenFolderAndSelectItems)
+    QUEUE_HOOK(&SHOpenFolderAndSelectItems, SHOpenFolderAndSelectItems)
     // CREATE_HOOK(&ShellExecute, ShellExecute)
 	
-	CREATE_HOOK(&CreateWindowExW, CreateWindowExW)
-    CREATE_HOOK(&DestroyWindow, DestroyWindow)
-    CREATE_HOOK(&BeginPaint, BeginPaint)
-    CREATE_HOOK(&FillRect, FillRect)
-    CREATE_HOOK(&CreateCompatibleDC, CreateCompatibleDC)
+	QUEUE_HOOK(&CreateWindowExW, CreateWindowExW)
+    QUEUE_HOOK(&DestroyWindow, DestroyWindow)
+    QUEUE_HOOK(&BeginPaint, BeginPaint)
+    QUEUE_HOOK(&FillRect, FillRect)
+    QUEUE_HOOK(&CreateCompatibleDC, CreateCompatibleDC)
+    APPLY_QUEUED_HOOKS()
 	Box(L"CREATE_HOOK end");
 	LoadSettings(true);
 	Box(L"LoadSettings end");
@@ -751,7 +796,8 @@ int InitShellBrowserHook(IShellBrowser* psb) {
     }
 
     // Create the BrowseObject hook
-    CREATE_COM_HOOK(psb, 11, BrowseObject);
+    std::vector<int> queuedHooks;
+    QUEUE_COM_HOOK(psb, 11, BrowseObject);
 
     // Vista and 7 have different IShellBrowserService interfaces.
     // Hook UpdateWindowList in whichever one we have, and get the TravelLog.
@@ -759,11 +805,11 @@ int InitShellBrowserHook(IShellBrowser* psb) {
     CComPtr<IShellBrowserService_Vista> psbsv;
     CComPtr<ITravelLog> ptl;
     if(psbs7.QueryFrom(psb)) {
-        CREATE_COM_HOOK(psbs7, 10, UpdateWindowList);
+        QUEUE_COM_HOOK(psbs7, 10, UpdateWindowList);
         psbs7->GetTravelLog(&ptl);
     }
     else if(psbsv.QueryFrom(psb)) {
-        CREATE_COM_HOOK(psbsv, 17, UpdateWindowList);
+        QUEUE_COM_HOOK(psbsv, 17, UpdateWindowList);
         psbsv->GetTravelLog(&ptl);
     }
 
@@ -771,9 +817,10 @@ int InitShellBrowserHook(IShellBrowser* psb) {
     if(ptl != NULL) {
         CComPtr<ITravelLogEx> ptlex;
         if(ptlex.QueryFrom(ptl)) {
-            CREATE_COM_HOOK(ptlex, 11, TravelToEntry);
+            QUEUE_COM_HOOK(ptlex, 11, TravelToEntry);
         }
     }
+    APPLY_QUEUED_HOOKS()
     return MH_OK;
 }
 
@@ -811,6 +858,97 @@ O_CreateCompatibleDC _CreateCompatibleDC_;
 
 #pragma endregion
 
+void ReleaseBackgroundSurface(BackgroundSurface& surface)
+{
+    if (surface.hDC)
+    {
+        SelectObject(surface.hDC, surface.hOldBmp);
+        DeleteDC(surface.hDC);
+    }
+    if (surface.hBmp)
+        DeleteObject(surface.hBmp);
+    surface = BackgroundSurface();
+}
+
+/*返回要绘制的图片 DC，缩放模式下只在窗口大小或模式改变时重新缩放
+* Returns the DC holding the image as it is drawn in this window. The scaling
+* modes are rescaled only when the window size, image or mode changes, and only
+* the part inside the window is kept.*/
+HDC EnsureBackgroundSurface(MyData& data, BitmapGDI* pBgBmp)
+{
+    BackgroundSurface& surface = data.surface;
+    if (surface.valid
+        && surface.wndSize.cx == data.size.cx && surface.wndSize.cy == data.size.cy
+        && surface.imgIndex == data.ImgIndex && surface.posMode == m_config.imgPosMode)
+    {
+        return surface.hDC ? surface.hDC : pBgBmp->pMem;
+    }
+    ReleaseBackgroundSurface(surface);
+
+    qttabbar::ImageRect placement = qttabbar::ComputeImagePlacement(
+        m_config.imgPosMode, pBgBmp->Size.cx, pBgBmp->Size.cy, data.size.cx, data.size.cy);
+    if (!qttabbar::ImagePosModeScales(m_config.imgPosMode))
+    {
+        surface.rect = placement;
+    }
+    else
+    {
+        qttabbar::ImageRect window = { 0, 0, data.size.cx, data.size.cy };
+        qttabbar::ImageRect visible = qttabbar::IntersectImageRects(placement, window);
+        if (!visible.IsEmpty())
+        {
+            BITMAPINFO bmi = {};
+            bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+            bmi.bmiHeader.biWidth = visible.Width();
+            bmi.bmiHeader.biHeight = -visible.Height();   //自上而下 top-down
+            bmi.bmiHeader.biPlanes = 1;
+            bmi.bmiHeader.biBitCount = 32;
+            bmi.bmiHeader.biCompression = BI_RGB;
+            void* bits = NULL;
+            HBITMAP hBmp = CreateDIBSection(NULL, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+            if (!hBmp)
+                return NULL;
+
+            AcquireSRWLockExclusive(&m_imageLock);
+            Gdiplus::Rect lockRect(0, 0, pBgBmp->Size.cx, pBgBmp->Size.cy);
+            Gdiplus::BitmapData locked;
+            bool ok = pBgBmp->src->LockBits(&lockRect, ImageLockModeRead, PixelFormat32bppPARGB, &locked) == Ok;
+            if (ok)
+            {
+                qttabbar::ImageRect region = { visible.left - placement.left, visible.top - placement.top,
+                                               visible.right - placement.left, visible.bottom - placement.top };
+                qttabbar::ScalePremultiplied(static_cast<const std::uint32_t*>(locked.Scan0),
+                                             pBgBmp->Size.cx, pBgBmp->Size.cy, locked.Stride / 4,
+                                             placement.Width(), placement.Height(), region,
+                                             static_cast<std::uint32_t*>(bits), visible.Width());
+                pBgBmp->src->UnlockBits(&locked);
+            }
+            ReleaseSRWLockExclusive(&m_imageLock);
+            if (!ok)
+            {
+                DeleteObject(hBmp);
+                return NULL;
+            }
+
+            //绕过自己的 CreateCompatibleDC hook Bypass our own CreateCompatibleDC detour
+            surface.hDC = fpCreateCompatibleDC ? fpCreateCompatibleDC(NULL) : CreateCompatibleDC(NULL);
+            if (!surface.hDC)
+            {
+                DeleteObject(hBmp);
+                return NULL;
+            }
+            surface.hBmp = hBmp;
+            surface.hOldBmp = SelectObject(surface.hDC, hBmp);
+        }
+        surface.rect = visible;
+    }
+    surface.valid = true;
+    surface.wndSize = data.size;
+    surface.imgIndex = data.ImgIndex;
+    surface.posMode = m_config.imgPosMode;
+    return surface.hDC ? surface.hDC : pBgBmp->pMem;
+}
+
 //////////////////////////////
 // Detour Functions
 //////////////////////////////
@@ -871,7 +1009,10 @@ HWND WINAPI DetourCreateWindowExW(
             {
 	            data.ImgIndex = 0;
             }
-            m_duiList[GetCurrentThreadId()] = data;
+            if (!t_duiSlot)
+                t_duiSlot = m_duiList.Acquire(GetCurrentThreadId());
+            ReleaseBackgroundSurface(t_duiSlot->value.surface);
+            t_duiSlot->value = data;
 			// Box1(L" mydata load hWnd suc!");
             // Box1(L"map load suc tid " + GetCurrentThreadId());
         } else
@@ -889,13 +1030,12 @@ HWND WINAPI DetourCreateWindowExW(
 BOOL WINAPI DetourDestroyWindow(HWND hWnd)
 {
     //查找并删除列表中的记录 Find and remove from list
-    auto iter = m_duiList.find(GetCurrentThreadId());
-    if (iter != m_duiList.end())
+    DuiRegistry::Slot* slot = t_duiSlot;
+    if (slot && slot->value.hWnd == hWnd)
     {
-        if (iter->second.hWnd == hWnd)
-        {
-	        m_duiList.erase(iter);
-        }
+        ReleaseBackgroundSurface(slot->value.surface);
+        t_duiSlot = NULL;
+        m_duiList.Release(slot);
     }
     // Box1(L"destory window suc");
     return fpDestroyWindow(hWnd);
@@ -908,14 +1048,29 @@ HDC WINAPI DetourBeginPaint(HWND hWnd, LPPAINTSTRUCT lpPaint)
     //开始绘制DUI窗口 BeginPaint dui window
     HDC hDC = fpBeginPaint(hWnd, lpPaint);
 
-    auto iter = m_duiList.find(GetCurrentThreadId());
+    DuiRegistry::Slot* slot = t_duiSlot;
 
-    if (iter != m_duiList.end()) {
-        if (iter->second.hWnd == hWnd)
+    if (slot) {
+        MyData& dui = slot->value;
+        if (dui.hWnd == hWnd)
         {
 	        // Box1(L" set hdc suc ");
             //记录到列表 Record values to list
-            iter->second.hDC = hDC;
+            dui.hDC = hDC;
+
+            //每次绘制只取一次窗口大小 Read the window size once per paint, not per FillRect
+            RECT pRc;
+            GetWindowRect(hWnd, &pRc);
+            SIZE wndSize = { pRc.right - pRc.left, pRc.bottom - pRc.top };
+
+            /*因图片定位方式不同 如果窗口大小改变 需要全体重绘 否则有残留
+            * Due to different image positioning methods,
+            * if the window size changes, you need to redraw, otherwise there will be residues*/
+            if ((dui.size.cx != wndSize.cx || dui.size.cy != wndSize.cy)
+                && m_config.imgPosMode != 0) {
+                InvalidateRect(hWnd, 0, TRUE);
+            }
+            dui.size = wndSize;
         }
     }
     return hDC;
@@ -928,145 +1083,36 @@ int WINAPI DetourFillRect(HDC hDC, const RECT* lprc, HBRUSH hbr)
 
 
 	// Box1(L"DetourFillRect in ");
-    auto iter = m_duiList.find(GetCurrentThreadId());
+    DuiRegistry::Slot* slot = t_duiSlot;
 
-	if (iter->second.hDC == hDC )
-	{
-		// Box1(L" resolve hdc suc" );
-	}
-    if (iter != m_duiList.end()) {
-        if (iter->second.hDC == hDC && m_config.imageList.size())
+    if (slot) {
+        MyData& dui = slot->value;
+        if (dui.hDC == hDC && m_config.imageList.size())
         {
-			// Box1(L" second hdc suc" );
-            RECT pRc;
-            GetWindowRect(iter->second.hWnd, &pRc);
-            SIZE wndSize = { pRc.right - pRc.left, pRc.bottom - pRc.top };
-
-            /*因图片定位方式不同 如果窗口大小改变 需要全体重绘 否则有残留
-            * Due to different image positioning methods,
-            * if the window size changes, you need to redraw, otherwise there will be residues*/
-            if ((iter->second.size.cx != wndSize.cx || iter->second.size.cy != wndSize.cy)
-                && m_config.imgPosMode != 0) {
-                InvalidateRect(iter->second.hWnd, 0, TRUE);
-            }
-			
-			// Box1(L"InvalidateRect suc ");
-
-            //裁剪矩形 Clip rect
-            SaveDC(hDC);
-            IntersectClipRect(hDC, lprc->left, lprc->top, lprc->right, lprc->bottom);
-
-			// Box1(L"SaveDC IntersectClipRect suc ");
-            BitmapGDI* pBgBmp = m_config.imageList[iter->second.ImgIndex];
-
-            //计算图片位置 Calculate picture position
-            POINT pos;
-            SIZE dstSize = { pBgBmp->Size.cx, pBgBmp->Size.cy };
-
-			// Box1(L"calc pos suc ");
-            switch (m_config.imgPosMode)
+            BitmapGDI* pBgBmp = m_config.imageList[dui.ImgIndex];
+            HDC srcDC = EnsureBackgroundSurface(dui, pBgBmp);
+            const qttabbar::ImageRect& img = dui.surface.rect;
+            RECT imgRc = { img.left, img.top, img.right, img.bottom };
+            RECT clip;
+
+            /*只绘制与填充区域相交的部分，1:1 不再拉伸
+            * Paint only the part under the filled rect, 1:1 without stretching*/
+            if (srcDC && IntersectRect(&clip, lprc, &imgRc))
             {
-            case 0://左上
-                 pos.x = 0;
-                pos.y = 0;
-                break;
-            case 1://右上
-                pos.x = wndSize.cx - pBgBmp->Size.cx;
-                pos.y = 0;
-                break;
-            case 2://左下
-                pos.x = 0;
-                pos.y = wndSize.cy - pBgBmp->Size.cy;
-                break;
-            case 3://右下
-                pos.x = wndSize.cx - pBgBmp->Size.cx;
-                pos.y = wndSize.cy - pBgBmp->Size.cy;
-                break;
-            case 4://居中正常顯示
-                pos.x = (wndSize.cx - pBgBmp->Size.cx) >> 1;
-                pos.y = (wndSize.cy - pBgBmp->Size.cy) >> 1;
-                break;
-            case 5://缩放
-                  {
-                      int newWidth = wndSize.cx;
-                      int newHeight = wndSize.cy;
-                      pos.x = 0;
-                      pos.y = 0;
-
-                      // dstSize = { newWidth, newHeight };
-
-					 dstSize.cx = newWidth;
-                     dstSize.cy = newHeight;
-                  }
-                  break;
-            case 6://缩放并填充
-                 {
-                     /*static auto calcAspectRatio = [](int fromWidth, int fromHeight, int toWidthOrHeight, bool isWidth)
-                     {
-                         if (isWidth) {
-                             return (int)(((float)fromHeight * ((float)toWidthOrHeight / (float)fromWidth)));
-                         }
-                         else {
-                             return (int)(((float)fromWidth * ((float)toWidthOrHeight / (float)fromHeight)));
-                         }
-                     };*/
-					 
-                     //按高等比例拉伸
-                     // int newWidth = calcAspectRatio(pBgBmp->Size.cx, pBgBmp->Size.cy, wndSize.cy, false);
-					 
-                     int newWidth =  round_int((float)pBgBmp->Size.cx * ((float)wndSize.cy / (float)pBgBmp->Size.cy));
-                     int newHeight = wndSize.cy;
-
-                     pos.x = newWidth - wndSize.cx;
-                     pos.x /= 2;//居中
-                     if (pos.x != 0) pos.x = -pos.x;
-                     pos.y = 0;
-
-					
-                     //按高不足以填充宽 按宽
-                     if (newWidth < wndSize.cx) {
-                         newWidth = wndSize.cx;
-                         newHeight = round_int((float)pBgBmp->Size.cy * ((float)wndSize.cx / (float)pBgBmp->Size.cx));
-                         // newHeight = calcAspectRatio(pBgBmp->Size.cx, pBgBmp->Size.cy, wndSize.cx, true);
-                         pos.x = 0;
-                         pos.y = newHeight - wndSize.cy;
-                         pos.y /= 2;//居中
-                         if (pos.y != 0) pos.y = -pos.y;
-                     }
-                     // dstSize = { newWidth, newHeight };
-					 dstSize.cx = newWidth;
-                     dstSize.cy = newHeight;
-                 }
-				 
-				// Box1(L"imgPosMode is 6 break");
-                break;
-            default://默認右下
-                pos.x = wndSize.cx - pBgBmp->Size.cx;
-                pos.y = wndSize.cy - pBgBmp->Size.cy;
-                break;
+                BLENDFUNCTION bf = { AC_SRC_OVER, 0, m_config.imgAlpha, AC_SRC_ALPHA };
+                AlphaBlend(
+                    hDC,
+                    clip.left,
+                    clip.top,
+                    clip.right - clip.left,
+                    clip.bottom - clip.top,
+                    srcDC,
+                    clip.left - imgRc.left,
+                    clip.top - imgRc.top,
+                    clip.right - clip.left,
+                    clip.bottom - clip.top,
+                    bf);
             }
-			
-            /*绘制图片 Paint image*/
-            BLENDFUNCTION bf = { AC_SRC_OVER, 0, m_config.imgAlpha, AC_SRC_ALPHA };
-			
-			// Box1(L"BLENDFUNCTION suc");
-            AlphaBlend(
-                hDC, 
-                pos.x, 
-                pos.y, 
-                dstSize.cx, 
-                dstSize.cy, 
-                pBgBmp->pMem, 
-                0, 
-                0, 
-                pBgBmp->Size.cx, 
-                pBgBmp->Size.cy, 
-				bf);
-			// Box1(L"AlphaBlend suc");
-            RestoreDC(hDC, -1);
-			// Box1(L"RestoreDC suc");
-            iter->second.size = wndSize;
-            // Log(L"DrawImage");
         }
     }
     return ret;
@@ -1079,11 +1125,11 @@ HDC WINAPI DetourCreateCompatibleDC(HDC hDC)
     //CreateCompatibleDC is called before drawing the DUI
     HDC retDC = fpCreateCompatibleDC(hDC);
 
-    auto iter = m_duiList.find(GetCurrentThreadId());
-    if (iter != m_duiList.end()) {
-        if (iter->second.hDC == hDC)
+    DuiRegistry::Slot* slot = t_duiSlot;
+    if (slot) {
+        if (slot->value.hDC == hDC)
         {
-	        iter->second.hDC = retDC;
+	        slot->value.hDC = retDC;
 	        // Box1(L" second hdc suc");
         }
     }
@@ -1120,25 +1166,27 @@ HRESULT WINAPI DetourSHCreateShellFolderView(const SFV_CREATE* pcsfv, IShellView
     if(SUCCEEDED(ret) && psv.Implements(IID_CDefView)) {
 		// Box2(L"CREATE_COM_HOOK MessageSFVCB")
 		// 注册成功
-        CREATE_COM_HOOK(pcsfv->psfvcb, 3, MessageSFVCB)
+        std::vector<int> queuedHooks;
+        QUEUE_COM_HOOK(pcsfv->psfvcb, 3, MessageSFVCB)
 
         CComPtr<IShellView3> psv3;
         if(psv3.QueryFrom(psv)) {
 			// Box2(L"CREATE_COM_HOOK CreateViewWindow3")
 			// 注册成功
-            CREATE_COM_HOOK(psv3, 20, CreateViewWindow3)
+            QUEUE_COM_HOOK(psv3, 20, CreateViewWindow3)
         }
 
         CComPtr<IListControlHost> plch;
         if(plch.QueryFrom(psv)) {
 			// Box2(L"CREATE_COM_HOOK OnActivateSelection")
 			// 不会执行
-			CREATE_COM_HOOK(plch, 3, OnActivateSelection)
+			QUEUE_COM_HOOK(plch, 3, OnActivateSelection)
         }
 		
 
         // Disable this hook, no need for it anymore.
-        MH_DisableHook(&SHCreateShellFolderView);
+        MH_QueueDisableHook(&SHCreateShellFolderView);
+        APPLY_QUEUED_HOOKS()
     }
     return ret;
 }
@@ -0,0 +1,195 @@
+// Checks where ComputeImagePlacement puts the folder background for every
+// imgPosMode, and ScalePremultiplied against hand-computed buffers for box
+// downscaling, linear upscaling and copies. Random images check that a region
+// matches the same part of a full scale, that flat colours stay flat and that
+// no channel exceeds alpha. Then times scaling a wallpaper-sized image for a
+// full repaint and for a partial one.
+//
+// BackgroundLayoutTest [rounds]
+
+#include "BackgroundLayout.h"
+
+#include "TestSupport.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+std::uint32_t Pixel(std::uint8_t b, std::uint8_t g, std::uint8_t r, std::uint8_t a) {
+    std::uint8_t bytes[4] = {b, g, r, a};
+    std::uint32_t pixel;
+    std::memcpy(&pixel, bytes, sizeof(pixel));
+    return pixel;
+}
+
+std::uint8_t Channel(std::uint32_t pixel, int index) {
+    std::uint8_t bytes[4];
+    std::memcpy(bytes, &pixel, sizeof(bytes));
+    return bytes[index];
+}
+
+bool Same(const ImageRect& rect, int left, int top, int right, int bottom) {
+    return rect.left == left && rect.top == top && rect.right == right && rect.bottom == bottom;
+}
+
+void CheckPlacement() {
+    // A 200x100 image in an 800x600 window.
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosLeftTop, 200, 100, 800, 600), 0, 0, 200, 100));
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosRightTop, 200, 100, 800, 600), 600, 0, 800, 100));
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosLeftBottom, 200, 100, 800, 600), 0, 500, 200, 600));
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosRightBottom, 200, 100, 800, 600), 600, 500, 800, 600));
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosCenter, 200, 100, 800, 600), 300, 250, 500, 350));
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosZoom, 200, 100, 800, 600), 0, 0, 800, 600));
+    // Fitted to the height, 1200 wide, and centred with the sides cut off.
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosZoomFill, 200, 100, 800, 600), -200, 0, 1000, 600));
+    // A tall image fitted to the height leaves the sides bare, so it is fitted
+    // to the width and centred vertically instead.
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosZoomFill, 100, 400, 800, 600), 0, -1300, 800, 1900));
+    // Odd leftovers round towards the top left; larger images hang over.
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosCenter, 201, 101, 800, 600), 299, 249, 500, 350));
+    QT_CHECK(Same(ComputeImagePlacement(ImagePosCenter, 1000, 700, 800, 600), -100, -50, 900, 650));
+    // Unknown modes draw right-bottom; an empty image is placed nowhere.
+    QT_CHECK(Same(ComputeImagePlacement(9, 200, 100, 800, 600), 600, 500, 800, 600));
+    QT_CHECK(ComputeImagePlacement(ImagePosZoom, 0, 100, 800, 600).IsEmpty());
+
+    for(int mode = 0; mode <= 6; ++mode) {
+        QT_CHECK(ImagePosModeScales(mode) == (mode == ImagePosZoom || mode == ImagePosZoomFill));
+    }
+    QT_CHECK(Same(IntersectImageRects({0, 0, 10, 10}, {5, -5, 20, 8}), 5, 0, 10, 8));
+    ImageRect apart = IntersectImageRects({0, 0, 10, 10}, {20, 20, 30, 30});
+    QT_CHECK(apart.IsEmpty() && apart.Width() == 0 && apart.Height() == 0);
+}
+
+std::vector<std::uint32_t> Scale(const std::vector<std::uint32_t>& src, int srcWidth, int srcHeight, int dstWidth,
+                                 int dstHeight) {
+    std::vector<std::uint32_t> dst(static_cast<std::size_t>(dstWidth) * dstHeight, 0xDEADBEEFu);
+    ScalePremultiplied(src.data(), srcWidth, srcHeight, srcWidth, dstWidth, dstHeight, {0, 0, dstWidth, dstHeight},
+                       dst.data(), dstWidth);
+    return dst;
+}
+
+void CheckGoldenBuffers() {
+    // Halving averages pairs, rounding halves up.
+    std::vector<std::uint32_t> row = {Pixel(10, 20, 30, 255), Pixel(20, 40, 60, 255), Pixel(0, 0, 0, 0),
+                                      Pixel(100, 100, 100, 201)};
+    std::vector<std::uint32_t> halved = {Pixel(15, 30, 45, 255), Pixel(50, 50, 50, 101)};
+    QT_CHECK(Scale(row, 4, 1, 2, 1) == halved);
+    QT_CHECK(Scale(row, 1, 4, 1, 2) == halved);
+
+    // Doubling interpolates between pixel centres and clamps at the edges.
+    std::vector<std::uint32_t> pair = {Pixel(40, 80, 120, 200), Pixel(200, 160, 120, 255)};
+    std::vector<std::uint32_t> doubled = {pair[0], Pixel(80, 100, 120, 214), Pixel(160, 140, 120, 241), pair[1]};
+    QT_CHECK(Scale(pair, 2, 1, 4, 1) == doubled);
+    QT_CHECK(Scale(pair, 1, 2, 1, 4) == doubled);
+
+    // Same size is a copy; one pixel fills everything.
+    std::vector<std::uint32_t> square(9);
+    for(std::size_t i = 0; i < square.size(); ++i) {
+        square[i] = Pixel(static_cast<std::uint8_t>(i), static_cast<std::uint8_t>(2 * i), 7, 200);
+    }
+    QT_CHECK(Scale(square, 3, 3, 3, 3) == square);
+    QT_CHECK(Scale({Pixel(1, 2, 3, 4)}, 1, 1, 3, 2) == std::vector<std::uint32_t>(6, Pixel(1, 2, 3, 4)));
+
+    // Three into two: each output covers one and a half source pixels.
+    std::vector<std::uint32_t> three = {Pixel(0, 0, 0, 255), Pixel(90, 90, 90, 255), Pixel(180, 180, 180, 255)};
+    QT_CHECK(Scale(three, 3, 1, 2, 1) == (std::vector<std::uint32_t>{Pixel(30, 30, 30, 255), Pixel(150, 150, 150, 255)}));
+
+    // An empty region or source writes nothing.
+    std::vector<std::uint32_t> untouched(4, 0xDEADBEEFu);
+    ScalePremultiplied(row.data(), 4, 1, 4, 2, 2, {5, 5, 9, 9}, untouched.data(), 2);
+    ScalePremultiplied(row.data(), 0, 1, 4, 2, 2, {0, 0, 2, 2}, untouched.data(), 2);
+    QT_CHECK(untouched == std::vector<std::uint32_t>(4, 0xDEADBEEFu));
+}
+
+std::vector<std::uint32_t> RandomImage(std::mt19937& rng, int width, int height) {
+    std::vector<std::uint32_t> image(static_cast<std::size_t>(width) * height);
+    for(std::uint32_t& pixel : image) {
+        std::uint8_t alpha = static_cast<std::uint8_t>(rng() % 4 == 0 ? 255 : rng());
+        pixel = Pixel(static_cast<std::uint8_t>(rng() % (alpha + 1u)), static_cast<std::uint8_t>(rng() % (alpha + 1u)),
+                      static_cast<std::uint8_t>(rng() % (alpha + 1u)), alpha);
+    }
+    return image;
+}
+
+void CheckRandomImages() {
+    std::mt19937 rng(13);
+    for(int round = 0; round < 40; ++round) {
+        int srcWidth = 1 + static_cast<int>(rng() % 120);
+        int srcHeight = 1 + static_cast<int>(rng() % 120);
+        int dstWidth = 1 + static_cast<int>(rng() % 120);
+        int dstHeight = 1 + static_cast<int>(rng() % 120);
+        std::vector<std::uint32_t> src = RandomImage(rng, srcWidth, srcHeight);
+        std::vector<std::uint32_t> full = Scale(src, srcWidth, srcHeight, dstWidth, dstHeight);
+        for(std::uint32_t pixel : full) {
+            for(int c = 0; c < 3; ++c) {
+                QT_CHECK(Channel(pixel, c) <= Channel(pixel, 3));
+            }
+        }
+
+        // WM_PAINT for part of the window scales just that part, the same way.
+        ImageRect region = {static_cast<int>(rng() % dstWidth), static_cast<int>(rng() % dstHeight), 0, 0};
+        region.right = region.left + 1 + static_cast<int>(rng() % (dstWidth - region.left));
+        region.bottom = region.top + 1 + static_cast<int>(rng() % (dstHeight - region.top));
+        std::ptrdiff_t stride = region.Width() + 3;
+        std::vector<std::uint32_t> part(static_cast<std::size_t>(stride) * region.Height(), 0xDEADBEEFu);
+        ScalePremultiplied(src.data(), srcWidth, srcHeight, srcWidth, dstWidth, dstHeight, region, part.data(), stride);
+        for(int y = 0; y < region.Height(); ++y) {
+            for(int x = 0; x < stride; ++x) {
+                std::uint32_t expected = x < region.Width()
+                                             ? full[static_cast<std::size_t>(region.top + y) * dstWidth + region.left + x]
+                                             : 0xDEADBEEFu;
+                QT_CHECK(part[static_cast<std::size_t>(y * stride + x)] == expected);
+            }
+        }
+
+        std::vector<std::uint32_t> flat(src.size(), Pixel(12, 34, 56, 78));
+        QT_CHECK(Scale(flat, srcWidth, srcHeight, dstWidth, dstHeight)
+                 == std::vector<std::uint32_t>(full.size(), Pixel(12, 34, 56, 78)));
+    }
+}
+
+void Benchmark(unsigned long rounds) {
+    std::mt19937 rng(2);
+    const int srcWidth = 1920;
+    const int srcHeight = 1080;
+    std::vector<std::uint32_t> src = RandomImage(rng, srcWidth, srcHeight);
+    struct Case {
+        const char* name;
+        int width;
+        int height;
+        ImageRect region;
+    };
+    const Case cases[] = {
+        {"down to 1280x720", 1280, 720, {0, 0, 1280, 720}},
+        {"up to 2560x1440", 2560, 1440, {0, 0, 2560, 1440}},
+        {"2560x1440, 256x256 part", 2560, 1440, {1000, 600, 1256, 856}},
+    };
+    std::printf("%-24s | %10s | %10s\n", "1920x1080 scaled", "ms", "Mpixel/s");
+    for(const Case& c : cases) {
+        std::vector<std::uint32_t> dst(static_cast<std::size_t>(c.region.Width()) * c.region.Height());
+        auto start = Clock::now();
+        for(unsigned long i = 0; i < rounds; ++i) {
+            ScalePremultiplied(src.data(), srcWidth, srcHeight, srcWidth, c.width, c.height, c.region, dst.data(),
+                               c.region.Width());
+        }
+        double each = ElapsedNanoseconds(start) / rounds;
+        std::printf("%-24s | %10.2f | %10.0f\n", c.name, each / 1e6, dst.size() / each * 1e3);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckPlacement();
+    CheckGoldenBuffers();
+    CheckRandomImages();
+    Benchmark(qttabbar::test::CountArgument(argc, argv, 1, 20));
+    std::puts("ok");
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Stresses BoundedExecutor: submissions from many threads never exceed the
+// thread or queue limits, every accepted task runs once or is counted as
+// dropped by Shutdown, and a full queue refuses work.
+//
+// BoundedExecutorTest [tasks per submitter]
+
+#include "BoundedExecutor.h"
+
+#include "TestSupport.h"
+
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using qttabbar::BoundedExecutor;
+
+void CheckRefusesWhenFull() {
+    BoundedExecutor executor(1, 2);
+    std::mutex gate;
+    gate.lock();
+    std::atomic<bool> started{false};
+    QT_CHECK(executor.TrySubmit([&]() {
+        started = true;
+        std::lock_guard<std::mutex> wait(gate);
+    }));
+    while(!started) {
+        std::this_thread::yield();
+    }
+    QT_CHECK(executor.TrySubmit([]() {}));
+    QT_CHECK(executor.TrySubmit([]() {}));
+    QT_CHECK(!executor.TrySubmit([]() {}));
+    QT_CHECK(executor.ThreadCount() == 1 && executor.QueuedCount() == 2);
+    gate.unlock();
+    while(executor.QueuedCount() > 0) {
+        std::this_thread::yield();
+    }
+    QT_CHECK(executor.TrySubmit([]() {}));
+    executor.Shutdown();
+}
+
+void Stress(std::size_t maxThreads, std::size_t capacity, int submitters, unsigned long perSubmitter) {
+    std::atomic<int> running{0};
+    std::atomic<int> peak{0};
+    std::atomic<unsigned long> ran{0};
+    std::atomic<unsigned long> accepted{0};
+    std::atomic<unsigned long> refused{0};
+    std::vector<std::atomic<int>> runs(submitters * perSubmitter);
+    std::size_t dropped = 0;
+    {
+        BoundedExecutor executor(maxThreads, capacity);
+        std::vector<std::thread> threads;
+        for(int s = 0; s < submitters; ++s) {
+            threads.emplace_back([&, s]() {
+                std::mt19937 rng(s);
+                for(unsigned long i = 0; i < perSubmitter; ++i) {
+                    std::size_t id = s * perSubmitter + i;
+                    bool ok = executor.TrySubmit([&, id]() {
+                        int now = ++running;
+                        int highest = peak;
+                        while(now > highest && !peak.compare_exchange_weak(highest, now)) {
+                        }
+                        ++runs[id];
+                        ++ran;
+                        std::this_thread::sleep_for(std::chrono::microseconds(id % 50));
+                        --running;
+                    });
+                    ++(ok ? accepted : refused);
+                    QT_CHECK(executor.ThreadCount() <= maxThreads);
+                    QT_CHECK(executor.QueuedCount() <= capacity);
+                    if(rng() % 8 == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for(auto& thread : threads) {
+            thread.join();
+        }
+        dropped = executor.Shutdown();
+        QT_CHECK(!executor.TrySubmit([]() {}));
+    }
+    for(auto& count : runs) {
+        QT_CHECK(count <= 1);
+    }
+    QT_CHECK(ran + dropped == accepted);
+    QT_CHECK(static_cast<std::size_t>(peak) <= maxThreads);
+    std::printf("%zu threads, queue %zu: %lu accepted, %lu refused, %lu ran, %zu dropped, peak %d running\n",
+                maxThreads, capacity, accepted.load(), refused.load(), ran.load(), dropped, peak.load());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned long tasks = qttabbar::test::CountArgument(argc, argv, 1, 5000);
+    CheckRefusesWhenFull();
+    Stress(4, 16, 8, tasks);
+    Stress(1, 1, 4, tasks / 2);
+    Stress(8, 256, 16, tasks / 2);
+    Stress(2, 0, 2, 100);
+    std::puts("ok");
+    return 0;
+}
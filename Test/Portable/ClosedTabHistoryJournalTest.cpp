@@ -0,0 +1,247 @@
+// Shares one in-memory store between journals the way Explorer processes share
+// the registry key: saves from either must be seen by the other, no sequence
+// number may be written twice, and every access must hold the storage lock.
+// Then times saves into a 10k-entry history with the head check against the
+// full snapshot-and-journal read it replaced.
+//
+// ClosedTabHistoryJournalTest [saves]
+
+#include "ClosedTabHistoryJournal.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+// The shared key. Entries read counts every path and record copied out.
+struct Storage {
+    std::mutex mutex;
+    std::atomic<bool> locked{false};
+    bool hasSnapshot = false;
+    std::deque<std::wstring> snapshot;
+    std::uint64_t journalBase = 0;
+    std::map<std::uint64_t, std::wstring> journal;
+    bool hasHead = false;
+    std::uint64_t head = 0;
+    std::uint64_t entriesRead = 0;
+};
+
+class MemoryBackend final : public IClosedTabHistoryBackend {
+public:
+    // Without a head the backend looks like a history stored before there was one.
+    MemoryBackend(Storage& storage, bool writeHead) : m_storage(storage), m_writeHead(writeHead) {
+    }
+
+    void LockStorage() override {
+        m_storage.mutex.lock();
+        m_storage.locked = true;
+    }
+
+    void UnlockStorage() override {
+        m_storage.locked = false;
+        m_storage.mutex.unlock();
+    }
+
+    bool ReadSnapshot(std::deque<std::wstring>& entries, std::uint64_t& journalBase) override {
+        QT_CHECK(m_storage.locked);
+        if(!m_storage.hasSnapshot) {
+            return false;
+        }
+        entries = m_storage.snapshot;
+        journalBase = m_storage.journalBase;
+        m_storage.entriesRead += entries.size();
+        return true;
+    }
+
+    std::vector<std::wstring> ReadJournal(std::uint64_t journalBase) override {
+        QT_CHECK(m_storage.locked);
+        std::vector<std::wstring> records;
+        for(auto it = m_storage.journal.find(journalBase); it != m_storage.journal.end() && it->first == journalBase;
+            ++it, ++journalBase) {
+            records.push_back(it->second);
+        }
+        m_storage.entriesRead += records.size();
+        return records;
+    }
+
+    bool ReadHead(std::uint64_t& nextSequence) override {
+        QT_CHECK(m_storage.locked);
+        nextSequence = m_storage.head;
+        return m_storage.hasHead;
+    }
+
+    bool AppendJournal(std::uint64_t sequence, const std::wstring& record) override {
+        QT_CHECK(m_storage.locked);
+        QT_CHECK(m_storage.journal.emplace(sequence, record).second);
+        MoveHead(sequence + 1);
+        return true;
+    }
+
+    bool WriteSnapshot(const std::deque<std::wstring>& entries, std::uint64_t journalBase) override {
+        QT_CHECK(m_storage.locked);
+        QT_CHECK(!m_storage.hasSnapshot || journalBase > m_storage.journalBase);
+        m_storage.hasSnapshot = true;
+        m_storage.snapshot = entries;
+        m_storage.journalBase = journalBase;
+        MoveHead(journalBase);
+        return true;
+    }
+
+    void DiscardJournal(std::uint64_t first, std::uint64_t last) override {
+        QT_CHECK(m_storage.locked);
+        m_storage.journal.erase(m_storage.journal.lower_bound(first), m_storage.journal.lower_bound(last));
+    }
+
+    void Clear() override {
+        QT_CHECK(m_storage.locked);
+        m_storage.hasSnapshot = false;
+        m_storage.snapshot.clear();
+        m_storage.journalBase = 0;
+        m_storage.journal.clear();
+        m_storage.hasHead = false;
+        m_storage.head = 0;
+    }
+
+private:
+    void MoveHead(std::uint64_t nextSequence) {
+        if(m_writeHead) {
+            m_storage.hasHead = true;
+            m_storage.head = nextSequence;
+        }
+    }
+
+    Storage& m_storage;
+    bool m_writeHead;
+};
+
+std::unique_ptr<ClosedTabHistoryJournal> OpenJournal(Storage& storage, bool writeHead = true) {
+    return std::make_unique<ClosedTabHistoryJournal>(std::make_unique<MemoryBackend>(storage, writeHead));
+}
+
+// Closes a tab, reopens one, or sometimes clears the list.
+void Mutate(std::deque<std::wstring>& history, std::mt19937& rng) {
+    switch(rng() % 8) {
+    case 0:
+        if(!history.empty()) {
+            history.erase(history.begin() + static_cast<std::ptrdiff_t>(rng() % history.size()));
+        }
+        break;
+    case 1:
+        if(rng() % 10 == 0) {
+            history.clear();
+        }
+        break;
+    default: {
+        std::wstring path = L"C:\\dir" + std::to_wstring(rng() % 64);
+        history.erase(std::remove(history.begin(), history.end(), path), history.end());
+        history.push_front(path);
+        break;
+    }
+    }
+}
+
+void CheckSharedStorage(unsigned long saves) {
+    Storage storage;
+    auto first = OpenJournal(storage);
+    auto second = OpenJournal(storage);
+    std::mt19937 rng(3);
+    std::deque<std::wstring> history;
+    for(unsigned long i = 0; i < saves; ++i) {
+        ClosedTabHistoryJournal& journal = rng() % 2 ? *first : *second;
+        if(rng() % 50 == 0) {
+            journal.Clear();
+            history.clear();
+        } else {
+            Mutate(history, rng);
+            journal.Save(history);
+        }
+        QT_CHECK(OpenJournal(storage)->Load() == history);
+    }
+    QT_CHECK(first->Load() == history && second->Load() == history);
+
+    // A store written before the head existed is still checked in full.
+    Storage legacy;
+    auto old = OpenJournal(legacy, false);
+    auto other = OpenJournal(legacy, false);
+    history.clear();
+    for(unsigned long i = 0; i < saves / 4; ++i) {
+        Mutate(history, rng);
+        (i % 3 ? *old : *other).Save(history);
+        QT_CHECK(OpenJournal(legacy, false)->Load() == history);
+    }
+}
+
+// Each thread owns a journal and saves its own paths; whatever interleaving
+// the lock allows, no sequence number is written twice and a fresh load
+// matches what the last saver sees.
+void CheckConcurrentSaves(unsigned long saves) {
+    Storage storage;
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&storage, saves, t]() {
+            auto journal = OpenJournal(storage);
+            std::mt19937 rng(t);
+            for(unsigned long i = 0; i < saves; ++i) {
+                std::deque<std::wstring> history = journal->Load();
+                Mutate(history, rng);
+                journal->Save(history);
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    auto last = OpenJournal(storage);
+    std::deque<std::wstring> history = last->Load();
+    QT_CHECK(OpenJournal(storage)->Load() == history);
+}
+
+// Saves that each close one tab into a history of `entries` paths.
+void Benchmark(std::size_t entries, unsigned long saves) {
+    std::deque<std::wstring> start;
+    for(std::size_t i = 0; i < entries; ++i) {
+        start.push_back(L"C:\\Users\\someone\\Documents\\project\\folder" + std::to_wstring(i));
+    }
+    for(bool head : {false, true}) {
+        Storage storage;
+        auto journal = OpenJournal(storage, head);
+        journal->Save(start);
+        std::deque<std::wstring> history = start;
+        std::uint64_t readBefore = storage.entriesRead;
+        auto begin = Clock::now();
+        for(unsigned long i = 0; i < saves; ++i) {
+            history.push_front(L"C:\\closed" + std::to_wstring(i));
+            history.pop_back();
+            journal->Save(history);
+        }
+        double perSave = ElapsedNanoseconds(begin) / saves;
+        std::uint64_t read = storage.entriesRead - readBefore;
+        QT_CHECK(OpenJournal(storage)->Load() == history);
+        std::printf("%zu entries, %s: %.1f us per save, %.1f entries read per save\n", entries,
+                    head ? "head check" : "full check", perSave / 1e3,
+                    static_cast<double>(read) / saves);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned long saves = qttabbar::test::CountArgument(argc, argv, 1, 2000);
+    CheckSharedStorage(saves);
+    CheckConcurrentSaves(saves / 4);
+    Benchmark(10000, saves);
+    std::puts("ok");
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Drives ConfigDiffWriter against a fake store through random saves: no-op
+// saves, saves that fail half-way, and saves that cover one category only.
+// After every step the store must hold the configuration, having been sent
+// only what changed. Also checks that values a baseline lacks or holds with
+// another type are written.
+//
+// ConfigDiffWriterTest [rounds]
+
+#include "ConfigDiffWriter.h"
+
+#include "TestSupport.h"
+
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace {
+
+using namespace qttabbar;
+
+// Values by category and name. A failing store writes the first value of
+// each category and then reports failure.
+class FakeStore final : public IConfigValueStore {
+public:
+    bool Write(const ConfigValueSet& changes) override {
+        ++batches;
+        lastBatch = 0;
+        for(const ConfigCategoryValues& category : changes) {
+            for(const auto& [name, value] : category.values) {
+                data[{category.category, name}] = value;
+                ++lastBatch;
+                if(fail) {
+                    break;
+                }
+            }
+        }
+        return !fail;
+    }
+
+    bool Holds(const ConfigValueSet& values) const {
+        for(const ConfigCategoryValues& category : values) {
+            for(const auto& [name, value] : category.values) {
+                auto found = data.find({category.category, name});
+                if(found == data.end() || found->second != value) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::map<std::pair<std::wstring, std::wstring>, ConfigValue> data;
+    bool fail = false;
+    std::size_t batches = 0;
+    std::size_t lastBatch = 0;
+};
+
+std::size_t CountValues(const ConfigValueSet& values) {
+    std::size_t count = 0;
+    for(const ConfigCategoryValues& category : values) {
+        count += category.values.size();
+    }
+    return count;
+}
+
+// Twelve categories of thirteen values, every fourth a JSON string.
+ConfigValueSet MakeConfig(std::mt19937& rng) {
+    ConfigValueSet config;
+    for(const wchar_t* name : {L"Window", L"Tabs", L"Tweaks", L"Tips", L"Misc", L"Skin", L"BBar", L"Mouse", L"Keys",
+                               L"Plugin", L"Lang", L"Desktop"}) {
+        ConfigCategoryValues category{name, {}};
+        for(int i = 0; i < 13; ++i) {
+            std::wstring valueName = L"V" + std::to_wstring(i);
+            if(i % 4 == 0) {
+                category.SetString(valueName.c_str(), L"{\"x\":" + std::to_wstring(rng() % 3) + L"}");
+            } else {
+                category.SetDword(valueName.c_str(), rng() % 2);
+            }
+        }
+        config.push_back(std::move(category));
+    }
+    return config;
+}
+
+// Changes `edits` values, sometimes reordering a category as well, and
+// returns how many values now differ.
+std::size_t Mutate(ConfigValueSet& config, std::mt19937& rng, int edits) {
+    ConfigValueSet before = config;
+    for(int i = 0; i < edits; ++i) {
+        ConfigCategoryValues& category = config[rng() % config.size()];
+        ConfigValue& value = category.values[rng() % category.values.size()].second;
+        if(value.type == ConfigValue::Type::Dword) {
+            value.dword ^= 1;
+        } else {
+            value.string += L"!";
+        }
+        if(rng() % 5 == 0) {
+            std::swap(category.values.front(), category.values.back());
+        }
+    }
+    return CountValues(DiffConfigValues(before, config));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned long rounds = qttabbar::test::CountArgument(argc, argv, 1, 300);
+    std::mt19937 rng(7);
+    for(unsigned long round = 0; round < rounds; ++round) {
+        FakeStore store;
+        ConfigDiffWriter writer;
+        ConfigValueSet config = MakeConfig(rng);
+        // Without a baseline everything is written.
+        QT_CHECK(writer.Save(config, store));
+        QT_CHECK(writer.Stats().lastWritten == CountValues(config) && store.Holds(config));
+        for(int step = 0; step < 20; ++step) {
+            switch(rng() % 10) {
+            case 0: {
+                std::size_t batches = store.batches;
+                QT_CHECK(writer.Save(config, store));
+                QT_CHECK(writer.Stats().lastWritten == 0 && store.batches == batches);
+                break;
+            }
+            case 1: {
+                // A failed save drops the baseline, so the next writes everything.
+                ConfigValueSet next = config;
+                std::size_t changed = Mutate(next, rng, 3);
+                store.fail = true;
+                bool saved = writer.Save(next, store);
+                store.fail = false;
+                QT_CHECK(saved == (changed == 0));
+                if(!saved) {
+                    QT_CHECK(writer.BaselineGeneration() == ConfigDiffWriter::kNoGeneration);
+                    QT_CHECK(writer.Save(next, store) && writer.Stats().lastWritten == CountValues(next));
+                    config = next;
+                }
+                break;
+            }
+            case 2: {
+                // Saving one category merges it into the baseline.
+                ConfigValueSet next = config;
+                Mutate(next, rng, 4);
+                ConfigValueSet desktop{next.back()};
+                std::size_t changed = CountValues(DiffConfigValues(config, desktop));
+                QT_CHECK(writer.Save(desktop, store) && writer.Stats().lastWritten == changed);
+                config.back() = desktop.back();
+                QT_CHECK(writer.Save(config, store) && writer.Stats().lastWritten == 0);
+                break;
+            }
+            default: {
+                ConfigValueSet next = config;
+                std::size_t changed = Mutate(next, rng, 1 + rng() % 4);
+                QT_CHECK(writer.Save(next, store));
+                QT_CHECK(writer.Stats().lastWritten == changed);
+                QT_CHECK(changed == 0 || store.lastBatch == changed);
+                config = next;
+                break;
+            }
+            }
+            QT_CHECK(store.Holds(config));
+        }
+    }
+
+    // A baseline read as stored: a value that is missing, or stored as a
+    // string where a DWORD belongs, is written even though the parsed
+    // configuration would have matched.
+    {
+        std::mt19937 seeded(3);
+        ConfigValueSet config = MakeConfig(seeded);
+        ConfigValueSet stored = config;
+        stored[0].values.erase(stored[0].values.begin() + 2);
+        std::wstring name = stored[4].values[1].first;
+        stored[4].values.erase(stored[4].values.begin() + 1);
+        stored[4].SetString(name.c_str(), std::to_wstring(config[4].values[1].second.dword));
+        FakeStore store;
+        store.Write(stored);
+        ConfigDiffWriter writer;
+        writer.SetBaseline(stored, 1);
+        QT_CHECK(writer.Save(config, store) && writer.Stats().lastWritten == 2 && store.Holds(config));
+        QT_CHECK(writer.Save(config, store) && writer.Stats().lastWritten == 0);
+    }
+
+    // One checkbox changed on a full configuration.
+    std::mt19937 fixed(1);
+    FakeStore store;
+    ConfigDiffWriter writer;
+    ConfigValueSet config = MakeConfig(fixed);
+    writer.SetBaseline(config, 1);
+    config[1].values[3].second.dword ^= 1;
+    QT_CHECK(writer.Save(config, store) && writer.Stats().lastWritten == 1 && store.batches == 1);
+    std::printf("one checkbox: compared %zu values, wrote %zu\n", CountValues(config), writer.Stats().lastWritten);
+    std::puts("ok");
+    return 0;
+}
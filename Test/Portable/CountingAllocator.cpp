@@ -0,0 +1,38 @@
+// Replaces the global operator new and delete to count allocations, for the
+// tests that check a path allocates nothing. Link it into those tests only.
+//
+// Kept out of the tests themselves: where GCC can see these definitions, it
+// inlines the delete into library code and warns that free() is called on
+// memory from operator new.
+
+#include "TestSupport.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<long> g_allocations{0};
+
+} // namespace
+
+long qttabbar::test::AllocationCount() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    ::operator delete(p);
+}
@@ -0,0 +1,218 @@
+// Checks that MinHook's DecodeInstruction agrees with HDE on every opcode,
+// ModR/M and SIB combination and on random bytes, then times both on
+// function prologues.
+//
+// DecodeInstructionTest [random inputs] [prologue file]
+//
+// The prologue file holds 32-byte records, each the start of a function,
+// e.g. taken from the exports of system DLLs.
+
+#include <stdint.h>
+
+#include "decode.h"
+
+#include "TestSupport.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace MinHook;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+#if defined _M_X64
+const char* const kMode = "x64";
+const int kLastRex = 0x4F;
+
+unsigned int Reference(const void* code, hde_t* hs) {
+    return hde64_disasm(code, hs);
+}
+#else
+const char* const kMode = "x86";
+const int kLastRex = 0x3F;  // No REX prefixes
+
+unsigned int Reference(const void* code, hde_t* hs) {
+    return hde32_disasm(code, hs);
+}
+#endif
+
+// Compiler-generated prologues and thunks, as hex with spaces for readability.
+const char* const kPrologues[] = {
+#if defined _M_X64
+    "48895c2408 4889742410 57 4883ec20",
+    "4053 4883ec20 488b05 78563412 4833c4 4889442410",
+    "4c8bdc 49895b08 49897310 57 4881ec 80000000",
+    "ff25 00100000",
+    "48ff25 00100000",
+    "e9 00100000",
+    "4c8bd1 b8 55000000 f604250803fe7f01 7503 0f05 c3",
+    "0f1f440000 4883ec28",
+    "cc cc cc cc",
+    "65488b042530000000 c3",
+    "4055 5356 57 488d6c24e1 4881ec b0000000",
+    "48894c2408 4883ec38",
+    "488bc4 488958 08 48896810",
+    "f30f1efa 55 4889e5",
+#else
+    "8bff 55 8bec 83ec10",
+    "6a14 68 00100000 e8 00100000",
+    "55 8bec 81ec 00010000 a1 00300000 33c5 8945fc",
+    "64a100000000 50",
+    "ff25 00200000",
+    "8bff 55 8bec 5d e9 00100000",
+    "53 56 57 8b7c2410",
+    "b8 01000000 c20400",
+    "90 90 90 90 90 8bff",
+#endif
+};
+
+// Decoding may read past the instruction, so every buffer is padded.
+constexpr size_t kPaddedSize = 48;
+
+unsigned long g_checked = 0;
+
+void Check(const uint8_t* code) {
+    hde_t expected;
+    hde_t actual;
+    Reference(code, &expected);
+    DecodeInstruction(code, &actual);
+    ++g_checked;
+    if(std::memcmp(&expected, &actual, sizeof(expected)) != 0) {
+        std::fprintf(stderr, "mismatch on");
+        for(int i = 0; i < 16; ++i) {
+            std::fprintf(stderr, " %02x", code[i]);
+        }
+        std::fprintf(stderr, ": hde len %u flags %x, decode len %u flags %x\n", expected.len, expected.flags,
+                     actual.len, actual.flags);
+        std::abort();
+    }
+}
+
+void CheckExhaustive() {
+    std::mt19937 rng(1);
+    uint8_t code[kPaddedSize];
+    for(int rex = 0x3F; rex <= kLastRex; ++rex) {
+        for(int opcode = 0; opcode < 256; ++opcode) {
+            for(int modrm = 0; modrm < 256; ++modrm) {
+                bool hasSib = (modrm >> 6) != 3 && (modrm & 7) == 4;
+                for(int sib = 0; sib < (hasSib ? 256 : 1); ++sib) {
+                    size_t length = 0;
+                    if(rex >= 0x40) {
+                        code[length++] = static_cast<uint8_t>(rex);
+                    }
+                    code[length++] = static_cast<uint8_t>(opcode);
+                    code[length++] = static_cast<uint8_t>(modrm);
+                    code[length++] = static_cast<uint8_t>(hasSib ? sib : rng());
+                    while(length < sizeof(code)) {
+                        code[length++] = static_cast<uint8_t>(rng());
+                    }
+                    Check(code);
+                }
+            }
+        }
+    }
+}
+
+// Random bytes, often led by prefixes and escape bytes. Each input is decoded
+// twice, the second time from DecodeInstruction's cache.
+void CheckRandom(unsigned long inputs) {
+    static const uint8_t kLeads[] = {0x0f, 0x66, 0x67, 0xf2, 0xf3, 0xf0, 0x2e, 0x64, 0x65, 0x48, 0x4c, 0x41};
+    std::mt19937 rng(2);
+    uint8_t code[kPaddedSize];
+    for(unsigned long i = 0; i < inputs; ++i) {
+        for(uint8_t& byte : code) {
+            byte = static_cast<uint8_t>(rng());
+        }
+        for(unsigned lead = 0, leads = rng() % 4; lead < leads; ++lead) {
+            code[lead] = kLeads[rng() % sizeof(kLeads)];
+        }
+        Check(code);
+        Check(code);
+    }
+}
+
+std::vector<std::vector<uint8_t>> LoadPrologues(const char* path) {
+    std::vector<std::vector<uint8_t>> prologues;
+    for(const char* hex : kPrologues) {
+        std::vector<uint8_t> code;
+        for(const char* p = hex; *p;) {
+            if(*p == ' ') {
+                ++p;
+                continue;
+            }
+            unsigned byte = 0;
+            QT_CHECK(std::sscanf(p, "%2x", &byte) == 1);
+            code.push_back(static_cast<uint8_t>(byte));
+            p += 2;
+        }
+        code.resize(kPaddedSize, 0xcc);
+        prologues.push_back(std::move(code));
+    }
+    if(path) {
+        FILE* file = std::fopen(path, "rb");
+        QT_CHECK(file != nullptr);
+        uint8_t record[32];
+        while(std::fread(record, 1, sizeof(record), file) == sizeof(record)) {
+            std::vector<uint8_t> code(record, record + sizeof(record));
+            code.resize(kPaddedSize, 0xcc);
+            prologues.push_back(std::move(code));
+        }
+        std::fclose(file);
+    }
+    return prologues;
+}
+
+// Decodes at least the five bytes a hook overwrites, as
+// CreateTrampolineFunction does.
+template<typename Decoder>
+double TimePrologues(const std::vector<std::vector<uint8_t>>& prologues, int rounds, Decoder decode) {
+    size_t instructions = 0;
+    volatile size_t sink = 0;
+    auto start = Clock::now();
+    for(int round = 0; round < rounds; ++round) {
+        for(const auto& code : prologues) {
+            size_t offset = 0;
+            while(offset < 5) {
+                hde_t hs;
+                unsigned int length = decode(&code[offset], &hs);
+                if(hs.flags & F_ERROR) {
+                    break;
+                }
+                offset += length;
+                ++instructions;
+            }
+            sink = sink + offset;
+        }
+    }
+    return ElapsedNanoseconds(start) / instructions;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckExhaustive();
+    CheckRandom(qttabbar::test::CountArgument(argc, argv, 1, 4000000));
+    auto prologues = LoadPrologues(argc > 2 ? argv[2] : nullptr);
+    for(const auto& code : prologues) {
+        for(size_t offset = 0; offset < 24;) {
+            Check(&code[offset]);
+            hde_t hs;
+            unsigned int length = Reference(&code[offset], &hs);
+            if(hs.flags & F_ERROR) {
+                break;
+            }
+            offset += length;
+        }
+    }
+    std::printf("%s: %lu inputs agree, %zu prologues\n", kMode, g_checked, prologues.size());
+
+    int rounds = static_cast<int>(2000000 / prologues.size());
+    double hde = TimePrologues(prologues, rounds, Reference);
+    double table = TimePrologues(prologues, rounds, DecodeInstruction);
+    std::printf("prologues: hde %.1f ns/instruction, DecodeInstruction %.1f ns/instruction\n", hde, table);
+    std::puts("ok");
+    return 0;
+}
@@ -0,0 +1,237 @@
+// Enumerates a scratch directory on AsyncDirectoryEnumerator's worker the way
+// SubDirTipWindow does: streamed batches followed by the sorted listing, with
+// the selection made on the batches carried over by path. Checks that
+// superseded and cancelled requests deliver nothing, then times the first
+// batch against a synchronous enumerate-and-sort.
+//
+// DirectoryEnumeratorTest [entries]
+
+#include "DirectoryEnumerator.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+namespace fs = std::filesystem;
+
+// Stands in for the window's message queue: the worker posts, the test waits.
+class Mailbox {
+public:
+    AsyncDirectoryEnumerator::NotifyFn Notifier() {
+        return [this]() {
+            std::lock_guard guard(m_mutex);
+            ++m_posted;
+            m_ready.notify_all();
+        };
+    }
+
+    void Wait() {
+        std::unique_lock lock(m_mutex);
+        m_ready.wait(lock, [this] { return m_posted > m_taken; });
+        m_taken = m_posted;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    int m_posted = 0;
+    int m_taken = 0;
+};
+
+fs::path MakeDirectory(const char* name, std::size_t entries) {
+    fs::path directory = fs::temp_directory_path() / name;
+    std::error_code ec;
+    fs::remove_all(directory, ec);
+    fs::create_directories(directory);
+    std::mt19937 rng(static_cast<unsigned>(entries));
+    for(std::size_t i = 0; i < entries; ++i) {
+        std::string leaf = (rng() % 2 ? "Item " : "item") + std::to_string(rng() % 100000) + "_" + std::to_string(i);
+        if(i % 5 == 0) {
+            fs::create_directory(directory / leaf);
+        } else {
+            std::ofstream(directory / (leaf + ".txt")) << i;
+        }
+    }
+    return directory;
+}
+
+std::set<std::wstring> Paths(const std::vector<DirectoryEntry>& entries) {
+    std::set<std::wstring> paths;
+    for(const DirectoryEntry& entry : entries) {
+        paths.insert(entry.path);
+    }
+    return paths;
+}
+
+void CheckMapEntryPositions() {
+    std::vector<DirectoryEntry> from(6);
+    for(std::size_t i = 0; i < from.size(); ++i) {
+        from[i].path = L"/d/" + std::to_wstring(i);
+    }
+    std::vector<DirectoryEntry> to = {from[5], from[3], from[0], from[4], from[1]};
+    QT_CHECK((MapEntryPositions(from, {0, 3, 2, 9}, to) == std::vector<std::size_t>{1, 2}));
+    QT_CHECK((MapEntryPositions(from, {5, 1}, to) == std::vector<std::size_t>{0, 4}));
+    QT_CHECK(MapEntryPositions(from, {}, to).empty() && MapEntryPositions(from, {2}, to).empty());
+}
+
+// OnListingReady: append batches, and when the sorted listing arrives, move
+// the rows picked so far to where their items now are.
+void CheckListing(const fs::path& directory, std::size_t entries) {
+    Mailbox mailbox;
+    AsyncDirectoryEnumerator enumerator({64});
+    std::uint64_t generation = enumerator.Start(directory.wstring(), nullptr, mailbox.Notifier());
+    QT_CHECK(generation == enumerator.CurrentGeneration());
+
+    std::vector<DirectoryEntry> shown;
+    std::vector<std::size_t> selected;
+    std::set<std::wstring> selectedPaths;
+    std::mt19937 rng(2);
+    std::size_t batches = 0;
+    bool complete = false;
+    while(!complete) {
+        mailbox.Wait();
+        for(auto& update : enumerator.TakeUpdates()) {
+            QT_CHECK(update.generation == generation);
+            if(update.complete) {
+                QT_CHECK(!update.failed && update.stamp.has_value());
+                std::vector<std::size_t> moved = MapEntryPositions(shown, selected, update.entries);
+                shown = std::move(update.entries);
+                selected = std::move(moved);
+                complete = true;
+            } else {
+                ++batches;
+                shown.insert(shown.end(), update.entries.begin(), update.entries.end());
+                // The user picks a row while the listing streams in.
+                std::size_t row = rng() % shown.size();
+                if(std::find(selected.begin(), selected.end(), row) == selected.end()) {
+                    selected.push_back(row);
+                    selectedPaths.insert(shown[row].path);
+                }
+            }
+        }
+    }
+    enumerator.WaitIdle();
+
+    std::vector<DirectoryEntry> expected;
+    QT_CHECK(EnumerateDirectory(directory.wstring(), nullptr, [&](DirectoryEntry&& entry) {
+        expected.push_back(std::move(entry));
+        return true;
+    }));
+    SortDirectoryEntries(expected);
+    QT_CHECK(shown.size() == entries && expected.size() == entries);
+    for(std::size_t i = 0; i < entries; ++i) {
+        QT_CHECK(shown[i].path == expected[i].path && shown[i].isDirectory == expected[i].isDirectory);
+    }
+    QT_CHECK(batches == entries / 64);
+    std::set<std::wstring> after;
+    for(std::size_t row : selected) {
+        after.insert(shown[row].path);
+    }
+    QT_CHECK(after == selectedPaths);
+    QT_CHECK(std::is_sorted(selected.begin(), selected.end()));
+}
+
+// A new request replaces one in flight, and a cancelled one delivers nothing,
+// however far the worker got.
+void CheckSuperseded(const fs::path& large, const fs::path& small) {
+    for(int round = 0; round < 20; ++round) {
+        Mailbox mailbox;
+        AsyncDirectoryEnumerator enumerator({16});
+        enumerator.Start(large.wstring(), nullptr, mailbox.Notifier());
+        std::uint64_t generation = enumerator.Start(small.wstring(), nullptr, mailbox.Notifier());
+        enumerator.WaitIdle();
+        std::vector<DirectoryEntry> shown;
+        for(auto& update : enumerator.TakeUpdates()) {
+            QT_CHECK(update.generation == generation);
+            if(update.complete) {
+                shown = std::move(update.entries);
+            }
+        }
+        QT_CHECK(Paths(shown).size() == 40 && shown.front().path.find(small.wstring()) == 0);
+
+        enumerator.Start(large.wstring(), nullptr, mailbox.Notifier());
+        if(round % 2) {
+            mailbox.Wait();
+        }
+        enumerator.Cancel();
+        enumerator.WaitIdle();
+        QT_CHECK(enumerator.TakeUpdates().empty());
+    }
+
+    // A filter is applied on the worker, and a missing directory completes as failed.
+    Mailbox mailbox;
+    AsyncDirectoryEnumerator enumerator;
+    enumerator.Start(small.wstring(), [](const DirectoryEntry& entry) { return entry.isDirectory; },
+                     mailbox.Notifier());
+    enumerator.WaitIdle();
+    auto updates = enumerator.TakeUpdates();
+    QT_CHECK(updates.size() == 1 && updates[0].complete && updates[0].entries.size() == 8);
+    enumerator.Start((small / "missing").wstring(), nullptr, mailbox.Notifier());
+    enumerator.WaitIdle();
+    updates = enumerator.TakeUpdates();
+    QT_CHECK(updates.size() == 1 && updates[0].failed && updates[0].entries.empty() && !updates[0].stamp);
+
+    // Destroying the enumerator mid-walk returns once the worker notices.
+    auto busy = std::make_unique<AsyncDirectoryEnumerator>(AsyncDirectoryEnumerator::Options{1});
+    busy->Start(large.wstring(), nullptr, []() {});
+    busy.reset();
+}
+
+void Benchmark(const fs::path& directory, std::size_t entries) {
+    const int rounds = 10;
+    double firstBatch = 0;
+    double asyncTotal = 0;
+    for(int round = 0; round < rounds; ++round) {
+        Mailbox mailbox;
+        AsyncDirectoryEnumerator enumerator;
+        auto start = Clock::now();
+        enumerator.Start(directory.wstring(), nullptr, mailbox.Notifier());
+        mailbox.Wait();
+        firstBatch += ElapsedNanoseconds(start);
+        enumerator.WaitIdle();
+        asyncTotal += ElapsedNanoseconds(start);
+    }
+    double sync = 0;
+    for(int round = 0; round < rounds; ++round) {
+        auto start = Clock::now();
+        std::vector<DirectoryEntry> listing;
+        EnumerateDirectory(directory.wstring(), nullptr, [&](DirectoryEntry&& entry) {
+            listing.push_back(std::move(entry));
+            return true;
+        });
+        SortDirectoryEntries(listing);
+        sync += ElapsedNanoseconds(start);
+    }
+    std::printf("%zu entries: first rows after %.2f ms, sorted after %.2f ms; synchronous %.2f ms on the UI thread\n",
+                entries, firstBatch / rounds / 1e6, asyncTotal / rounds / 1e6, sync / rounds / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t entries = qttabbar::test::CountArgument(argc, argv, 1, 5000);
+    fs::path large = MakeDirectory("DirectoryEnumeratorTest.large", entries);
+    fs::path small = MakeDirectory("DirectoryEnumeratorTest.small", 40);
+    CheckMapEntryPositions();
+    CheckListing(large, entries);
+    CheckSuperseded(large, small);
+    Benchmark(large, entries);
+    std::error_code ec;
+    fs::remove_all(large, ec);
+    fs::remove_all(small, ec);
+    std::puts("ok");
+    return 0;
+}
@@ -0,0 +1,177 @@
+// Stores listings of a scratch directory in DirectoryListingCache the way
+// SubDirTipWindow does, then creates, renames, deletes and edits children to
+// check which changes invalidate the entry through the directory stamp and
+// which only through maxAge. Also checks the LRU limits and times a cached
+// lookup against enumerating and sorting the folder again.
+//
+// DirectoryListingCacheTest [entries]
+
+#include "DirectoryListingCache.h"
+
+#include "TestSupport.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using namespace std::chrono_literals;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+namespace fs = std::filesystem;
+
+// A clock the test moves by hand.
+struct ManualNow {
+    DirectoryListingCache::TimePoint now{};
+
+    DirectoryListingCache::NowFn Fn() {
+        return [this]() { return now; };
+    }
+};
+
+void Touch(const fs::path& file, const std::string& text) {
+    std::ofstream(file, std::ios::trunc) << text;
+}
+
+// SubDirTipWindow::LoadItemsNow: stamp first, then enumerate, sort and store.
+std::vector<DirectoryEntry> LoadInto(DirectoryListingCache& cache, const fs::path& directory) {
+    std::optional<std::int64_t> stamp = ReadDirectoryStamp(directory.wstring());
+    std::vector<DirectoryEntry> listing;
+    QT_CHECK(stamp && EnumerateDirectory(directory.wstring(), nullptr, [&](DirectoryEntry&& entry) {
+                 listing.push_back(std::move(entry));
+                 return true;
+             }));
+    SortDirectoryEntries(listing);
+    cache.Store(directory.wstring(), *stamp, listing);
+    return listing;
+}
+
+// Directory stamps tick as coarsely as the file system's clock, so leave a
+// gap before each change for it to show.
+template<typename Change>
+void AfterTick(Change&& change) {
+    std::this_thread::sleep_for(20ms);
+    change();
+}
+
+void CheckInvalidation(const fs::path& directory) {
+    ManualNow clock;
+    DirectoryListingCache cache(DirectoryListingCache::Limits{}, ReadDirectoryStamp, clock.Fn());
+    std::wstring path = directory.wstring();
+    QT_CHECK(!cache.Lookup(path) && cache.GetStats().misses == 1);
+
+    LoadInto(cache, directory);
+    QT_CHECK(cache.Lookup(path) && cache.GetStats().hits == 1);
+
+    // Adding, renaming and removing a child change the directory stamp.
+    AfterTick([&] { Touch(directory / "added.txt", "a"); });
+    QT_CHECK(!cache.Lookup(path) && cache.GetStats().stale == 1);
+    LoadInto(cache, directory);
+    AfterTick([&] { fs::rename(directory / "added.txt", directory / "renamed.txt"); });
+    QT_CHECK(!cache.Lookup(path) && cache.GetStats().stale == 2);
+    LoadInto(cache, directory);
+    AfterTick([&] { fs::remove(directory / "renamed.txt"); });
+    QT_CHECK(!cache.Lookup(path) && cache.GetStats().stale == 3);
+
+    // Rewriting a child in place leaves the directory stamp alone, so the
+    // listing, with its old "Modified" time, is served until maxAge passes.
+    std::vector<DirectoryEntry> before = LoadInto(cache, directory);
+    std::int64_t oldTime = before.back().modified;
+    AfterTick([&] { Touch(before.back().path, "edited in place"); });
+    QT_CHECK(ReadFileStamp(before.back().path) != oldTime);
+    clock.now += 4s;
+    auto listing = cache.Lookup(path);
+    QT_CHECK(listing && listing->back().modified == oldTime && cache.GetStats().stale == 3);
+    clock.now += 1001ms;
+    QT_CHECK(!cache.Lookup(path) && cache.GetStats().stale == 4);
+    std::vector<DirectoryEntry> after = LoadInto(cache, directory);
+    QT_CHECK(after.back().modified == *ReadFileStamp(before.back().path));
+
+    // A directory that went away is dropped, and Invalidate drops at once.
+    fs::path gone = directory / "gone";
+    fs::create_directory(gone);
+    LoadInto(cache, gone);
+    fs::remove(gone);
+    QT_CHECK(!cache.Lookup(gone.wstring()));
+    LoadInto(cache, directory);
+    QT_CHECK(cache.Lookup(path));
+    cache.Invalidate(path);
+    QT_CHECK(!cache.Lookup(path) && cache.GetStats().listings == 0);
+}
+
+std::vector<DirectoryEntry> FakeListing(std::size_t count) {
+    std::vector<DirectoryEntry> listing(count);
+    for(std::size_t i = 0; i < count; ++i) {
+        listing[i].name = L"entry" + std::to_wstring(i);
+        listing[i].path = L"/fake/" + listing[i].name;
+    }
+    return listing;
+}
+
+void CheckLimits() {
+    ManualNow clock;
+    DirectoryListingCache::Limits limits;
+    limits.maxEntries = 100;
+    auto stamp = [](const std::wstring&) { return std::optional<std::int64_t>(1); };
+    DirectoryListingCache cache(limits, stamp, clock.Fn());
+    for(int i = 0; i < 5; ++i) {
+        cache.Store(L"/fake/" + std::to_wstring(i), 1, FakeListing(30));
+    }
+    // Three listings of 30 fit; the least recently used went first.
+    DirectoryListingCache::Stats stats = cache.GetStats();
+    QT_CHECK(stats.listings == 3 && stats.entries == 90 && stats.evictions == 2);
+    QT_CHECK(!cache.Lookup(L"/fake/0") && !cache.Lookup(L"/fake/1") && cache.Lookup(L"/fake/2"));
+    cache.Store(L"/fake/5", 1, FakeListing(30));
+    QT_CHECK(cache.Lookup(L"/fake/2") && !cache.Lookup(L"/fake/3"));
+    // An oversized listing is not stored and drops the folder's old entry.
+    cache.Store(L"/fake/2", 1, FakeListing(101));
+    QT_CHECK(!cache.Lookup(L"/fake/2"));
+    QT_CHECK(cache.GetStats().bytes == DirectoryListingCache::EstimateBytes(*cache.Lookup(L"/fake/4"))
+                                           + DirectoryListingCache::EstimateBytes(*cache.Lookup(L"/fake/5")));
+    cache.Clear();
+    QT_CHECK(cache.GetStats().listings == 0 && cache.GetStats().entries == 0 && cache.GetStats().bytes == 0);
+}
+
+void Benchmark(const fs::path& directory, std::size_t entries) {
+    DirectoryListingCache cache;
+    LoadInto(cache, directory);
+    const int rounds = 200;
+    std::size_t sink = 0;
+    auto start = Clock::now();
+    for(int round = 0; round < rounds; ++round) {
+        sink += cache.Lookup(directory.wstring())->size();
+    }
+    double cached = ElapsedNanoseconds(start) / rounds;
+    start = Clock::now();
+    for(int round = 0; round < rounds / 10; ++round) {
+        DirectoryListingCache fresh;
+        sink += LoadInto(fresh, directory).size();
+    }
+    double loaded = ElapsedNanoseconds(start) / (rounds / 10);
+    QT_CHECK(sink == rounds * entries + rounds / 10 * entries);
+    std::printf("%zu entries: cached lookup %.1f us, enumerate and sort %.1f us\n", entries, cached / 1e3,
+                loaded / 1e3);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t entries = qttabbar::test::CountArgument(argc, argv, 1, 5000);
+    fs::path directory = fs::temp_directory_path() / "DirectoryListingCacheTest";
+    std::error_code ec;
+    fs::remove_all(directory, ec);
+    fs::create_directories(directory);
+    for(std::size_t i = 0; i < entries; ++i) {
+        Touch(directory / ("file" + std::to_string(i) + ".txt"), "x");
+    }
+    CheckInvalidation(directory);
+    CheckLimits();
+    Benchmark(directory, entries);
+    fs::remove_all(directory, ec);
+    std::puts("ok");
+    return 0;
+}
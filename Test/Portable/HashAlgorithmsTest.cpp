@@ -0,0 +1,144 @@
+// Checks each hash against published test vectors, through MultiHasher as
+// the hash dialog shows them, and checks that splitting the input into
+// arbitrary Update calls does not change a digest. Then times each algorithm
+// and all of them together over 1 MB reads, as FileHashEngine feeds them.
+//
+// HashAlgorithmsTest [megabytes]
+
+#include "HashAlgorithms.h"
+
+#include "TestSupport.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+std::vector<std::uint8_t> Bytes(const std::string& text) {
+    return std::vector<std::uint8_t>(text.begin(), text.end());
+}
+
+// 0, 1, ..., 250, 0, 1, ... so that no block repeats the one before it.
+std::vector<std::uint8_t> Pattern(std::size_t size) {
+    std::vector<std::uint8_t> data(size);
+    for(std::size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<std::uint8_t>(i % 251);
+    }
+    return data;
+}
+
+std::wstring Digest(HashAlgorithm algorithm, const std::vector<std::uint8_t>& data) {
+    MultiHasher hasher(static_cast<HashAlgorithmMask>(algorithm));
+    hasher.Update(data.data(), data.size());
+    hasher.Finish();
+    return hasher.Digest(algorithm);
+}
+
+struct Vector {
+    HashAlgorithm algorithm;
+    std::vector<std::uint8_t> input;
+    const wchar_t* digest;
+};
+
+void CheckVectors() {
+    const std::string fox = "The quick brown fox jumps over the lazy dog";
+    const std::string nist = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    const std::vector<std::uint8_t> million(1000000, 'a');
+    const std::vector<Vector> vectors = {
+        {HashAlgorithm::Md5, Bytes(""), L"D41D8CD98F00B204E9800998ECF8427E"},
+        {HashAlgorithm::Md5, Bytes("abc"), L"900150983CD24FB0D6963F7D28E17F72"},
+        {HashAlgorithm::Md5, Bytes(fox), L"9E107D9D372BB6826BD81D3542A419D6"},
+        {HashAlgorithm::Md5, million, L"7707D6AE4E027C70EEA2A935C2296F21"},
+        {HashAlgorithm::Md5, Pattern(1000), L"A24F1E3EF66950E1327F210E3997BA2C"},
+        {HashAlgorithm::Sha1, Bytes(""), L"DA39A3EE5E6B4B0D3255BFEF95601890AFD80709"},
+        {HashAlgorithm::Sha1, Bytes("abc"), L"A9993E364706816ABA3E25717850C26C9CD0D89D"},
+        {HashAlgorithm::Sha1, Bytes(nist), L"84983E441C3BD26EBAAE4AA1F95129E5E54670F1"},
+        {HashAlgorithm::Sha1, million, L"34AA973CD4C4DAA4F61EEB2BDBAD27316534016F"},
+        {HashAlgorithm::Sha1, Pattern(1000), L"C9C960A0B925474FAB83942CC27D504FC24AC37B"},
+        {HashAlgorithm::Sha256, Bytes(""), L"E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855"},
+        {HashAlgorithm::Sha256, Bytes("abc"), L"BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD"},
+        {HashAlgorithm::Sha256, Bytes(nist), L"248D6A61D20638B8E5C026930C3E6039A33CE45964FF2167F6ECEDD419DB06C1"},
+        {HashAlgorithm::Sha256, million, L"CDC76E5C9914FB9281A1C7E284D73E67F1809A48A497200E046D39CCC7112CD0"},
+        {HashAlgorithm::Sha256, Pattern(1000), L"4E4C294B331F7A2099A379BEC34B9F9FC03DC46AB465D998F4D683DA53487E6D"},
+        {HashAlgorithm::Crc32, Bytes(""), L"00000000"},
+        {HashAlgorithm::Crc32, Bytes("123456789"), L"CBF43926"},
+        {HashAlgorithm::Crc32, Bytes(fox), L"414FA339"},
+        {HashAlgorithm::Crc32, Pattern(1000), L"721746A6"},
+        {HashAlgorithm::XxHash64, Bytes(""), L"EF46DB3751D8E999"},
+        {HashAlgorithm::XxHash64, Bytes("abc"), L"44BC2CF5AD770999"},
+        {HashAlgorithm::XxHash64, Bytes(fox), L"0B242D361FDA71BC"},
+        {HashAlgorithm::XxHash64, Pattern(1000), L"F306F04AA88B54D3"},
+    };
+    for(const Vector& vector : vectors) {
+        QT_CHECK(Digest(vector.algorithm, vector.input) == vector.digest);
+    }
+    QT_CHECK(std::wstring(HashAlgorithmName(HashAlgorithm::Sha256)).find(L"256") != std::wstring::npos);
+}
+
+// Random Update sizes around the 64-byte and 32-byte block edges give the
+// same digests as a single Update.
+void CheckSplits() {
+    std::mt19937 rng(12);
+    HashAlgorithmMask all = 0;
+    for(HashAlgorithm algorithm : kAllHashAlgorithms) {
+        all |= static_cast<HashAlgorithmMask>(algorithm);
+    }
+    for(int round = 0; round < 200; ++round) {
+        std::vector<std::uint8_t> data(rng() % 1000);
+        for(std::uint8_t& byte : data) {
+            byte = static_cast<std::uint8_t>(rng());
+        }
+        MultiHasher whole(all);
+        whole.Update(data.data(), data.size());
+        whole.Finish();
+        MultiHasher split(all);
+        for(std::size_t offset = 0; offset < data.size();) {
+            std::size_t size = std::min<std::size_t>(data.size() - offset, rng() % 3 == 0 ? rng() % 4 : rng() % 130);
+            split.Update(data.data() + offset, size);
+            offset += size;
+        }
+        split.Finish();
+        for(HashAlgorithm algorithm : kAllHashAlgorithms) {
+            QT_CHECK(!whole.Digest(algorithm).empty() && split.Digest(algorithm) == whole.Digest(algorithm));
+            QT_CHECK(Digest(algorithm, data) == whole.Digest(algorithm));
+        }
+    }
+}
+
+double GigabytesPerSecond(HashAlgorithmMask algorithms, const std::vector<std::uint8_t>& chunk, std::size_t chunks) {
+    auto start = Clock::now();
+    MultiHasher hasher(algorithms);
+    for(std::size_t i = 0; i < chunks; ++i) {
+        hasher.Update(chunk.data(), chunk.size());
+    }
+    hasher.Finish();
+    return static_cast<double>(chunk.size()) * chunks / ElapsedNanoseconds(start);
+}
+
+void Benchmark(std::size_t megabytes) {
+    std::vector<std::uint8_t> chunk = Pattern(1u << 20);
+    HashAlgorithmMask all = 0;
+    std::printf("%-10s | %8s\n", "algorithm", "GB/s");
+    for(HashAlgorithm algorithm : kAllHashAlgorithms) {
+        all |= static_cast<HashAlgorithmMask>(algorithm);
+        std::wstring name = HashAlgorithmName(algorithm);
+        std::printf("%-10ls | %8.2f\n", name.c_str(),
+                    GigabytesPerSecond(static_cast<HashAlgorithmMask>(algorithm), chunk, megabytes));
+    }
+    std::printf("%-10s | %8.2f\n", "all five", GigabytesPerSecond(all, chunk, megabytes));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckVectors();
+    CheckSplits();
+    Benchmark(qttabbar::test::CountArgument(argc, argv, 1, 256));
+    std::puts("ok");
+    return 0;
+}
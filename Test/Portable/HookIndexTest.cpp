@@ -0,0 +1,216 @@
+// Checks MinHook's HookIndex against std::map under random inserts, removes
+// and lookups, and the queued-hook planning in queue.h: which hooks
+// PlanQueuedHooks picks, and how IPTranslation merges and looks up their IP
+// fix-ups. Then times HookIndex against the sorted vector it replaced.
+//
+// HookIndexTest [operations]
+
+#include <stdint.h>
+
+#include "hookindex.h"
+#include "queue.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace MinHook;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+// The fields hook.cpp's HOOK_ENTRY gives PlanQueuedHooks.
+struct Entry {
+    void* pTarget;
+    void* pTrampoline;
+    bool isEnabled;
+    bool queueEnable;
+    uint8_t nIP;
+    uint8_t oldIPs[8];
+    uint8_t newIPs[8];
+};
+
+// The previous layout: sorted by target, IP tables on the heap.
+struct VectorEntry {
+    void* pTarget;
+    std::vector<uintptr_t> oldIPs;
+    std::vector<uintptr_t> newIPs;
+
+    bool operator<(const VectorEntry& other) const { return pTarget < other.pTarget; }
+};
+
+void* Target(size_t index) {
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(0x7ff800000000ull + index * 16));
+}
+
+void CheckAgainstMap(unsigned long operations) {
+    HookIndex<Entry> index;
+    std::map<void*, uint8_t> model;
+    std::mt19937 rng(1);
+    for(unsigned long op = 0; op < operations; ++op) {
+        void* target = Target(rng() % 3000);
+        switch(rng() % 3) {
+        case 0:
+            if(model.count(target) == 0) {
+                Entry entry = {};
+                entry.pTarget = target;
+                entry.nIP = static_cast<uint8_t>(op & 7);
+                QT_CHECK(index.Insert(target, entry)->pTarget == target);
+                model[target] = entry.nIP;
+            }
+            break;
+        case 1:
+            QT_CHECK(index.Remove(target) == (model.erase(target) == 1));
+            break;
+        default: {
+            Entry* found = index.Find(target);
+            auto expected = model.find(target);
+            QT_CHECK((found != nullptr) == (expected != model.end()));
+            QT_CHECK(!found || (found->pTarget == target && found->nIP == expected->second));
+            break;
+        }
+        }
+        QT_CHECK(index.size() == model.size());
+    }
+    size_t visited = 0;
+    index.ForEach([&](Entry& entry) {
+        ++visited;
+        QT_CHECK(model.count(entry.pTarget) == 1);
+    });
+    QT_CHECK(visited == model.size());
+}
+
+void CheckIPTranslation() {
+    IPTranslation ips;
+    QT_CHECK(ips.empty());
+    const uint8_t oldIPs[] = {0, 2, 5};
+    const uint8_t newIPs[] = {0, 7, 12};
+    ips.Add(0x1000, oldIPs, 0x9000, newIPs, 3);
+    // A second table maps 0x1002 again and adds 0x1003; the first 0x1002 wins.
+    const uint8_t otherOld[] = {2, 3};
+    const uint8_t otherNew[] = {40, 41};
+    ips.Add(0x1000, otherOld, 0xA000, otherNew, 2);
+    ips.Seal();
+    QT_CHECK(ips.size() == 4);
+    uintptr_t newIP = 0;
+    QT_CHECK(ips.Translate(0x1000, newIP) && newIP == 0x9000);
+    QT_CHECK(ips.Translate(0x1002, newIP) && newIP == 0x9007);
+    QT_CHECK(ips.Translate(0x1003, newIP) && newIP == 0xA029);
+    QT_CHECK(ips.Translate(0x1005, newIP) && newIP == 0x900C);
+    QT_CHECK(!ips.Translate(0x1001, newIP) && !ips.Translate(0x0FFF, newIP) && !ips.Translate(0x1006, newIP));
+
+    // Adding after sealing and sealing again keeps the earlier mappings first.
+    const uint8_t late[] = {0};
+    ips.Add(0x1000, late, 0xB000, late, 1);
+    ips.Seal();
+    QT_CHECK(ips.size() == 4 && ips.Translate(0x1000, newIP) && newIP == 0x9000);
+}
+
+void CheckQueuedPlan() {
+    // Hook i is enabled when i & 1, queued to be enabled when i & 2: hooks 1
+    // and 2 change, 0 and 3 are already in their queued state.
+    HookIndex<Entry> index;
+    for(size_t i = 0; i < 4; ++i) {
+        Entry entry = {};
+        entry.pTarget = Target(i);
+        entry.pTrampoline = Target(1000 + i);
+        entry.nIP = 2;
+        entry.oldIPs[1] = static_cast<uint8_t>(3 + i);
+        entry.newIPs[1] = static_cast<uint8_t>(4 + i);
+        entry.isEnabled = (i & 1) != 0;
+        entry.queueEnable = (i & 2) != 0;
+        index.Insert(entry.pTarget, entry);
+    }
+    std::vector<Entry*> pending;
+    IPTranslation ips;
+    PlanQueuedHooks(index, pending, ips);
+    QT_CHECK(pending.size() == 2 && ips.size() == 4);
+    std::vector<void*> targets;
+    for(Entry* entry : pending) {
+        targets.push_back(entry->pTarget);
+    }
+    std::sort(targets.begin(), targets.end());
+    QT_CHECK(targets == (std::vector<void*>{Target(1), Target(2)}));
+
+    // Both changing hooks are translated by the one table, the others not.
+    uintptr_t newIP = 0;
+    for(size_t i = 0; i < 4; ++i) {
+        uintptr_t target = reinterpret_cast<uintptr_t>(Target(i));
+        uintptr_t trampoline = reinterpret_cast<uintptr_t>(Target(1000 + i));
+        bool planned = i == 1 || i == 2;
+        QT_CHECK(ips.Translate(target, newIP) == planned && (!planned || newIP == trampoline));
+        QT_CHECK(ips.Translate(target + 3 + i, newIP) == planned && (!planned || newIP == trampoline + 4 + i));
+    }
+
+    // Nothing queued: nothing planned, and the table is still sealed.
+    index.ForEach([](Entry& entry) { entry.queueEnable = entry.isEnabled; });
+    pending.clear();
+    IPTranslation none;
+    PlanQueuedHooks(index, pending, none);
+    QT_CHECK(pending.empty() && none.empty() && !none.Translate(reinterpret_cast<uintptr_t>(Target(1)), newIP));
+}
+
+void Benchmark() {
+    std::mt19937 rng(2);
+    for(size_t count : {1000, 4000, 16000}) {
+        std::vector<void*> targets;
+        for(size_t i = 0; i < count; ++i) {
+            targets.push_back(Target(i * 7919 % (count * 8)));
+        }
+        std::shuffle(targets.begin(), targets.end(), rng);
+        const int rounds = 100;
+        volatile size_t sink = 0;
+
+        std::vector<VectorEntry> sorted;
+        auto start = Clock::now();
+        for(void* target : targets) {
+            VectorEntry entry{target, std::vector<uintptr_t>(6, 1), std::vector<uintptr_t>(6, 2)};
+            sorted.insert(std::lower_bound(sorted.begin(), sorted.end(), entry), std::move(entry));
+        }
+        double vectorCreate = ElapsedNanoseconds(start);
+        start = Clock::now();
+        for(int round = 0; round < rounds; ++round) {
+            for(void* target : targets) {
+                VectorEntry key{target, {}, {}};
+                sink = sink + std::lower_bound(sorted.begin(), sorted.end(), key)->oldIPs.size();
+            }
+        }
+        double vectorFind = ElapsedNanoseconds(start);
+
+        HookIndex<Entry> index;
+        start = Clock::now();
+        for(void* target : targets) {
+            Entry entry = {};
+            entry.pTarget = target;
+            entry.nIP = 6;
+            index.Insert(target, entry);
+        }
+        double indexCreate = ElapsedNanoseconds(start);
+        start = Clock::now();
+        for(int round = 0; round < rounds; ++round) {
+            for(void* target : targets) {
+                sink = sink + index.Find(target)->nIP;
+            }
+        }
+        double indexFind = ElapsedNanoseconds(start);
+
+        std::printf("%6zu hooks | vector: create %.2f ms, find %.1f ns | index: create %.2f ms, find %.1f ns\n",
+                    count, vectorCreate / 1e6, vectorFind / (rounds * count), indexCreate / 1e6,
+                    indexFind / (rounds * count));
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckAgainstMap(qttabbar::test::CountArgument(argc, argv, 1, 200000));
+    CheckIPTranslation();
+    CheckQueuedPlan();
+    Benchmark();
+    std::puts("ok");
+    return 0;
+}
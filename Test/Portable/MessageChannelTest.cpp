@@ -0,0 +1,481 @@
+// Exercises MessageChannel over in-memory connections: concurrent calls
+// answered out of order, posts both ways, Close with calls in flight,
+// reconnecting to a replaced server, and a handler that drops its own
+// channel. Feed is checked with the stream split at arbitrary points. Ends
+// with per-message latencies.
+//
+// MessageChannelTest [calls per thread]
+
+#include "MessageChannel.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <random>
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+using std::chrono::milliseconds;
+
+// One direction of a connection.
+struct ByteQueue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::uint8_t> bytes;
+    bool closed = false;
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        changed.notify_all();
+    }
+};
+
+struct Connection {
+    ByteQueue toServer;
+    ByteQueue toClient;
+};
+
+// Stands in for a pipe handle. Shutdown ends both directions, so the peer
+// sees the end of the stream once it has read what was sent before.
+class MemoryTransport final : public IChannelTransport {
+public:
+    MemoryTransport(std::shared_ptr<Connection> connection, bool server)
+        : m_connection(std::move(connection)),
+          m_in(server ? m_connection->toServer : m_connection->toClient),
+          m_out(server ? m_connection->toClient : m_connection->toServer) {}
+
+    ~MemoryTransport() override { Shutdown(); }
+
+    bool Write(const void* data, std::size_t size) override {
+        auto* bytes = static_cast<const std::uint8_t*>(data);
+        std::lock_guard<std::mutex> lock(m_out.mutex);
+        if(m_out.closed) {
+            return false;
+        }
+        m_out.bytes.insert(m_out.bytes.end(), bytes, bytes + size);
+        m_out.changed.notify_all();
+        return true;
+    }
+
+    bool Read(void* data, std::size_t size) override {
+        std::unique_lock<std::mutex> lock(m_in.mutex);
+        m_in.changed.wait(lock, [&]() { return m_in.bytes.size() >= size || m_in.closed; });
+        if(m_in.bytes.size() < size) {
+            return false;
+        }
+        std::copy_n(m_in.bytes.begin(), size, static_cast<std::uint8_t*>(data));
+        m_in.bytes.erase(m_in.bytes.begin(), m_in.bytes.begin() + static_cast<std::ptrdiff_t>(size));
+        return true;
+    }
+
+    void Shutdown() override {
+        m_in.Close();
+        m_out.Close();
+    }
+
+private:
+    std::shared_ptr<Connection> m_connection;
+    ByteQueue& m_in;
+    ByteQueue& m_out;
+};
+
+// Write side only, for channels driven through Feed.
+class RecordingTransport final : public IChannelTransport {
+public:
+    bool Write(const void* data, std::size_t size) override {
+        auto* bytes = static_cast<const std::uint8_t*>(data);
+        std::lock_guard<std::mutex> lock(mutex);
+        written.insert(written.end(), bytes, bytes + size);
+        return true;
+    }
+    bool Read(void*, std::size_t) override { return false; }
+    void Shutdown() override {}
+
+    std::mutex mutex;
+    std::vector<std::uint8_t> written;
+};
+
+enum class ServerMode {
+    Echo,          // Answers at once
+    DelayedEcho,   // Answers from another thread after a random delay, tagged with the server id
+    Silent,        // Never answers
+};
+
+// Echoes requests; posts are counted and, except in Echo mode, sent back
+// as server pushes.
+class Server {
+public:
+    Server(ServerMode mode, std::uint8_t id) : m_mode(mode), m_id(id) {}
+    ~Server() { Stop(); }
+
+    std::unique_ptr<IChannelTransport> Connect() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_stopped) {
+            return nullptr;
+        }
+        auto connection = std::make_shared<Connection>();
+        auto channel = std::make_shared<MessageChannel>(std::make_unique<MemoryTransport>(connection, true),
+            [this](MessageChannel& channel, FrameKind kind, std::uint64_t sequence, ByteSpan body) {
+                OnFrame(channel, kind, sequence, MessageChannel::Body(body.data, body.data + body.size));
+            });
+        channel->Start();
+        m_channels.push_back(channel);
+        return std::make_unique<MemoryTransport>(connection, false);
+    }
+
+    void Stop() {
+        std::vector<std::shared_ptr<MessageChannel>> channels;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+            channels.swap(m_channels);
+        }
+        for(auto& channel : channels) {
+            channel->Close();
+        }
+        while(m_responders > 0) {
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+    }
+
+    int Posts() const { return m_posts; }
+
+private:
+    void OnFrame(MessageChannel& channel, FrameKind kind, std::uint64_t sequence, MessageChannel::Body body) {
+        if(kind == FrameKind::Post) {
+            ++m_posts;
+            if(m_mode != ServerMode::Echo) {
+                channel.Post(body);
+            }
+            return;
+        }
+        switch(m_mode) {
+        case ServerMode::Echo:
+            channel.Respond(sequence, body);
+            break;
+        case ServerMode::DelayedEcho: {
+            body.push_back(m_id);
+            ++m_responders;
+            std::thread([this, self = channel.shared_from_this(), sequence, body]() {
+                thread_local std::mt19937 rng(std::random_device{}());
+                std::this_thread::sleep_for(std::chrono::microseconds(rng() % 200));
+                self->Respond(sequence, body);
+                --m_responders;
+            }).detach();
+            break;
+        }
+        case ServerMode::Silent:
+            break;
+        }
+    }
+
+    ServerMode m_mode;
+    std::uint8_t m_id;
+    std::mutex m_mutex;
+    bool m_stopped = false;
+    std::vector<std::shared_ptr<MessageChannel>> m_channels;
+    std::atomic<int> m_posts{0};
+    std::atomic<int> m_responders{0};
+};
+
+// Keeps one channel to whichever server is current and reconnects when it
+// has closed, as InstanceManager::GetServerChannel and SendToServer do.
+class Client {
+public:
+    explicit Client(Server*& server) : m_server(server) {}
+    ~Client() { Close(); }
+
+    std::shared_ptr<MessageChannel> Channel() {
+        std::shared_ptr<MessageChannel> stale;
+        std::shared_ptr<MessageChannel> channel;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_channel && m_channel->IsOpen()) {
+                return m_channel;
+            }
+            stale = std::move(m_channel);
+            std::unique_ptr<IChannelTransport> transport = m_server ? m_server->Connect() : nullptr;
+            if(transport) {
+                channel = std::make_shared<MessageChannel>(std::move(transport),
+                    [this](MessageChannel&, FrameKind, std::uint64_t, ByteSpan) { ++m_pushes; });
+                channel->Start();
+                m_channel = channel;
+            }
+        }
+        if(stale) {
+            stale->Close();
+        }
+        return channel;
+    }
+
+    bool Send(const MessageChannel::Body& body, bool wait, MessageChannel::Body* reply = nullptr) {
+        for(int attempt = 0; attempt < 2; ++attempt) {
+            std::shared_ptr<MessageChannel> channel = Channel();
+            if(!channel) {
+                return false;
+            }
+            MessageChannel::Body received;
+            bool sent = wait ? channel->Call(body, received, milliseconds(5000)) : channel->Post(body);
+            if(sent) {
+                if(reply) {
+                    *reply = std::move(received);
+                }
+                return true;
+            }
+            if(channel->IsOpen()) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    void Close() {
+        std::shared_ptr<MessageChannel> channel;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            channel = std::move(m_channel);
+        }
+        if(channel) {
+            channel->Close();
+        }
+    }
+
+    int Pushes() const { return m_pushes; }
+
+private:
+    Server*& m_server;
+    std::mutex m_mutex;
+    std::shared_ptr<MessageChannel> m_channel;
+    std::atomic<int> m_pushes{0};
+};
+
+void CheckConcurrentCalls(unsigned long callsPerThread) {
+    const int threads = 8;
+    const unsigned long postEvery = 50;
+    Server server(ServerMode::DelayedEcho, 7);
+    Server* current = &server;
+    Client client(current);
+    std::vector<std::thread> callers;
+    std::atomic<unsigned long> answered{0};
+    std::atomic<unsigned long> posted{0};
+    for(int t = 0; t < threads; ++t) {
+        callers.emplace_back([&, t]() {
+            std::mt19937 rng(t);
+            for(unsigned long i = 0; i < callsPerThread; ++i) {
+                MessageChannel::Body body(rng() % 300);
+                for(auto& byte : body) {
+                    byte = static_cast<std::uint8_t>(rng());
+                }
+                body.push_back(static_cast<std::uint8_t>(t));
+                MessageChannel::Body reply;
+                QT_CHECK(client.Send(body, true, &reply));
+                body.push_back(7);
+                QT_CHECK(reply == body);
+                ++answered;
+                if(i % postEvery == 0) {
+                    QT_CHECK(client.Send(body, false));
+                    ++posted;
+                }
+            }
+        });
+    }
+    for(auto& caller : callers) {
+        caller.join();
+    }
+    for(int i = 0; i < 1000 && (server.Posts() != static_cast<int>(posted) || client.Pushes() != server.Posts()); ++i) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    QT_CHECK(answered == threads * callsPerThread);
+    QT_CHECK(server.Posts() == static_cast<int>(posted) && client.Pushes() == server.Posts());
+}
+
+void CheckCloseFailsCalls() {
+    Server server(ServerMode::Silent, 9);
+    Server* current = &server;
+    Client client(current);
+    std::shared_ptr<MessageChannel> channel = client.Channel();
+    std::atomic<int> failed{0};
+    std::vector<std::thread> callers;
+    auto start = Clock::now();
+    for(int i = 0; i < 4; ++i) {
+        callers.emplace_back([&]() {
+            MessageChannel::Body reply;
+            if(!channel->Call({1, 2, 3}, reply, milliseconds(5000))) {
+                ++failed;
+            }
+        });
+    }
+    std::this_thread::sleep_for(milliseconds(100));
+    channel->Close();
+    for(auto& caller : callers) {
+        caller.join();
+    }
+    QT_CHECK(failed == 4 && ElapsedNanoseconds(start) < 1e9);
+}
+
+void CheckReconnect() {
+    Server first(ServerMode::DelayedEcho, 7);
+    Server* current = &first;
+    Client client(current);
+    MessageChannel::Body reply;
+    QT_CHECK(client.Send({9}, true, &reply) && reply.back() == 7);
+    first.Stop();
+    current = nullptr;
+    QT_CHECK(!client.Send({9}, true, &reply));
+    Server second(ServerMode::DelayedEcho, 8);
+    current = &second;
+    QT_CHECK(client.Send({9}, true, &reply) && reply.back() == 8);
+    client.Close();
+}
+
+void CheckHandlerDropsChannel() {
+    Server server(ServerMode::Silent, 9);
+    std::shared_ptr<MessageChannel> holder;
+    std::atomic<bool> dropped{false};
+    auto channel = std::make_shared<MessageChannel>(server.Connect(),
+        [&](MessageChannel& self, FrameKind, std::uint64_t, ByteSpan) {
+            self.Close();
+            holder.reset();
+            dropped = true;
+        });
+    channel->Start();
+    holder = channel;
+    std::weak_ptr<MessageChannel> weak = channel;
+    channel.reset();
+    // The silent server still echoes posts.
+    QT_CHECK(holder->Post({5}));
+    while(!dropped) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    for(int i = 0; i < 1000 && !weak.expired(); ++i) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    QT_CHECK(weak.expired());
+}
+
+std::vector<std::uint8_t> Frame(FrameKind kind, std::uint64_t sequence, const std::vector<std::uint8_t>& body) {
+    FrameHeader header{};
+    header.magic = MessageChannel::kFrameMagic;
+    header.kind = kind;
+    header.sequence = sequence;
+    header.length = static_cast<std::uint32_t>(body.size());
+    std::vector<std::uint8_t> frame(sizeof(header) + body.size());
+    std::memcpy(frame.data(), &header, sizeof(header));
+    std::copy(body.begin(), body.end(), frame.begin() + sizeof(header));
+    return frame;
+}
+
+// The completion-port read loop hands the channel whatever each read
+// returned; frames must come out the same however the stream is cut.
+void CheckFeed() {
+    std::mt19937 rng(7);
+    std::vector<std::uint8_t> stream;
+    std::vector<MessageChannel::Body> bodies;
+    const int frames = 500;
+    for(int i = 0; i < frames; ++i) {
+        MessageChannel::Body body(rng() % 300);
+        for(auto& byte : body) {
+            byte = static_cast<std::uint8_t>(rng());
+        }
+        auto frame = Frame(i % 2 ? FrameKind::Request : FrameKind::Post, i + 1, body);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+        bodies.push_back(std::move(body));
+    }
+    for(int trial = 0; trial < 50; ++trial) {
+        std::vector<MessageChannel::Body> received;
+        auto* transport = new RecordingTransport;
+        auto channel = std::make_shared<MessageChannel>(std::unique_ptr<IChannelTransport>(transport),
+            [&](MessageChannel& self, FrameKind kind, std::uint64_t sequence, ByteSpan body) {
+                QT_CHECK(reinterpret_cast<std::uintptr_t>(body.data) % MessageChannel::kBodyAlignment == 0);
+                received.emplace_back(body.data, body.data + body.size);
+                if(kind == FrameKind::Request) {
+                    self.Respond(sequence, {});
+                }
+            });
+        for(std::size_t offset = 0; offset < stream.size();) {
+            std::size_t size = std::min<std::size_t>(stream.size() - offset, trial == 0 ? 1 : rng() % 4096);
+            QT_CHECK(channel->Feed(stream.data() + offset, size));
+            offset += size;
+        }
+        QT_CHECK(received == bodies);
+        QT_CHECK(transport->written.size() == frames / 2 * sizeof(FrameHeader));
+    }
+
+    std::uint8_t junk[sizeof(FrameHeader)] = {1};
+    auto broken = std::make_shared<MessageChannel>(std::make_unique<RecordingTransport>(), nullptr);
+    QT_CHECK(!broken->Feed(junk, sizeof(junk)));
+
+    // A response fed in completes a call waiting on another thread.
+    auto* transport = new RecordingTransport;
+    auto channel = std::make_shared<MessageChannel>(std::unique_ptr<IChannelTransport>(transport), nullptr);
+    std::thread caller([&]() {
+        MessageChannel::Body reply;
+        QT_CHECK(channel->Call({1, 2}, reply, std::chrono::seconds(5)));
+        QT_CHECK(reply == MessageChannel::Body({9}));
+    });
+    FrameHeader request{};
+    for(;;) {
+        {
+            std::lock_guard<std::mutex> lock(transport->mutex);
+            if(transport->written.size() >= sizeof(request)) {
+                std::memcpy(&request, transport->written.data(), sizeof(request));
+                break;
+            }
+        }
+        std::this_thread::yield();
+    }
+    auto response = Frame(FrameKind::Response, request.sequence, {9});
+    QT_CHECK(channel->Feed(response.data(), response.size()));
+    caller.join();
+}
+
+// Connecting for every message, as before, next to one kept connection.
+void Benchmark() {
+    Server server(ServerMode::Echo, 1);
+    Server* current = &server;
+    MessageChannel::Body body(200, 0x41);
+    const int messages = 500;
+
+    auto start = Clock::now();
+    for(int i = 0; i < messages; ++i) {
+        auto channel = std::make_shared<MessageChannel>(server.Connect(), nullptr);
+        channel->Post(body);
+        channel->Close();
+    }
+    double perConnection = ElapsedNanoseconds(start) / messages / 1e3;
+
+    Client client(current);
+    client.Channel();
+    start = Clock::now();
+    for(int i = 0; i < messages; ++i) {
+        client.Send(body, false);
+    }
+    double perPost = ElapsedNanoseconds(start) / messages / 1e3;
+    start = Clock::now();
+    for(int i = 0; i < messages; ++i) {
+        MessageChannel::Body reply;
+        QT_CHECK(client.Send(body, true, &reply));
+    }
+    double perCall = ElapsedNanoseconds(start) / messages / 1e3;
+    std::printf("connect+post+close %.1f us, kept connection: post %.2f us, round trip %.1f us\n",
+                perConnection, perPost, perCall);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckConcurrentCalls(qttabbar::test::CountArgument(argc, argv, 1, 500));
+    CheckCloseFailsCalls();
+    CheckReconnect();
+    CheckHandlerDropsChannel();
+    CheckFeed();
+    Benchmark();
+    std::puts("ok");
+    return 0;
+}
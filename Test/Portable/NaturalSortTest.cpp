@@ -0,0 +1,123 @@
+// Checks that NaturalSortKeys orders names like a stable sort with
+// CompareNatural, with groups first and ties in insertion order, then times
+// the keyed sort against that comparator sort for folder-sized lists.
+//
+// NaturalSortTest [cases]
+
+#include "NaturalSort.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+struct Name {
+    std::wstring text;
+    std::uint32_t group = 0;
+};
+
+// Names a camera or a download folder produces: shared prefixes, numbers of
+// varying width with leading zeros, and case-only differences.
+std::wstring RandomName(std::mt19937& rng) {
+    static const wchar_t* const kStems[] = {L"IMG_", L"img_", L"Report ", L"report", L"file", L"File-", L""};
+    std::wstring name = kStems[rng() % 7];
+    name += std::wstring(rng() % 3, L'0') + std::to_wstring(rng() % (rng() % 2 ? 100 : 100000));
+    if(rng() % 4 == 0) {
+        name += L" (" + std::to_wstring(rng() % 12) + L")";
+    }
+    if(rng() % 3 == 0) {
+        name += rng() % 2 ? L".JPG" : L".jpg";
+    }
+    return name;
+}
+
+std::vector<Name> RandomNames(std::mt19937& rng, std::size_t count) {
+    std::vector<Name> names(count);
+    for(Name& name : names) {
+        name.text = RandomName(rng);
+        name.group = rng() % 5 == 0 ? 0 : 1;
+    }
+    return names;
+}
+
+// The comparator sort the keys replaced.
+std::vector<std::size_t> CompareSort(const std::vector<Name>& names) {
+    std::vector<std::size_t> order(names.size());
+    for(std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) {
+        if(names[lhs].group != names[rhs].group) {
+            return names[lhs].group < names[rhs].group;
+        }
+        return CompareNatural(names[lhs].text, names[rhs].text) < 0;
+    });
+    return order;
+}
+
+std::vector<std::size_t> KeySort(const std::vector<Name>& names) {
+    NaturalSortKeys keys;
+    std::size_t totalChars = 0;
+    for(const Name& name : names) {
+        totalChars += name.text.size();
+    }
+    keys.Reserve(names.size(), totalChars);
+    for(const Name& name : names) {
+        keys.Add(name.text, name.group);
+    }
+    return keys.SortedOrder();
+}
+
+void CheckOrder(unsigned long cases) {
+    QT_CHECK(CompareNatural(L"file2", L"file10") < 0 && CompareNatural(L"File10", L"file2") > 0);
+    QT_CHECK(CompareNatural(L"a007", L"A7") == 0 && CompareNatural(L"a7b", L"a07c") < 0);
+    QT_CHECK(CompareNatural(L"x", L"x1") < 0 && CompareNatural(L"", L"") == 0);
+    std::vector<Name> fixed = {{L"file10", 1}, {L"File2", 1}, {L"zeta", 0}, {L"file02", 1}, {L"Alpha", 0}};
+    QT_CHECK((KeySort(fixed) == std::vector<std::size_t>{4, 2, 1, 3, 0}));
+
+    std::mt19937 rng(3);
+    for(unsigned long c = 0; c < cases; ++c) {
+        std::vector<Name> names = RandomNames(rng, rng() % 300);
+        QT_CHECK(KeySort(names) == CompareSort(names));
+    }
+}
+
+void Benchmark() {
+    std::printf("%7s | %12s | %14s\n", "names", "keys ms", "comparator ms");
+    for(std::size_t count : {1000, 10000, 50000}) {
+        std::mt19937 rng(6);
+        std::vector<Name> names = RandomNames(rng, count);
+        int rounds = static_cast<int>(std::max<std::size_t>(1, 50000 / count));
+        std::vector<std::size_t> keyOrder;
+        auto start = Clock::now();
+        for(int round = 0; round < rounds; ++round) {
+            keyOrder = KeySort(names);
+        }
+        double keyed = ElapsedNanoseconds(start) / rounds;
+        std::vector<std::size_t> compareOrder;
+        start = Clock::now();
+        for(int round = 0; round < rounds; ++round) {
+            compareOrder = CompareSort(names);
+        }
+        double compared = ElapsedNanoseconds(start) / rounds;
+        QT_CHECK(keyOrder == compareOrder);
+        std::printf("%7zu | %12.2f | %14.2f\n", count, keyed / 1e6, compared / 1e6);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckOrder(qttabbar::test::CountArgument(argc, argv, 1, 20000));
+    Benchmark();
+    std::puts("ok");
+    return 0;
+}
@@ -0,0 +1,328 @@
+// Fuzzes the pipe message codec and MessageChannel::Feed, checks the size
+// fields that would wrap if added in 32 bits, and measures decoding fed
+// streams and encoding gathered posts.
+//
+// PipeMessageCodecTest [fuzz inputs]
+//
+// Build with -DNO_MAIN, together with CountingAllocator.cpp, and link
+// against libFuzzer to fuzz LLVMFuzzerTestOneInput directly.
+
+#include "PipeMessageCodec.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size);
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::AllocationCount;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+class NullTransport final : public IChannelTransport {
+public:
+    bool Write(const void*, std::size_t size) override {
+        written += size;
+        return true;
+    }
+    bool WriteGather(const ByteSpan* buffers, std::size_t count) override {
+        for(std::size_t i = 0; i < count; ++i) {
+            written += buffers[i].size;
+        }
+        return true;
+    }
+    bool Read(void*, std::size_t) override { return false; }
+    void Shutdown() override {}
+
+    std::size_t written = 0;
+};
+
+std::vector<std::uint8_t> Encode(const PipeMessageWriter& writer) {
+    std::vector<std::uint8_t> out;
+    writer.AppendTo(out);
+    return out;
+}
+
+std::vector<std::uint8_t> Frame(std::uint64_t sequence, const std::vector<std::uint8_t>& body) {
+    FrameHeader header{};
+    header.magic = MessageChannel::kFrameMagic;
+    header.kind = FrameKind::Post;
+    header.sequence = sequence;
+    header.length = static_cast<std::uint32_t>(body.size());
+    std::vector<std::uint8_t> frame(sizeof(header) + body.size());
+    std::memcpy(frame.data(), &header, sizeof(header));
+    std::copy(body.begin(), body.end(), frame.begin() + sizeof(header));
+    return frame;
+}
+
+// Decoded views stay inside the body, and re-encoding gives back the input
+// apart from the reserved words.
+void CheckMessage(const std::uint8_t* data, std::size_t size) {
+    alignas(8) static std::uint8_t body[1 << 16];
+    if(size > sizeof(body)) {
+        return;
+    }
+    std::memcpy(body, data, size);
+    PipeMessageView view;
+    if(!DecodePipeMessage(ByteSpan{body, size}, view)) {
+        return;
+    }
+    auto inside = [&](const void* p, std::size_t n) {
+        auto* bytes = static_cast<const std::uint8_t*>(p);
+        return bytes >= body && bytes + n <= body + size;
+    };
+    QT_CHECK(view.payload.empty() || inside(view.payload.data(), view.payload.size() * sizeof(char16_t)));
+    QT_CHECK(view.binary.size == 0 || inside(view.binary.data, view.binary.size));
+
+    PipeMessageWriter writer(view);
+    std::vector<std::uint8_t> again = Encode(writer);
+    QT_CHECK(again.size() == size && writer.Size() == size);
+    std::vector<std::uint8_t> expected(body, body + size);
+    std::fill_n(expected.begin() + 12, 4, 0);
+    std::fill_n(expected.begin() + 44, 4, 0);
+    QT_CHECK(again == expected);
+
+    // Action arguments stay in bounds, and repacking them round-trips.
+    ActionArgumentsView arguments = DecodeActionArguments(view.binary);
+    QT_CHECK(arguments.text.empty() || inside(arguments.text.data(), arguments.text.size() * sizeof(char16_t)));
+    QT_CHECK(arguments.binary.size == 0 || inside(arguments.binary.data, arguments.binary.size));
+    QT_CHECK(view.binary.size < PipeMessageFormat::kActionPrefixSize
+             || arguments.text.size() * sizeof(char16_t) + arguments.binary.size + PipeMessageFormat::kActionPrefixSize
+                    == view.binary.size);
+    PipeMessageWriter action(view.type, view.payload, arguments.text, arguments.binary);
+    std::vector<std::uint8_t> packed = Encode(action);
+    alignas(8) static std::uint8_t repacked[(1 << 16) + PipeMessageFormat::kActionPrefixSize];
+    std::memcpy(repacked, packed.data(), packed.size());
+    PipeMessageView back;
+    QT_CHECK(DecodePipeMessage(ByteSpan{repacked, packed.size()}, back));
+    ActionArgumentsView backArguments = DecodeActionArguments(back.binary);
+    QT_CHECK(back.payload == view.payload && backArguments.text == arguments.text);
+    QT_CHECK(backArguments.binary.size == arguments.binary.size);
+    QT_CHECK(arguments.binary.size == 0
+             || std::memcmp(backArguments.binary.data, arguments.binary.data, arguments.binary.size) == 0);
+}
+
+// Feeding a stream whole, in pieces, or from an odd address dispatches the
+// same frames and fails at the same place.
+void CheckFeed(const std::uint8_t* data, std::size_t size, std::uint32_t seed) {
+    auto run = [&](std::size_t offset, bool split, bool& valid) {
+        std::vector<std::vector<std::uint8_t>> frames;
+        MessageChannel channel(std::make_unique<NullTransport>(),
+            [&](MessageChannel&, FrameKind, std::uint64_t, ByteSpan body) {
+                QT_CHECK(reinterpret_cast<std::uintptr_t>(body.data) % MessageChannel::kBodyAlignment == 0);
+                frames.emplace_back(body.data, body.data + body.size);
+            });
+        std::vector<std::uint8_t> buffer(size + 16);
+        std::copy(data, data + size, buffer.begin() + offset);
+        const std::uint8_t* next = buffer.data() + offset;
+        std::mt19937 rng(seed);
+        std::size_t left = size;
+        valid = true;
+        while(left > 0 && valid) {
+            std::size_t piece = split ? std::min<std::size_t>(left, 1 + rng() % 64) : left;
+            valid = channel.Feed(next, piece);
+            next += piece;
+            left -= piece;
+        }
+        return frames;
+    };
+    bool whole = false;
+    bool pieces = false;
+    bool odd = false;
+    auto a = run(0, false, whole);
+    auto b = run(0, true, pieces);
+    auto c = run(3, true, odd);
+    QT_CHECK(a == b && a == c && whole == pieces && whole == odd);
+}
+
+// Size fields whose sum only matches the body modulo 2^32 must be refused.
+void CheckWrappingSizes() {
+    alignas(8) std::uint8_t body[PipeMessageFormat::kHeaderSize + 16] = {};
+    std::vector<std::uint8_t> valid = Encode(PipeMessageWriter(PipeMessageView{}));
+    std::memcpy(body, valid.data(), valid.size());
+    std::uint32_t bodyBytes = 16;
+    const std::uint32_t cases[][2] = {
+        {0xFFFFFFFEu, bodyBytes + 2},
+        {bodyBytes + 2, 0xFFFFFFFEu},
+        {0x80000000u, 0x80000000u + bodyBytes},
+        {0xFFFFFFF0u, 0xFFFFFFF0u},
+    };
+    for(const auto& sizes : cases) {
+        std::memcpy(body + 36, &sizes[0], 4);
+        std::memcpy(body + 40, &sizes[1], 4);
+        PipeMessageView view;
+        QT_CHECK(!DecodePipeMessage(ByteSpan{body, sizeof(body)}, view));
+    }
+    std::uint32_t payloadBytes = 6;
+    std::uint32_t binaryBytes = bodyBytes - payloadBytes;
+    std::memcpy(body + 36, &payloadBytes, 4);
+    std::memcpy(body + 40, &binaryBytes, 4);
+    PipeMessageView view;
+    QT_CHECK(DecodePipeMessage(ByteSpan{body, sizeof(body)}, view));
+    QT_CHECK(view.payload.size() == 3 && view.binary.size == binaryBytes);
+
+    // A text length near 2^32 units is clamped to the buffer.
+    std::uint8_t arguments[PipeMessageFormat::kActionPrefixSize + 6] = {};
+    std::uint32_t units = 0xFFFFFFFFu;
+    std::memcpy(arguments, &units, 4);
+    ActionArgumentsView decoded = DecodeActionArguments(ByteSpan{arguments, sizeof(arguments)});
+    QT_CHECK(decoded.text.size() == 3 && decoded.binary.size == 0);
+}
+
+// Stands in for libFuzzer: random bytes, mutated streams of valid frames,
+// and valid headers over arbitrary contents.
+void Fuzz(unsigned long inputs) {
+    std::mt19937 rng(1);
+    std::vector<std::uint8_t> seed;
+    for(std::uint64_t m = 0; m < 6; ++m) {
+        std::u16string text(rng() % 40, u'x');
+        std::vector<std::uint8_t> argument(rng() % 50, 7);
+        std::vector<std::uint8_t> body = Encode(PipeMessageWriter(m % 2 ? 5 : 6, u"act", text,
+                                                                  ByteSpan{argument.data(), argument.size()}));
+        std::vector<std::uint8_t> frame = Frame(m, body);
+        seed.insert(seed.end(), frame.begin(), frame.end());
+    }
+    unsigned long decoded = 0;
+    for(unsigned long i = 0; i < inputs; ++i) {
+        std::vector<std::uint8_t> input;
+        switch(i % 4) {
+        case 0:
+            input.resize(rng() % 200);
+            for(auto& byte : input) {
+                byte = static_cast<std::uint8_t>(rng());
+            }
+            break;
+        case 3: {
+            std::u16string action(rng() % 8, u'a');
+            std::vector<std::uint8_t> binary(rng() % 64);
+            for(auto& byte : binary) {
+                byte = static_cast<std::uint8_t>(rng());
+            }
+            if(binary.size() >= 4 && rng() % 2) {
+                std::uint32_t units = rng() % 40;
+                std::memcpy(binary.data(), &units, sizeof(units));
+            }
+            PipeMessageView view;
+            view.type = rng();
+            view.intValue = static_cast<std::int32_t>(rng());
+            view.explorer = rng();
+            view.payload = action;
+            view.binary = ByteSpan{binary.data(), binary.size()};
+            input = Encode(PipeMessageWriter(view));
+            break;
+        }
+        default:
+            input = seed;
+            if(i % 4 == 2) {
+                // Start at the first message body instead of a frame header.
+                input.erase(input.begin(), input.begin() + sizeof(FrameHeader));
+                input.resize(std::min<std::size_t>(input.size(), 48 + rng() % 150));
+            }
+            for(unsigned flip = 0, flips = 1 + rng() % 4; flip < flips && !input.empty(); ++flip) {
+                std::size_t at = rng() % input.size();
+                switch(rng() % 4) {
+                case 0:
+                    input[at] = static_cast<std::uint8_t>(rng());
+                    break;
+                case 1:
+                    input[at] ^= static_cast<std::uint8_t>(1u << (rng() % 8));
+                    break;
+                case 2:
+                    input.resize(at);
+                    break;
+                default:
+                    if(at + 4 <= input.size()) {
+                        std::uint32_t value = rng() % 300;
+                        std::memcpy(&input[at], &value, sizeof(value));
+                    }
+                    break;
+                }
+            }
+            break;
+        }
+        alignas(8) static std::uint8_t aligned[4096];
+        if(!input.empty() && input.size() <= sizeof(aligned)) {
+            std::memcpy(aligned, input.data(), input.size());
+            PipeMessageView view;
+            decoded += DecodePipeMessage(ByteSpan{aligned, input.size()}, view);
+        }
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    std::printf("fuzz: %lu inputs, %lu decoded as messages\n", inputs, decoded);
+}
+
+// An action message received through Feed in 16 KB reads, decoded as the
+// instance pipe server does, and the same message sent as a gathered post.
+void Benchmark() {
+    const std::u16string action = u"desktop.groups";
+    const std::u16string text = u"C:\\Users\\someone\\Documents\\Projects\\qttabbar";
+    const std::vector<std::uint8_t> argument(64, 0x5a);
+    const ByteSpan argumentSpan{argument.data(), argument.size()};
+    std::vector<std::uint8_t> body = Encode(PipeMessageWriter(6, action, text, argumentSpan));
+    std::vector<std::uint8_t> stream;
+    const int messages = 20000;
+    for(int i = 0; i < messages; ++i) {
+        std::vector<std::uint8_t> frame = Frame(i, body);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    std::size_t textUnits = 0;
+    MessageChannel receiver(std::make_unique<NullTransport>(),
+        [&](MessageChannel&, FrameKind, std::uint64_t, ByteSpan received) {
+            PipeMessageView message;
+            QT_CHECK(DecodePipeMessage(received, message) && message.payload == action);
+            textUnits += DecodeActionArguments(message.binary).text.size();
+        });
+    auto feedAll = [&]() {
+        for(std::size_t offset = 0; offset < stream.size(); offset += 16 * 1024) {
+            QT_CHECK(receiver.Feed(stream.data() + offset, std::min<std::size_t>(16 * 1024, stream.size() - offset)));
+        }
+    };
+    feedAll();
+    long allocations = AllocationCount();
+    auto start = Clock::now();
+    feedAll();
+    double receive = ElapsedNanoseconds(start) / messages;
+    double receiveAllocations = double(AllocationCount() - allocations) / messages;
+    QT_CHECK(textUnits == 2 * messages * text.size());
+
+    MessageChannel sender(std::make_unique<NullTransport>(), nullptr);
+    allocations = AllocationCount();
+    start = Clock::now();
+    for(int i = 0; i < messages; ++i) {
+        PipeMessageWriter writer(6, action, text, argumentSpan);
+        QT_CHECK(sender.Post(writer.Segments(), writer.SegmentCount()));
+    }
+    double send = ElapsedNanoseconds(start) / messages;
+    double sendAllocations = double(AllocationCount() - allocations) / messages;
+    std::printf("receive %.0f ns/message (%.2f allocations), send %.0f ns/message (%.2f allocations)\n", receive,
+                receiveAllocations, send, sendAllocations);
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+    CheckMessage(data, size);
+    if(size >= 4) {
+        std::uint32_t seed;
+        std::memcpy(&seed, data, sizeof(seed));
+        CheckFeed(data, size, seed);
+    }
+    return 0;
+}
+
+#ifndef NO_MAIN
+int main(int argc, char** argv) {
+    CheckWrappingSizes();
+    Fuzz(qttabbar::test::CountArgument(argc, argv, 1, 200000));
+    Benchmark();
+    std::puts("ok");
+    return 0;
+}
+#endif
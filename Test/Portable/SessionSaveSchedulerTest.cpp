@@ -0,0 +1,278 @@
+// Drives SaveCoalescer with ManualSaveClock through the quiet period, the
+// max-delay cap and the flush a closing window makes, with BackgroundSaveWriter
+// behind it the way TabBarHost uses them. Then replays bursts of tab changes to
+// count the writes saved, and times the writer under a stream of submissions.
+//
+// SessionSaveSchedulerTest [bursts]
+
+#include "SessionSaveScheduler.h"
+
+#include "TestSupport.h"
+
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using namespace std::chrono_literals;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+std::vector<std::uint8_t> Payload(std::uint32_t value) {
+    return {static_cast<std::uint8_t>(value), static_cast<std::uint8_t>(value >> 8),
+            static_cast<std::uint8_t>(value >> 16), static_cast<std::uint8_t>(value >> 24)};
+}
+
+std::uint32_t Value(const std::vector<std::uint8_t>& payload) {
+    return payload[0] | payload[1] << 8 | payload[2] << 16 | static_cast<std::uint32_t>(payload[3]) << 24;
+}
+
+// Records the last payload written to each target; each write can be made slow.
+struct Disk {
+    std::mutex mutex;
+    std::vector<std::pair<std::filesystem::path, std::uint32_t>> last;
+    std::atomic<int> writes{0};
+    std::chrono::microseconds delay{0};
+
+    BackgroundSaveWriter::WriteFn Writer() {
+        return [this](const std::filesystem::path& target, const std::vector<std::uint8_t>& payload) {
+            if(delay.count() > 0) {
+                std::this_thread::sleep_for(delay);
+            }
+            std::lock_guard guard(mutex);
+            ++writes;
+            for(auto& entry : last) {
+                if(entry.first == target) {
+                    entry.second = Value(payload);
+                    return true;
+                }
+            }
+            last.emplace_back(target, Value(payload));
+            return true;
+        };
+    }
+
+    std::uint32_t Get(const std::filesystem::path& target) {
+        std::lock_guard guard(mutex);
+        for(const auto& entry : last) {
+            if(entry.first == target) {
+                return entry.second;
+            }
+        }
+        return 0;
+    }
+};
+
+// TabBarHost's session timer: ScheduleSessionSave arms it for TimeUntilDue,
+// and when it fires the session is flushed if due or the timer re-armed.
+class Host {
+public:
+    Host(ManualSaveClock& clock, BackgroundSaveWriter& writer) : m_clock(clock), m_writer(writer), m_saves(clock) {
+    }
+
+    void Change() {
+        ++m_state;
+        m_saves.Request();
+        if(auto remaining = m_saves.TimeUntilDue()) {
+            m_timer = m_clock.Now() + *remaining;
+        }
+    }
+
+    // Advances the clock in steps, firing the timer when it comes due.
+    void Wait(std::chrono::milliseconds duration) {
+        ISaveClock::TimePoint end = m_clock.Now() + duration;
+        while(m_timer && *m_timer <= end) {
+            m_clock.Advance(std::chrono::duration_cast<std::chrono::milliseconds>(*m_timer - m_clock.Now()));
+            m_timer.reset();
+            if(m_saves.IsDue()) {
+                Flush(false);
+            } else if(auto remaining = m_saves.TimeUntilDue()) {
+                m_timer = m_clock.Now() + std::max(*remaining, std::chrono::milliseconds(50));
+            }
+        }
+        m_clock.Advance(std::chrono::duration_cast<std::chrono::milliseconds>(end - m_clock.Now()));
+    }
+
+    // What a closing window does through SaveSessionState.
+    void Flush(bool wait) {
+        m_timer.reset();
+        m_writer.Submit(L"Session.qts", Payload(m_state));
+        m_saves.MarkFlushed();
+        if(wait) {
+            m_writer.WaitIdle();
+        }
+    }
+
+    const SaveCoalescer& Saves() const { return m_saves; }
+    std::uint32_t State() const { return m_state; }
+
+private:
+    ManualSaveClock& m_clock;
+    BackgroundSaveWriter& m_writer;
+    SaveCoalescer m_saves;
+    std::optional<ISaveClock::TimePoint> m_timer;
+    std::uint32_t m_state = 0;
+};
+
+void CheckQuietPeriod() {
+    ManualSaveClock clock;
+    SaveCoalescer saves(clock);
+    QT_CHECK(!saves.IsDirty() && !saves.IsDue() && !saves.TimeUntilDue());
+    saves.Request();
+    QT_CHECK(saves.IsDirty() && *saves.TimeUntilDue() == 750ms);
+    clock.Advance(749ms);
+    QT_CHECK(!saves.IsDue() && *saves.TimeUntilDue() == 1ms);
+    // Another change restarts the quiet period.
+    saves.Request();
+    clock.Advance(749ms);
+    QT_CHECK(!saves.IsDue());
+    clock.Advance(1ms);
+    QT_CHECK(saves.IsDue() && *saves.TimeUntilDue() == 0ms);
+    clock.Advance(10s);
+    QT_CHECK(saves.IsDue() && *saves.TimeUntilDue() == 0ms);
+    saves.MarkFlushed();
+    QT_CHECK(!saves.IsDirty() && !saves.IsDue() && !saves.TimeUntilDue());
+    saves.MarkFlushed();
+    QT_CHECK(saves.GetCounters().requested == 2 && saves.GetCounters().flushed == 1);
+}
+
+void CheckMaxDelay() {
+    ManualSaveClock clock;
+    SaveCoalescer saves(clock);
+    // A change every 500 ms never leaves a quiet period, so the cap applies
+    // 5 s after the first one.
+    for(int i = 0; i < 10; ++i) {
+        saves.Request();
+        QT_CHECK(!saves.IsDue());
+        QT_CHECK(*saves.TimeUntilDue() == std::min(750ms, 5000ms - i * 500ms));
+        clock.Advance(500ms);
+    }
+    QT_CHECK(saves.IsDue());
+    // The cap counts from the first change after a flush.
+    saves.MarkFlushed();
+    saves.Request();
+    clock.Advance(700ms);
+    saves.Request();
+    QT_CHECK(*saves.TimeUntilDue() == 750ms);
+
+    SaveCoalescer custom(clock, {100ms, 250ms});
+    for(int i = 0; i < 3; ++i) {
+        custom.Request();
+        clock.Advance(90ms);
+    }
+    QT_CHECK(custom.IsDue() && *custom.TimeUntilDue() == 0ms);
+}
+
+// A closing window flushes at once and waits, whatever the timer says; the
+// newest state is on disk when the flush returns.
+void CheckFlushOnClose() {
+    Disk disk;
+    disk.delay = 2ms;
+    BackgroundSaveWriter writer(disk.Writer());
+    ManualSaveClock clock;
+    Host host(clock, writer);
+    for(int i = 0; i < 20; ++i) {
+        host.Change();
+        host.Wait(100ms);
+    }
+    QT_CHECK(disk.writes == 0 && host.Saves().IsDirty());
+    host.Flush(true);
+    QT_CHECK(disk.writes == 1 && disk.Get(L"Session.qts") == host.State() && !host.Saves().IsDirty());
+
+    // Submissions queued behind a slow write are superseded, and WaitIdle
+    // returns only after the last of them is written.
+    for(std::uint32_t i = 1; i <= 50; ++i) {
+        writer.Submit(L"Session.qts", Payload(1000 + i));
+        writer.Submit(L"Other.qts", Payload(2000 + i));
+    }
+    writer.WaitIdle();
+    QT_CHECK(disk.Get(L"Session.qts") == 1050 && disk.Get(L"Other.qts") == 2050);
+    BackgroundSaveWriter::Counters counters = writer.GetCounters();
+    QT_CHECK(counters.submitted == 101 && counters.failed == 0);
+    QT_CHECK(counters.written + counters.superseded == counters.submitted);
+    QT_CHECK(counters.written == static_cast<std::uint64_t>(disk.writes));
+    std::printf("slow writer: 100 submissions written as %llu writes\n",
+                static_cast<unsigned long long>(counters.written - 1));
+
+    // A writer idle since its last flush starts a new worker on demand.
+    writer.Submit(L"Session.qts", Payload(7));
+    writer.WaitIdle();
+    QT_CHECK(disk.Get(L"Session.qts") == 7);
+}
+
+// Bursts of tab changes 20-300 ms apart with pauses of up to 3 s between
+// them, as when navigating and opening tabs.
+void ReplayBursts(unsigned long bursts) {
+    Disk disk;
+    BackgroundSaveWriter writer(disk.Writer());
+    ManualSaveClock clock;
+    Host host(clock, writer);
+    std::mt19937 rng(5);
+    std::uint64_t changes = 0;
+    for(unsigned long burst = 0; burst < bursts; ++burst) {
+        for(unsigned int n = 1 + rng() % 40; n > 0; --n) {
+            host.Change();
+            ++changes;
+            host.Wait(std::chrono::milliseconds(20 + rng() % 280));
+            // The cap bounds how stale the file can get while changes continue.
+            QT_CHECK(!host.Saves().IsDirty() || !host.Saves().IsDue());
+        }
+        host.Wait(std::chrono::milliseconds(rng() % 3000));
+    }
+    host.Wait(1s);
+    writer.WaitIdle();
+    QT_CHECK(!host.Saves().IsDirty() && disk.Get(L"Session.qts") == host.State());
+    SaveCoalescer::Counters counters = host.Saves().GetCounters();
+    QT_CHECK(counters.requested == changes);
+    std::printf("%llu changes in %lu bursts saved with %llu flushes\n", static_cast<unsigned long long>(changes),
+                bursts, static_cast<unsigned long long>(counters.flushed));
+}
+
+void Benchmark() {
+    ManualSaveClock clock;
+    SaveCoalescer saves(clock);
+    const int iterations = 2000000;
+    std::uint64_t due = 0;
+    auto start = Clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        saves.Request();
+        clock.Advance(1ms);
+        if(saves.TimeUntilDue() && saves.IsDue()) {
+            saves.MarkFlushed();
+            ++due;
+        }
+    }
+    double perRequest = ElapsedNanoseconds(start) / iterations;
+    QT_CHECK(due == static_cast<std::uint64_t>(iterations / 5000));
+
+    // One window's session submitted from the UI thread as fast as it can.
+    Disk disk;
+    disk.delay = 200us;
+    BackgroundSaveWriter writer(disk.Writer());
+    const int submissions = 20000;
+    std::vector<std::uint8_t> session(16 * 1024);
+    start = Clock::now();
+    for(int i = 0; i < submissions; ++i) {
+        writer.Submit(L"Session.qts", session);
+    }
+    double perSubmit = ElapsedNanoseconds(start) / submissions;
+    writer.WaitIdle();
+    std::printf("coalescer: %.1f ns per request; writer: %.0f ns per 16 KB submit, %d submissions, %d writes\n",
+                perRequest, perSubmit, submissions, disk.writes.load());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckQuietPeriod();
+    CheckMaxDelay();
+    CheckFlushOnClose();
+    ReplayBursts(qttabbar::test::CountArgument(argc, argv, 1, 2000));
+    Benchmark();
+    std::puts("ok");
+    return 0;
+}
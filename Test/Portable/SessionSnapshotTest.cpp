@@ -0,0 +1,186 @@
+// Round-trips random sessions through the snapshot codec and a file, checks
+// that truncated and corrupted buffers are refused or read back in bounds, and
+// times encoding and decoding against the ';'-joined registry string the
+// snapshot replaced.
+//
+// SessionSnapshotTest [sessions]
+
+#include "SessionSnapshot.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+std::mt19937 g_rng(11);
+
+// Mostly ASCII, with some characters outside the BMP so that UTF-16
+// surrogate pairs are exercised where wchar_t is 32 bits wide.
+std::wstring RandomText(std::size_t length) {
+    static const wchar_t kExtra[] = {L'\u00E9', L'\u4E2D', L'\u6587', L'\uFF3C', static_cast<wchar_t>(0x1F4C1)};
+    std::wstring text;
+    for(std::size_t i = 0; i < length; ++i) {
+        if(g_rng() % 8 == 0 && sizeof(wchar_t) > 2) {
+            text.push_back(kExtra[g_rng() % 5]);
+        } else if(g_rng() % 8 == 0) {
+            text.push_back(kExtra[g_rng() % 4]);
+        } else {
+            text.push_back(static_cast<wchar_t>(L'a' + g_rng() % 26));
+        }
+    }
+    return text;
+}
+
+std::vector<SessionTab> RandomSession(std::size_t count) {
+    std::vector<SessionTab> tabs(count);
+    for(SessionTab& tab : tabs) {
+        tab.path = L"C:\\" + RandomText(1 + g_rng() % 60);
+        if(g_rng() % 4 == 0) {
+            tab.alias = RandomText(1 + g_rng() % 12);
+        }
+        tab.locked = g_rng() % 5 == 0;
+    }
+    return tabs;
+}
+
+bool SameTabs(const std::vector<SessionTab>& left, const std::vector<SessionTab>& right) {
+    if(left.size() != right.size()) {
+        return false;
+    }
+    for(std::size_t i = 0; i < left.size(); ++i) {
+        if(left[i].path != right[i].path || left[i].alias != right[i].alias || left[i].locked != right[i].locked) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads every tab of a buffer the reader accepted; the views must stay
+// inside the buffer.
+void CheckInBounds(const std::vector<std::uint8_t>& bytes, std::size_t size) {
+    SessionSnapshotReader reader(bytes.data(), size);
+    if(!reader.IsValid()) {
+        QT_CHECK(reader.GetCount() == 0 && reader.GetActiveIndex() == 0);
+        return;
+    }
+    QT_CHECK(reader.GetCount() == 0 || reader.GetActiveIndex() < reader.GetCount());
+    const auto* begin = reinterpret_cast<const char16_t*>(bytes.data());
+    const auto* end = reinterpret_cast<const char16_t*>(bytes.data() + size);
+    for(std::size_t i = 0; i < reader.GetCount(); ++i) {
+        SessionTabView view = reader.At(i);
+        for(std::u16string_view text : {view.path, view.alias}) {
+            QT_CHECK(text.empty() || (text.data() >= begin && text.data() + text.size() <= end));
+        }
+    }
+}
+
+void CheckRoundTrips(unsigned long sessions) {
+    for(unsigned long i = 0; i < sessions; ++i) {
+        std::vector<SessionTab> tabs = RandomSession(g_rng() % 40);
+        std::size_t active = g_rng() % (tabs.size() + 2);
+        std::vector<std::uint8_t> bytes = EncodeSessionSnapshot(tabs, active);
+        QT_CHECK(bytes.size() % 4 == 0);
+        SessionSnapshotReader reader(bytes.data(), bytes.size());
+        QT_CHECK(reader.IsValid() && reader.GetCount() == tabs.size());
+        QT_CHECK(reader.GetActiveIndex() == (active < tabs.size() ? active : 0));
+        QT_CHECK(SameTabs(reader.Materialize(), tabs));
+
+        // A truncated buffer is refused unless only the last record's padding
+        // was cut, in which case it still reads back whole.
+        for(std::size_t size = 0; size < bytes.size(); ++size) {
+            SessionSnapshotReader truncated(bytes.data(), size);
+            QT_CHECK(!truncated.IsValid() || SameTabs(truncated.Materialize(), tabs));
+        }
+
+        // Corrupted bytes never lead the reader outside the buffer.
+        std::vector<std::uint8_t> corrupt = bytes;
+        for(int flips = 0; flips < 4; ++flips) {
+            corrupt[g_rng() % corrupt.size()] ^= static_cast<std::uint8_t>(1u << (g_rng() % 8));
+            CheckInBounds(corrupt, corrupt.size());
+        }
+    }
+    QT_CHECK(!SessionSnapshotReader(nullptr, 0).IsValid());
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "SessionSnapshotTest";
+    std::filesystem::path path = directory / "Session.qts";
+    std::vector<SessionTab> tabs = RandomSession(25);
+    QT_CHECK(WriteSessionSnapshotFile(path, EncodeSessionSnapshot(tabs, 7)));
+    std::size_t active = 0;
+    auto read = ReadSessionSnapshotFile(path, &active);
+    QT_CHECK(read && SameTabs(*read, tabs) && active == 7);
+    QT_CHECK(!ReadSessionSnapshotFile(directory / "missing.qts"));
+    std::error_code ec;
+    std::filesystem::remove_all(directory, ec);
+}
+
+// The registry value the snapshot replaced: paths only, ';'-joined.
+std::wstring JoinPaths(const std::vector<SessionTab>& tabs) {
+    std::wstring joined;
+    for(const SessionTab& tab : tabs) {
+        joined.append(tab.path);
+        joined.push_back(L';');
+    }
+    return joined;
+}
+
+std::vector<std::wstring> SplitPaths(const std::wstring& joined) {
+    std::vector<std::wstring> paths;
+    std::size_t start = 0;
+    for(std::size_t end; (end = joined.find(L';', start)) != std::wstring::npos; start = end + 1) {
+        paths.push_back(joined.substr(start, end - start));
+    }
+    return paths;
+}
+
+void Benchmark() {
+    std::printf("%6s | %10s | %12s | %12s | %12s | %12s\n", "tabs", "bytes", "encode MB/s", "view MB/s",
+                "decode MB/s", "joined MB/s");
+    for(std::size_t count : {10, 100, 1000}) {
+        std::vector<SessionTab> tabs = RandomSession(count);
+        std::vector<std::uint8_t> bytes = EncodeSessionSnapshot(tabs, 0);
+        int iterations = static_cast<int>(std::max<std::size_t>(200, 200000 / count));
+        std::size_t sink = 0;
+        // The joined string is measured by its own size as a REG_SZ.
+        std::size_t joinedBytes = (JoinPaths(tabs).size() + 1) * 2;
+        auto rate = [&](std::size_t size, auto&& work) {
+            auto start = Clock::now();
+            for(int i = 0; i < iterations; ++i) {
+                work();
+            }
+            return static_cast<double>(size) * iterations / ElapsedNanoseconds(start) * 1e3;
+        };
+        double encode = rate(bytes.size(), [&]() { sink += EncodeSessionSnapshot(tabs, 0).size(); });
+        // What RestoreSessionState does: validate, then view each path in place.
+        double view = rate(bytes.size(), [&]() {
+            SessionSnapshotReader reader(bytes.data(), bytes.size());
+            for(std::size_t i = 0; i < reader.GetCount(); ++i) {
+                sink += reader.At(i).path.size();
+            }
+        });
+        double decode = rate(bytes.size(), [&]() {
+            sink += SessionSnapshotReader(bytes.data(), bytes.size()).Materialize().size();
+        });
+        double joined = rate(joinedBytes, [&]() { sink += SplitPaths(JoinPaths(tabs)).size(); });
+        QT_CHECK(sink > 0);
+        std::printf("%6zu | %10zu | %12.0f | %12.0f | %12.0f | %12.0f\n", count, bytes.size(), encode, view, decode,
+                    joined);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckRoundTrips(qttabbar::test::CountArgument(argc, argv, 1, 2000));
+    Benchmark();
+    std::puts("ok");
+    return 0;
+}
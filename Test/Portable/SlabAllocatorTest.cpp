@@ -0,0 +1,284 @@
+// Fuzzes MinHook's SlabAllocator over a simulated address space, then counts
+// the page queries it needs next to the one-block-at-a-time probing it
+// replaced.
+//
+// SlabAllocatorTest [rounds]
+
+#include <stdint.h>
+
+#include "slab.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace MinHook;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+constexpr uintptr_t kGranularity = 0x10000;
+constexpr uintptr_t kMinAddress = 0x10000;
+constexpr uintptr_t kMaxAddress = 0x7FFFFFFEFFFFull;
+constexpr uintptr_t kMaxDistance = 0x20000000;
+constexpr size_t kSlotSize = 256;
+
+// VirtualQuery/VirtualAlloc over a map of reserved ranges. Reservations can
+// be made to fail as if another thread had taken the address first.
+class FakePages : public PageProvider {
+public:
+    std::map<uintptr_t, size_t> used;
+    size_t queries = 0;
+    size_t reserves = 0;
+    size_t releases = 0;
+    std::mt19937_64* rng = nullptr;
+    unsigned failPercent = 0;
+
+    bool Query(uintptr_t address, PAGE_REGION& region) override {
+        ++queries;
+        return Describe(address, region);
+    }
+
+    void* Reserve(uintptr_t address, size_t size) override {
+        ++reserves;
+        if(address == 0) {
+            for(uintptr_t candidate = kMinAddress;; candidate += kGranularity) {
+                if(IsFree(candidate, size)) {
+                    used[candidate] = size;
+                    return reinterpret_cast<void*>(candidate);
+                }
+            }
+        }
+        QT_CHECK(address % kGranularity == 0);
+        if(rng && (*rng)() % 100 < failPercent) {
+            used[address] = size;
+            return nullptr;
+        }
+        if(!IsFree(address, size)) {
+            return nullptr;
+        }
+        used[address] = size;
+        return reinterpret_cast<void*>(address);
+    }
+
+    void Release(void* address, size_t) override {
+        ++releases;
+        used.erase(reinterpret_cast<uintptr_t>(address));
+    }
+
+    bool IsFree(uintptr_t address, size_t size) const {
+        PAGE_REGION region;
+        return Describe(address, region) && region.isFree && address + size <= region.base + region.size;
+    }
+
+private:
+    bool Describe(uintptr_t address, PAGE_REGION& region) const {
+        if(address < kMinAddress || address > kMaxAddress) {
+            return false;
+        }
+        auto next = used.upper_bound(address);
+        if(next != used.begin()) {
+            auto previous = std::prev(next);
+            if(address < previous->first + previous->second) {
+                region = PAGE_REGION{previous->first, previous->second, false};
+                return true;
+            }
+        }
+        uintptr_t low = next == used.begin() ? kMinAddress : std::prev(next)->first + std::prev(next)->second;
+        uintptr_t high = next == used.end() ? kMaxAddress + 1 : next->first;
+        region = PAGE_REGION{low, high - low, true};
+        return true;
+    }
+};
+
+// The previous allocator: blocks in range are scanned in order, and a new
+// block is found by querying one allocation granule at a time outward from
+// the middle of the range.
+class ProbingAllocator {
+public:
+    explicit ProbingAllocator(FakePages& pages) : m_pages(pages) {}
+
+    void* Allocate(uintptr_t origin) {
+        uintptr_t low = std::max(kMinAddress, origin - std::min(origin, kMaxDistance));
+        uintptr_t high = std::min(kMaxAddress, origin + kMaxDistance);
+        auto byBase = [](const Block& block, uintptr_t base) { return block.base < base; };
+        auto first = std::lower_bound(m_blocks.begin(), m_blocks.end(), low, byBase);
+        auto last = std::lower_bound(first, m_blocks.end(), high, byBase);
+        for(auto block = first; block != last; ++block) {
+            if(block->used + kSlotSize <= kGranularity) {
+                void* slot = reinterpret_cast<void*>(block->base + block->used);
+                block->used += kSlotSize;
+                return slot;
+            }
+        }
+        intptr_t lowGranule = static_cast<intptr_t>(low / kGranularity);
+        intptr_t highGranule = static_cast<intptr_t>(high / kGranularity);
+        intptr_t offset = 0;
+        for(intptr_t i = 0; i < highGranule - lowGranule + 1; ++i) {
+            offset = -offset + (i & 1);
+            uintptr_t address = static_cast<uintptr_t>((lowGranule + highGranule) / 2 + offset) * kGranularity;
+            PAGE_REGION region;
+            if(!m_pages.Query(address, region) || !region.isFree) {
+                continue;
+            }
+            if(void* base = m_pages.Reserve(address, kGranularity)) {
+                Block block{reinterpret_cast<uintptr_t>(base), kSlotSize};
+                m_blocks.insert(std::lower_bound(m_blocks.begin(), m_blocks.end(), block.base, byBase), block);
+                return base;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    struct Block {
+        uintptr_t base;
+        size_t used;
+    };
+
+    FakePages& m_pages;
+    std::vector<Block> m_blocks;
+};
+
+void Fuzz(unsigned long rounds) {
+    std::mt19937_64 rng(7);
+    for(unsigned long round = 0; round < rounds; ++round) {
+        FakePages pages;
+        pages.rng = &rng;
+        pages.failPercent = round % 3 == 0 ? 20 : 0;
+
+        // Module images, then small reservations scattered around them.
+        std::vector<uintptr_t> images;
+        for(int i = 0; i < 40; ++i) {
+            uintptr_t base = 0x7ff000000000ull + (rng() % 0x7F000) * kGranularity;
+            size_t size = kGranularity * (1 + rng() % 300);
+            if(pages.IsFree(base, size) && pages.IsFree(base + size - kGranularity, kGranularity)) {
+                pages.used[base] = size;
+                images.push_back(base);
+            }
+        }
+        QT_CHECK(!images.empty());
+        for(int i = 0; i < 2000; ++i) {
+            int64_t granules = static_cast<int64_t>(rng() % 0x40000) - 0x20000;
+            uintptr_t base = images[rng() % images.size()] + granules * static_cast<int64_t>(kGranularity);
+            if(pages.IsFree(base, kGranularity)) {
+                pages.used[base] = kGranularity;
+            }
+        }
+
+        SlabAllocator allocator(pages, kSlotSize, kGranularity);
+        allocator.SetAddressLimits(kMinAddress, kMaxAddress);
+        std::map<uintptr_t, uintptr_t> live;  // slot -> origin, 0 for anywhere
+        for(int op = 0; op < 20000; ++op) {
+            if(live.empty() || rng() % 3 != 0) {
+                bool anywhere = rng() % 10 == 0;
+                uintptr_t origin = images[rng() % images.size()] + (rng() % kGranularity) * 16 % kGranularity;
+                void* slot = allocator.Allocate(anywhere ? 0 : origin, kMaxDistance);
+                if(!slot) {
+                    continue;
+                }
+                auto address = reinterpret_cast<uintptr_t>(slot);
+                QT_CHECK(live.count(address) == 0);
+                QT_CHECK(address % kSlotSize == 0);
+                if(!anywhere) {
+                    uintptr_t region = address - address % kGranularity;
+                    QT_CHECK(region >= origin - kMaxDistance && region + kGranularity - 1 <= origin + kMaxDistance);
+                }
+                live[address] = anywhere ? 0 : origin;
+                continue;
+            }
+            // Freeing a slot and allocating for the same origin reuses a
+            // slot without asking the provider.
+            auto freed = live.begin();
+            std::advance(freed, rng() % live.size());
+            size_t queries = pages.queries;
+            size_t reserves = pages.reserves;
+            allocator.Free(reinterpret_cast<void*>(freed->first));
+            void* slot = allocator.Allocate(freed->second, kMaxDistance);
+            QT_CHECK(slot && pages.queries == queries && pages.reserves == reserves);
+            live[reinterpret_cast<uintptr_t>(slot)] = freed->second;
+            if(reinterpret_cast<uintptr_t>(slot) != freed->first) {
+                live.erase(freed);
+            }
+            auto dropped = live.begin();
+            std::advance(dropped, rng() % live.size());
+            allocator.Free(reinterpret_cast<void*>(dropped->first));
+            live.erase(dropped);
+        }
+        for(const auto& slot : live) {
+            PAGE_REGION region;
+            QT_CHECK(pages.Query(slot.first, region) && !region.isFree);
+        }
+        size_t regions = allocator.regionCount();
+        allocator.ReleaseAll();
+        QT_CHECK(pages.releases == regions);
+    }
+}
+
+// 5000 hooks spread over 50 modules in a fragmented address space.
+void Benchmark() {
+    for(int slab = 0; slab < 2; ++slab) {
+        std::mt19937_64 rng(3);
+        FakePages pages;
+        std::vector<uintptr_t> images;
+        for(int i = 0; i < 50; ++i) {
+            uintptr_t base = 0x7ff800000000ull + i * 0x4000000ull;
+            pages.used[base] = kGranularity * 64;
+            images.push_back(base);
+        }
+        for(int i = 0; i < 400000; ++i) {
+            uintptr_t base = 0x7ff7f0000000ull + (rng() % 0x20000) * kGranularity;
+            size_t size = kGranularity * (1 + rng() % 32);
+            if(pages.IsFree(base, size) && pages.IsFree(base + size - kGranularity, kGranularity)) {
+                pages.used[base] = size;
+            }
+        }
+        pages.queries = 0;
+        pages.reserves = 0;
+
+        const int hooks = 5000;
+        size_t allocated = 0;
+        auto start = Clock::now();
+        if(!slab) {
+            ProbingAllocator allocator(pages);
+            for(int i = 0; i < hooks; ++i) {
+                allocated += allocator.Allocate(images[i % 50] + 0x1000) != nullptr;
+            }
+            std::printf("probing: %zu slots, %zu queries, %zu reserves, %.2f ms\n", allocated, pages.queries,
+                        pages.reserves, ElapsedNanoseconds(start) / 1e6);
+            continue;
+        }
+        SlabAllocator allocator(pages, kSlotSize, kGranularity);
+        allocator.SetAddressLimits(kMinAddress, kMaxAddress);
+        std::vector<void*> slots;
+        for(int i = 0; i < hooks; ++i) {
+            slots.push_back(allocator.Allocate(images[i % 50] + 0x1000, kMaxDistance));
+            allocated += slots.back() != nullptr;
+        }
+        std::printf("slab:    %zu slots, %zu queries, %zu reserves, %.2f ms\n", allocated, pages.queries,
+                    pages.reserves, ElapsedNanoseconds(start) / 1e6);
+        size_t queries = pages.queries;
+        for(int i = 0; i < hooks; i += 2) {
+            allocator.Free(slots[i]);
+        }
+        for(int i = 0; i < hooks; i += 2) {
+            QT_CHECK(allocator.Allocate(images[i % 50] + 0x1000, kMaxDistance));
+        }
+        std::printf("slab:    freeing and reallocating %d slots made %zu queries\n", hooks / 2,
+                    pages.queries - queries);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Fuzz(qttabbar::test::CountArgument(argc, argv, 1, 20));
+    Benchmark();
+    std::puts("ok");
+    return 0;
+}
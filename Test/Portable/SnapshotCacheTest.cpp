@@ -0,0 +1,193 @@
+// Counts configuration loads and JSON parses with and without SnapshotCache
+// while windows open, over a fake registry shaped like QTTabBar's settings,
+// and checks that one change costs one load even with concurrent readers.
+//
+// SnapshotCacheTest [windows]
+
+#include "SnapshotCache.h"
+
+#include "third_party/nlohmann/json.hpp"
+
+#include "TestSupport.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using nlohmann::json;
+using qttabbar::SnapshotCache;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+// Value names mapped to REG_DWORD values and to REG_SZ values holding JSON.
+struct FakeRegistry {
+    std::map<std::wstring, std::uint32_t> dwords;
+    std::map<std::wstring, std::wstring> strings;
+};
+
+struct FakeConfig {
+    std::vector<std::uint32_t> flags;
+    std::vector<json> values;
+};
+
+// Components that read the configuration while an Explorer window opens:
+// NativeTabControl, TabBarHost, QTButtonBar and HookManagerNative.
+constexpr int kReadsPerWindow = 4;
+
+std::atomic<int> g_loads{0};
+std::atomic<int> g_parses{0};
+
+std::wstring Widen(const std::string& text) {
+    return std::wstring(text.begin(), text.end());
+}
+
+FakeRegistry MakeRegistry() {
+    FakeRegistry registry;
+    for(const char* category : {"Window", "Tabs", "Tweaks", "Tips", "Misc", "Skin", "BBar", "Mouse", "Keys",
+                                "Plugin", "Lang", "Desktop"}) {
+        for(int i = 0; i < 14; ++i) {
+            registry.dwords[Widen(category) + L"\\Flag" + std::to_wstring(i)] = i & 1;
+        }
+    }
+    json color = {{"Value", 4294967295u}, {"knownColor", 0}, {"name", nullptr}, {"state", 2}};
+    for(int i = 0; i < 12; ++i) {
+        registry.strings[L"Skin\\Color" + std::to_wstring(i)] = Widen(color.dump());
+    }
+    json font = {{"FontName", "Segoe UI"}, {"FontSize", 9.0}, {"FontStyle", 0}};
+    registry.strings[L"Skin\\TabTextFont"] = Widen(font.dump());
+    registry.strings[L"Tips\\PreviewFont"] = Widen(font.dump());
+    json padding = {{"Left", 2}, {"Top", 2}, {"Right", 2}, {"Bottom", 2}};
+    for(int i = 0; i < 3; ++i) {
+        registry.strings[L"Skin\\Margin" + std::to_wstring(i)] = Widen(padding.dump());
+    }
+    json extensions = json::array();
+    for(int i = 0; i < 120; ++i) {
+        extensions.push_back("." + std::to_string(i) + "ext");
+    }
+    registry.strings[L"Tips\\TextExt"] = Widen(extensions.dump());
+    registry.strings[L"Tips\\ImageExt"] = Widen(extensions.dump());
+    for(int m = 0; m < 6; ++m) {
+        json actions = json::array();
+        for(int i = 0; i < 6; ++i) {
+            actions.push_back({{"Key", i * 17}, {"Value", i}});
+        }
+        registry.strings[L"Mouse\\Map" + std::to_wstring(m)] = Widen(actions.dump());
+    }
+    json shortcuts = json::array();
+    for(int i = 0; i < 80; ++i) {
+        shortcuts.push_back(i | (1 << 30));
+    }
+    registry.strings[L"Keys\\Shortcuts"] = Widen(shortcuts.dump());
+    json plugins = json::array();
+    for(int i = 0; i < 4; ++i) {
+        plugins.push_back({{"Key", "plugin" + std::to_string(i)}, {"Value", shortcuts}});
+    }
+    registry.strings[L"Keys\\PluginShortcuts"] = Widen(plugins.dump());
+    return registry;
+}
+
+// Mirrors LoadConfigFromRegistry: every value read, every JSON string
+// narrowed and parsed.
+FakeConfig Load(const FakeRegistry& registry) {
+    ++g_loads;
+    FakeConfig config;
+    for(const auto& value : registry.dwords) {
+        config.flags.push_back(value.second);
+    }
+    for(const auto& value : registry.strings) {
+        std::string utf8(value.second.begin(), value.second.end());
+        config.values.push_back(json::parse(utf8));
+        ++g_parses;
+    }
+    return config;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const FakeRegistry registry = MakeRegistry();
+    const int windows = static_cast<int>(qttabbar::test::CountArgument(argc, argv, 1, 2000));
+    const int changeEvery = 100;
+    volatile std::size_t sink = 0;
+
+    g_loads = 0;
+    g_parses = 0;
+    auto start = Clock::now();
+    for(int window = 0; window < windows; ++window) {
+        for(int read = 0; read < kReadsPerWindow; ++read) {
+            sink = sink + Load(registry).flags.size();
+        }
+    }
+    double uncachedTime = ElapsedNanoseconds(start) / windows;
+    int uncachedLoads = g_loads;
+    int uncachedParses = g_parses;
+
+    // A settings change every hundred windows.
+    std::atomic<bool> changed{false};
+    SnapshotCache<FakeConfig> cache([&]() { return Load(registry); }, [&]() { return changed.exchange(false); });
+    QT_CHECK(cache.Generation() == 0);
+    g_loads = 0;
+    g_parses = 0;
+    start = Clock::now();
+    int changes = 0;
+    for(int window = 0; window < windows; ++window) {
+        if(window % changeEvery == changeEvery / 2) {
+            changed = true;
+            ++changes;
+        }
+        for(int read = 0; read < kReadsPerWindow; ++read) {
+            sink = sink + cache.Get()->value.flags.size();
+        }
+    }
+    double cachedTime = ElapsedNanoseconds(start) / windows;
+    int cachedLoads = g_loads;
+    int cachedParses = g_parses;
+    QT_CHECK(cachedLoads == 1 + changes);
+    QT_CHECK(cache.Generation() == static_cast<std::uint64_t>(1 + changes));
+
+    // Windows opening together right after a change load once between them.
+    changed = true;
+    g_loads = 0;
+    std::atomic<int> ready{0};
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            ++ready;
+            while(ready < 8) {
+                std::this_thread::yield();
+            }
+            std::size_t flags = 0;
+            for(int read = 0; read < kReadsPerWindow * 100; ++read) {
+                flags += cache.Get()->value.flags.size();
+            }
+            QT_CHECK(flags > 0);
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    QT_CHECK(g_loads == 1);
+
+    // A snapshot held across an invalidation stays as it was.
+    auto held = cache.Get();
+    std::uint64_t generation = held->generation;
+    cache.Invalidate();
+    auto fresh = cache.Get();
+    QT_CHECK(held->generation == generation && fresh->generation == generation + 1);
+    QT_CHECK(held->value.values.size() == fresh->value.values.size());
+    QT_CHECK(cache.Get() == fresh);
+
+    std::printf("%d windows, %d reads each\n", windows, kReadsPerWindow);
+    std::printf("uncached: %.2f loads, %.1f JSON parses, %.1f us per window\n",
+                static_cast<double>(uncachedLoads) / windows, static_cast<double>(uncachedParses) / windows,
+                uncachedTime / 1e3);
+    std::printf("cached:   %.3f loads, %.2f JSON parses, %.2f us per window (%d changes)\n",
+                static_cast<double>(cachedLoads) / windows, static_cast<double>(cachedParses) / windows,
+                cachedTime / 1e3, changes);
+    std::puts("ok");
+    return 0;
+}
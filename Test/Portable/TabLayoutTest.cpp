@@ -0,0 +1,297 @@
+// Checks that flowing tab rows from the first changed tab matches a full flow,
+// that TabHitIndex agrees with a linear scan of the rects, and that
+// TextMeasureCache keys on font, DPI and text. Then times the reflows
+// NativeTabControl::LayoutTabs does with and without the cache, and hit tests
+// against the linear scan they replaced.
+//
+// TabLayoutTest [cases]
+
+#include "TabLayout.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+bool SameRects(const std::vector<TabRect>& left, const std::vector<TabRect>& right) {
+    if(left.size() != right.size()) {
+        return false;
+    }
+    for(std::size_t i = 0; i < left.size(); ++i) {
+        if(left[i].left != right[i].left || left[i].top != right[i].top || left[i].right != right[i].right
+           || left[i].bottom != right[i].bottom) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TabFlowParams RandomParams(std::mt19937& rng) {
+    TabFlowParams params;
+    params.originX = static_cast<int>(rng() % 8);
+    params.originY = static_cast<int>(rng() % 8);
+    params.wrapLimit = 100 + static_cast<int>(rng() % 1500);
+    params.rowHeight = 20 + static_cast<int>(rng() % 10);
+    params.spacing = static_cast<int>(rng() % 4);
+    params.plusWidth = rng() % 2 ? params.rowHeight : 0;
+    params.multiRow = rng() % 4 != 0;
+    return params;
+}
+
+void CheckFlow(unsigned long cases) {
+    std::mt19937 rng(9);
+    for(unsigned long c = 0; c < cases; ++c) {
+        TabFlowParams params = RandomParams(rng);
+        std::vector<int> widths(rng() % 60);
+        for(int& width : widths) {
+            width = 40 + static_cast<int>(rng() % 200);
+        }
+        std::vector<TabRect> rects;
+        TabFlowCursor full = FlowTabRows(params, widths, 0, rects);
+
+        // Every tab starts a row or follows the previous one, and no row but
+        // one holding a single tab crosses the wrap limit.
+        for(std::size_t i = 0; i < rects.size(); ++i) {
+            QT_CHECK(rects[i].right - rects[i].left == widths[i] && rects[i].bottom - rects[i].top == params.rowHeight);
+            bool rowStart = rects[i].left == params.originX;
+            QT_CHECK(rowStart || (i > 0 && rects[i].left == rects[i - 1].right + params.spacing
+                                  && rects[i].top == rects[i - 1].top));
+            QT_CHECK(!params.multiRow || rowStart || rects[i].right + params.plusWidth <= params.wrapLimit);
+            QT_CHECK(params.multiRow || rects[i].top == params.originY);
+        }
+
+        // Changing tabs from `first` on and flowing only those gives the
+        // same rects as flowing everything.
+        std::size_t first = widths.empty() ? 0 : rng() % (widths.size() + 1);
+        for(std::size_t i = first; i < widths.size(); ++i) {
+            if(rng() % 2) {
+                widths[i] = 40 + static_cast<int>(rng() % 200);
+            }
+        }
+        if(rng() % 4 == 0) {
+            widths.resize(first + rng() % 10, 80);
+        }
+        TabFlowCursor partial = FlowTabRows(params, widths, first, rects);
+        std::vector<TabRect> expected;
+        full = FlowTabRows(params, widths, 0, expected);
+        QT_CHECK(SameRects(rects, expected) && partial.x == full.x && partial.y == full.y);
+    }
+}
+
+// The PtInRect loop over every tab that TabHitIndex replaced.
+std::optional<std::size_t> LinearHitTest(const std::vector<TabRect>& rects, int x, int y) {
+    for(std::size_t i = 0; i < rects.size(); ++i) {
+        if(x >= rects[i].left && x < rects[i].right && y >= rects[i].top && y < rects[i].bottom) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+// Hit tests every pixel around the strip, including the gaps between tabs and
+// rows, after full and partial updates.
+void CheckHitIndex(unsigned long cases) {
+    std::mt19937 rng(21);
+    for(unsigned long c = 0; c < cases / 50; ++c) {
+        TabFlowParams params = RandomParams(rng);
+        params.rowGap = static_cast<int>(rng() % 6);
+        std::vector<int> widths(rng() % 40);
+        for(int& width : widths) {
+            width = 1 + static_cast<int>(rng() % 200);
+        }
+        std::vector<TabRect> rects;
+        FlowTabRows(params, widths, 0, rects);
+        TabHitIndex index;
+        index.Update(rects);
+        for(int step = 0; step < 3; ++step) {
+            int right = params.wrapLimit + 300;
+            int bottom = rects.empty() ? 40 : rects.back().bottom + 10;
+            for(int y = -2; y < bottom; ++y) {
+                for(int x = -2; x < right; x += 1 + static_cast<int>(rng() % 3)) {
+                    QT_CHECK(index.HitTest(x, y) == LinearHitTest(rects, x, y));
+                }
+            }
+            // Change, add or drop tabs from somewhere on and update from there.
+            std::size_t first = rng() % (widths.size() + 1);
+            widths.resize(first + rng() % 20, 60);
+            for(std::size_t i = first; i < widths.size(); ++i) {
+                widths[i] = 1 + static_cast<int>(rng() % 200);
+            }
+            FlowTabRows(params, widths, first, rects);
+            index.Update(rects, first);
+        }
+        std::size_t rows = 0;
+        for(std::size_t i = 0; i < rects.size(); ++i) {
+            rows += i == 0 || rects[i].top != rects[i - 1].top;
+        }
+        QT_CHECK(index.GetRowCount() == rows);
+        index.Clear();
+        QT_CHECK(index.GetRowCount() == 0 && !index.HitTest(params.originX, params.originY));
+    }
+}
+
+void CheckMeasureCache() {
+    int calls = 0;
+    TextMeasureCache::MeasureFn measure = [&calls](const std::wstring& text) {
+        ++calls;
+        return static_cast<int>(text.size()) * 7;
+    };
+    TextMeasureCache cache(4);
+    QT_CHECK(cache.Measure(1, 96, L"Documents", measure) == 63 && calls == 1);
+    QT_CHECK(cache.Measure(1, 96, L"Documents", measure) == 63 && calls == 1);
+    // Another font or DPI is measured again.
+    cache.Measure(2, 96, L"Documents", measure);
+    cache.Measure(1, 144, L"Documents", measure);
+    QT_CHECK(calls == 3 && cache.GetStats().hits == 1 && cache.GetStats().misses == 3);
+    // Reaching the capacity starts over rather than growing.
+    cache.Measure(1, 96, L"Desktop", measure);
+    cache.Measure(1, 96, L"Downloads", measure);
+    QT_CHECK(calls == 5);
+    cache.Measure(1, 96, L"Documents", measure);
+    QT_CHECK(calls == 6);
+    cache.Clear();
+    cache.Measure(1, 96, L"Downloads", measure);
+    QT_CHECK(calls == 7);
+}
+
+// Stands in for GetTextExtentPoint32 on a memory DC, which costs on the order
+// of a microsecond per title.
+int SlowMeasure(const std::wstring& text) {
+    volatile unsigned width = 0;
+    for(int pass = 0; pass < 40; ++pass) {
+        for(wchar_t ch : text) {
+            width = width + (static_cast<unsigned>(ch) % 5 + 5);
+        }
+    }
+    return static_cast<int>(width / 40);
+}
+
+// LayoutTabs: measure tabs from firstChanged on, then flow them.
+struct Strip {
+    std::vector<std::wstring> titles;
+    std::vector<int> widths;
+    std::vector<TabRect> rects;
+    TextMeasureCache cache;
+    bool cached = true;
+
+    void Layout(const TabFlowParams& params, std::size_t firstChanged) {
+        widths.resize(titles.size());
+        for(std::size_t i = firstChanged; i < titles.size(); ++i) {
+            int text = cached ? cache.Measure(1, 96, titles[i], SlowMeasure) : SlowMeasure(titles[i]);
+            widths[i] = std::clamp(text + 24, 48, 220);
+        }
+        FlowTabRows(params, widths, firstChanged, rects);
+    }
+};
+
+void BenchmarkReflow() {
+    std::printf("%5s | %18s | %18s | %18s | %18s\n", "tabs", "resize uncached us", "resize cached us",
+                "rename uncached us", "rename cached us");
+    for(std::size_t count : {20, 100, 500}) {
+        std::mt19937 rng(4);
+        Strip strip;
+        for(std::size_t i = 0; i < count; ++i) {
+            strip.titles.push_back(L"Folder name " + std::to_wstring(rng() % 100000));
+        }
+        TabFlowParams params;
+        params.originX = 4;
+        params.originY = 4;
+        params.rowHeight = 24;
+        params.plusWidth = 24;
+        params.multiRow = true;
+        int iterations = static_cast<int>(20000 / count);
+        double results[4] = {};
+        for(int cached = 0; cached < 2; ++cached) {
+            strip.cached = cached != 0;
+            strip.cache.Clear();
+            params.wrapLimit = 1200;
+            strip.Layout(params, 0);
+            // Dragging the window edge: every tab flows again.
+            auto start = Clock::now();
+            for(int i = 0; i < iterations; ++i) {
+                params.wrapLimit = 600 + i % 800;
+                strip.Layout(params, 0);
+            }
+            results[cached] = ElapsedNanoseconds(start) / iterations / 1e3;
+            // A title change in the middle: tabs from it on flow again.
+            start = Clock::now();
+            for(int i = 0; i < iterations; ++i) {
+                std::size_t tab = count / 2 + static_cast<std::size_t>(i) % (count / 2);
+                strip.titles[tab] = L"Folder name " + std::to_wstring(i % 50);
+                strip.Layout(params, tab);
+            }
+            results[2 + cached] = ElapsedNanoseconds(start) / iterations / 1e3;
+        }
+        std::printf("%5zu | %18.2f | %18.2f | %18.2f | %18.2f\n", count, results[0], results[1], results[2],
+                    results[3]);
+    }
+}
+
+// Mouse moves over a multi-row strip; a quarter of them land outside any tab.
+void BenchmarkHitTest() {
+    std::printf("%5s | %5s | %12s | %12s\n", "tabs", "rows", "index ns", "linear ns");
+    for(std::size_t count : {10, 50, 200, 1000}) {
+        std::mt19937 rng(8);
+        TabFlowParams params;
+        params.originX = 4;
+        params.originY = 4;
+        params.wrapLimit = 1600;
+        params.rowHeight = 24;
+        params.plusWidth = 24;
+        params.multiRow = true;
+        std::vector<int> widths(count);
+        for(int& width : widths) {
+            width = 48 + static_cast<int>(rng() % 172);
+        }
+        std::vector<TabRect> rects;
+        FlowTabRows(params, widths, 0, rects);
+        TabHitIndex index;
+        index.Update(rects);
+        std::vector<std::pair<int, int>> points(4096);
+        int bottom = rects.back().bottom;
+        for(auto& point : points) {
+            point = {static_cast<int>(rng() % 1700), static_cast<int>(rng() % (bottom + bottom / 3))};
+        }
+        const int rounds = 50;
+        std::size_t hits = 0;
+        auto start = Clock::now();
+        for(int round = 0; round < rounds; ++round) {
+            for(const auto& [x, y] : points) {
+                hits += index.HitTest(x, y).value_or(0);
+            }
+        }
+        double indexed = ElapsedNanoseconds(start) / (rounds * points.size());
+        std::size_t linearHits = 0;
+        start = Clock::now();
+        for(int round = 0; round < rounds; ++round) {
+            for(const auto& [x, y] : points) {
+                linearHits += LinearHitTest(rects, x, y).value_or(0);
+            }
+        }
+        double linear = ElapsedNanoseconds(start) / (rounds * points.size());
+        QT_CHECK(hits == linearHits);
+        std::printf("%5zu | %5zu | %12.1f | %12.1f\n", count, index.GetRowCount(), indexed, linear);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned long cases = qttabbar::test::CountArgument(argc, argv, 1, 50000);
+    CheckFlow(cases);
+    CheckHitIndex(cases);
+    CheckMeasureCache();
+    BenchmarkReflow();
+    BenchmarkHitTest();
+    std::puts("ok");
+    return 0;
+}
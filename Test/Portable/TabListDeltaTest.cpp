@@ -0,0 +1,186 @@
+// Property test for tab list deltas: diffing then applying reproduces the
+// target, stale deltas are refused, coalesced chains equal their last list,
+// and out-of-order appends are refused. Prints the op counts of typical
+// edits.
+//
+// TabListDeltaTest [cases]
+
+#include "TabListDelta.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace {
+
+using namespace qttabbar;
+
+std::mt19937_64 g_rng(12345);
+
+std::size_t Random(std::size_t bound) {
+    return bound ? static_cast<std::size_t>(g_rng() % bound) : 0;
+}
+
+// Few distinct strings, so edits often produce duplicates.
+std::wstring RandomPath() {
+    static const wchar_t* const kRoots[] = {L"C:\\a", L"C:\\b", L"C:\\c", L"D:\\x",
+                                            L"D:\\y", L"E:\\z", L"F:\\q", L"\\\\srv\\share"};
+    return kRoots[Random(8)] + std::to_wstring(Random(4));
+}
+
+bool SameTabs(const TabList& left, const TabList& right) {
+    return left.currentPath == right.currentPath && left.tabNames == right.tabNames
+           && left.tabPaths == right.tabPaths;
+}
+
+void InsertTab(TabList& list, std::size_t index, std::wstring name, std::wstring path) {
+    list.tabNames.insert(list.tabNames.begin() + static_cast<std::ptrdiff_t>(index), std::move(name));
+    list.tabPaths.insert(list.tabPaths.begin() + static_cast<std::ptrdiff_t>(index), std::move(path));
+}
+
+void EraseTab(TabList& list, std::size_t index) {
+    list.tabNames.erase(list.tabNames.begin() + static_cast<std::ptrdiff_t>(index));
+    list.tabPaths.erase(list.tabPaths.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+// Opens, closes, swaps, renames, navigates and moves tabs.
+TabList Mutate(TabList list) {
+    int edits = 1 + static_cast<int>(Random(Random(2) ? 3 : 12));
+    for(int edit = 0; edit < edits; ++edit) {
+        std::size_t count = list.tabNames.size();
+        switch(Random(7)) {
+        case 0:
+            InsertTab(list, Random(count + 1), RandomPath(), RandomPath());
+            break;
+        case 1:
+            if(count > 0) {
+                EraseTab(list, Random(count));
+            }
+            break;
+        case 2:
+            if(count > 0) {
+                std::size_t i = Random(count);
+                std::size_t j = Random(count);
+                std::swap(list.tabNames[i], list.tabNames[j]);
+                std::swap(list.tabPaths[i], list.tabPaths[j]);
+            }
+            break;
+        case 3:
+            if(count > 0) {
+                list.tabNames[Random(count)] = RandomPath();
+            }
+            break;
+        case 4:
+            if(count > 0) {
+                std::size_t i = Random(count);
+                list.tabPaths[i] = RandomPath();
+                if(Random(2)) {
+                    list.tabNames[i] = RandomPath();
+                }
+            }
+            break;
+        case 5:
+            list.currentPath = RandomPath();
+            break;
+        default:
+            if(count > 1) {
+                std::size_t from = Random(count);
+                std::size_t to = std::min(Random(count), count - 1);
+                std::wstring name = list.tabNames[from];
+                std::wstring path = list.tabPaths[from];
+                EraseTab(list, from);
+                InsertTab(list, to, std::move(name), std::move(path));
+            }
+            break;
+        }
+    }
+    return list;
+}
+
+TabList NumberedTabs(int count) {
+    TabList list;
+    for(int i = 0; i < count; ++i) {
+        list.tabNames.push_back(L"tab" + std::to_wstring(i));
+        list.tabPaths.push_back(L"C:\\dir" + std::to_wstring(i));
+    }
+    return list;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned long cases = qttabbar::test::CountArgument(argc, argv, 1, 200000);
+    std::size_t ops = 0;
+    std::size_t chainedOps = 0;
+    std::size_t coalescedOps = 0;
+    for(unsigned long i = 0; i < cases; ++i) {
+        TabList base;
+        base.version = Random(5);
+        for(std::size_t n = Random(i % 10 == 0 ? 60 : 12); n > 0; --n) {
+            base.tabNames.push_back(RandomPath());
+            base.tabPaths.push_back(RandomPath());
+        }
+        base.currentPath = RandomPath();
+
+        // Diffing then applying reproduces the target at the next version.
+        TabList target = Mutate(base);
+        TabListDelta delta = DiffTabLists(base, target);
+        TabList applied = base;
+        QT_CHECK(ApplyTabListDelta(applied, delta));
+        QT_CHECK(SameTabs(applied, target) && applied.version == base.version + 1);
+        ops += delta.ops.size();
+
+        // A list at another version is left alone.
+        TabList ahead = base;
+        ahead.version += 1;
+        TabList untouched = ahead;
+        QT_CHECK(!ApplyTabListDelta(ahead, delta));
+        QT_CHECK(SameTabs(ahead, untouched) && ahead.version == untouched.version);
+
+        // A coalesced chain of deltas equals the last list.
+        TabListDelta chain;
+        chain.baseVersion = chain.version = base.version;
+        TabList last = base;
+        for(int steps = 1 + static_cast<int>(Random(6)); steps > 0; --steps) {
+            TabList next = Mutate(last);
+            TabListDelta step = DiffTabLists(last, next);
+            chainedOps += step.ops.size();
+            QT_CHECK(ApplyTabListDelta(last, step) && SameTabs(last, next));
+            QT_CHECK(AppendTabListDelta(chain, std::move(step)));
+        }
+        TabList coalesced = base;
+        QT_CHECK(ApplyTabListDelta(coalesced, chain));
+        QT_CHECK(SameTabs(coalesced, last) && coalesced.version == last.version);
+        coalescedOps += chain.ops.size();
+
+        // An append that does not continue the chain is refused and leaves
+        // both deltas as they were.
+        TabListDelta gap = DiffTabLists(last, base);
+        gap.baseVersion += 1;
+        std::size_t gapOps = gap.ops.size();
+        TabListDelta before = chain;
+        QT_CHECK(!AppendTabListDelta(chain, std::move(gap)));
+        QT_CHECK(gap.ops.size() == gapOps && chain.version == before.version && chain.ops.size() == before.ops.size());
+
+        QT_CHECK(DiffTabLists(target, target).ops.empty());
+    }
+
+    TabList window = NumberedTabs(30);
+    TabList navigated = window;
+    navigated.tabPaths[7] = L"C:\\other";
+    navigated.tabNames[7] = L"other";
+    TabList swapped = window;
+    std::swap(swapped.tabNames[3], swapped.tabNames[20]);
+    std::swap(swapped.tabPaths[3], swapped.tabPaths[20]);
+    TabList opened = window;
+    InsertTab(opened, 5, L"new", L"C:\\new");
+    std::printf("%lu cases, %.2f ops per delta; chains of %zu ops coalesced to %zu\n", cases,
+                static_cast<double>(ops) / cases, chainedOps, coalescedOps);
+    std::printf("30 tabs: navigate %zu ops, swap %zu ops, open %zu ops\n", DiffTabLists(window, navigated).ops.size(),
+                DiffTabLists(window, swapped).ops.size(), DiffTabLists(window, opened).ops.size());
+    std::puts("ok");
+    return 0;
+}
@@ -0,0 +1,185 @@
+// Checks TabPathIndex against a plain list of tabs under random opens,
+// closes, moves and lookups, then times adding and looking up 1k-10k tabs
+// against the case-insensitive linear scan NativeTabControl used before.
+//
+// TabPathIndexTest [operations]
+
+#include "TabPathIndex.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using qttabbar::TabPathIndex;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+bool EqualFolded(const std::wstring& left, const std::wstring& right) {
+    return left.size() == right.size()
+           && std::equal(left.begin(), left.end(), right.begin(), [](wchar_t a, wchar_t b) {
+                  return std::towlower(static_cast<std::wint_t>(a)) == std::towlower(static_cast<std::wint_t>(b));
+              });
+}
+
+std::optional<std::size_t> LinearFind(const std::vector<std::wstring>& tabs, const std::wstring& path) {
+    for(std::size_t i = 0; i < tabs.size(); ++i) {
+        if(EqualFolded(tabs[i], path)) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+// Few distinct paths in mixed case, so duplicates and case-only differences
+// are common.
+std::wstring RandomPath(std::mt19937& rng) {
+    std::wstring path = L"C:\\Folder" + std::to_wstring(rng() % 24);
+    for(wchar_t& ch : path) {
+        if(rng() % 3 == 0) {
+            ch = static_cast<wchar_t>(std::towupper(static_cast<std::wint_t>(ch)));
+        }
+    }
+    return path;
+}
+
+void CheckAgainstList(unsigned long operations) {
+    std::mt19937 rng(17);
+    TabPathIndex index;
+    std::vector<std::wstring> tabs;
+    for(unsigned long i = 0; i < operations; ++i) {
+        std::size_t count = tabs.size();
+        switch(rng() % 9) {
+        case 0:
+        case 1: {
+            std::wstring path = RandomPath(rng);
+            index.Append(path);
+            tabs.push_back(path);
+            break;
+        }
+        case 2: {
+            std::wstring path = RandomPath(rng);
+            std::size_t position = rng() % (count + 2);
+            index.Insert(position, path);
+            tabs.insert(tabs.begin() + static_cast<std::ptrdiff_t>(std::min(position, count)), path);
+            break;
+        }
+        case 3:
+            if(count > 0) {
+                // Closing the last tab keeps the index live; others defer it.
+                std::size_t position = rng() % 2 ? count - 1 : rng() % count;
+                index.Erase(position);
+                tabs.erase(tabs.begin() + static_cast<std::ptrdiff_t>(position));
+            }
+            break;
+        case 4:
+            if(count > 1) {
+                std::size_t from = rng() % count;
+                std::size_t to = rng() % count;
+                index.Move(from, to);
+                if(from != to) {
+                    std::wstring path = tabs[from];
+                    tabs.erase(tabs.begin() + static_cast<std::ptrdiff_t>(from));
+                    tabs.insert(tabs.begin() + static_cast<std::ptrdiff_t>(to), path);
+                }
+            }
+            break;
+        case 5:
+            if(rng() % 50 == 0) {
+                index.Clear();
+                tabs.clear();
+            }
+            break;
+        default: {
+            std::wstring path = RandomPath(rng);
+            QT_CHECK(index.Find(path) == LinearFind(tabs, path));
+            std::size_t expected = static_cast<std::size_t>(std::count_if(
+                tabs.begin(), tabs.end(), [&](const std::wstring& tab) { return EqualFolded(tab, path); }));
+            QT_CHECK(index.Count(path) == expected && index.Contains(path) == (expected > 0));
+            break;
+        }
+        }
+        // Out-of-range edits are ignored.
+        index.Erase(tabs.size());
+        index.Move(tabs.size(), 0);
+        QT_CHECK(index.Size() == tabs.size());
+    }
+}
+
+// Opens `count` tabs, then looks each up once (as navigation does to find an
+// existing tab) and closes every other one, looking up after each close.
+void Benchmark() {
+    std::printf("%6s | %12s | %12s | %14s | %14s | %14s\n", "tabs", "add ns/tab", "find ns", "linear find ns",
+                "close+find ns", "linear c+f ns");
+    for(std::size_t count : {1000, 2000, 5000, 10000}) {
+        std::vector<std::wstring> paths;
+        for(std::size_t i = 0; i < count; ++i) {
+            paths.push_back(L"C:\\Users\\Someone\\Projects\\Repository" + std::to_wstring(i) + L"\\Src");
+        }
+        std::vector<std::wstring> lookups;
+        std::mt19937 rng(1);
+        for(std::size_t i = 0; i < 1000; ++i) {
+            std::wstring path = paths[rng() % count];
+            std::transform(path.begin(), path.end(), path.begin(),
+                           [](wchar_t ch) { return static_cast<wchar_t>(std::towlower(static_cast<std::wint_t>(ch))); });
+            lookups.push_back(path);
+        }
+
+        TabPathIndex index;
+        auto start = Clock::now();
+        for(const std::wstring& path : paths) {
+            index.Append(path);
+        }
+        double add = ElapsedNanoseconds(start) / count;
+
+        std::size_t found = 0;
+        start = Clock::now();
+        for(const std::wstring& path : lookups) {
+            found += index.Find(path).value_or(0);
+        }
+        double find = ElapsedNanoseconds(start) / lookups.size();
+        std::size_t linearFound = 0;
+        start = Clock::now();
+        for(const std::wstring& path : lookups) {
+            linearFound += LinearFind(paths, path).value_or(0);
+        }
+        double linear = ElapsedNanoseconds(start) / lookups.size();
+        QT_CHECK(found == linearFound);
+
+        // A batch close followed by a lookup, 100 times from the middle.
+        std::vector<std::wstring> tabs = paths;
+        start = Clock::now();
+        for(std::size_t i = 0; i < 100; ++i) {
+            for(int k = 0; k < 5; ++k) {
+                index.Erase(index.Size() / 2);
+            }
+            found += index.Find(lookups[i]).value_or(0);
+        }
+        double closeFind = ElapsedNanoseconds(start) / 100;
+        start = Clock::now();
+        for(std::size_t i = 0; i < 100; ++i) {
+            for(int k = 0; k < 5; ++k) {
+                tabs.erase(tabs.begin() + static_cast<std::ptrdiff_t>(tabs.size() / 2));
+            }
+            linearFound += LinearFind(tabs, lookups[i]).value_or(0);
+        }
+        double linearCloseFind = ElapsedNanoseconds(start) / 100;
+        QT_CHECK(found == linearFound && index.Size() == tabs.size());
+        std::printf("%6zu | %12.1f | %12.1f | %14.1f | %14.1f | %14.1f\n", count, add, find, linear, closeFind,
+                    linearCloseFind);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckAgainstList(qttabbar::test::CountArgument(argc, argv, 1, 200000));
+    Benchmark();
+    std::puts("ok");
+    return 0;
+}
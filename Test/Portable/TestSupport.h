@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Like assert, but kept in release builds, where the benchmarks are meant to
+// be run.
+#define QT_CHECK(condition)                                                                  \
+    do {                                                                                     \
+        if(!(condition)) {                                                                   \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::abort();                                                                    \
+        }                                                                                    \
+    } while(0)
+
+namespace qttabbar::test {
+
+// The count given as argument `index`, or `fallback`. ctest passes small
+// counts; run the binaries by hand for the full sizes.
+inline unsigned long CountArgument(int argc, char** argv, int index, unsigned long fallback) {
+    if(argc <= index) {
+        return fallback;
+    }
+    return std::strtoul(argv[index], nullptr, 10);
+}
+
+using Clock = std::chrono::steady_clock;
+
+inline double ElapsedNanoseconds(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// Global operator new calls so far, in tests linked with CountingAllocator.cpp.
+long AllocationCount();
+
+} // namespace qttabbar::test
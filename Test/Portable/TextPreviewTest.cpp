@@ -0,0 +1,170 @@
+// Checks encoding detection and the preview built from UTF-8, UTF-16, GBK and
+// Shift-JIS prefixes, including empty and cut-off input, then times
+// MakeTextPreview on a 32 KB prefix of each encoding.
+//
+// TextPreviewTest [rounds]
+
+#include "TextPreview.h"
+
+#include "TestSupport.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+using Bytes = std::vector<std::uint8_t>;
+
+// "中文测试文件，" in GBK and "日本語のテキスト" in Shift-JIS.
+const Bytes kGbkLine = {0xD6, 0xD0, 0xCE, 0xC4, 0xB2, 0xE2, 0xCA, 0xD4, 0xCE, 0xC4, 0xBC, 0xFE, 0xA3, 0xAC};
+const std::wstring kGbkText = L"\u4E2D\u6587\u6D4B\u8BD5\u6587\u4EF6\uFF0C";
+const Bytes kShiftJisLine = {0x93, 0xFA, 0x96, 0x7B, 0x8C, 0xEA, 0x82, 0xCC,
+                             0x83, 0x65, 0x83, 0x4C, 0x83, 0x58, 0x83, 0x67};
+const std::wstring kShiftJisText = L"\u65E5\u672C\u8A9E\u306E\u30C6\u30AD\u30B9\u30C8";
+
+Bytes Utf8(const std::string& text) {
+    return Bytes(text.begin(), text.end());
+}
+
+Bytes Utf16(const std::wstring& text, bool bigEndian, bool bom) {
+    Bytes bytes;
+    auto put = [&](std::uint16_t unit) {
+        bytes.push_back(static_cast<std::uint8_t>(bigEndian ? unit >> 8 : unit));
+        bytes.push_back(static_cast<std::uint8_t>(bigEndian ? unit : unit >> 8));
+    };
+    if(bom) {
+        put(0xFEFF);
+    }
+    for(wchar_t ch : text) {
+        put(static_cast<std::uint16_t>(ch));
+    }
+    return bytes;
+}
+
+// `line` followed by "\r\n", `count` times.
+Bytes Lines(const Bytes& line, std::size_t count) {
+    Bytes bytes;
+    for(std::size_t i = 0; i < count; ++i) {
+        bytes.insert(bytes.end(), line.begin(), line.end());
+        bytes.push_back('\r');
+        bytes.push_back('\n');
+    }
+    return bytes;
+}
+
+TextPreview Preview(const Bytes& bytes, std::size_t maxLines = 12) {
+    TextPreviewOptions options;
+    options.maxLines = maxLines;
+    return MakeTextPreview(bytes.data(), bytes.size(), options);
+}
+
+void CheckEncodings() {
+    // An empty file reads as empty UTF-8 text, with or without a buffer.
+    TextPreview empty = MakeTextPreview(nullptr, 0, TextPreviewOptions{});
+    QT_CHECK(empty.encoding == TextEncoding::Utf8 && empty.text.empty() && !empty.truncated);
+    Bytes none;
+    QT_CHECK(Preview(none).text.empty());
+
+    TextPreview utf8 = Preview(Utf8("caf\xC3\xA9\nline two\r\nthree"));
+    QT_CHECK(utf8.encoding == TextEncoding::Utf8 && utf8.text == L"caf\u00E9\r\nline two\r\nthree\r\n");
+    TextPreview bom = Preview(Utf8("\xEF\xBB\xBF" "abc"));
+    QT_CHECK(bom.encoding == TextEncoding::Utf8Bom && bom.text == L"abc\r\n");
+
+    std::wstring mixed = L"Readme \u4E2D\u6587\r\nsecond\r\n";
+    TextPreview le = Preview(Utf16(mixed, false, true));
+    QT_CHECK(le.encoding == TextEncoding::Utf16Le && le.text == mixed);
+    TextPreview be = Preview(Utf16(mixed, true, true));
+    QT_CHECK(be.encoding == TextEncoding::Utf16Be && be.text == mixed);
+    // Without a BOM, Latin text is told by where its zero bytes fall.
+    QT_CHECK(Preview(Utf16(L"plain ascii text\r\n", false, false)).encoding == TextEncoding::Utf16Le);
+    QT_CHECK(Preview(Utf16(L"plain ascii text\r\n", true, false)).encoding == TextEncoding::Utf16Be);
+
+    TextPreview gbk = Preview(Lines(kGbkLine, 3));
+    QT_CHECK(gbk.encoding == TextEncoding::Gbk);
+    QT_CHECK(gbk.text == kGbkText + L"\r\n" + kGbkText + L"\r\n" + kGbkText + L"\r\n");
+    TextPreview shiftJis = Preview(Lines(kShiftJisLine, 2));
+    QT_CHECK(shiftJis.encoding == TextEncoding::ShiftJis);
+    QT_CHECK(shiftJis.text == kShiftJisText + L"\r\n" + kShiftJisText + L"\r\n");
+
+    Bytes binary = {'M', 'Z', 0x90, 0, 3, 0, 0, 0, 4, 0, 0, 0, 0xFF, 0xFF, 0, 0};
+    QT_CHECK(Preview(binary).encoding == TextEncoding::Binary && Preview(binary).text.empty());
+}
+
+void CheckTruncation() {
+    // More lines than shown.
+    TextPreview lines = Preview(Lines(Utf8("row"), 20), 5);
+    QT_CHECK(lines.truncated && lines.text == L"row\r\nrow\r\nrow\r\nrow\r\nrow\r\n");
+    QT_CHECK(!Preview(Lines(Utf8("row"), 5), 5).truncated);
+
+    // A long line is cut at maxLineChars.
+    TextPreviewOptions options;
+    options.maxLineChars = 10;
+    Bytes longLine = Utf8(std::string(50, 'x'));
+    TextPreview cut = MakeTextPreview(longLine.data(), longLine.size(), options);
+    QT_CHECK(cut.truncated && cut.text == std::wstring(10, L'x') + L"\r\n");
+
+    // A prefix that ends inside a character drops the partial character.
+    Bytes gbk = Lines(kGbkLine, 2);
+    gbk.pop_back();
+    gbk.pop_back();
+    gbk.pop_back();
+    QT_CHECK(Preview(gbk).text == kGbkText + L"\r\n" + kGbkText.substr(0, 6) + L"\r\n");
+    Bytes utf8 = Utf8("ab\xE4\xB8\xAD\xE6\x96");
+    QT_CHECK(Preview(utf8).encoding == TextEncoding::Utf8 && Preview(utf8).text == L"ab\u4E2D\r\n");
+    Bytes utf16 = Utf16(L"ab\u4E2D", false, true);
+    utf16.pop_back();
+    QT_CHECK(Preview(utf16).text == L"ab\r\n");
+}
+
+void Benchmark(unsigned long rounds) {
+    const std::size_t size = 32u * 1024u;
+    struct Sample {
+        const char* name;
+        Bytes bytes;
+    };
+    std::wstring wide;
+    while(wide.size() * 2 < size) {
+        wide += L"Log entry \u4E2D\u6587 with some ASCII around it\r\n";
+    }
+    std::vector<Sample> samples = {
+        {"UTF-8", Lines(Utf8("2024-01-01 12:00:00 INFO caf\xC3\xA9 request handled in 12 ms"), size / 10)},
+        {"UTF-16 LE", Utf16(wide, false, true)},
+        {"GBK", Lines(kGbkLine, size / 10)},
+        {"Shift-JIS", Lines(kShiftJisLine, size / 10)},
+    };
+    // The tooltip shows a dozen lines; also time decoding a whole prefix.
+    std::printf("%-10s | %14s | %16s\n", "encoding", "12 lines us", "32 KB MB/s");
+    for(Sample& sample : samples) {
+        // Cut mid-line, as a read of the first 32 KB is.
+        sample.bytes.resize(size);
+        TextPreviewOptions all;
+        all.maxLines = size;
+        std::size_t sink = 0;
+        auto start = Clock::now();
+        for(unsigned long i = 0; i < rounds; ++i) {
+            sink += Preview(sample.bytes).text.size();
+        }
+        double shortPreview = ElapsedNanoseconds(start) / rounds;
+        start = Clock::now();
+        for(unsigned long i = 0; i < rounds; ++i) {
+            sink += MakeTextPreview(sample.bytes.data(), sample.bytes.size(), all).text.size();
+        }
+        double full = ElapsedNanoseconds(start) / rounds;
+        QT_CHECK(sink > 0);
+        std::printf("%-10s | %14.1f | %16.0f\n", sample.name, shortPreview / 1e3, size / full * 1e3);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckEncodings();
+    CheckTruncation();
+    Benchmark(qttabbar::test::CountArgument(argc, argv, 1, 500));
+    std::puts("ok");
+    return 0;
+}
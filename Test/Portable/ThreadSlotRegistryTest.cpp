@@ -0,0 +1,200 @@
+// Churns ThreadSlotRegistry from several threads the way QTHookLib's DUI
+// hooks do: threads come and go, claim a slot, use it alone and hand it back,
+// sometimes ending without releasing it. Checks that no two owners ever share a
+// slot, that the list grows only to the number of concurrent owners, and that
+// ForEachOwned sees exactly the slots left owned. Run it under
+// -fsanitize=thread as well. Then times acquire and release against a
+// mutex-guarded map.
+//
+// ThreadSlotRegistryTest [cycles per thread]
+
+#include "ThreadSlotRegistry.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using qttabbar::ThreadSlotRegistry;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+// Plain fields: a slot handed to two owners at once shows up as a torn
+// value here and as a data race under TSan.
+struct Record {
+    std::uint32_t user = 0;
+    std::uint64_t uses = 0;
+};
+
+using Registry = ThreadSlotRegistry<Record>;
+
+// Number of slots in the list, all of them free and used before: claims them
+// one by one until a fresh one is linked in.
+std::size_t CountSlots(Registry& registry) {
+    std::vector<Registry::Slot*> claimed;
+    for(std::uint32_t id = 0xF0000000u;; ++id) {
+        Registry::Slot* slot = registry.Acquire(id);
+        claimed.push_back(slot);
+        if(slot->value.uses == 0) {
+            break;
+        }
+    }
+    for(Registry::Slot* slot : claimed) {
+        registry.Release(slot);
+    }
+    return claimed.size() - 1;
+}
+
+void CheckChurn(unsigned long cycles, unsigned workers) {
+    Registry registry;
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned long> walks{0};
+    // Walks the list while slots are claimed and linked in, as process detach
+    // may; only owners are read, since values belong to running threads.
+    std::thread walker([&] {
+        while(!stop.load()) {
+            std::size_t owned = 0;
+            registry.ForEachOwned([&](Record&) { ++owned; });
+            QT_CHECK(owned <= 2 * workers);
+            ++walks;
+        }
+    });
+
+    std::vector<std::set<std::uint32_t>> leftBehind(workers);
+    std::vector<std::thread> threads;
+    for(unsigned w = 0; w < workers; ++w) {
+        threads.emplace_back([&, w] {
+            std::uint32_t base = (w + 1) << 20;
+            std::uint32_t abandoned = 0;
+            for(std::uint32_t cycle = 0; cycle < cycles; ++cycle) {
+                // Each cycle is a new thread of this worker's.
+                std::uint32_t id = base + cycle + 1;
+                Registry::Slot* slot = registry.Acquire(id);
+                QT_CHECK(slot->owner.load() == id);
+                slot->value.user = id;
+                for(int i = 0; i < 8; ++i) {
+                    ++slot->value.uses;
+                    QT_CHECK(slot->value.user == id);
+                }
+                if(cycle % 97 == 0 && abandoned == 0) {
+                    // The thread ended without its DLL_THREAD_DETACH.
+                    abandoned = id;
+                    continue;
+                }
+                slot->value.user = 0;
+                registry.Release(slot);
+                if(abandoned != 0 && cycle % 97 == 50) {
+                    // A thread id came back around while its slot was still
+                    // owned: the old slot is handed back as is.
+                    Registry::Slot* old = registry.Acquire(abandoned);
+                    QT_CHECK(old->owner.load() == abandoned && old->value.user == abandoned);
+                    old->value.user = 0;
+                    registry.Release(old);
+                    abandoned = 0;
+                }
+            }
+            if(abandoned != 0) {
+                leftBehind[w].insert(abandoned);
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    stop = true;
+    walker.join();
+
+    // Only slots that were left behind are still owned, and their values can
+    // be cleaned up now that no owner runs.
+    std::set<std::uint32_t> expected;
+    for(const auto& ids : leftBehind) {
+        expected.insert(ids.begin(), ids.end());
+    }
+    std::set<std::uint32_t> owned;
+    std::uint64_t uses = 0;
+    registry.ForEachOwned([&](Record& record) {
+        owned.insert(record.user);
+        uses += record.uses;
+    });
+    QT_CHECK(owned == expected && uses > 0);
+    registry.ReleaseAll();
+    std::size_t after = 0;
+    registry.ForEachOwned([&](Record&) { ++after; });
+    QT_CHECK(after == 0);
+    // Each worker holds at most two slots at a time.
+    std::size_t slots = CountSlots(registry);
+    QT_CHECK(slots >= 1 && slots <= 2 * workers);
+    std::printf("%u threads, %lu cycles each: %zu slots, %zu left owned, %lu concurrent walks\n", workers, cycles,
+                slots, owned.size(), walks.load());
+}
+
+// The map and lock a registry like this replaces.
+class LockedRegistry {
+public:
+    Record* Acquire(std::uint32_t threadId) {
+        std::lock_guard guard(m_mutex);
+        return &m_records[threadId];
+    }
+
+    void Release(std::uint32_t threadId) {
+        std::lock_guard guard(m_mutex);
+        m_records.erase(threadId);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::unordered_map<std::uint32_t, Record> m_records;
+};
+
+template <typename Cycle>
+double CyclesPerMicrosecond(unsigned workers, unsigned long cycles, Cycle&& cycle) {
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for(unsigned w = 0; w < workers; ++w) {
+        threads.emplace_back([&, w] {
+            for(std::uint32_t i = 0; i < cycles; ++i) {
+                cycle(((w + 1) << 20) + i + 1);
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    return static_cast<double>(workers) * cycles / ElapsedNanoseconds(start) * 1e3;
+}
+
+void Benchmark(unsigned long cycles) {
+    std::printf("%7s | %16s | %16s\n", "threads", "registry M/s", "locked map M/s");
+    for(unsigned workers : {1u, 2u, 4u, 8u}) {
+        Registry registry;
+        double lockFree = CyclesPerMicrosecond(workers, cycles, [&](std::uint32_t id) {
+            Registry::Slot* slot = registry.Acquire(id);
+            ++slot->value.uses;
+            registry.Release(slot);
+        });
+        LockedRegistry locked;
+        double mapped = CyclesPerMicrosecond(workers, cycles, [&](std::uint32_t id) {
+            ++locked.Acquire(id)->uses;
+            locked.Release(id);
+        });
+        std::printf("%7u | %16.2f | %16.2f\n", workers, lockFree, mapped);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned long cycles = qttabbar::test::CountArgument(argc, argv, 1, 200000);
+    for(unsigned workers : {2u, 8u}) {
+        CheckChurn(cycles, workers);
+    }
+    Benchmark(cycles);
+    std::puts("ok");
+    return 0;
+}
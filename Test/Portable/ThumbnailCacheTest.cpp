@@ -0,0 +1,280 @@
+// Fills ThumbnailCache past its 64 MB and 256-handle limits and checks that
+// the least recently used bitmaps are released exactly once, that the pinned
+// one survives trimming and invalidation until the pin moves, and that stale
+// stamps are dropped. Then drives AsyncThumbnailDecoder with a decode that
+// blocks, to check request order, cancellation and that destroying it does not
+// wait for the decode. Times lookups and stores at the end.
+//
+// ThumbnailCacheTest [thumbnails]
+
+#include "ThumbnailCache.h"
+
+#include "TestSupport.h"
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace qttabbar;
+using namespace std::chrono_literals;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+// Hands out bitmap handles and records their release, across threads and
+// beyond the lifetime of the decoder that releases them.
+struct Bitmaps {
+    std::mutex mutex;
+    std::uintptr_t next = 1;
+    std::set<std::uintptr_t> live;
+    int doubleReleases = 0;
+
+    Thumbnail Make(int width, int height, std::int64_t stamp = 1) {
+        std::lock_guard guard(mutex);
+        live.insert(next);
+        return {next++, width, height, stamp};
+    }
+
+    ThumbnailReleaseFn Releaser() {
+        return [this](std::uintptr_t handle) {
+            std::lock_guard guard(mutex);
+            doubleReleases += live.erase(handle) == 0;
+        };
+    }
+
+    bool IsLive(std::uintptr_t handle) {
+        std::lock_guard guard(mutex);
+        return live.count(handle) != 0;
+    }
+
+    std::size_t Live() {
+        std::lock_guard guard(mutex);
+        return live.size();
+    }
+};
+
+std::wstring PathOf(int i) {
+    return L"/pictures/IMG_" + std::to_wstring(i) + L".jpg";
+}
+
+void CheckLimits() {
+    Bitmaps bitmaps;
+    {
+        ThumbnailCache cache(bitmaps.Releaser());
+        // 4 MB each: sixteen fit in 64 MB.
+        std::vector<std::uintptr_t> handles;
+        for(int i = 0; i < 20; ++i) {
+            handles.push_back(cache.Store(PathOf(i), bitmaps.Make(1024, 1024))->handle);
+            if(i == 10) {
+                QT_CHECK(cache.Lookup(PathOf(0), 1));
+            }
+        }
+        ThumbnailCache::Stats stats = cache.GetStats();
+        QT_CHECK(stats.entries == 16 && stats.bytes == 64u * 1024u * 1024u && stats.evictions == 4);
+        // 0 was looked up after 1-10 went in, so 1-4 went first.
+        QT_CHECK(cache.Contains(PathOf(0)) && !cache.Contains(PathOf(4)) && cache.Contains(PathOf(5)));
+        QT_CHECK(bitmaps.IsLive(handles[0]) && !bitmaps.IsLive(handles[1]) && bitmaps.Live() == 16);
+
+        // Small thumbnails run into the handle limit first.
+        cache.Clear();
+        QT_CHECK(bitmaps.Live() == 0 && cache.GetStats().bytes == 0);
+        for(int i = 0; i < 300; ++i) {
+            cache.Store(PathOf(i), bitmaps.Make(96, 96));
+        }
+        QT_CHECK(cache.GetStats().entries == 256 && bitmaps.Live() == 256);
+        QT_CHECK(!cache.Contains(PathOf(43)) && cache.Contains(PathOf(44)));
+
+        // A single thumbnail larger than the limit is still kept.
+        const Thumbnail* huge = cache.Store(L"/pictures/panorama.jpg", bitmaps.Make(8192, 4096));
+        QT_CHECK(huge && cache.GetStats().entries == 1 && bitmaps.Live() == 1);
+
+        // Storing a path again releases the bitmap it replaces.
+        std::uintptr_t old = cache.Store(PathOf(1), bitmaps.Make(10, 10))->handle;
+        cache.Store(PathOf(1), bitmaps.Make(10, 10));
+        QT_CHECK(!bitmaps.IsLive(old));
+    }
+    QT_CHECK(bitmaps.Live() == 0 && bitmaps.doubleReleases == 0);
+}
+
+void CheckStampsAndPin() {
+    Bitmaps bitmaps;
+    ThumbnailCache::Limits limits;
+    limits.maxHandles = 4;
+    {
+        ThumbnailCache cache(limits, bitmaps.Releaser());
+        std::uintptr_t edited = cache.Store(PathOf(0), bitmaps.Make(10, 10, 100))->handle;
+        QT_CHECK(cache.Lookup(PathOf(0), 100) && cache.GetStats().hits == 1);
+        QT_CHECK(!cache.Lookup(PathOf(0), 101) && cache.GetStats().stale == 1 && !bitmaps.IsLive(edited));
+        QT_CHECK(!cache.Lookup(PathOf(0), 100) && cache.GetStats().misses == 2);
+
+        // The pinned thumbnail is skipped when trimming, however old it is.
+        std::uintptr_t pinned = cache.Store(PathOf(1), bitmaps.Make(10, 10))->handle;
+        cache.Pin(PathOf(1));
+        for(int i = 2; i < 12; ++i) {
+            cache.Store(PathOf(i), bitmaps.Make(10, 10));
+        }
+        QT_CHECK(cache.Contains(PathOf(1)) && cache.GetStats().entries == 4 && bitmaps.IsLive(pinned));
+
+        // Invalidated while on screen: out of the cache, but alive until the pin moves.
+        cache.Invalidate(PathOf(1));
+        QT_CHECK(!cache.Contains(PathOf(1)) && bitmaps.IsLive(pinned));
+        cache.Pin(PathOf(11));
+        QT_CHECK(!bitmaps.IsLive(pinned));
+
+        std::uintptr_t shown = cache.Lookup(PathOf(11), 1)->handle;
+        cache.Clear();
+        QT_CHECK(bitmaps.IsLive(shown) && bitmaps.Live() == 1);
+        cache.Unpin();
+        QT_CHECK(bitmaps.Live() == 0);
+        cache.Store(PathOf(20), bitmaps.Make(10, 10));
+        cache.Pin(PathOf(20));
+        cache.Invalidate(PathOf(20));
+    }
+    // The destructor releases a detached bitmap too.
+    QT_CHECK(bitmaps.Live() == 0 && bitmaps.doubleReleases == 0);
+}
+
+// A decode that waits until the test opens the gate, and records the paths
+// that went through it.
+struct Gate {
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool open = true;
+    int waiting = 0;
+    std::vector<std::wstring> decoded;
+
+    void Pass(const std::wstring& path) {
+        std::unique_lock lock(mutex);
+        ++waiting;
+        changed.notify_all();
+        changed.wait(lock, [this] { return open; });
+        --waiting;
+        decoded.push_back(path);
+    }
+
+    std::vector<std::wstring> Decoded() {
+        std::lock_guard guard(mutex);
+        return decoded;
+    }
+
+    void Set(bool value) {
+        std::lock_guard guard(mutex);
+        open = value;
+        changed.notify_all();
+    }
+
+    void WaitForDecode() {
+        std::unique_lock lock(mutex);
+        changed.wait(lock, [this] { return waiting > 0; });
+    }
+};
+
+struct DecoderFixture {
+    std::shared_ptr<Bitmaps> bitmaps = std::make_shared<Bitmaps>();
+    std::shared_ptr<Gate> gate = std::make_shared<Gate>();
+    std::shared_ptr<std::atomic<int>> notified = std::make_shared<std::atomic<int>>(0);
+
+    std::unique_ptr<AsyncThumbnailDecoder> Make() {
+        auto decode = [bitmaps = bitmaps, gate = gate](const std::wstring& path, int, int) -> std::optional<Thumbnail> {
+            gate->Pass(path);
+            if(path.find(L"broken") != std::wstring::npos) {
+                return std::nullopt;
+            }
+            return bitmaps->Make(96, 96);
+        };
+        return std::make_unique<AsyncThumbnailDecoder>(decode, bitmaps->Releaser(),
+                                                       [notified = notified]() { ++*notified; });
+    }
+};
+
+void CheckDecoder() {
+    DecoderFixture fixture;
+    auto decoder = fixture.Make();
+
+    // While one decode runs, a request goes ahead of queued prefetches, and a
+    // new prefetch batch replaces the old one.
+    fixture.gate->Set(false);
+    decoder->Request(L"/a/first.jpg", 96, 96);
+    fixture.gate->WaitForDecode();
+    decoder->Prefetch({L"/a/p1.jpg", L"/a/p2.jpg", L"/a/first.jpg"}, 96, 96);
+    decoder->Prefetch({L"/a/p3.jpg", L"/a/broken.jpg"}, 96, 96);
+    decoder->Request(L"/a/second.jpg", 96, 96);
+    fixture.gate->Set(true);
+    decoder->WaitIdle();
+    QT_CHECK((fixture.gate->Decoded() == std::vector<std::wstring>{L"/a/first.jpg", L"/a/second.jpg", L"/a/p3.jpg",
+                                                            L"/a/broken.jpg"}));
+    std::vector<AsyncThumbnailDecoder::Result> results = decoder->TakeResults();
+    QT_CHECK(results.size() == 4 && *fixture.notified == 4);
+    QT_CHECK(!results[0].prefetch && results[2].prefetch && results[2].thumbnail && !results[3].thumbnail);
+    for(auto& result : results) {
+        if(result.thumbnail) {
+            fixture.bitmaps->Releaser()(result.thumbnail->handle);
+        }
+    }
+
+    // A decode finished after Cancel is released by the worker, not delivered.
+    fixture.gate->Set(false);
+    decoder->Request(L"/a/cancelled.jpg", 96, 96);
+    fixture.gate->WaitForDecode();
+    decoder->Cancel();
+    fixture.gate->Set(true);
+    decoder->WaitIdle();
+    QT_CHECK(decoder->TakeResults().empty() && fixture.bitmaps->Live() == 0);
+
+    // Destroying the decoder mid-decode returns at once; the worker finishes
+    // on its own and releases what it decoded.
+    fixture.gate->Set(false);
+    decoder->Request(L"/a/slow.jpg", 96, 96);
+    decoder->Prefetch({L"/a/never.jpg"}, 96, 96);
+    fixture.gate->WaitForDecode();
+    int notifiedBefore = *fixture.notified;
+    auto start = Clock::now();
+    decoder.reset();
+    double destroy = ElapsedNanoseconds(start);
+    fixture.gate->Set(true);
+    // The worker's copy of the decode function goes with the shared state.
+    while(fixture.gate.use_count() > 1) {
+        std::this_thread::sleep_for(1ms);
+    }
+    QT_CHECK(fixture.gate->Decoded().back() == L"/a/slow.jpg" && fixture.bitmaps->Live() == 0);
+    QT_CHECK(*fixture.notified == notifiedBefore && fixture.bitmaps->doubleReleases == 0);
+    std::printf("decoder destroyed in %.1f us with a decode in flight\n", destroy / 1e3);
+}
+
+void Benchmark(unsigned long thumbnails) {
+    Bitmaps bitmaps;
+    ThumbnailCache cache(bitmaps.Releaser());
+    std::vector<std::wstring> paths;
+    for(unsigned long i = 0; i < thumbnails; ++i) {
+        paths.push_back(PathOf(static_cast<int>(i)));
+    }
+    auto start = Clock::now();
+    for(const std::wstring& path : paths) {
+        cache.Store(path, bitmaps.Make(256, 192));
+    }
+    double store = ElapsedNanoseconds(start) / paths.size();
+    // Hovering back and forth over the last 200 items, which are all cached.
+    std::size_t hits = 0;
+    const std::size_t lookups = 200000;
+    start = Clock::now();
+    for(std::size_t i = 0; i < lookups; ++i) {
+        hits += cache.Lookup(paths[paths.size() - 1 - i % 200], 1) != nullptr;
+    }
+    double lookup = ElapsedNanoseconds(start) / lookups;
+    QT_CHECK(hits == lookups && cache.GetStats().entries == 256);
+    std::printf("%lu stores: %.0f ns per store with trimming, %.0f ns per lookup\n", thumbnails, store, lookup);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckLimits();
+    CheckStampsAndPin();
+    CheckDecoder();
+    Benchmark(qttabbar::test::CountArgument(argc, argv, 1, 100000));
+    std::puts("ok");
+    return 0;
+}
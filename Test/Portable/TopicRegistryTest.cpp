@@ -0,0 +1,203 @@
+// Checks TopicRegistry's delivery rules and re-entrancy, publishes while
+// other threads subscribe and unsubscribe, and times publishing against the
+// copy-under-lock list it replaced.
+//
+// TopicRegistryTest [subscription changes per thread] [0 to skip the benchmark]
+
+#include "TopicRegistry.h"
+
+#include "TestSupport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using qttabbar::TopicRegistry;
+using qttabbar::test::AllocationCount;
+using qttabbar::test::Clock;
+using qttabbar::test::ElapsedNanoseconds;
+
+struct Message {
+    std::uint32_t type;
+    std::wstring action;
+    int value;
+};
+
+using Registry = TopicRegistry<Message>;
+
+// The previous InstanceManager::Publish: every callback copied out under the
+// lock on each publish.
+class LockedList {
+public:
+    void Subscribe(std::function<void(const Message&)> callback) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_callbacks.push_back(std::move(callback));
+    }
+
+    void Publish(const Message& message) {
+        std::vector<std::function<void(const Message&)>> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            callbacks = m_callbacks;
+        }
+        for(auto& callback : callbacks) {
+            callback(message);
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::function<void(const Message&)>> m_callbacks;
+};
+
+void CheckDelivery() {
+    Registry registry;
+    std::vector<int> order;
+    auto record = [&order](int tag) { return [&order, tag](const Message&) { order.push_back(tag); }; };
+    registry.Subscribe(5, L"", record(1));
+    registry.Subscribe(Registry::kAnyType, L"", record(2));
+    registry.Subscribe(5, L"go", record(3));
+    registry.Subscribe(6, L"", record(4));
+    auto anyGo = registry.Subscribe(Registry::kAnyType, L"go", record(5));
+    registry.Subscribe(5, L"stop", record(6));
+    registry.Subscribe(5, L"", record(7));
+
+    // Subscribers are called in subscription order.
+    QT_CHECK(registry.Publish(5, L"go", Message{}) == 5);
+    QT_CHECK((order == std::vector<int>{1, 2, 3, 5, 7}));
+    order.clear();
+    QT_CHECK(registry.Publish(5, L"", Message{}) == 3);
+    QT_CHECK((order == std::vector<int>{1, 2, 7}));
+    order.clear();
+    QT_CHECK(registry.Publish(6, L"go", Message{}) == 3);
+    QT_CHECK((order == std::vector<int>{2, 4, 5}));
+    QT_CHECK(registry.Publish(9, L"", Message{}) == 1);
+    QT_CHECK(registry.Publish(Registry::kAnyType, L"", Message{}) == 1);
+
+    registry.Unsubscribe(anyGo);
+    registry.Unsubscribe(999);
+    QT_CHECK(registry.Publish(6, L"go", Message{}) == 2);
+    QT_CHECK(registry.HasSubscribers(5, L"stop") && registry.HasSubscribers(7, L""));
+
+    Registry empty;
+    QT_CHECK(!empty.HasSubscribers(5, L"x") && empty.Publish(1, L"", Message{}) == 0);
+
+    // Changes made from a callback apply from the next publish.
+    Registry reentrant;
+    int added = 0;
+    Registry::Id self = 0;
+    self = reentrant.Subscribe(1, L"", [&](const Message&) {
+        reentrant.Subscribe(1, L"", [&](const Message&) { ++added; });
+        reentrant.Unsubscribe(self);
+    });
+    QT_CHECK(reentrant.Publish(1, L"", Message{}) == 1 && added == 0);
+    QT_CHECK(reentrant.Publish(1, L"", Message{}) == 1 && added == 1);
+}
+
+void Stress(unsigned long changes) {
+    Registry registry;
+    std::atomic<bool> stop{false};
+    std::atomic<long> calls{0};
+    std::vector<std::thread> publishers;
+    for(int p = 0; p < 4; ++p) {
+        publishers.emplace_back([&, p]() {
+            std::mt19937 rng(p);
+            while(!stop) {
+                Message message{static_cast<std::uint32_t>(rng() % 4), L"", p};
+                registry.Publish(message.type, rng() % 2 ? L"a" : L"", message);
+            }
+        });
+    }
+    std::vector<std::thread> subscribers;
+    for(int s = 0; s < 2; ++s) {
+        subscribers.emplace_back([&, s]() {
+            std::mt19937 rng(100 + s);
+            std::vector<Registry::Id> mine;
+            for(unsigned long i = 0; i < changes; ++i) {
+                if(mine.size() < 50 && rng() % 3 != 0) {
+                    std::uint32_t type = rng() % 5 == 0 ? Registry::kAnyType : rng() % 4;
+                    mine.push_back(registry.Subscribe(type, rng() % 2 ? L"a" : L"", [&](const Message& message) {
+                        QT_CHECK(message.type < 4);
+                        ++calls;
+                    }));
+                } else if(!mine.empty()) {
+                    std::size_t k = rng() % mine.size();
+                    registry.Unsubscribe(mine[k]);
+                    mine.erase(mine.begin() + static_cast<std::ptrdiff_t>(k));
+                }
+            }
+            for(Registry::Id id : mine) {
+                registry.Unsubscribe(id);
+            }
+        });
+    }
+    for(auto& thread : subscribers) {
+        thread.join();
+    }
+    stop = true;
+    for(auto& thread : publishers) {
+        thread.join();
+    }
+    QT_CHECK(!registry.HasSubscribers(Registry::kAnyType, L""));
+    std::printf("stress: %ld callbacks\n", calls.load());
+}
+
+// Each subscriber set is published to from one thread; "one topic" has a
+// subscriber for each of many topics, so a publish reaches just one.
+void Benchmark() {
+    std::printf("%6s | %14s | %14s | %14s | %s\n", "subs", "locked ns/pub", "any ns/pub", "one topic ns/pub",
+                "allocations/pub locked/new");
+    for(int count : {1, 10, 100, 1000}) {
+        LockedList locked;
+        Registry all;
+        Registry typed;
+        volatile long sink = 0;
+        auto callback = [&sink](const Message& message) { sink = sink + message.value; };
+        for(int i = 0; i < count; ++i) {
+            locked.Subscribe(callback);
+            all.Subscribe(Registry::kAnyType, L"", callback);
+            typed.Subscribe(static_cast<std::uint32_t>(i % 10), L"action" + std::to_wstring(i / 10), callback);
+        }
+        Message message{3, L"action0", 1};
+        int iterations = std::max(2000, 2000000 / count);
+        auto time = [&](auto&& publish, double& allocations) {
+            for(int i = 0; i < 100; ++i) {
+                publish();
+            }
+            long before = AllocationCount();
+            auto start = Clock::now();
+            for(int i = 0; i < iterations; ++i) {
+                publish();
+            }
+            allocations = double(AllocationCount() - before) / iterations;
+            return ElapsedNanoseconds(start) / iterations;
+        };
+        double lockedAllocations = 0;
+        double allAllocations = 0;
+        double typedAllocations = 0;
+        double lockedTime = time([&]() { locked.Publish(message); }, lockedAllocations);
+        double allTime = time([&]() { all.Publish(message.type, L"", message); }, allAllocations);
+        double typedTime = time([&]() { typed.Publish(message.type, L"action0", message); }, typedAllocations);
+        std::printf("%6d | %14.1f | %14.1f | %16.1f | %.0f / %.0f\n", count, lockedTime, allTime, typedTime,
+                    lockedAllocations, std::max(allAllocations, typedAllocations));
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    CheckDelivery();
+    Stress(qttabbar::test::CountArgument(argc, argv, 1, 20000));
+    if(qttabbar::test::CountArgument(argc, argv, 2, 1) != 0) {
+        Benchmark();
+    }
+    std::puts("ok");
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "BoundedExecutor.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace qttabbar {
+
+BoundedExecutor::BoundedExecutor(std::size_t maxThreads, std::size_t queueCapacity)
+    : m_maxThreads(std::max<std::size_t>(maxThreads, 1))
+    , m_queueCapacity(queueCapacity) {
+}
+
+BoundedExecutor::~BoundedExecutor() {
+    Shutdown();
+}
+
+bool BoundedExecutor::TrySubmit(Task task) {
+    if(!task) {
+        return false;
+    }
+    std::lock_guard lock(m_mutex);
+    if(m_stopping || m_queue.size() >= m_queueCapacity) {
+        return false;
+    }
+    m_queue.push_back(std::move(task));
+    // Every idle thread may already have been woken for an earlier task.
+    if(m_idleThreads < m_queue.size() && m_threads.size() < m_maxThreads) {
+        m_threads.emplace_back(&BoundedExecutor::WorkerProc, this);
+    } else {
+        m_taskAvailable.notify_one();
+    }
+    return true;
+}
+
+std::size_t BoundedExecutor::Shutdown() {
+    std::vector<std::thread> threads;
+    std::deque<Task> dropped;
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+        dropped.swap(m_queue);
+        threads.swap(m_threads);
+    }
+    m_taskAvailable.notify_all();
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    // Destroyed outside the lock; captured state may be arbitrarily heavy.
+    return dropped.size();
+}
+
+std::size_t BoundedExecutor::ThreadCount() const {
+    std::lock_guard lock(m_mutex);
+    return m_threads.size();
+}
+
+std::size_t BoundedExecutor::QueuedCount() const {
+    std::lock_guard lock(m_mutex);
+    return m_queue.size();
+}
+
+void BoundedExecutor::WorkerProc() {
+    std::unique_lock lock(m_mutex);
+    for(;;) {
+        ++m_idleThreads;
+        m_taskAvailable.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+        --m_idleThreads;
+        if(m_stopping) {
+            return;
+        }
+        Task task = std::move(m_queue.front());
+        m_queue.pop_front();
+        lock.unlock();
+        task();
+        // Release captures before taking the lock again.
+        task = nullptr;
+        lock.lock();
+    }
+}
+
+} // namespace qttabbar
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace qttabbar {
+
+// Runs tasks on at most `maxThreads` threads, queueing at most `queueCapacity`
+// tasks that have not started yet. Threads are created as load requires and
+// then kept until shutdown. When the queue is full TrySubmit refuses the task
+// and the caller decides what to do with it, so a burst can never grow the
+// number of threads or the backlog without bound.
+class BoundedExecutor {
+public:
+    using Task = std::function<void()>;
+
+    BoundedExecutor(std::size_t maxThreads, std::size_t queueCapacity);
+    ~BoundedExecutor();
+
+    BoundedExecutor(const BoundedExecutor&) = delete;
+    BoundedExecutor& operator=(const BoundedExecutor&) = delete;
+
+    // False when the queue is full or the executor is shutting down.
+    bool TrySubmit(Task task);
+
+    // Stops accepting tasks, drops the ones still queued and waits for running
+    // ones to finish. Returns the number dropped. Must not be called from a task.
+    std::size_t Shutdown();
+
+    std::size_t ThreadCount() const;
+    std::size_t QueuedCount() const;
+
+private:
+    void WorkerProc();
+
+    const std::size_t m_maxThreads;
+    const std::size_t m_queueCapacity;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_taskAvailable;
+    std::deque<Task> m_queue;
+    std::vector<std::thread> m_threads;
+    std::size_t m_idleThreads = 0;
+    bool m_stopping = false;
+};
+
+} // namespace qttabbar
@@ -0,0 +1,439 @@
+#include "ClosedTabHistoryJournal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+
+constexpr char kSnapshotMagic[4] = {'Q', 'T', 'C', 'S'};
+constexpr char kJournalMagic[4] = {'Q', 'T', 'C', 'J'};
+constexpr const wchar_t kSnapshotFileName[] = L"closed.snapshot";
+constexpr const wchar_t kJournalFileName[] = L"closed.journal";
+constexpr const wchar_t kHeadFileName[] = L"closed.head";
+
+template <typename T>
+void WritePod(std::ostream& stream, const T& value) {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool ReadPod(std::istream& stream, T& value) {
+    return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+void WriteString(std::ostream& stream, const std::wstring& value) {
+    WritePod(stream, static_cast<std::uint32_t>(value.size()));
+    stream.write(reinterpret_cast<const char*>(value.data()),
+                 static_cast<std::streamsize>(value.size() * sizeof(wchar_t)));
+}
+
+bool ReadString(std::istream& stream, std::wstring& value) {
+    std::uint32_t length = 0;
+    if(!ReadPod(stream, length)) {
+        return false;
+    }
+    value.assign(length, L'\0');
+    return static_cast<bool>(stream.read(reinterpret_cast<char*>(value.data()),
+                                         static_cast<std::streamsize>(length * sizeof(wchar_t))));
+}
+
+void WriteHeader(std::ostream& stream, const char (&magic)[4]) {
+    stream.write(magic, sizeof(magic));
+    WritePod(stream, static_cast<std::uint8_t>(sizeof(wchar_t)));
+}
+
+bool ReadHeader(std::istream& stream, const char (&magic)[4]) {
+    char actual[4] = {};
+    std::uint8_t charSize = 0;
+    if(!stream.read(actual, sizeof(actual)) || !ReadPod(stream, charSize)) {
+        return false;
+    }
+    return std::memcmp(actual, magic, sizeof(actual)) == 0 && charSize == sizeof(wchar_t);
+}
+
+bool HasDuplicates(const std::deque<std::wstring>& values) {
+    std::unordered_set<std::wstring> seen;
+    seen.reserve(values.size());
+    for(const auto& value : values) {
+        if(!seen.insert(value).second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+class StorageLock {
+public:
+    explicit StorageLock(qttabbar::IClosedTabHistoryBackend& backend) : m_backend(backend) {
+        m_backend.LockStorage();
+    }
+    ~StorageLock() {
+        m_backend.UnlockStorage();
+    }
+    StorageLock(const StorageLock&) = delete;
+    StorageLock& operator=(const StorageLock&) = delete;
+
+private:
+    qttabbar::IClosedTabHistoryBackend& m_backend;
+};
+
+} // namespace
+
+namespace qttabbar {
+
+std::wstring ClosedTabRecord::Encode() const {
+    std::wstring encoded;
+    encoded.reserve(path.size() + 1);
+    encoded.push_back(static_cast<wchar_t>(op));
+    encoded.append(path);
+    return encoded;
+}
+
+std::optional<ClosedTabRecord> ClosedTabRecord::Decode(const std::wstring& encoded) {
+    if(encoded.size() < 2) {
+        return std::nullopt;
+    }
+    ClosedTabRecord record;
+    switch(encoded.front()) {
+    case static_cast<wchar_t>(Op::Push):
+        record.op = Op::Push;
+        break;
+    case static_cast<wchar_t>(Op::Remove):
+        record.op = Op::Remove;
+        break;
+    default:
+        return std::nullopt;
+    }
+    record.path = encoded.substr(1);
+    return record;
+}
+
+FileClosedTabHistoryBackend::FileClosedTabHistoryBackend(std::filesystem::path directory)
+    : m_directory(std::move(directory)) {
+}
+
+std::filesystem::path FileClosedTabHistoryBackend::SnapshotPath() const {
+    return m_directory / kSnapshotFileName;
+}
+
+std::filesystem::path FileClosedTabHistoryBackend::JournalPath() const {
+    return m_directory / kJournalFileName;
+}
+
+std::filesystem::path FileClosedTabHistoryBackend::HeadPath() const {
+    return m_directory / kHeadFileName;
+}
+
+bool FileClosedTabHistoryBackend::ReadHead(std::uint64_t& nextSequence) {
+    std::ifstream stream(HeadPath(), std::ios::binary);
+    return stream && ReadPod(stream, nextSequence);
+}
+
+bool FileClosedTabHistoryBackend::WriteHead(std::uint64_t nextSequence) {
+    std::ofstream stream(HeadPath(), std::ios::binary | std::ios::trunc);
+    if(!stream) {
+        return false;
+    }
+    WritePod(stream, nextSequence);
+    return static_cast<bool>(stream.flush());
+}
+
+bool FileClosedTabHistoryBackend::ReadSnapshot(std::deque<std::wstring>& entries, std::uint64_t& journalBase) {
+    std::ifstream stream(SnapshotPath(), std::ios::binary);
+    if(!stream || !ReadHeader(stream, kSnapshotMagic)) {
+        return false;
+    }
+    std::uint64_t base = 0;
+    std::uint32_t count = 0;
+    if(!ReadPod(stream, base) || !ReadPod(stream, count)) {
+        return false;
+    }
+    std::deque<std::wstring> loaded;
+    for(std::uint32_t index = 0; index < count; ++index) {
+        std::wstring path;
+        if(!ReadString(stream, path)) {
+            return false;
+        }
+        loaded.push_back(std::move(path));
+    }
+    entries = std::move(loaded);
+    journalBase = base;
+    return true;
+}
+
+std::vector<std::wstring> FileClosedTabHistoryBackend::ReadJournal(std::uint64_t journalBase) {
+    std::vector<std::wstring> records;
+    std::ifstream stream(JournalPath(), std::ios::binary);
+    if(!stream || !ReadHeader(stream, kJournalMagic)) {
+        return records;
+    }
+    std::uint64_t expected = journalBase;
+    for(;;) {
+        std::uint64_t sequence = 0;
+        std::wstring record;
+        if(!ReadPod(stream, sequence) || !ReadString(stream, record)) {
+            break; // a torn tail record is dropped
+        }
+        if(sequence < expected) {
+            continue;
+        }
+        if(sequence != expected) {
+            break;
+        }
+        records.push_back(std::move(record));
+        ++expected;
+    }
+    return records;
+}
+
+bool FileClosedTabHistoryBackend::AppendJournal(std::uint64_t sequence, const std::wstring& record) {
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    bool fresh = !std::filesystem::exists(JournalPath(), ec);
+    std::ofstream stream(JournalPath(), std::ios::binary | std::ios::app);
+    if(!stream) {
+        return false;
+    }
+    if(fresh) {
+        WriteHeader(stream, kJournalMagic);
+    }
+    WritePod(stream, sequence);
+    WriteString(stream, record);
+    if(!stream.flush()) {
+        return false;
+    }
+    stream.close();
+    return WriteHead(sequence + 1);
+}
+
+bool FileClosedTabHistoryBackend::WriteSnapshot(const std::deque<std::wstring>& entries, std::uint64_t journalBase) {
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    std::filesystem::path temp = SnapshotPath();
+    temp += L".tmp";
+    {
+        std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+        if(!stream) {
+            return false;
+        }
+        WriteHeader(stream, kSnapshotMagic);
+        WritePod(stream, journalBase);
+        WritePod(stream, static_cast<std::uint32_t>(entries.size()));
+        for(const auto& path : entries) {
+            WriteString(stream, path);
+        }
+        if(!stream.flush()) {
+            return false;
+        }
+    }
+    std::filesystem::rename(temp, SnapshotPath(), ec);
+    return !ec && WriteHead(journalBase);
+}
+
+void FileClosedTabHistoryBackend::DiscardJournal(std::uint64_t /*first*/, std::uint64_t /*last*/) {
+    // Compaction always folds the whole journal, so the file can simply go away.
+    std::error_code ec;
+    std::filesystem::remove(JournalPath(), ec);
+}
+
+void FileClosedTabHistoryBackend::Clear() {
+    std::error_code ec;
+    std::filesystem::remove(JournalPath(), ec);
+    std::filesystem::remove(SnapshotPath(), ec);
+    std::filesystem::remove(HeadPath(), ec);
+}
+
+ClosedTabHistoryJournal::ClosedTabHistoryJournal(std::unique_ptr<IClosedTabHistoryBackend> backend)
+    : m_backend(std::move(backend)) {
+}
+
+std::deque<std::wstring> ClosedTabHistoryJournal::Load() {
+    std::lock_guard guard(m_mutex);
+    StorageLock storage(*m_backend);
+    m_loaded = false;
+    EnsureLoaded();
+    return m_entries;
+}
+
+void ClosedTabHistoryJournal::Save(const std::deque<std::wstring>& history) {
+    std::lock_guard guard(m_mutex);
+    StorageLock storage(*m_backend);
+    EnsureLoaded();
+    ++m_stats.saves;
+    if(!IsCurrentLocked()) {
+        // Another process wrote since this one loaded. Appending would reuse its
+        // sequence numbers, so reload and replace the history in one snapshot.
+        m_loaded = false;
+        EnsureLoaded();
+        if(history != m_entries) {
+            CompactLocked(history);
+        }
+        return;
+    }
+    if(history == m_entries) {
+        return;
+    }
+
+    auto records = Diff(m_entries, history);
+    std::size_t pending = static_cast<std::size_t>(m_nextSequence - m_journalBase);
+    if(!records || pending + records->size() > CompactionThreshold()) {
+        CompactLocked(history);
+        return;
+    }
+
+    for(const auto& record : *records) {
+        if(!m_backend->AppendJournal(m_nextSequence, record.Encode())) {
+            CompactLocked(history);
+            return;
+        }
+        ++m_nextSequence;
+        ++m_stats.recordsAppended;
+        ++m_stats.backendWrites;
+    }
+    m_entries = history;
+}
+
+void ClosedTabHistoryJournal::Clear() {
+    std::lock_guard guard(m_mutex);
+    StorageLock storage(*m_backend);
+    m_backend->Clear();
+    ++m_stats.backendWrites;
+    m_entries.clear();
+    m_journalBase = 0;
+    m_nextSequence = 0;
+    m_loaded = true;
+}
+
+void ClosedTabHistoryJournal::Compact() {
+    std::lock_guard guard(m_mutex);
+    StorageLock storage(*m_backend);
+    EnsureLoaded();
+    if(!IsCurrentLocked()) {
+        m_loaded = false;
+        EnsureLoaded();
+    }
+    if(m_nextSequence != m_journalBase) {
+        CompactLocked(m_entries);
+    }
+}
+
+ClosedTabHistoryJournal::Stats ClosedTabHistoryJournal::GetStats() const {
+    std::lock_guard guard(m_mutex);
+    return m_stats;
+}
+
+void ClosedTabHistoryJournal::EnsureLoaded() {
+    if(m_loaded) {
+        return;
+    }
+    m_loaded = true;
+    m_entries.clear();
+    m_journalBase = 0;
+    if(!m_backend->ReadSnapshot(m_entries, m_journalBase)) {
+        m_entries.clear();
+        m_journalBase = 0;
+    }
+    m_nextSequence = m_journalBase;
+    for(const auto& encoded : m_backend->ReadJournal(m_journalBase)) {
+        if(auto record = ClosedTabRecord::Decode(encoded)) {
+            Apply(m_entries, *record);
+        }
+        ++m_nextSequence;
+    }
+}
+
+bool ClosedTabHistoryJournal::IsCurrentLocked() {
+    std::uint64_t head = 0;
+    if(m_backend->ReadHead(head)) {
+        return head == m_nextSequence;
+    }
+    std::deque<std::wstring> entries;
+    std::uint64_t base = 0;
+    if(!m_backend->ReadSnapshot(entries, base)) {
+        base = 0;
+    }
+    if(base != m_journalBase) {
+        return false;
+    }
+    return m_journalBase + m_backend->ReadJournal(base).size() == m_nextSequence;
+}
+
+void ClosedTabHistoryJournal::CompactLocked(const std::deque<std::wstring>& history) {
+    // Each snapshot takes a sequence number of its own, so other processes see
+    // that it was replaced even when no records were appended in between.
+    std::uint64_t base = m_nextSequence + 1;
+    if(!m_backend->WriteSnapshot(history, base)) {
+        return;
+    }
+    ++m_stats.backendWrites;
+    ++m_stats.compactions;
+    if(m_nextSequence != m_journalBase) {
+        // Up to the new base, in case a failed append left a record behind.
+        m_backend->DiscardJournal(m_journalBase, base);
+        m_stats.backendWrites += m_nextSequence - m_journalBase;
+    }
+    m_journalBase = base;
+    m_nextSequence = base;
+    m_entries = history;
+}
+
+std::size_t ClosedTabHistoryJournal::CompactionThreshold() const {
+    return std::max(kMinCompactionThreshold, m_entries.size());
+}
+
+std::optional<std::vector<ClosedTabRecord>> ClosedTabHistoryJournal::Diff(const std::deque<std::wstring>& from,
+                                                                          const std::deque<std::wstring>& to) {
+    if(HasDuplicates(from)) {
+        return std::nullopt;
+    }
+
+    std::vector<ClosedTabRecord> records;
+    std::unordered_map<std::wstring, std::size_t> target;
+    target.reserve(to.size());
+    for(std::size_t index = 0; index < to.size(); ++index) {
+        if(!target.emplace(to[index], index).second) {
+            return std::nullopt;
+        }
+    }
+    std::vector<std::size_t> kept;
+    kept.reserve(from.size());
+    for(const auto& path : from) {
+        auto it = target.find(path);
+        if(it == target.end()) {
+            records.push_back({ClosedTabRecord::Op::Remove, path});
+        } else {
+            kept.push_back(it->second);
+        }
+    }
+
+    // Walk both lists from the back. Surviving entries that line up stay where
+    // they are; an entry that has to move further forward is skipped here and
+    // re-pushed with the prefix, so moving one tab to the front costs one record.
+    std::size_t toIndex = to.size();
+    std::size_t keptIndex = kept.size();
+    while(toIndex > 0 && keptIndex > 0) {
+        if(kept[keptIndex - 1] == toIndex - 1) {
+            --toIndex;
+        }
+        --keptIndex;
+    }
+    while(toIndex > 0) {
+        --toIndex;
+        records.push_back({ClosedTabRecord::Op::Push, to[toIndex]});
+    }
+    return records;
+}
+
+void ClosedTabHistoryJournal::Apply(std::deque<std::wstring>& history, const ClosedTabRecord& record) {
+    history.erase(std::remove(history.begin(), history.end(), record.path), history.end());
+    if(record.op == ClosedTabRecord::Op::Push) {
+        history.push_front(record.path);
+    }
+}
+
+} // namespace qttabbar
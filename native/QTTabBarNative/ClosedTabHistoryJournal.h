@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace qttabbar {
+
+// A single journaled change to the closed-tab history. Push moves (or inserts) a
+// path to the front of the list; Remove drops every occurrence of a path.
+struct ClosedTabRecord {
+    enum class Op : wchar_t {
+        Push = L'+',
+        Remove = L'-',
+    };
+
+    Op op = Op::Push;
+    std::wstring path;
+
+    std::wstring Encode() const;
+    static std::optional<ClosedTabRecord> Decode(const std::wstring& encoded);
+};
+
+// Storage used by ClosedTabHistoryJournal. A backend keeps one compacted snapshot
+// plus an append-only list of encoded records numbered from the snapshot's
+// journal base, and a head holding the sequence number the next record will
+// take. Implementations do not need to be thread-safe.
+class IClosedTabHistoryBackend {
+public:
+    virtual ~IClosedTabHistoryBackend() = default;
+
+    // Held around every read and check-then-write, so that processes sharing the
+    // storage cannot write the same sequence number. The defaults suit storage
+    // used by a single process.
+    virtual void LockStorage() {}
+    virtual void UnlockStorage() {}
+
+    // Returns false when nothing has been persisted yet.
+    virtual bool ReadSnapshot(std::deque<std::wstring>& entries, std::uint64_t& journalBase) = 0;
+    // Returns the records numbered journalBase, journalBase + 1, ... up to the first gap.
+    virtual std::vector<std::wstring> ReadJournal(std::uint64_t journalBase) = 0;
+    // Returns false when no head was written, e.g. for histories stored before
+    // there was one.
+    virtual bool ReadHead(std::uint64_t& nextSequence) = 0;
+    // Also moves the head to sequence + 1.
+    virtual bool AppendJournal(std::uint64_t sequence, const std::wstring& record) = 0;
+    // Must replace the previous snapshot atomically and move the head to
+    // journalBase; the old journal stays readable until DiscardJournal is called.
+    virtual bool WriteSnapshot(const std::deque<std::wstring>& entries, std::uint64_t journalBase) = 0;
+    virtual void DiscardJournal(std::uint64_t first, std::uint64_t last) = 0;
+    virtual void Clear() = 0;
+};
+
+// Stores each journal record and snapshot as a file under a directory. Used on
+// hosts without a registry and for measuring write counts of large histories.
+class FileClosedTabHistoryBackend final : public IClosedTabHistoryBackend {
+public:
+    explicit FileClosedTabHistoryBackend(std::filesystem::path directory);
+
+    bool ReadSnapshot(std::deque<std::wstring>& entries, std::uint64_t& journalBase) override;
+    std::vector<std::wstring> ReadJournal(std::uint64_t journalBase) override;
+    bool ReadHead(std::uint64_t& nextSequence) override;
+    bool AppendJournal(std::uint64_t sequence, const std::wstring& record) override;
+    bool WriteSnapshot(const std::deque<std::wstring>& entries, std::uint64_t journalBase) override;
+    void DiscardJournal(std::uint64_t first, std::uint64_t last) override;
+    void Clear() override;
+
+private:
+    std::filesystem::path SnapshotPath() const;
+    std::filesystem::path JournalPath() const;
+    std::filesystem::path HeadPath() const;
+    bool WriteHead(std::uint64_t nextSequence);
+
+    std::filesystem::path m_directory;
+};
+
+// Keeps the closed-tab history in memory and persists changes as small journal
+// records, folding them into a fresh snapshot once the journal grows past the
+// compaction threshold.
+class ClosedTabHistoryJournal {
+public:
+    struct Stats {
+        std::uint64_t saves = 0;
+        std::uint64_t recordsAppended = 0;
+        std::uint64_t compactions = 0;
+        std::uint64_t backendWrites = 0;
+    };
+
+    static constexpr std::size_t kMinCompactionThreshold = 32;
+
+    explicit ClosedTabHistoryJournal(std::unique_ptr<IClosedTabHistoryBackend> backend);
+
+    std::deque<std::wstring> Load();
+    void Save(const std::deque<std::wstring>& history);
+    void Clear();
+    void Compact();
+    Stats GetStats() const;
+
+    // Computes the records that turn `from` into `to`, or nullopt when either list
+    // contains duplicates and a snapshot has to be written instead.
+    static std::optional<std::vector<ClosedTabRecord>> Diff(const std::deque<std::wstring>& from,
+                                                            const std::deque<std::wstring>& to);
+    static void Apply(std::deque<std::wstring>& history, const ClosedTabRecord& record);
+
+private:
+    void EnsureLoaded();
+    // Whether the backend's head is still where this instance left it; another
+    // process sharing the backend may have appended or compacted since. Sequence
+    // numbers only grow, so comparing the head is enough. Without a head the
+    // snapshot base and journal length are read instead.
+    bool IsCurrentLocked();
+    void CompactLocked(const std::deque<std::wstring>& history);
+    std::size_t CompactionThreshold() const;
+
+    mutable std::mutex m_mutex;
+    std::unique_ptr<IClosedTabHistoryBackend> m_backend;
+    std::deque<std::wstring> m_entries;
+    std::uint64_t m_journalBase = 0;
+    std::uint64_t m_nextSequence = 0;
+    bool m_loaded = false;
+    Stats m_stats{};
+};
+
+} // namespace qttabbar
@@ -3,63 +3,243 @@
 
 #include <atlbase.h>
 
+#include <cwchar>
+
 namespace {
 constexpr const wchar_t kHistoryRoot[] = L"Software\\QTTabBar\\RecentlyClosed";
-}
+constexpr const wchar_t kSnapshotValueName[] = L"Snapshot";
+constexpr const wchar_t kHeadValueName[] = L"Head";
+constexpr const wchar_t kHistoryMutexName[] = L"QTTabBar_RecentlyClosed";
+constexpr wchar_t kJournalBasePrefix = L'#';
 
-namespace qttabbar {
+void FormatJournalValueName(std::uint64_t sequence, wchar_t (&valueName)[24]) {
+    _snwprintf_s(valueName, std::size(valueName), _TRUNCATE, L"J%llu", static_cast<unsigned long long>(sequence));
+}
 
-ClosedTabHistoryStore& ClosedTabHistoryStore::Instance() {
-    static ClosedTabHistoryStore instance;
-    return instance;
+bool QueryString(CRegKey& key, const wchar_t* valueName, std::wstring& value) {
+    ULONG chars = 0;
+    if(key.QueryStringValue(valueName, nullptr, &chars) != ERROR_SUCCESS || chars == 0) {
+        return false;
+    }
+    value.assign(chars, L'\0');
+    if(key.QueryStringValue(valueName, value.data(), &chars) != ERROR_SUCCESS) {
+        return false;
+    }
+    value.resize(wcsnlen(value.c_str(), value.size()));
+    return true;
 }
 
-std::deque<std::wstring> ClosedTabHistoryStore::Load() const {
-    std::deque<std::wstring> history;
-    CRegKey key;
-    if(key.Open(HKEY_CURRENT_USER, kHistoryRoot, KEY_READ) != ERROR_SUCCESS) {
-        return history;
+// Layout under kHistoryRoot: "Snapshot" is a REG_MULTI_SZ whose first string is
+// "#<journal base>" followed by the paths, each journal record is a REG_SZ named
+// "J<sequence>", and "Head" is a REG_QWORD holding the next sequence number.
+// Histories written before the journal existed are stored as numbered values
+// "0".."n-1" and are migrated on the first compaction. Every Explorer process
+// shares the key, so updates are serialized by a named mutex.
+class RegistryClosedTabHistoryBackend final : public qttabbar::IClosedTabHistoryBackend {
+public:
+    RegistryClosedTabHistoryBackend() : m_mutex(CreateMutexW(nullptr, FALSE, kHistoryMutexName)) {
     }
-    for(DWORD index = 0;; ++index) {
-        wchar_t valueName[16] = {};
-        _snwprintf_s(valueName, std::size(valueName), L"%u", index);
+
+    ~RegistryClosedTabHistoryBackend() override {
+        if(m_mutex) {
+            CloseHandle(m_mutex);
+        }
+    }
+
+    void LockStorage() override {
+        // An abandoned mutex still grants ownership; the journal copes with the
+        // torn write a crashed owner may have left.
+        if(m_mutex) {
+            WaitForSingleObject(m_mutex, INFINITE);
+        }
+    }
+
+    void UnlockStorage() override {
+        if(m_mutex) {
+            ReleaseMutex(m_mutex);
+        }
+    }
+
+    bool ReadSnapshot(std::deque<std::wstring>& entries, std::uint64_t& journalBase) override {
+        CRegKey key;
+        if(key.Open(HKEY_CURRENT_USER, kHistoryRoot, KEY_READ) != ERROR_SUCCESS) {
+            return false;
+        }
         ULONG chars = 0;
-        if(key.QueryStringValue(valueName, nullptr, &chars) != ERROR_SUCCESS || chars == 0) {
-            break;
+        if(key.QueryMultiStringValue(kSnapshotValueName, nullptr, &chars) == ERROR_SUCCESS && chars > 0) {
+            std::wstring buffer(chars, L'\0');
+            if(key.QueryMultiStringValue(kSnapshotValueName, buffer.data(), &chars) != ERROR_SUCCESS) {
+                return false;
+            }
+            entries.clear();
+            bool header = true;
+            for(const wchar_t* cursor = buffer.c_str(); *cursor != L'\0'; cursor += wcslen(cursor) + 1) {
+                if(header) {
+                    header = false;
+                    if(*cursor == kJournalBasePrefix) {
+                        journalBase = _wcstoui64(cursor + 1, nullptr, 10);
+                        continue;
+                    }
+                }
+                entries.emplace_back(cursor);
+            }
+            return true;
         }
-        std::wstring path(chars, L'\0');
-        if(key.QueryStringValue(valueName, path.data(), &chars) == ERROR_SUCCESS) {
-            if(!path.empty() && path.back() == L'\0') {
-                path.pop_back();
+
+        entries.clear();
+        journalBase = 0;
+        for(DWORD index = 0;; ++index) {
+            wchar_t valueName[16] = {};
+            _snwprintf_s(valueName, std::size(valueName), L"%u", index);
+            std::wstring path;
+            if(!QueryString(key, valueName, path)) {
+                break;
             }
             if(!path.empty()) {
-                history.push_back(std::move(path));
+                entries.push_back(std::move(path));
             }
         }
+        m_legacyCount = entries.size();
+        return !entries.empty();
+    }
+
+    std::vector<std::wstring> ReadJournal(std::uint64_t journalBase) override {
+        std::vector<std::wstring> records;
+        CRegKey key;
+        if(key.Open(HKEY_CURRENT_USER, kHistoryRoot, KEY_READ) != ERROR_SUCCESS) {
+            return records;
+        }
+        for(std::uint64_t sequence = journalBase;; ++sequence) {
+            wchar_t valueName[24] = {};
+            FormatJournalValueName(sequence, valueName);
+            std::wstring record;
+            if(!QueryString(key, valueName, record)) {
+                break;
+            }
+            records.push_back(std::move(record));
+        }
+        return records;
+    }
+
+    bool ReadHead(std::uint64_t& nextSequence) override {
+        CRegKey key;
+        if(key.Open(HKEY_CURRENT_USER, kHistoryRoot, KEY_READ) != ERROR_SUCCESS) {
+            return false;
+        }
+        ULONGLONG value = 0;
+        if(key.QueryQWORDValue(kHeadValueName, value) != ERROR_SUCCESS) {
+            return false;
+        }
+        nextSequence = value;
+        return true;
     }
-    return history;
-}
 
-void ClosedTabHistoryStore::Save(const std::deque<std::wstring>& history) const {
-    RegDeleteTreeW(HKEY_CURRENT_USER, kHistoryRoot);
-    CRegKey key;
-    if(key.Create(HKEY_CURRENT_USER, kHistoryRoot) != ERROR_SUCCESS) {
-        return;
+    bool AppendJournal(std::uint64_t sequence, const std::wstring& record) override {
+        CRegKey key;
+        if(key.Create(HKEY_CURRENT_USER, kHistoryRoot) != ERROR_SUCCESS) {
+            return false;
+        }
+        wchar_t valueName[24] = {};
+        FormatJournalValueName(sequence, valueName);
+        return key.SetStringValue(valueName, record.c_str()) == ERROR_SUCCESS
+               && key.SetQWORDValue(kHeadValueName, sequence + 1) == ERROR_SUCCESS;
     }
-    DWORD index = 0;
+
+    bool WriteSnapshot(const std::deque<std::wstring>& entries, std::uint64_t journalBase) override {
+        CRegKey key;
+        if(key.Create(HKEY_CURRENT_USER, kHistoryRoot) != ERROR_SUCCESS) {
+            return false;
+        }
+        wchar_t header[24] = {};
+        _snwprintf_s(header, std::size(header), _TRUNCATE, L"%c%llu", kJournalBasePrefix,
+                     static_cast<unsigned long long>(journalBase));
+        std::wstring buffer = header;
+        buffer.push_back(L'\0');
+        for(const auto& path : entries) {
+            buffer.append(path);
+            buffer.push_back(L'\0');
+        }
+        buffer.push_back(L'\0');
+        if(key.SetMultiStringValue(kSnapshotValueName, buffer.c_str()) != ERROR_SUCCESS
+           || key.SetQWORDValue(kHeadValueName, journalBase) != ERROR_SUCCESS) {
+            return false;
+        }
+        for(DWORD index = 0; index < m_legacyCount; ++index) {
+            wchar_t valueName[16] = {};
+            _snwprintf_s(valueName, std::size(valueName), L"%u", index);
+            key.DeleteValue(valueName);
+        }
+        m_legacyCount = 0;
+        return true;
+    }
+
+    void DiscardJournal(std::uint64_t first, std::uint64_t last) override {
+        CRegKey key;
+        if(key.Open(HKEY_CURRENT_USER, kHistoryRoot, KEY_SET_VALUE) != ERROR_SUCCESS) {
+            return;
+        }
+        for(std::uint64_t sequence = first; sequence < last; ++sequence) {
+            wchar_t valueName[24] = {};
+            FormatJournalValueName(sequence, valueName);
+            key.DeleteValue(valueName);
+        }
+    }
+
+    void Clear() override {
+        RegDeleteTreeW(HKEY_CURRENT_USER, kHistoryRoot);
+        m_legacyCount = 0;
+    }
+
+private:
+    HANDLE m_mutex = nullptr;
+    std::size_t m_legacyCount = 0;
+};
+
+} // namespace
+
+namespace qttabbar {
+
+ClosedTabHistoryStore& ClosedTabHistoryStore::Instance() {
+    static ClosedTabHistoryStore instance;
+    return instance;
+}
+
+ClosedTabHistoryStore::ClosedTabHistoryStore()
+    : m_journal(std::make_unique<ClosedTabHistoryJournal>(std::make_unique<RegistryClosedTabHistoryBackend>())) {
+}
+
+std::deque<std::wstring> ClosedTabHistoryStore::Load() {
+    std::lock_guard guard(m_mutex);
+    return m_journal->Load();
+}
+
+void ClosedTabHistoryStore::Save(const std::deque<std::wstring>& history) {
+    std::deque<std::wstring> filtered;
     for(const auto& path : history) {
-        if(path.empty()) {
-            continue;
+        if(!path.empty()) {
+            filtered.push_back(path);
         }
-        wchar_t valueName[16] = {};
-        _snwprintf_s(valueName, std::size(valueName), L"%u", index++);
-        key.SetStringValue(valueName, path.c_str());
     }
+    std::lock_guard guard(m_mutex);
+    m_journal->Save(filtered);
 }
 
-void ClosedTabHistoryStore::Clear() const {
-    RegDeleteTreeW(HKEY_CURRENT_USER, kHistoryRoot);
+void ClosedTabHistoryStore::Clear() {
+    std::lock_guard guard(m_mutex);
+    m_journal->Clear();
 }
 
-} // namespace qttabbar
+void ClosedTabHistoryStore::SetBackend(std::unique_ptr<IClosedTabHistoryBackend> backend) {
+    if(backend) {
+        auto journal = std::make_unique<ClosedTabHistoryJournal>(std::move(backend));
+        std::lock_guard guard(m_mutex);
+        m_journal = std::move(journal);
+    }
+}
+
+ClosedTabHistoryJournal::Stats ClosedTabHistoryStore::GetStats() const {
+    std::lock_guard guard(m_mutex);
+    return m_journal->GetStats();
+}
 
+} // namespace qttabbar
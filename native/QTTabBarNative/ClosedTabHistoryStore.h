@@ -3,21 +3,32 @@
 #include <windows.h>
 
 #include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
 
+#include "ClosedTabHistoryJournal.h"
+
 namespace qttabbar {
 
 class ClosedTabHistoryStore {
 public:
     static ClosedTabHistoryStore& Instance();
 
-    std::deque<std::wstring> Load() const;
-    void Save(const std::deque<std::wstring>& history) const;
-    void Clear() const;
+    std::deque<std::wstring> Load();
+    void Save(const std::deque<std::wstring>& history);
+    void Clear();
+
+    // Replaces the registry backend, e.g. with FileClosedTabHistoryBackend.
+    void SetBackend(std::unique_ptr<IClosedTabHistoryBackend> backend);
+    ClosedTabHistoryJournal::Stats GetStats() const;
 
 private:
-    ClosedTabHistoryStore() = default;
+    ClosedTabHistoryStore();
+
+    // Guards m_journal itself, which SetBackend may replace while tabs close.
+    mutable std::mutex m_mutex;
+    std::unique_ptr<ClosedTabHistoryJournal> m_journal;
 };
 
 } // namespace qttabbar
-
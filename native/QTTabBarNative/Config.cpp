@@ -10,11 +10,14 @@
 #include <cwctype>
 #include <cstring>
 #include <gdiplus.h>
+#include <ktmw32.h>
+#include <mutex>
 #include <sstream>
 
 #include "third_party/nlohmann/json.hpp"
 
 #pragma comment(lib, "Gdiplus.lib")
+#pragma comment(lib, "KtmW32.lib")
 
 namespace qttabbar {
 namespace {
@@ -150,17 +153,25 @@ bool ReadStringValue(HKEY key, const wchar_t* name, std::wstring* out) {
     return true;
 }
 
-void WriteDwordValue(HKEY key, const wchar_t* name, DWORD value) {
-    RegSetValueExW(key, name, 0, REG_DWORD, reinterpret_cast<const BYTE*>(&value), sizeof(value));
+void WriteDwordValue(ConfigCategoryValues& key, const wchar_t* name, DWORD value) {
+    key.SetDword(name, value);
 }
 
-void WriteStringValue(HKEY key, const wchar_t* name, const std::wstring& value) {
-    const BYTE* data = reinterpret_cast<const BYTE*>(value.c_str());
-    DWORD size = static_cast<DWORD>((value.size() + 1) * sizeof(wchar_t));
-    RegSetValueExW(key, name, 0, REG_SZ, data, size);
+void WriteStringValue(ConfigCategoryValues& key, const wchar_t* name, const std::wstring& value) {
+    key.SetString(name, value);
 }
 
-void WriteJsonValue(HKEY key, const wchar_t* name, const json& j) {
+LSTATUS SetRegistryValue(HKEY key, const std::wstring& name, const ConfigValue& value) {
+    if (value.type == ConfigValue::Type::Dword) {
+        DWORD data = value.dword;
+        return RegSetValueExW(key, name.c_str(), 0, REG_DWORD, reinterpret_cast<const BYTE*>(&data), sizeof(data));
+    }
+    const BYTE* data = reinterpret_cast<const BYTE*>(value.string.c_str());
+    DWORD size = static_cast<DWORD>((value.string.size() + 1) * sizeof(wchar_t));
+    return RegSetValueExW(key, name.c_str(), 0, REG_SZ, data, size);
+}
+
+void WriteJsonValue(ConfigCategoryValues& key, const wchar_t* name, const json& j) {
     std::string utf8 = j.dump();
     int length = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), static_cast<int>(utf8.size()), nullptr, 0);
     std::wstring wide(length, L'\0');
@@ -652,7 +663,9 @@ ConfigData::ConfigData() {
     lang.pluginLangFiles.clear();
 }
 
-static std::wstring MakeCategoryPath(const wchar_t* category) {
+namespace {
+
+std::wstring MakeCategoryPath(const wchar_t* category) {
     std::wstring path = kRegRoot;
     path.append(L"\\");
     path.append(category);
@@ -676,7 +689,7 @@ void ReadWindowSettings(HKEY key, WindowSettings& settings) {
     }
 }
 
-void WriteWindowSettings(HKEY key, const WindowSettings& settings) {
+void WriteWindowSettings(ConfigCategoryValues& key, const WindowSettings& settings) {
     WriteDwordValue(key, L"CaptureNewWindows", (settings.captureNewWindows ? 1u : 0u));
     WriteDwordValue(key, L"CaptureWeChatSelection", (settings.captureWeChatSelection ? 1u : 0u));
     WriteDwordValue(key, L"RestoreSession", (settings.restoreSession ? 1u : 0u));
@@ -724,7 +737,7 @@ void ReadTabsSettings(HKEY key, TabsSettings& settings) {
     if (ReadDwordValue(key, L"NeedPlusButton", &value)) settings.needPlusButton = value != 0;
 }
 
-void WriteTabsSettings(HKEY key, const TabsSettings& settings) {
+void WriteTabsSettings(ConfigCategoryValues& key, const TabsSettings& settings) {
     WriteStringValue(key, L"NewTabPosition", TabPosToString(settings.newTabPosition));
     WriteStringValue(key, L"NextAfterClosed", TabPosToString(settings.nextAfterClosed));
     WriteDwordValue(key, L"ActivateNewTab", (settings.activateNewTab ? 1u : 0u));
@@ -761,7 +774,7 @@ void ReadTweaksSettings(HKEY key, TweaksSettings& settings) {
     if (auto jsonValue = ReadJsonValue(key, L"AltRowForegroundColor")) settings.altRowForegroundColor = ParseColor(*jsonValue);
 }
 
-void WriteTweaksSettings(HKEY key, const TweaksSettings& settings) {
+void WriteTweaksSettings(ConfigCategoryValues& key, const TweaksSettings& settings) {
     WriteDwordValue(key, L"AlwaysShowHeaders", (settings.alwaysShowHeaders ? 1u : 0u));
     WriteDwordValue(key, L"KillExtWhileRenaming", (settings.killExtWhileRenaming ? 1u : 0u));
     WriteDwordValue(key, L"RedirectLibraryFolders", (settings.redirectLibraryFolders ? 1u : 0u));
@@ -793,7 +806,7 @@ void ReadTipsSettings(HKEY key, TipsSettings& settings) {
     if (auto jsonValue = ReadJsonValue(key, L"ImageExt")) settings.imageExt = ParseStringList(*jsonValue);
 }
 
-void WriteTipsSettings(HKEY key, const TipsSettings& settings) {
+void WriteTipsSettings(ConfigCategoryValues& key, const TipsSettings& settings) {
     WriteDwordValue(key, L"ShowSubDirTips", (settings.showSubDirTips ? 1u : 0u));
     WriteDwordValue(key, L"SubDirTipsPreview", (settings.subDirTipsPreview ? 1u : 0u));
     WriteDwordValue(key, L"SubDirTipsFiles", (settings.subDirTipsFiles ? 1u : 0u));
@@ -821,7 +834,7 @@ void ReadMiscSettings(HKEY key, MiscSettings& settings) {
     if (ReadDwordValue(key, L"EnableLog", &value)) settings.enableLog = value != 0;
 }
 
-void WriteMiscSettings(HKEY key, const MiscSettings& settings) {
+void WriteMiscSettings(ConfigCategoryValues& key, const MiscSettings& settings) {
     WriteDwordValue(key, L"TaskbarThumbnails", (settings.taskbarThumbnails ? 1u : 0u));
     WriteDwordValue(key, L"KeepHistory", (settings.keepHistory ? 1u : 0u));
     WriteDwordValue(key, L"TabHistoryCount", static_cast<DWORD>(settings.tabHistoryCount));
@@ -874,7 +887,7 @@ void ReadSkinSettings(HKEY key, SkinSettings& settings) {
     if (ReadDwordValue(key, L"DrawVerticalExplorerBarBgColor", &value)) settings.drawVerticalExplorerBarBgColor = value != 0;
 }
 
-void WriteSkinSettings(HKEY key, const SkinSettings& settings) {
+void WriteSkinSettings(ConfigCategoryValues& key, const SkinSettings& settings) {
     WriteDwordValue(key, L"UseTabSkin", (settings.useTabSkin ? 1u : 0u));
     WriteStringValue(key, L"TabImageFile", settings.tabImageFile);
     WriteJsonValue(key, L"TabSizeMargin", SerializePadding(settings.tabSizeMargin));
@@ -920,7 +933,7 @@ void ReadBBarSettings(HKEY key, BBarSettings& settings) {
     ReadStringValue(key, L"ImageStripPath", &settings.imageStripPath);
 }
 
-void WriteBBarSettings(HKEY key, const BBarSettings& settings) {
+void WriteBBarSettings(ConfigCategoryValues& key, const BBarSettings& settings) {
     WriteJsonValue(key, L"ButtonIndexes", SerializeIntVector(settings.buttonIndexes));
     WriteJsonValue(key, L"ActivePluginIDs", SerializeStringList(settings.activePluginIDs));
     WriteDwordValue(key, L"LargeButtons", (settings.largeButtons ? 1u : 0u));
@@ -941,7 +954,7 @@ void ReadMouseSettings(HKEY key, MouseSettings& settings) {
     if (auto jsonValue = ReadJsonValue(key, L"MarginActions")) settings.marginActions = ParseMouseActionMap(*jsonValue);
 }
 
-void WriteMouseSettings(HKEY key, const MouseSettings& settings) {
+void WriteMouseSettings(ConfigCategoryValues& key, const MouseSettings& settings) {
     WriteDwordValue(key, L"MouseScrollsHotWnd", (settings.mouseScrollsHotWnd ? 1u : 0u));
     WriteJsonValue(key, L"GlobalMouseActions", SerializeMouseActionMap(settings.globalMouseActions));
     WriteJsonValue(key, L"TabActions", SerializeMouseActionMap(settings.tabActions));
@@ -958,7 +971,7 @@ void ReadKeysSettings(HKEY key, KeysSettings& settings) {
     if (ReadDwordValue(key, L"UseTabSwitcher", &value)) settings.useTabSwitcher = value != 0;
 }
 
-void WriteKeysSettings(HKEY key, const KeysSettings& settings) {
+void WriteKeysSettings(ConfigCategoryValues& key, const KeysSettings& settings) {
     WriteJsonValue(key, L"Shortcuts", SerializeIntVector(settings.shortcuts));
     WriteJsonValue(key, L"PluginShortcuts", SerializePluginShortcuts(settings.pluginShortcuts));
     WriteDwordValue(key, L"UseTabSwitcher", (settings.useTabSwitcher ? 1u : 0u));
@@ -968,7 +981,7 @@ void ReadPluginSettings(HKEY key, PluginSettings& settings) {
     if (auto jsonValue = ReadJsonValue(key, L"Enabled")) settings.enabled = ParseStringList(*jsonValue);
 }
 
-void WritePluginSettings(HKEY key, const PluginSettings& settings) {
+void WritePluginSettings(ConfigCategoryValues& key, const PluginSettings& settings) {
     WriteJsonValue(key, L"Enabled", SerializeStringList(settings.enabled));
 }
 
@@ -981,7 +994,7 @@ void ReadLangSettings(HKEY key, LangSettings& settings) {
     if (ReadDwordValue(key, L"BuiltInLangSelectedIndex", &value)) settings.builtInLangSelectedIndex = static_cast<int>(value);
 }
 
-void WriteLangSettings(HKEY key, const LangSettings& settings) {
+void WriteLangSettings(ConfigCategoryValues& key, const LangSettings& settings) {
     WriteJsonValue(key, L"PluginLangFiles", SerializeStringList(settings.pluginLangFiles));
     WriteDwordValue(key, L"UseLangFile", (settings.useLangFile ? 1u : 0u));
     WriteStringValue(key, L"LangFile", settings.langFile);
@@ -1013,7 +1026,7 @@ void ReadDesktopSettings(HKEY key, DesktopSettings& settings) {
     if (ReadDwordValue(key, L"lstSelectedIndex", &value)) settings.lstSelectedIndex = static_cast<int>(value);
 }
 
-void WriteDesktopSettings(HKEY key, const DesktopSettings& settings) {
+void WriteDesktopSettings(ConfigCategoryValues& key, const DesktopSettings& settings) {
     WriteDwordValue(key, L"FirstItem", static_cast<DWORD>(settings.firstItem));
     WriteDwordValue(key, L"SecondItem", static_cast<DWORD>(settings.secondItem));
     WriteDwordValue(key, L"ThirdItem", static_cast<DWORD>(settings.thirdItem));
@@ -1101,6 +1114,176 @@ void ApplyConfigValidation(ConfigData& config) {
     }
 }
 
+#ifndef REG_NOTIFY_THREAD_AGNOSTIC
+#define REG_NOTIFY_THREAD_AGNOSTIC 0x10000000L
+#endif
+
+// Reports changes anywhere under the config key. The notification is armed
+// again each time a change is consumed, so a burst of writes costs one reload.
+class ConfigKeyWatcher {
+public:
+    ConfigKeyWatcher() {
+        m_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (RegCreateKeyExW(HKEY_CURRENT_USER, kRegRoot, 0, nullptr, 0, KEY_NOTIFY, nullptr, &m_key, nullptr) != ERROR_SUCCESS) {
+            m_key = nullptr;
+        }
+        m_armed = Arm();
+    }
+
+    ~ConfigKeyWatcher() {
+        if (m_key) {
+            RegCloseKey(m_key);
+        }
+        if (m_event) {
+            CloseHandle(m_event);
+        }
+    }
+
+    ConfigKeyWatcher(const ConfigKeyWatcher&) = delete;
+    ConfigKeyWatcher& operator=(const ConfigKeyWatcher&) = delete;
+
+    // True when the key changed since the last call. A key that cannot be
+    // watched always reports a change, which reads the registry every time.
+    bool ConsumeChange() {
+        if (m_armed && WaitForSingleObject(m_event, 0) != WAIT_OBJECT_0) {
+            return false;
+        }
+        ResetEvent(m_event);
+        m_armed = Arm();
+        return true;
+    }
+
+private:
+    bool Arm() {
+        if (!m_key || !m_event) {
+            return false;
+        }
+        const DWORD filter = REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET;
+        if (RegNotifyChangeKeyValue(m_key, TRUE, filter | REG_NOTIFY_THREAD_AGNOSTIC, m_event, TRUE) == ERROR_SUCCESS) {
+            return true;
+        }
+        // Before Windows 8 the registration ends with the thread that made it,
+        // which signals the event: at worst one needless reload.
+        return RegNotifyChangeKeyValue(m_key, TRUE, filter, m_event, TRUE) == ERROR_SUCCESS;
+    }
+
+    HKEY m_key = nullptr;
+    HANDLE m_event = nullptr;
+    bool m_armed = false;
+};
+
+SnapshotCache<ConfigData>& ConfigCache() {
+    static ConfigKeyWatcher watcher;
+    static SnapshotCache<ConfigData> cache(LoadConfigFromRegistry, [] { return watcher.ConsumeChange(); });
+    return cache;
+}
+
+ConfigValueSet SerializeConfig(const ConfigData& config, bool desktopOnly) {
+    ConfigValueSet values;
+    auto writeCategory = [&](const wchar_t* name, auto&& writer, const auto& settings) {
+        values.push_back(ConfigCategoryValues{name, {}});
+        writer(values.back(), settings);
+    };
+
+    if (!desktopOnly) {
+        writeCategory(L"Window", WriteWindowSettings, config.window);
+        writeCategory(L"Tabs", WriteTabsSettings, config.tabs);
+        writeCategory(L"Tweaks", WriteTweaksSettings, config.tweaks);
+        writeCategory(L"Tips", WriteTipsSettings, config.tips);
+        writeCategory(L"Misc", WriteMiscSettings, config.misc);
+        writeCategory(L"Skin", WriteSkinSettings, config.skin);
+        writeCategory(L"BBar", WriteBBarSettings, config.bbar);
+        writeCategory(L"Mouse", WriteMouseSettings, config.mouse);
+        writeCategory(L"Keys", WriteKeysSettings, config.keys);
+        writeCategory(L"Plugin", WritePluginSettings, config.plugin);
+        writeCategory(L"Lang", WriteLangSettings, config.lang);
+    }
+    writeCategory(L"Desktop", WriteDesktopSettings, config.desktop);
+    return values;
+}
+
+// Writes the changes of one save in a single registry transaction, so other
+// processes see all of them or none. Where the transaction cannot be used,
+// the values are written one by one as before.
+class RegistryValueStore : public IConfigValueStore {
+public:
+    bool Write(const ConfigValueSet& changes) override {
+        HANDLE transaction = CreateTransaction(nullptr, nullptr, 0, 0, 0, 0, nullptr);
+        if (transaction != INVALID_HANDLE_VALUE) {
+            bool committed = WriteAll(changes, transaction) && CommitTransaction(transaction);
+            if (!committed) {
+                RollbackTransaction(transaction);
+            }
+            CloseHandle(transaction);
+            if (committed) {
+                return true;
+            }
+        }
+        return WriteAll(changes, nullptr);
+    }
+
+private:
+    static bool WriteAll(const ConfigValueSet& changes, HANDLE transaction) {
+        for (const ConfigCategoryValues& category : changes) {
+            std::wstring path = MakeCategoryPath(category.category.c_str());
+            HKEY key = nullptr;
+            LSTATUS status = transaction
+                ? RegCreateKeyTransactedW(HKEY_CURRENT_USER, path.c_str(), 0, nullptr, 0, KEY_WRITE, nullptr, &key, nullptr, transaction, nullptr)
+                : RegCreateKeyExW(HKEY_CURRENT_USER, path.c_str(), 0, nullptr, 0, KEY_WRITE, nullptr, &key, nullptr);
+            if (status != ERROR_SUCCESS) {
+                return false;
+            }
+            for (const auto& [name, value] : category.values) {
+                status = SetRegistryValue(key, name, value);
+                if (status != ERROR_SUCCESS) {
+                    break;
+                }
+            }
+            RegCloseKey(key);
+            if (status != ERROR_SUCCESS) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// What the registry holds under the names `layout` uses, as stored: a value
+// that is missing, or is not a DWORD or string, is left out, and one stored
+// with the other type keeps that type, so the diff writes both again.
+ConfigValueSet ReadStoredConfigValues(const ConfigValueSet& layout) {
+    ConfigValueSet stored;
+    for (const ConfigCategoryValues& category : layout) {
+        stored.push_back(ConfigCategoryValues{category.category, {}});
+        std::wstring path = MakeCategoryPath(category.category.c_str());
+        HKEY key = nullptr;
+        if (RegOpenKeyExW(HKEY_CURRENT_USER, path.c_str(), 0, KEY_READ, &key) != ERROR_SUCCESS) {
+            continue;
+        }
+        for (const auto& [name, value] : category.values) {
+            DWORD dword = 0;
+            std::wstring string;
+            if (ReadDwordValue(key, name.c_str(), &dword)) {
+                stored.back().SetDword(name.c_str(), dword);
+            } else if (ReadStringValue(key, name.c_str(), &string)) {
+                stored.back().SetString(name.c_str(), std::move(string));
+            }
+        }
+        RegCloseKey(key);
+    }
+    return stored;
+}
+
+struct ConfigWriterState {
+    std::mutex mutex;
+    ConfigDiffWriter writer;
+};
+
+ConfigWriterState& ConfigWriter() {
+    static ConfigWriterState state;
+    return state;
+}
+
 }  // namespace
 
 ConfigData LoadConfigFromRegistry() {
@@ -1140,42 +1323,30 @@ ConfigData LoadConfigFromRegistry() {
 void WriteConfigToRegistry(const ConfigData& config, bool desktopOnly) {
     ConfigData sanitized = config;
     ApplyConfigValidation(sanitized);
-
-    HKEY root = nullptr;
-    RegCreateKeyExW(HKEY_CURRENT_USER, kRegRoot, 0, nullptr, 0, KEY_WRITE, nullptr, &root, nullptr);
-    auto writeCategory = [&](const wchar_t* name, auto&& writer, const auto& settings) {
-        std::wstring path = MakeCategoryPath(name);
-        HKEY key = nullptr;
-        if (RegCreateKeyExW(HKEY_CURRENT_USER, path.c_str(), 0, nullptr, 0, KEY_WRITE, nullptr, &key, nullptr) == ERROR_SUCCESS) {
-            writer(key, settings);
-            RegCloseKey(key);
-        }
-    };
-
-    if (!desktopOnly) {
-        writeCategory(L"Window", WriteWindowSettings, sanitized.window);
-        writeCategory(L"Tabs", WriteTabsSettings, sanitized.tabs);
-        writeCategory(L"Tweaks", WriteTweaksSettings, sanitized.tweaks);
-        writeCategory(L"Tips", WriteTipsSettings, sanitized.tips);
-        writeCategory(L"Misc", WriteMiscSettings, sanitized.misc);
-        writeCategory(L"Skin", WriteSkinSettings, sanitized.skin);
-        writeCategory(L"BBar", WriteBBarSettings, sanitized.bbar);
-        writeCategory(L"Mouse", WriteMouseSettings, sanitized.mouse);
-        writeCategory(L"Keys", WriteKeysSettings, sanitized.keys);
-        writeCategory(L"Plugin", WritePluginSettings, sanitized.plugin);
-        writeCategory(L"Lang", WriteLangSettings, sanitized.lang);
-        writeCategory(L"Desktop", WriteDesktopSettings, sanitized.desktop);
-    } else {
-        writeCategory(L"Desktop", WriteDesktopSettings, sanitized.desktop);
+    ConfigValueSet values = SerializeConfig(sanitized, desktopOnly);
+
+    ConfigWriterState& state = ConfigWriter();
+    std::lock_guard lock(state.mutex);
+    // Only values that differ from the registry are written. The baseline is
+    // read from it as stored rather than taken from the parsed snapshot, which
+    // fills in defaults for missing values and accepts some of the wrong type.
+    // It is read again once the snapshot's generation shows that a process,
+    // this one included, changed the key.
+    std::shared_ptr<const ConfigSnapshot> persisted = GetConfigSnapshot();
+    if (state.writer.BaselineGeneration() != persisted->generation) {
+        ConfigValueSet layout = desktopOnly ? SerializeConfig(sanitized, false) : values;
+        state.writer.SetBaseline(ReadStoredConfigValues(layout), persisted->generation);
     }
-
-    if (root) {
-        RegCloseKey(root);
+    RegistryValueStore store;
+    bool saved = state.writer.Save(values, store);
+    if (!saved || state.writer.Stats().lastWritten > 0) {
+        InvalidateConfigSnapshot();
     }
 }
 
 void UpdateConfigSideEffects(ConfigData& config, bool broadcastChanges) {
     ApplyConfigValidation(config);
+    InvalidateConfigSnapshot();
     hooks::HookManagerNative::Instance().ReloadConfiguration(config);
     if(!broadcastChanges) {
         return;
@@ -1186,5 +1357,19 @@ void UpdateConfigSideEffects(ConfigData& config, bool broadcastChanges) {
                           SMTO_ABORTIFHUNG, 100, nullptr);
 }
 
+std::shared_ptr<const ConfigSnapshot> GetConfigSnapshot() {
+    return ConfigCache().Get();
+}
+
+void InvalidateConfigSnapshot() {
+    ConfigCache().Invalidate();
+}
+
+ConfigWriteStats GetConfigWriteStats() {
+    ConfigWriterState& state = ConfigWriter();
+    std::lock_guard lock(state.mutex);
+    return state.writer.Stats();
+}
+
 }  // namespace qttabbar
 
@@ -1,12 +1,15 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include "ConfigDiffWriter.h"
 #include "ConfigEnums.h"
 #include "ConfigTypes.h"
+#include "SnapshotCache.h"
 
 namespace qttabbar {
 
@@ -199,9 +202,21 @@ struct ConfigData {
     ConfigData();
 };
 
+using ConfigSnapshot = SnapshotCache<ConfigData>::Snapshot;
+
 ConfigData LoadConfigFromRegistry();
 void WriteConfigToRegistry(const ConfigData& config, bool desktopOnly = false);
 void UpdateConfigSideEffects(ConfigData& config, bool broadcastChanges);
 
+// The configuration shared by everything in the process. It is read from the
+// registry again only after the config key changed, whichever process wrote
+// it, so opening a window no longer parses it once per component.
+std::shared_ptr<const ConfigSnapshot> GetConfigSnapshot();
+void InvalidateConfigSnapshot();
+
+// Counts what WriteConfigToRegistry compared and wrote. It writes only the
+// values that changed, so a save after one option changed writes one value.
+ConfigWriteStats GetConfigWriteStats();
+
 }  // namespace qttabbar
 
@@ -0,0 +1,120 @@
+#include "ConfigDiffWriter.h"
+
+#include <algorithm>
+
+namespace {
+
+using qttabbar::ConfigCategoryValues;
+using qttabbar::ConfigValue;
+using qttabbar::ConfigValueSet;
+
+const ConfigCategoryValues* FindCategory(const ConfigValueSet& values, const std::wstring& category) {
+    auto found = std::find_if(values.begin(), values.end(),
+        [&category](const ConfigCategoryValues& entry) { return entry.category == category; });
+    return found != values.end() ? &*found : nullptr;
+}
+
+// Both sides come from the same serializer, so a value is usually at the
+// same position; anything else falls back to a search.
+const ConfigValue* FindValue(const ConfigCategoryValues& category, std::size_t hint, const std::wstring& name) {
+    if(hint < category.values.size() && category.values[hint].first == name) {
+        return &category.values[hint].second;
+    }
+    for(const auto& [valueName, value] : category.values) {
+        if(valueName == name) {
+            return &value;
+        }
+    }
+    return nullptr;
+}
+
+std::size_t CountValues(const ConfigValueSet& values) {
+    std::size_t count = 0;
+    for(const ConfigCategoryValues& category : values) {
+        count += category.values.size();
+    }
+    return count;
+}
+
+} // namespace
+
+namespace qttabbar {
+
+bool operator==(const ConfigValue& left, const ConfigValue& right) {
+    if(left.type != right.type) {
+        return false;
+    }
+    return left.type == ConfigValue::Type::Dword ? left.dword == right.dword : left.string == right.string;
+}
+
+void ConfigCategoryValues::SetDword(const wchar_t* name, std::uint32_t value) {
+    ConfigValue entry;
+    entry.type = ConfigValue::Type::Dword;
+    entry.dword = value;
+    values.emplace_back(name, std::move(entry));
+}
+
+void ConfigCategoryValues::SetString(const wchar_t* name, std::wstring value) {
+    ConfigValue entry;
+    entry.type = ConfigValue::Type::String;
+    entry.string = std::move(value);
+    values.emplace_back(name, std::move(entry));
+}
+
+ConfigValueSet DiffConfigValues(const ConfigValueSet& persisted, const ConfigValueSet& next) {
+    ConfigValueSet changes;
+    for(const ConfigCategoryValues& category : next) {
+        const ConfigCategoryValues* old = FindCategory(persisted, category.category);
+        ConfigCategoryValues* changed = nullptr;
+        for(std::size_t i = 0; i < category.values.size(); ++i) {
+            const auto& [name, value] = category.values[i];
+            const ConfigValue* oldValue = old ? FindValue(*old, i, name) : nullptr;
+            if(oldValue && *oldValue == value) {
+                continue;
+            }
+            if(!changed) {
+                changes.push_back(ConfigCategoryValues{category.category, {}});
+                changed = &changes.back();
+            }
+            changed->values.emplace_back(name, value);
+        }
+    }
+    return changes;
+}
+
+void ConfigDiffWriter::SetBaseline(ConfigValueSet values, std::uint64_t generation) {
+    m_baseline = std::move(values);
+    m_generation = generation;
+}
+
+bool ConfigDiffWriter::Save(const ConfigValueSet& next, IConfigValueStore& store) {
+    ConfigValueSet changes = DiffConfigValues(m_baseline, next);
+    std::size_t written = CountValues(changes);
+    ++m_stats.saves;
+    m_stats.valuesCompared += CountValues(next);
+    m_stats.lastWritten = 0;
+    if(written == 0) {
+        return true;
+    }
+    if(!store.Write(changes)) {
+        m_baseline.clear();
+        m_generation = kNoGeneration;
+        return false;
+    }
+    m_stats.valuesWritten += written;
+    m_stats.lastWritten = written;
+
+    // Later saves compare against what was just written.
+    for(const ConfigCategoryValues& category : next) {
+        auto found = std::find_if(m_baseline.begin(), m_baseline.end(),
+            [&category](const ConfigCategoryValues& entry) { return entry.category == category.category; });
+        if(found != m_baseline.end()) {
+            *found = category;
+        } else {
+            m_baseline.push_back(category);
+        }
+    }
+    return true;
+}
+
+} // namespace qttabbar
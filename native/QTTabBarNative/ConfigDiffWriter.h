@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace qttabbar {
+
+// One stored configuration value, as WriteConfigToRegistry lays it out:
+// flags and numbers as DWORDs, everything else as strings (mostly JSON).
+struct ConfigValue {
+    enum class Type : std::uint8_t {
+        Dword,
+        String,
+    };
+
+    Type type = Type::Dword;
+    std::uint32_t dword = 0;
+    std::wstring string;
+};
+
+bool operator==(const ConfigValue& left, const ConfigValue& right);
+inline bool operator!=(const ConfigValue& left, const ConfigValue& right) { return !(left == right); }
+
+// The values of one category (registry subkey), in the order they were set.
+struct ConfigCategoryValues {
+    std::wstring category;
+    std::vector<std::pair<std::wstring, ConfigValue>> values;
+
+    void SetDword(const wchar_t* name, std::uint32_t value);
+    void SetString(const wchar_t* name, std::wstring value);
+};
+
+using ConfigValueSet = std::vector<ConfigCategoryValues>;
+
+// The values of `next` that `persisted` lacks or holds differently, grouped
+// by category. Categories without changes are left out.
+ConfigValueSet DiffConfigValues(const ConfigValueSet& persisted, const ConfigValueSet& next);
+
+// Where saved values end up.
+class IConfigValueStore {
+public:
+    virtual ~IConfigValueStore() = default;
+    // Writes every value in `changes`, all or nothing where the store can
+    // manage it. False if any could not be written.
+    virtual bool Write(const ConfigValueSet& changes) = 0;
+};
+
+struct ConfigWriteStats {
+    std::uint64_t saves = 0;
+    std::uint64_t valuesCompared = 0;
+    std::uint64_t valuesWritten = 0;
+    // Values written by the most recent save.
+    std::size_t lastWritten = 0;
+};
+
+// Saves configurations by writing only what differs from the baseline, the
+// values the store is known to hold. Without a baseline everything is
+// written. Not thread-safe.
+class ConfigDiffWriter {
+public:
+    static constexpr std::uint64_t kNoGeneration = UINT64_MAX;
+
+    // `generation` tags where the baseline came from, so the caller can tell
+    // when it has to be replaced.
+    void SetBaseline(ConfigValueSet values, std::uint64_t generation);
+    std::uint64_t BaselineGeneration() const noexcept { return m_generation; }
+
+    // Writes the changed values of `next`, which may cover only some
+    // categories. On success they become part of the baseline; on failure
+    // the baseline is dropped, as the store may hold some of them.
+    bool Save(const ConfigValueSet& next, IConfigValueStore& store);
+
+    const ConfigWriteStats& Stats() const noexcept { return m_stats; }
+
+private:
+    ConfigValueSet m_baseline;
+    std::uint64_t m_generation = kNoGeneration;
+    ConfigWriteStats m_stats;
+};
+
+} // namespace qttabbar
@@ -0,0 +1,299 @@
+#include "DirectoryEnumerator.h"
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <unordered_set>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "NaturalSort.h"
+
+namespace {
+
+#if defined(_WIN32)
+std::int64_t ToTicks(const FILETIME& time) {
+    return static_cast<std::int64_t>((static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime);
+}
+#else
+std::int64_t ToTicks(const struct timespec& time) {
+    constexpr std::int64_t kUnixEpochTicks = 116444736000000000LL;
+    return kUnixEpochTicks + static_cast<std::int64_t>(time.tv_sec) * 10000000LL + time.tv_nsec / 100;
+}
+#endif
+
+std::wstring JoinPath(const std::wstring& directory, const std::wstring& name) {
+    std::wstring result = directory;
+    if(!result.empty() && result.back() != L'\\' && result.back() != L'/') {
+#if defined(_WIN32)
+        result.push_back(L'\\');
+#else
+        result.push_back(L'/');
+#endif
+    }
+    result += name;
+    return result;
+}
+
+} // namespace
+
+namespace qttabbar {
+
+bool EnumerateDirectory(const std::wstring& path, const DirectoryEntryFilter& filter, const DirectoryEntrySink& sink) {
+#if defined(_WIN32)
+    WIN32_FIND_DATAW data{};
+    HANDLE find = ::FindFirstFileExW(JoinPath(path, L"*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                     FIND_FIRST_EX_LARGE_FETCH);
+    if(find == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    bool completed = true;
+    do {
+        if(wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0) {
+            continue;
+        }
+        DirectoryEntry entry;
+        entry.name = data.cFileName;
+        entry.path = JoinPath(path, entry.name);
+        entry.isDirectory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        entry.modified = ToTicks(data.ftLastWriteTime);
+        if(filter && !filter(entry)) {
+            continue;
+        }
+        if(!sink(std::move(entry))) {
+            completed = false;
+            break;
+        }
+    } while(::FindNextFileW(find, &data));
+    ::FindClose(find);
+    return completed;
+#else
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::directory_iterator it(fs::path(path), fs::directory_options::skip_permission_denied, ec);
+    if(ec) {
+        return false;
+    }
+    for(; it != fs::directory_iterator(); it.increment(ec)) {
+        if(ec) {
+            return false;
+        }
+        DirectoryEntry entry;
+        try {
+            entry.name = it->path().filename().wstring();
+            entry.path = JoinPath(path, entry.name);
+        } catch(const std::exception&) {
+            // Names that do not convert to the wide encoding cannot be shown anyway.
+            continue;
+        }
+        struct stat info {};
+        if(::stat(it->path().c_str(), &info) == 0) {
+            entry.isDirectory = S_ISDIR(info.st_mode);
+            entry.modified = ToTicks(info.st_mtim);
+        }
+        if(filter && !filter(entry)) {
+            continue;
+        }
+        if(!sink(std::move(entry))) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+std::optional<std::int64_t> ReadDirectoryStamp(const std::wstring& path) {
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA data{};
+    if(!::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data) ||
+       (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        return std::nullopt;
+    }
+    return ToTicks(data.ftLastWriteTime);
+#else
+    struct stat info {};
+    if(::stat(std::filesystem::path(path).c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+        return std::nullopt;
+    }
+    return ToTicks(info.st_mtim);
+#endif
+}
+
+std::optional<std::int64_t> ReadFileStamp(const std::wstring& path) {
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA data{};
+    if(!::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data) ||
+       (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+        return std::nullopt;
+    }
+    return ToTicks(data.ftLastWriteTime);
+#else
+    struct stat info {};
+    if(::stat(std::filesystem::path(path).c_str(), &info) != 0 || S_ISDIR(info.st_mode)) {
+        return std::nullopt;
+    }
+    return ToTicks(info.st_mtim);
+#endif
+}
+
+void SortDirectoryEntries(std::vector<DirectoryEntry>& entries) {
+    NaturalSortKeys keys;
+    std::size_t totalChars = 0;
+    for(const auto& entry : entries) {
+        totalChars += entry.name.size();
+    }
+    keys.Reserve(entries.size(), totalChars);
+    for(const auto& entry : entries) {
+        keys.Add(entry.name, entry.isDirectory ? 0 : 1);
+    }
+    std::vector<DirectoryEntry> sorted;
+    sorted.reserve(entries.size());
+    for(std::size_t index : keys.SortedOrder()) {
+        sorted.push_back(std::move(entries[index]));
+    }
+    entries.swap(sorted);
+}
+
+std::vector<std::size_t> MapEntryPositions(const std::vector<DirectoryEntry>& from,
+                                           const std::vector<std::size_t>& positions,
+                                           const std::vector<DirectoryEntry>& to) {
+    std::vector<std::size_t> mapped;
+    if(positions.empty()) {
+        return mapped;
+    }
+    std::unordered_set<std::wstring> paths;
+    paths.reserve(positions.size());
+    for(std::size_t position : positions) {
+        if(position < from.size()) {
+            paths.insert(from[position].path);
+        }
+    }
+    for(std::size_t index = 0; index < to.size() && mapped.size() < paths.size(); ++index) {
+        if(paths.count(to[index].path) != 0) {
+            mapped.push_back(index);
+        }
+    }
+    return mapped;
+}
+
+AsyncDirectoryEnumerator::AsyncDirectoryEnumerator()
+    : AsyncDirectoryEnumerator(Options{}) {
+}
+
+AsyncDirectoryEnumerator::AsyncDirectoryEnumerator(Options options)
+    : m_options(options) {
+    m_options.batchSize = std::max<std::size_t>(m_options.batchSize, 1);
+}
+
+AsyncDirectoryEnumerator::~AsyncDirectoryEnumerator() {
+    Cancel();
+    WaitIdle();
+    if(m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+std::uint64_t AsyncDirectoryEnumerator::Start(std::wstring path, DirectoryEntryFilter filter, NotifyFn notify) {
+    std::lock_guard guard(m_mutex);
+    std::uint64_t generation = m_generation.fetch_add(1, std::memory_order_acq_rel) + 1;
+    m_pending.clear();
+    m_updates.clear();
+    m_pending.push_back({generation, std::move(path), std::move(filter), std::move(notify)});
+    if(!m_running) {
+        if(m_worker.joinable()) {
+            m_worker.join();
+        }
+        m_running = true;
+        m_worker = std::thread(&AsyncDirectoryEnumerator::Run, this);
+    }
+    return generation;
+}
+
+void AsyncDirectoryEnumerator::Cancel() {
+    std::lock_guard guard(m_mutex);
+    m_generation.fetch_add(1, std::memory_order_acq_rel);
+    m_pending.clear();
+    m_updates.clear();
+}
+
+std::vector<AsyncDirectoryEnumerator::Update> AsyncDirectoryEnumerator::TakeUpdates() {
+    std::lock_guard guard(m_mutex);
+    std::vector<Update> updates;
+    updates.swap(m_updates);
+    std::uint64_t current = CurrentGeneration();
+    updates.erase(std::remove_if(updates.begin(), updates.end(),
+                                 [current](const Update& update) { return update.generation != current; }),
+                  updates.end());
+    return updates;
+}
+
+void AsyncDirectoryEnumerator::WaitIdle() {
+    std::unique_lock lock(m_mutex);
+    m_idle.wait(lock, [this] { return !m_running; });
+}
+
+void AsyncDirectoryEnumerator::Run() {
+    std::unique_lock lock(m_mutex);
+    while(!m_pending.empty()) {
+        Request request = std::move(m_pending.front());
+        m_pending.erase(m_pending.begin());
+        lock.unlock();
+        Execute(request);
+        lock.lock();
+    }
+    m_running = false;
+    m_idle.notify_all();
+}
+
+void AsyncDirectoryEnumerator::Execute(Request& request) {
+    auto cancelled = [&] { return m_generation.load(std::memory_order_acquire) != request.generation; };
+    std::optional<std::int64_t> stamp = ReadDirectoryStamp(request.path);
+    std::vector<DirectoryEntry> listing;
+    std::size_t published = 0;
+    bool ok = EnumerateDirectory(request.path, request.filter, [&](DirectoryEntry&& entry) {
+        if(cancelled()) {
+            return false;
+        }
+        listing.push_back(std::move(entry));
+        if(listing.size() - published >= m_options.batchSize) {
+            Update batch;
+            batch.generation = request.generation;
+            batch.entries.assign(listing.begin() + static_cast<std::ptrdiff_t>(published), listing.end());
+            published = listing.size();
+            return Publish(request, std::move(batch));
+        }
+        return true;
+    });
+    if(cancelled()) {
+        return;
+    }
+    SortDirectoryEntries(listing);
+    Update final;
+    final.generation = request.generation;
+    final.entries = std::move(listing);
+    final.stamp = stamp;
+    final.complete = true;
+    final.failed = !ok;
+    Publish(request, std::move(final));
+}
+
+bool AsyncDirectoryEnumerator::Publish(const Request& request, Update update) {
+    {
+        std::lock_guard guard(m_mutex);
+        if(m_generation.load(std::memory_order_acquire) != request.generation) {
+            return false;
+        }
+        m_updates.push_back(std::move(update));
+    }
+    if(request.notify) {
+        request.notify();
+    }
+    return true;
+}
+
+} // namespace qttabbar
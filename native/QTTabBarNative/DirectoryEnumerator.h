@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace qttabbar {
+
+struct DirectoryEntry {
+    std::wstring name;
+    std::wstring path;
+    bool isDirectory = false;
+    // Last write time in FILETIME units (100 ns since 1601-01-01 UTC); 0 when unknown.
+    std::int64_t modified = 0;
+};
+
+using DirectoryEntryFilter = std::function<bool(const DirectoryEntry&)>;
+// Receives each accepted entry; returning false stops the enumeration.
+using DirectoryEntrySink = std::function<bool(DirectoryEntry&&)>;
+
+// Reads name, type and last write time of every child in a single pass, without
+// a separate metadata call per entry on Windows. Returns false if the directory
+// could not be opened or the sink stopped the walk.
+bool EnumerateDirectory(const std::wstring& path, const DirectoryEntryFilter& filter, const DirectoryEntrySink& sink);
+
+// Last write time of the directory itself, in DirectoryEntry::modified units.
+// Creating, deleting or renaming a child updates it, which makes it a cheap
+// validator for a previously read listing.
+std::optional<std::int64_t> ReadDirectoryStamp(const std::wstring& path);
+// Last write time of a regular file, in the same units; used to validate
+// data derived from the file's contents.
+std::optional<std::int64_t> ReadFileStamp(const std::wstring& path);
+
+// Folders first, then names in natural order (see NaturalSortKeys).
+void SortDirectoryEntries(std::vector<DirectoryEntry>& entries);
+
+// Positions in `to` of the entries at `positions` in `from`, matched by path and
+// in ascending order; entries missing from `to` are dropped. Carries a list
+// view selection across a listing being replaced, e.g. by its sorted form.
+std::vector<std::size_t> MapEntryPositions(const std::vector<DirectoryEntry>& from,
+                                           const std::vector<std::size_t>& positions,
+                                           const std::vector<DirectoryEntry>& to);
+
+// Enumerates one directory at a time on a worker thread. Starting a new request
+// cancels the previous one; results of a superseded request are never delivered.
+// While the walk runs, unsorted batches are published; the final update carries
+// the whole sorted listing and replaces whatever was shown before.
+class AsyncDirectoryEnumerator {
+public:
+    struct Options {
+        std::size_t batchSize = 256;
+    };
+
+    struct Update {
+        std::uint64_t generation = 0;
+        std::vector<DirectoryEntry> entries;
+        // Directory stamp read before the walk; set on the final update only.
+        std::optional<std::int64_t> stamp;
+        bool complete = false;
+        bool failed = false;
+    };
+
+    // Invoked on the worker thread whenever updates are ready; it is expected to
+    // wake the owner (e.g. PostMessage) which then calls TakeUpdates.
+    using NotifyFn = std::function<void()>;
+
+    AsyncDirectoryEnumerator();
+    explicit AsyncDirectoryEnumerator(Options options);
+    ~AsyncDirectoryEnumerator();
+
+    AsyncDirectoryEnumerator(const AsyncDirectoryEnumerator&) = delete;
+    AsyncDirectoryEnumerator& operator=(const AsyncDirectoryEnumerator&) = delete;
+
+    std::uint64_t Start(std::wstring path, DirectoryEntryFilter filter, NotifyFn notify);
+    void Cancel();
+    std::uint64_t CurrentGeneration() const noexcept { return m_generation.load(std::memory_order_acquire); }
+    // Returns pending updates of the current request in arrival order.
+    std::vector<Update> TakeUpdates();
+    // Blocks until the worker has nothing left to do.
+    void WaitIdle();
+
+private:
+    struct Request {
+        std::uint64_t generation = 0;
+        std::wstring path;
+        DirectoryEntryFilter filter;
+        NotifyFn notify;
+    };
+
+    void Run();
+    void Execute(Request& request);
+    bool Publish(const Request& request, Update update);
+
+    Options m_options;
+    std::atomic<std::uint64_t> m_generation{0};
+    mutable std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::vector<Request> m_pending;
+    std::vector<Update> m_updates;
+    std::thread m_worker;
+    bool m_running = false;
+};
+
+} // namespace qttabbar
@@ -0,0 +1,137 @@
+#include "DirectoryListingCache.h"
+
+#include <utility>
+
+#include "TabPathIndex.h"
+
+namespace qttabbar {
+
+DirectoryListingCache::DirectoryListingCache()
+    : DirectoryListingCache(Limits{}) {
+}
+
+DirectoryListingCache::DirectoryListingCache(Limits limits, StampFn stamp, NowFn now)
+    : m_limits(limits)
+    , m_stamp(std::move(stamp))
+    , m_now(std::move(now)) {
+}
+
+DirectoryListingCache::Listing DirectoryListingCache::Lookup(const std::wstring& path) {
+    std::wstring key = MakeKey(path);
+    TimePoint now = m_now();
+    {
+        std::lock_guard guard(m_mutex);
+        auto found = m_slots.find(key);
+        if(found == m_slots.end()) {
+            ++m_stats.misses;
+            return nullptr;
+        }
+        if(now - found->second->stored > m_limits.maxAge) {
+            // Children edited in place leave the directory stamp alone.
+            ++m_stats.stale;
+            ++m_stats.misses;
+            EraseLocked(found->second);
+            return nullptr;
+        }
+    }
+    // Stat the directory without holding the lock; it may sit on a slow share.
+    std::optional<std::int64_t> current = m_stamp(path);
+
+    std::lock_guard guard(m_mutex);
+    auto found = m_slots.find(key);
+    if(found == m_slots.end()) {
+        ++m_stats.misses;
+        return nullptr;
+    }
+    if(!current || *current != found->second->stamp) {
+        ++m_stats.stale;
+        ++m_stats.misses;
+        EraseLocked(found->second);
+        return nullptr;
+    }
+    ++m_stats.hits;
+    m_lru.splice(m_lru.begin(), m_lru, found->second);
+    return found->second->listing;
+}
+
+void DirectoryListingCache::Store(const std::wstring& path, std::int64_t stamp, std::vector<DirectoryEntry> listing) {
+    Slot slot;
+    slot.key = MakeKey(path);
+    slot.stamp = stamp;
+    slot.stored = m_now();
+    slot.bytes = EstimateBytes(listing);
+    std::size_t count = listing.size();
+    if(count > m_limits.maxEntries || slot.bytes > m_limits.maxBytes) {
+        // Never worth evicting everything else for a single oversized folder.
+        Invalidate(path);
+        return;
+    }
+    slot.listing = std::make_shared<const std::vector<DirectoryEntry>>(std::move(listing));
+
+    std::lock_guard guard(m_mutex);
+    auto found = m_slots.find(slot.key);
+    if(found != m_slots.end()) {
+        EraseLocked(found->second);
+    }
+    m_stats.entries += count;
+    m_stats.bytes += slot.bytes;
+    m_lru.push_front(std::move(slot));
+    m_slots.emplace(m_lru.front().key, m_lru.begin());
+    m_stats.listings = m_lru.size();
+    TrimLocked();
+}
+
+void DirectoryListingCache::Invalidate(const std::wstring& path) {
+    std::lock_guard guard(m_mutex);
+    auto found = m_slots.find(MakeKey(path));
+    if(found != m_slots.end()) {
+        EraseLocked(found->second);
+    }
+}
+
+void DirectoryListingCache::Clear() {
+    std::lock_guard guard(m_mutex);
+    m_slots.clear();
+    m_lru.clear();
+    m_stats.listings = 0;
+    m_stats.entries = 0;
+    m_stats.bytes = 0;
+}
+
+DirectoryListingCache::Stats DirectoryListingCache::GetStats() const {
+    std::lock_guard guard(m_mutex);
+    return m_stats;
+}
+
+std::size_t DirectoryListingCache::EstimateBytes(const std::vector<DirectoryEntry>& listing) {
+    std::size_t bytes = sizeof(std::vector<DirectoryEntry>) + listing.capacity() * sizeof(DirectoryEntry);
+    for(const auto& entry : listing) {
+        bytes += (entry.name.capacity() + entry.path.capacity()) * sizeof(wchar_t);
+    }
+    return bytes;
+}
+
+std::wstring DirectoryListingCache::MakeKey(const std::wstring& path) {
+#if defined(_WIN32)
+    return TabPathIndex::Fold(path);
+#else
+    return path;
+#endif
+}
+
+void DirectoryListingCache::EraseLocked(SlotList::iterator it) {
+    m_stats.entries -= it->listing ? it->listing->size() : 0;
+    m_stats.bytes -= it->bytes;
+    m_slots.erase(it->key);
+    m_lru.erase(it);
+    m_stats.listings = m_lru.size();
+}
+
+void DirectoryListingCache::TrimLocked() {
+    while(!m_lru.empty() && (m_stats.entries > m_limits.maxEntries || m_stats.bytes > m_limits.maxBytes)) {
+        EraseLocked(std::prev(m_lru.end()));
+        ++m_stats.evictions;
+    }
+}
+
+} // namespace qttabbar
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DirectoryEnumerator.h"
+
+namespace qttabbar {
+
+// LRU cache of sorted directory listings keyed by path. An entry is served only
+// while the directory's last write time still matches the stamp recorded before
+// it was enumerated; adding, removing or renaming a child changes that stamp.
+// Editing a child in place does not, so an entry is also dropped once it is
+// older than Limits::maxAge, which bounds how stale a "Modified" column can be.
+// The cache is bounded both by the total number of listed entries and by an
+// estimate of the memory they hold.
+class DirectoryListingCache {
+public:
+    using Listing = std::shared_ptr<const std::vector<DirectoryEntry>>;
+    using StampFn = std::function<std::optional<std::int64_t>(const std::wstring&)>;
+    using TimePoint = std::chrono::steady_clock::time_point;
+    using NowFn = std::function<TimePoint()>;
+
+    struct Limits {
+        std::size_t maxEntries = 100000;
+        std::size_t maxBytes = 32u * 1024u * 1024u;
+        std::chrono::milliseconds maxAge{5000};
+    };
+
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t stale = 0;
+        std::uint64_t evictions = 0;
+        std::size_t listings = 0;
+        std::size_t entries = 0;
+        std::size_t bytes = 0;
+    };
+
+    DirectoryListingCache();
+    explicit DirectoryListingCache(Limits limits, StampFn stamp = ReadDirectoryStamp,
+                                   NowFn now = std::chrono::steady_clock::now);
+
+    // Returns the cached listing if the directory has not changed since it was
+    // stored and the listing is not older than maxAge.
+    Listing Lookup(const std::wstring& path);
+    // `stamp` must have been read before the enumeration that produced `listing`,
+    // so a change made while it ran invalidates the entry on the next lookup.
+    void Store(const std::wstring& path, std::int64_t stamp, std::vector<DirectoryEntry> listing);
+    void Invalidate(const std::wstring& path);
+    void Clear();
+    Stats GetStats() const;
+
+    static std::size_t EstimateBytes(const std::vector<DirectoryEntry>& listing);
+
+private:
+    struct Slot {
+        std::wstring key;
+        std::int64_t stamp = 0;
+        TimePoint stored{};
+        Listing listing;
+        std::size_t bytes = 0;
+    };
+    using SlotList = std::list<Slot>;
+
+    static std::wstring MakeKey(const std::wstring& path);
+    void EraseLocked(SlotList::iterator it);
+    void TrimLocked();
+
+    Limits m_limits;
+    StampFn m_stamp;
+    NowFn m_now;
+    mutable std::mutex m_mutex;
+    SlotList m_lru;
+    std::unordered_map<std::wstring, SlotList::iterator> m_slots;
+    Stats m_stats{};
+};
+
+} // namespace qttabbar
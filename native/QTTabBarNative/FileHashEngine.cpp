@@ -0,0 +1,225 @@
+#include "FileHashEngine.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Minimal sequential reader; the OS read-ahead keeps the next chunk in flight
+// while the current one is being hashed.
+class SequentialFile {
+public:
+    explicit SequentialFile(const std::wstring& path) {
+#if defined(_WIN32)
+        m_handle = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                 FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if(m_handle == INVALID_HANDLE_VALUE) {
+            m_error = ::GetLastError();
+        }
+#else
+        m_fd = ::open(std::filesystem::path(path).c_str(), O_RDONLY | O_CLOEXEC);
+        if(m_fd < 0) {
+            m_error = static_cast<std::uint32_t>(errno);
+        } else {
+            ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    ~SequentialFile() {
+#if defined(_WIN32)
+        if(m_handle != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(m_handle);
+        }
+#else
+        if(m_fd >= 0) {
+            ::close(m_fd);
+        }
+#endif
+    }
+
+    SequentialFile(const SequentialFile&) = delete;
+    SequentialFile& operator=(const SequentialFile&) = delete;
+
+    bool IsOpen() const noexcept { return m_error == 0; }
+    std::uint32_t Error() const noexcept { return m_error; }
+
+    // Returns the number of bytes read, 0 at end of file, or -1 on error.
+    std::int64_t Read(std::uint8_t* buffer, std::size_t size) {
+#if defined(_WIN32)
+        DWORD read = 0;
+        if(!::ReadFile(m_handle, buffer, static_cast<DWORD>(size), &read, nullptr)) {
+            m_error = ::GetLastError();
+            return -1;
+        }
+        return read;
+#else
+        for(;;) {
+            ssize_t read = ::read(m_fd, buffer, size);
+            if(read >= 0) {
+                return read;
+            }
+            if(errno != EINTR) {
+                m_error = static_cast<std::uint32_t>(errno);
+                return -1;
+            }
+        }
+#endif
+    }
+
+private:
+#if defined(_WIN32)
+    HANDLE m_handle = INVALID_HANDLE_VALUE;
+#else
+    int m_fd = -1;
+#endif
+    std::uint32_t m_error = 0;
+};
+
+std::size_t DigestSlot(qttabbar::HashAlgorithm algorithm) {
+    const auto& all = qttabbar::kAllHashAlgorithms;
+    return static_cast<std::size_t>(std::find(all.begin(), all.end(), algorithm) - all.begin());
+}
+
+} // namespace
+
+namespace qttabbar {
+
+const std::wstring& FileHashResult::Digest(HashAlgorithm algorithm) const {
+    return digests[DigestSlot(algorithm)];
+}
+
+FileHashProgress::Snapshot FileHashProgress::Get() const noexcept {
+    Snapshot snapshot;
+    snapshot.bytesDone = m_bytesDone.load(std::memory_order_relaxed);
+    snapshot.bytesTotal = m_bytesTotal.load(std::memory_order_relaxed);
+    snapshot.filesDone = m_filesDone.load(std::memory_order_relaxed);
+    snapshot.filesTotal = m_filesTotal.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+std::vector<FileHashResult> HashFiles(const std::vector<std::wstring>& paths, const FileHashOptions& options,
+                                      const std::atomic<bool>* cancel, FileHashProgress* progress) {
+    std::vector<FileHashResult> results(paths.size());
+    if(paths.empty()) {
+        return results;
+    }
+    if(progress != nullptr) {
+        std::uint64_t total = 0;
+        for(const auto& path : paths) {
+            std::error_code ec;
+            auto size = std::filesystem::file_size(std::filesystem::path(path), ec);
+            total += ec ? 0 : size;
+        }
+        progress->m_bytesTotal.store(total, std::memory_order_relaxed);
+        progress->m_filesTotal.store(paths.size(), std::memory_order_relaxed);
+    }
+
+    auto isCancelled = [cancel] { return cancel != nullptr && cancel->load(std::memory_order_relaxed); };
+    std::size_t chunkSize = std::max<std::size_t>(options.chunkSize, 64 * 1024);
+    std::atomic<std::size_t> next{0};
+
+    auto worker = [&] {
+        std::unique_ptr<std::uint8_t[]> buffer(new std::uint8_t[chunkSize]);
+        for(;;) {
+            std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+            if(index >= paths.size()) {
+                return;
+            }
+            FileHashResult& result = results[index];
+            result.path = paths[index];
+            if(isCancelled()) {
+                result.cancelled = true;
+                continue;
+            }
+
+            SequentialFile file(paths[index]);
+            if(!file.IsOpen()) {
+                result.error = file.Error();
+            } else {
+                MultiHasher hasher(options.algorithms);
+                bool failed = false;
+                for(;;) {
+                    if(isCancelled()) {
+                        result.cancelled = true;
+                        break;
+                    }
+                    std::int64_t read = file.Read(buffer.get(), chunkSize);
+                    if(read < 0) {
+                        result.error = file.Error();
+                        failed = true;
+                        break;
+                    }
+                    if(read == 0) {
+                        break;
+                    }
+                    hasher.Update(buffer.get(), static_cast<std::size_t>(read));
+                    result.bytes += static_cast<std::uint64_t>(read);
+                    if(progress != nullptr) {
+                        progress->m_bytesDone.fetch_add(static_cast<std::uint64_t>(read), std::memory_order_relaxed);
+                    }
+                }
+                if(!failed && !result.cancelled) {
+                    hasher.Finish();
+                    for(HashAlgorithm algorithm : kAllHashAlgorithms) {
+                        if(HasAlgorithm(options.algorithms, algorithm)) {
+                            result.digests[DigestSlot(algorithm)] = hasher.Digest(algorithm);
+                        }
+                    }
+                    result.ok = true;
+                }
+            }
+            if(progress != nullptr) {
+                progress->m_filesDone.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    unsigned threads = options.threads;
+    if(threads == 0) {
+        threads = std::min(std::max(1u, std::thread::hardware_concurrency()), 4u);
+    }
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, paths.size()));
+    std::vector<std::thread> pool;
+    for(unsigned i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for(auto& thread : pool) {
+        thread.join();
+    }
+    return results;
+}
+
+FileHashJob::FileHashJob(std::vector<std::wstring> paths, FileHashOptions options) {
+    m_thread = std::thread([this, paths = std::move(paths), options]() {
+        m_results = HashFiles(paths, options, &m_cancel, &m_progress);
+        m_done.store(true, std::memory_order_release);
+    });
+}
+
+FileHashJob::~FileHashJob() {
+    Cancel();
+    if(m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+std::vector<FileHashResult> FileHashJob::Wait() {
+    if(m_thread.joinable()) {
+        m_thread.join();
+    }
+    return std::move(m_results);
+}
+
+} // namespace qttabbar
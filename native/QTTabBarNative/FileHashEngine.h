@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HashAlgorithms.h"
+
+namespace qttabbar {
+
+struct FileHashOptions {
+    HashAlgorithmMask algorithms = static_cast<HashAlgorithmMask>(HashAlgorithm::Md5);
+    // Number of files hashed at once; 0 picks min(cores, 4) since disks rarely
+    // keep up with more concurrent sequential readers.
+    unsigned threads = 0;
+    std::size_t chunkSize = 1u << 20;
+};
+
+class FileHashProgress;
+
+struct FileHashResult {
+    std::wstring path;
+    bool ok = false;
+    bool cancelled = false;
+    std::uint64_t bytes = 0;
+    // Platform error code of the failed open/read; 0 on success.
+    std::uint32_t error = 0;
+    std::array<std::wstring, kAllHashAlgorithms.size()> digests;
+
+    const std::wstring& Digest(HashAlgorithm algorithm) const;
+};
+
+// Hashes every file with all selected algorithms in a single pass over its data,
+// several files at a time. Results keep the order of `paths`. Setting `cancel`
+// stops all workers at the next chunk boundary.
+std::vector<FileHashResult> HashFiles(const std::vector<std::wstring>& paths, const FileHashOptions& options,
+                                      const std::atomic<bool>* cancel = nullptr, FileHashProgress* progress = nullptr);
+
+class FileHashProgress {
+public:
+    struct Snapshot {
+        std::uint64_t bytesDone = 0;
+        std::uint64_t bytesTotal = 0;
+        std::size_t filesDone = 0;
+        std::size_t filesTotal = 0;
+    };
+
+    Snapshot Get() const noexcept;
+
+private:
+    friend std::vector<FileHashResult> HashFiles(const std::vector<std::wstring>&, const FileHashOptions&,
+                                                 const std::atomic<bool>*, FileHashProgress*);
+
+    std::atomic<std::uint64_t> m_bytesDone{0};
+    std::atomic<std::uint64_t> m_bytesTotal{0};
+    std::atomic<std::size_t> m_filesDone{0};
+    std::atomic<std::size_t> m_filesTotal{0};
+};
+
+// Runs HashFiles on a background thread so a UI can poll progress and cancel.
+class FileHashJob {
+public:
+    FileHashJob(std::vector<std::wstring> paths, FileHashOptions options);
+    ~FileHashJob();
+
+    FileHashJob(const FileHashJob&) = delete;
+    FileHashJob& operator=(const FileHashJob&) = delete;
+
+    void Cancel() noexcept { m_cancel.store(true, std::memory_order_relaxed); }
+    bool IsCancelled() const noexcept { return m_cancel.load(std::memory_order_relaxed); }
+    bool IsDone() const noexcept { return m_done.load(std::memory_order_acquire); }
+    FileHashProgress::Snapshot GetProgress() const noexcept { return m_progress.Get(); }
+    // Blocks until the job finishes and hands over its results.
+    std::vector<FileHashResult> Wait();
+
+private:
+    std::atomic<bool> m_cancel{false};
+    std::atomic<bool> m_done{false};
+    FileHashProgress m_progress;
+    std::vector<FileHashResult> m_results;
+    std::thread m_thread;
+};
+
+} // namespace qttabbar
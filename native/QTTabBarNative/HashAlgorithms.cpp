@@ -0,0 +1,516 @@
+#include "HashAlgorithms.h"
+
+#include <cstring>
+
+namespace {
+
+inline std::uint32_t Rotl32(std::uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+inline std::uint32_t Rotr32(std::uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+inline std::uint64_t Rotl64(std::uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline std::uint32_t LoadLe32(const std::uint8_t* in) {
+    return static_cast<std::uint32_t>(in[0]) | (static_cast<std::uint32_t>(in[1]) << 8) |
+           (static_cast<std::uint32_t>(in[2]) << 16) | (static_cast<std::uint32_t>(in[3]) << 24);
+}
+
+inline std::uint64_t LoadLe64(const std::uint8_t* in) {
+    return static_cast<std::uint64_t>(LoadLe32(in)) | (static_cast<std::uint64_t>(LoadLe32(in + 4)) << 32);
+}
+
+inline std::uint32_t LoadBe32(const std::uint8_t* in) {
+    return (static_cast<std::uint32_t>(in[0]) << 24) | (static_cast<std::uint32_t>(in[1]) << 16) |
+           (static_cast<std::uint32_t>(in[2]) << 8) | static_cast<std::uint32_t>(in[3]);
+}
+
+inline void StoreBe32(std::uint8_t* out, std::uint32_t value) {
+    out[0] = static_cast<std::uint8_t>(value >> 24);
+    out[1] = static_cast<std::uint8_t>(value >> 16);
+    out[2] = static_cast<std::uint8_t>(value >> 8);
+    out[3] = static_cast<std::uint8_t>(value);
+}
+
+inline void StoreLe32(std::uint8_t* out, std::uint32_t value) {
+    out[0] = static_cast<std::uint8_t>(value);
+    out[1] = static_cast<std::uint8_t>(value >> 8);
+    out[2] = static_cast<std::uint8_t>(value >> 16);
+    out[3] = static_cast<std::uint8_t>(value >> 24);
+}
+
+// Shared Merkle-Damgard block buffering for the 64-byte-block digests.
+template <typename Transform>
+void BufferBlocks(std::array<std::uint8_t, 64>& buffer, std::uint64_t& length, const std::uint8_t* data,
+                  std::size_t size, Transform&& transform) {
+    std::size_t used = static_cast<std::size_t>(length % 64);
+    length += size;
+    if(used != 0) {
+        std::size_t take = std::min<std::size_t>(64 - used, size);
+        std::memcpy(buffer.data() + used, data, take);
+        data += take;
+        size -= take;
+        if(used + take < 64) {
+            return;
+        }
+        transform(buffer.data());
+    }
+    while(size >= 64) {
+        transform(data);
+        data += 64;
+        size -= 64;
+    }
+    if(size != 0) {
+        std::memcpy(buffer.data(), data, size);
+    }
+}
+
+// Appends 0x80, zero padding and the 64-bit bit length (byte order chosen by the caller).
+template <typename Update>
+void PadMessage(std::uint64_t length, bool bigEndianLength, Update&& update) {
+    std::uint8_t padding[72] = {0x80};
+    std::size_t used = static_cast<std::size_t>(length % 64);
+    std::size_t padLength = used < 56 ? 56 - used : 120 - used;
+    std::uint64_t bits = length * 8;
+    for(int i = 0; i < 8; ++i) {
+        int shift = bigEndianLength ? 56 - i * 8 : i * 8;
+        padding[padLength + i] = static_cast<std::uint8_t>(bits >> shift);
+    }
+    update(padding, padLength + 8);
+}
+
+struct Crc32Tables {
+    std::uint32_t table[8][256];
+
+    Crc32Tables() {
+        for(std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t crc = i;
+            for(int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+            }
+            table[0][i] = crc;
+        }
+        for(std::uint32_t i = 0; i < 256; ++i) {
+            for(int slice = 1; slice < 8; ++slice) {
+                table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const Crc32Tables& GetCrc32Tables() {
+    static const Crc32Tables tables;
+    return tables;
+}
+
+constexpr std::uint64_t kXxPrime1 = 0x9E3779B185EBCA87ull;
+constexpr std::uint64_t kXxPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr std::uint64_t kXxPrime3 = 0x165667B19E3779F9ull;
+constexpr std::uint64_t kXxPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr std::uint64_t kXxPrime5 = 0x27D4EB2F165667C5ull;
+
+inline std::uint64_t XxRound(std::uint64_t acc, std::uint64_t input) {
+    acc += input * kXxPrime2;
+    acc = Rotl64(acc, 31);
+    return acc * kXxPrime1;
+}
+
+inline std::uint64_t XxMerge(std::uint64_t acc, std::uint64_t lane) {
+    acc ^= XxRound(0, lane);
+    return acc * kXxPrime1 + kXxPrime4;
+}
+
+template <std::size_t N>
+std::wstring ToHex(const std::array<std::uint8_t, N>& bytes) {
+    static constexpr wchar_t kDigits[] = L"0123456789ABCDEF";
+    std::wstring text;
+    text.reserve(N * 2);
+    for(std::uint8_t byte : bytes) {
+        text.push_back(kDigits[byte >> 4]);
+        text.push_back(kDigits[byte & 0x0F]);
+    }
+    return text;
+}
+
+std::size_t DigestSlot(qttabbar::HashAlgorithm algorithm) {
+    for(std::size_t i = 0; i < qttabbar::kAllHashAlgorithms.size(); ++i) {
+        if(qttabbar::kAllHashAlgorithms[i] == algorithm) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+namespace qttabbar {
+
+const wchar_t* HashAlgorithmName(HashAlgorithm algorithm) {
+    switch(algorithm) {
+    case HashAlgorithm::Md5:
+        return L"MD5";
+    case HashAlgorithm::Sha1:
+        return L"SHA-1";
+    case HashAlgorithm::Sha256:
+        return L"SHA-256";
+    case HashAlgorithm::Crc32:
+        return L"CRC32";
+    case HashAlgorithm::XxHash64:
+        return L"XXH64";
+    }
+    return L"";
+}
+
+Md5::Md5()
+    : m_state{0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u} {
+}
+
+void Md5::Update(const std::uint8_t* data, std::size_t size) {
+    BufferBlocks(m_buffer, m_length, data, size, [this](const std::uint8_t* block) { Transform(block); });
+}
+
+std::array<std::uint8_t, 16> Md5::Final() {
+    PadMessage(m_length, false, [this](const std::uint8_t* data, std::size_t size) { Update(data, size); });
+    std::array<std::uint8_t, 16> digest{};
+    for(std::size_t i = 0; i < m_state.size(); ++i) {
+        StoreLe32(digest.data() + i * 4, m_state[i]);
+    }
+    return digest;
+}
+
+void Md5::Transform(const std::uint8_t* block) {
+    static constexpr std::uint32_t kSine[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+    };
+    static constexpr int kShift[64] = {
+        7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+    };
+    std::uint32_t words[16];
+    for(int i = 0; i < 16; ++i) {
+        words[i] = LoadLe32(block + i * 4);
+    }
+    std::uint32_t a = m_state[0];
+    std::uint32_t b = m_state[1];
+    std::uint32_t c = m_state[2];
+    std::uint32_t d = m_state[3];
+    // One loop per round function keeps the per-step branch out of the hot path.
+    auto step = [&](std::uint32_t f, int i, int g) {
+        std::uint32_t next = d;
+        d = c;
+        c = b;
+        b = b + Rotl32(a + f + kSine[i] + words[g], kShift[i]);
+        a = next;
+    };
+    for(int i = 0; i < 16; ++i) {
+        step((b & c) | (~b & d), i, i);
+    }
+    for(int i = 16; i < 32; ++i) {
+        step((d & b) | (~d & c), i, (5 * i + 1) & 15);
+    }
+    for(int i = 32; i < 48; ++i) {
+        step(b ^ c ^ d, i, (3 * i + 5) & 15);
+    }
+    for(int i = 48; i < 64; ++i) {
+        step(c ^ (b | ~d), i, (7 * i) & 15);
+    }
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+}
+
+Sha1::Sha1()
+    : m_state{0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u} {
+}
+
+void Sha1::Update(const std::uint8_t* data, std::size_t size) {
+    BufferBlocks(m_buffer, m_length, data, size, [this](const std::uint8_t* block) { Transform(block); });
+}
+
+std::array<std::uint8_t, 20> Sha1::Final() {
+    PadMessage(m_length, true, [this](const std::uint8_t* data, std::size_t size) { Update(data, size); });
+    std::array<std::uint8_t, 20> digest{};
+    for(std::size_t i = 0; i < m_state.size(); ++i) {
+        StoreBe32(digest.data() + i * 4, m_state[i]);
+    }
+    return digest;
+}
+
+void Sha1::Transform(const std::uint8_t* block) {
+    // The schedule is expanded in place over a 16-word window; a precomputed
+    // 80-word array lets compilers vectorize the expansion into overlapping
+    // stores that defeat store-to-load forwarding.
+    std::uint32_t w[16];
+    for(int i = 0; i < 16; ++i) {
+        w[i] = LoadBe32(block + i * 4);
+    }
+    auto schedule = [&w](int i) {
+        if(i < 16) {
+            return w[i];
+        }
+        std::uint32_t value = Rotl32(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+        w[i & 15] = value;
+        return value;
+    };
+    std::uint32_t a = m_state[0];
+    std::uint32_t b = m_state[1];
+    std::uint32_t c = m_state[2];
+    std::uint32_t d = m_state[3];
+    std::uint32_t e = m_state[4];
+    // Five steps per iteration with rotated arguments instead of shuffling the
+    // working variables after every step.
+    auto rounds = [&](auto&& function, std::uint32_t k, int first) {
+        auto step = [&](std::uint32_t v, std::uint32_t& x, std::uint32_t y, std::uint32_t z, std::uint32_t& t, int i) {
+            t += Rotl32(v, 5) + function(x, y, z) + k + schedule(i);
+            x = Rotl32(x, 30);
+        };
+        for(int i = first; i < first + 20; i += 5) {
+            step(a, b, c, d, e, i);
+            step(e, a, b, c, d, i + 1);
+            step(d, e, a, b, c, i + 2);
+            step(c, d, e, a, b, i + 3);
+            step(b, c, d, e, a, i + 4);
+        }
+    };
+    rounds([](std::uint32_t x, std::uint32_t y, std::uint32_t z) { return z ^ (x & (y ^ z)); }, 0x5A827999u, 0);
+    rounds([](std::uint32_t x, std::uint32_t y, std::uint32_t z) { return x ^ y ^ z; }, 0x6ED9EBA1u, 20);
+    rounds([](std::uint32_t x, std::uint32_t y, std::uint32_t z) { return (x & y) | (z & (x | y)); }, 0x8F1BBCDCu, 40);
+    rounds([](std::uint32_t x, std::uint32_t y, std::uint32_t z) { return x ^ y ^ z; }, 0xCA62C1D6u, 60);
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+}
+
+Sha256::Sha256()
+    : m_state{0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au, 0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u} {
+}
+
+void Sha256::Update(const std::uint8_t* data, std::size_t size) {
+    BufferBlocks(m_buffer, m_length, data, size, [this](const std::uint8_t* block) { Transform(block); });
+}
+
+std::array<std::uint8_t, 32> Sha256::Final() {
+    PadMessage(m_length, true, [this](const std::uint8_t* data, std::size_t size) { Update(data, size); });
+    std::array<std::uint8_t, 32> digest{};
+    for(std::size_t i = 0; i < m_state.size(); ++i) {
+        StoreBe32(digest.data() + i * 4, m_state[i]);
+    }
+    return digest;
+}
+
+void Sha256::Transform(const std::uint8_t* block) {
+    static constexpr std::uint32_t kRound[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+    // Same 16-word rolling schedule as Sha1::Transform.
+    std::uint32_t w[16];
+    for(int i = 0; i < 16; ++i) {
+        w[i] = LoadBe32(block + i * 4);
+    }
+    auto schedule = [&w](int i) {
+        if(i < 16) {
+            return w[i];
+        }
+        std::uint32_t w15 = w[(i + 1) & 15];
+        std::uint32_t w2 = w[(i + 14) & 15];
+        std::uint32_t s0 = Rotr32(w15, 7) ^ Rotr32(w15, 18) ^ (w15 >> 3);
+        std::uint32_t s1 = Rotr32(w2, 17) ^ Rotr32(w2, 19) ^ (w2 >> 10);
+        std::uint32_t value = w[i & 15] + s0 + w[(i + 9) & 15] + s1;
+        w[i & 15] = value;
+        return value;
+    };
+    std::uint32_t a = m_state[0];
+    std::uint32_t b = m_state[1];
+    std::uint32_t c = m_state[2];
+    std::uint32_t d = m_state[3];
+    std::uint32_t e = m_state[4];
+    std::uint32_t f = m_state[5];
+    std::uint32_t g = m_state[6];
+    std::uint32_t h = m_state[7];
+    for(int i = 0; i < 64; ++i) {
+        std::uint32_t s1 = Rotr32(e, 6) ^ Rotr32(e, 11) ^ Rotr32(e, 25);
+        std::uint32_t choose = (e & f) ^ (~e & g);
+        std::uint32_t temp1 = h + s1 + choose + kRound[i] + schedule(i);
+        std::uint32_t s0 = Rotr32(a, 2) ^ Rotr32(a, 13) ^ Rotr32(a, 22);
+        std::uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        std::uint32_t temp2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+    m_state[5] += f;
+    m_state[6] += g;
+    m_state[7] += h;
+}
+
+void Crc32::Update(const std::uint8_t* data, std::size_t size) {
+    const auto& t = GetCrc32Tables().table;
+    std::uint32_t crc = m_crc;
+    while(size >= 8) {
+        std::uint32_t low = LoadLe32(data) ^ crc;
+        std::uint32_t high = LoadLe32(data + 4);
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while(size-- > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+    m_crc = crc;
+}
+
+XxHash64::XxHash64()
+    : m_lanes{kXxPrime1 + kXxPrime2, kXxPrime2, 0, 0ull - kXxPrime1} {
+}
+
+void XxHash64::Update(const std::uint8_t* data, std::size_t size) {
+    m_length += size;
+    if(m_buffered + size < 32) {
+        std::memcpy(m_buffer.data() + m_buffered, data, size);
+        m_buffered += size;
+        return;
+    }
+    if(m_buffered != 0) {
+        std::size_t take = 32 - m_buffered;
+        std::memcpy(m_buffer.data() + m_buffered, data, take);
+        for(int i = 0; i < 4; ++i) {
+            m_lanes[i] = XxRound(m_lanes[i], LoadLe64(m_buffer.data() + i * 8));
+        }
+        data += take;
+        size -= take;
+        m_buffered = 0;
+    }
+    while(size >= 32) {
+        m_lanes[0] = XxRound(m_lanes[0], LoadLe64(data));
+        m_lanes[1] = XxRound(m_lanes[1], LoadLe64(data + 8));
+        m_lanes[2] = XxRound(m_lanes[2], LoadLe64(data + 16));
+        m_lanes[3] = XxRound(m_lanes[3], LoadLe64(data + 24));
+        data += 32;
+        size -= 32;
+    }
+    std::memcpy(m_buffer.data(), data, size);
+    m_buffered = size;
+}
+
+std::uint64_t XxHash64::Final() const {
+    std::uint64_t hash = 0;
+    if(m_length >= 32) {
+        hash = Rotl64(m_lanes[0], 1) + Rotl64(m_lanes[1], 7) + Rotl64(m_lanes[2], 12) + Rotl64(m_lanes[3], 18);
+        for(std::uint64_t lane : m_lanes) {
+            hash = XxMerge(hash, lane);
+        }
+    } else {
+        hash = m_lanes[2] + kXxPrime5;
+    }
+    hash += m_length;
+
+    const std::uint8_t* tail = m_buffer.data();
+    std::size_t remaining = m_buffered;
+    while(remaining >= 8) {
+        hash ^= XxRound(0, LoadLe64(tail));
+        hash = Rotl64(hash, 27) * kXxPrime1 + kXxPrime4;
+        tail += 8;
+        remaining -= 8;
+    }
+    if(remaining >= 4) {
+        hash ^= static_cast<std::uint64_t>(LoadLe32(tail)) * kXxPrime1;
+        hash = Rotl64(hash, 23) * kXxPrime2 + kXxPrime3;
+        tail += 4;
+        remaining -= 4;
+    }
+    while(remaining-- > 0) {
+        hash ^= static_cast<std::uint64_t>(*tail++) * kXxPrime5;
+        hash = Rotl64(hash, 11) * kXxPrime1;
+    }
+    hash ^= hash >> 33;
+    hash *= kXxPrime2;
+    hash ^= hash >> 29;
+    hash *= kXxPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+MultiHasher::MultiHasher(HashAlgorithmMask algorithms)
+    : m_algorithms(algorithms) {
+}
+
+void MultiHasher::Update(const std::uint8_t* data, std::size_t size) {
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::Md5)) {
+        m_md5.Update(data, size);
+    }
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::Sha1)) {
+        m_sha1.Update(data, size);
+    }
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::Sha256)) {
+        m_sha256.Update(data, size);
+    }
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::Crc32)) {
+        m_crc32.Update(data, size);
+    }
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::XxHash64)) {
+        m_xxhash.Update(data, size);
+    }
+}
+
+void MultiHasher::Finish() {
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::Md5)) {
+        m_digests[DigestSlot(HashAlgorithm::Md5)] = ToHex(m_md5.Final());
+    }
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::Sha1)) {
+        m_digests[DigestSlot(HashAlgorithm::Sha1)] = ToHex(m_sha1.Final());
+    }
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::Sha256)) {
+        m_digests[DigestSlot(HashAlgorithm::Sha256)] = ToHex(m_sha256.Final());
+    }
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::Crc32)) {
+        std::array<std::uint8_t, 4> bytes{};
+        StoreBe32(bytes.data(), m_crc32.Final());
+        m_digests[DigestSlot(HashAlgorithm::Crc32)] = ToHex(bytes);
+    }
+    if(HasAlgorithm(m_algorithms, HashAlgorithm::XxHash64)) {
+        std::uint64_t value = m_xxhash.Final();
+        std::array<std::uint8_t, 8> bytes{};
+        StoreBe32(bytes.data(), static_cast<std::uint32_t>(value >> 32));
+        StoreBe32(bytes.data() + 4, static_cast<std::uint32_t>(value));
+        m_digests[DigestSlot(HashAlgorithm::XxHash64)] = ToHex(bytes);
+    }
+}
+
+const std::wstring& MultiHasher::Digest(HashAlgorithm algorithm) const {
+    return m_digests[DigestSlot(algorithm)];
+}
+
+} // namespace qttabbar
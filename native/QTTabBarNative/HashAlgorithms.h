@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace qttabbar {
+
+enum class HashAlgorithm : std::uint32_t {
+    Md5 = 1u << 0,
+    Sha1 = 1u << 1,
+    Sha256 = 1u << 2,
+    Crc32 = 1u << 3,
+    XxHash64 = 1u << 4,
+};
+
+using HashAlgorithmMask = std::uint32_t;
+
+constexpr HashAlgorithmMask operator|(HashAlgorithm lhs, HashAlgorithm rhs) {
+    return static_cast<HashAlgorithmMask>(lhs) | static_cast<HashAlgorithmMask>(rhs);
+}
+
+constexpr HashAlgorithmMask operator|(HashAlgorithmMask lhs, HashAlgorithm rhs) {
+    return lhs | static_cast<HashAlgorithmMask>(rhs);
+}
+
+constexpr bool HasAlgorithm(HashAlgorithmMask mask, HashAlgorithm algorithm) {
+    return (mask & static_cast<HashAlgorithmMask>(algorithm)) != 0;
+}
+
+constexpr std::array<HashAlgorithm, 5> kAllHashAlgorithms = {
+    HashAlgorithm::Md5, HashAlgorithm::Sha1, HashAlgorithm::Sha256, HashAlgorithm::Crc32, HashAlgorithm::XxHash64,
+};
+
+const wchar_t* HashAlgorithmName(HashAlgorithm algorithm);
+
+class Md5 {
+public:
+    Md5();
+    void Update(const std::uint8_t* data, std::size_t size);
+    std::array<std::uint8_t, 16> Final();
+
+private:
+    void Transform(const std::uint8_t* block);
+
+    std::array<std::uint32_t, 4> m_state;
+    std::array<std::uint8_t, 64> m_buffer{};
+    std::uint64_t m_length = 0;
+};
+
+class Sha1 {
+public:
+    Sha1();
+    void Update(const std::uint8_t* data, std::size_t size);
+    std::array<std::uint8_t, 20> Final();
+
+private:
+    void Transform(const std::uint8_t* block);
+
+    std::array<std::uint32_t, 5> m_state;
+    std::array<std::uint8_t, 64> m_buffer{};
+    std::uint64_t m_length = 0;
+};
+
+class Sha256 {
+public:
+    Sha256();
+    void Update(const std::uint8_t* data, std::size_t size);
+    std::array<std::uint8_t, 32> Final();
+
+private:
+    void Transform(const std::uint8_t* block);
+
+    std::array<std::uint32_t, 8> m_state;
+    std::array<std::uint8_t, 64> m_buffer{};
+    std::uint64_t m_length = 0;
+};
+
+// IEEE 802.3 CRC-32 (the zip/PNG polynomial), table driven eight bytes at a time.
+class Crc32 {
+public:
+    void Update(const std::uint8_t* data, std::size_t size);
+    std::uint32_t Final() const noexcept { return ~m_crc; }
+
+private:
+    std::uint32_t m_crc = 0xFFFFFFFFu;
+};
+
+// XXH64 with seed 0.
+class XxHash64 {
+public:
+    XxHash64();
+    void Update(const std::uint8_t* data, std::size_t size);
+    std::uint64_t Final() const;
+
+private:
+    std::array<std::uint64_t, 4> m_lanes;
+    std::array<std::uint8_t, 32> m_buffer{};
+    std::size_t m_buffered = 0;
+    std::uint64_t m_length = 0;
+};
+
+// Feeds one buffer to every selected algorithm, so each byte is read once.
+class MultiHasher {
+public:
+    explicit MultiHasher(HashAlgorithmMask algorithms);
+
+    void Update(const std::uint8_t* data, std::size_t size);
+    // Upper-case hex digest of an algorithm; only valid after Finish().
+    const std::wstring& Digest(HashAlgorithm algorithm) const;
+    void Finish();
+    HashAlgorithmMask Algorithms() const noexcept { return m_algorithms; }
+
+private:
+    HashAlgorithmMask m_algorithms;
+    Md5 m_md5;
+    Sha1 m_sha1;
+    Sha256 m_sha256;
+    Crc32 m_crc32;
+    XxHash64 m_xxhash;
+    std::array<std::wstring, kAllHashAlgorithms.size()> m_digests;
+};
+
+} // namespace qttabbar
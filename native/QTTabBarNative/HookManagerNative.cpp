@@ -50,8 +50,7 @@ void HookManagerNative::OnTabBarSiteCleared(QTTabBarClass* /*tabBar*/) {
 }
 
 void HookManagerNative::ReloadConfiguration() {
-    ConfigData config = LoadConfigFromRegistry();
-    ReloadConfiguration(config);
+    ReloadConfiguration(GetConfigSnapshot()->value);
 }
 
 void HookManagerNative::ReloadConfiguration(const ConfigData& config) {
@@ -26,6 +26,124 @@ constexpr UINT ID_CLOSE_ALL = 0x5101;
 
 static_assert(sizeof(InstanceManager::MessageType) == sizeof(uint32_t),
     "MessageType must remain a 32-bit enum for IPC serialization.");
+static_assert(sizeof(wchar_t) == sizeof(char16_t), "Pipe strings are UTF-16 and viewed as wchar_t in place.");
+
+// How long a synchronous cross-process action may take before the caller gives up.
+constexpr std::chrono::milliseconds kServerCallTimeout{5000};
+constexpr DWORD kPipeBusyWaitMs = 1000;
+
+// The server keeps this many pipe instances waiting, so clients that arrive
+// together rarely have to retry, and serves every connection from a fixed pool.
+constexpr int kListeningPipes = 2;
+constexpr DWORD kPipeWorkerCount = 4;
+constexpr size_t kPipeReadBufferSize = 16 * 1024;
+// Frames up to this size are coalesced into one WriteFile; pipes have no gather write.
+constexpr size_t kPipeCoalesceLimit = 64 * 1024;
+// How long StopPipeServer lets the workers drop their connections, checking
+// every poll interval whether they still run at all.
+constexpr std::chrono::milliseconds kPipeStopTimeout{2000};
+constexpr std::chrono::milliseconds kPipeStopPollInterval{50};
+
+std::wstring_view AsWide(std::u16string_view value) {
+    return {reinterpret_cast<const wchar_t*>(value.data()), value.size()};
+}
+
+std::u16string_view AsUtf16(std::wstring_view value) {
+    return {reinterpret_cast<const char16_t*>(value.data()), value.size()};
+}
+
+qttabbar::ByteSpan AsBytes(const std::vector<uint8_t>& value) {
+    return {value.data(), value.size()};
+}
+
+// Overlapped named pipe end. The handle must be opened with FILE_FLAG_OVERLAPPED:
+// synchronous pipe handles serialize I/O, so a blocked read would hold up every write.
+// On the server only Write is used; reads complete on the completion port.
+class PipeTransport final : public qttabbar::IChannelTransport {
+public:
+    explicit PipeTransport(HANDLE pipe)
+        : m_pipe(pipe)
+        , m_readEvent(CreateEventW(nullptr, TRUE, FALSE, nullptr))
+        , m_writeEvent(CreateEventW(nullptr, TRUE, FALSE, nullptr))
+        , m_shutdownEvent(CreateEventW(nullptr, TRUE, FALSE, nullptr)) {}
+
+    ~PipeTransport() override {
+        CloseHandle(m_pipe);
+        for(HANDLE event : {m_readEvent, m_writeEvent, m_shutdownEvent}) {
+            if(event) {
+                CloseHandle(event);
+            }
+        }
+    }
+
+    bool Write(const void* data, size_t size) override {
+        return Transfer(false, const_cast<void*>(data), size, m_writeEvent);
+    }
+
+    // Small frames go out in one WriteFile from a reused buffer; copying them
+    // is cheaper than a wait per segment. Calls are serialized by the channel.
+    bool WriteGather(const qttabbar::ByteSpan* buffers, size_t count) override {
+        size_t total = 0;
+        for(size_t i = 0; i < count; ++i) {
+            total += buffers[i].size;
+        }
+        if(count == 1 || total > kPipeCoalesceLimit) {
+            return IChannelTransport::WriteGather(buffers, count);
+        }
+        m_gather.clear();
+        for(size_t i = 0; i < count; ++i) {
+            m_gather.insert(m_gather.end(), buffers[i].data, buffers[i].data + buffers[i].size);
+        }
+        return Write(m_gather.data(), m_gather.size());
+    }
+
+    bool Read(void* data, size_t size) override {
+        return Transfer(true, data, size, m_readEvent);
+    }
+
+    void Shutdown() override {
+        SetEvent(m_shutdownEvent);
+    }
+
+private:
+    bool Transfer(bool read, void* data, size_t size, HANDLE event) {
+        if(!event || !m_shutdownEvent) {
+            return false;
+        }
+        auto* cursor = static_cast<uint8_t*>(data);
+        while(size > 0) {
+            OVERLAPPED overlapped{};
+            // The low bit keeps the completion off a port the handle may be
+            // associated with; the event is signalled either way.
+            overlapped.hEvent = reinterpret_cast<HANDLE>(reinterpret_cast<ULONG_PTR>(event) | 1);
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 64 * 1024));
+            DWORD transferred = 0;
+            BOOL done = read ? ReadFile(m_pipe, cursor, chunk, nullptr, &overlapped)
+                             : WriteFile(m_pipe, cursor, chunk, nullptr, &overlapped);
+            if(!done && GetLastError() != ERROR_IO_PENDING) {
+                return false;
+            }
+            HANDLE waits[] = {event, m_shutdownEvent};
+            if(WaitForMultipleObjects(ARRAYSIZE(waits), waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                CancelIoEx(m_pipe, &overlapped);
+                GetOverlappedResult(m_pipe, &overlapped, &transferred, TRUE);
+                return false;
+            }
+            if(!GetOverlappedResult(m_pipe, &overlapped, &transferred, FALSE) || transferred == 0) {
+                return false;
+            }
+            cursor += transferred;
+            size -= transferred;
+        }
+        return true;
+    }
+
+    HANDLE m_pipe;
+    HANDLE m_readEvent;
+    HANDLE m_writeEvent;
+    HANDLE m_shutdownEvent;
+    std::vector<uint8_t> m_gather;
+};
 
 std::vector<uint8_t> PackActionPayload(const std::wstring& payload, const std::vector<uint8_t>& binary) {
     uint32_t length = static_cast<uint32_t>(payload.size());
@@ -40,29 +158,6 @@ std::vector<uint8_t> PackActionPayload(const std::wstring& payload, const std::v
     }
     return buffer;
 }
-
-void UnpackActionPayload(const std::vector<uint8_t>& buffer, std::wstring& payload, std::vector<uint8_t>& binary) {
-    if(buffer.size() < sizeof(uint32_t)) {
-        payload.clear();
-        binary.clear();
-        return;
-    }
-    uint32_t length = 0;
-    std::memcpy(&length, buffer.data(), sizeof(length));
-    size_t offset = sizeof(length);
-    size_t payloadBytes = static_cast<size_t>(length) * sizeof(wchar_t);
-    if(offset + payloadBytes > buffer.size()) {
-        payloadBytes = buffer.size() - offset;
-        length = static_cast<uint32_t>(payloadBytes / sizeof(wchar_t));
-    }
-    payload.assign(reinterpret_cast<const wchar_t*>(buffer.data() + offset), length);
-    offset += payloadBytes;
-    if(offset < buffer.size()) {
-        binary.assign(buffer.begin() + static_cast<ptrdiff_t>(offset), buffer.end());
-    } else {
-        binary.clear();
-    }
-}
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -78,7 +173,10 @@ public:
     void EnsureThread();
     void Shutdown();
 
-    void AddOrUpdate(const TrayInstance& instance);
+    // Sends the window to the tray along with what changed in its tab list.
+    void AddOrUpdate(HWND explorer, HWND tabBar, qttabbar::TabListDelta delta);
+    // Same with the whole list, for windows of other processes.
+    void AddOrUpdate(HWND explorer, HWND tabBar, qttabbar::TabList tabs);
     void Remove(HWND tabBar);
     void RestoreAll();
     void Show(HWND tabBar, bool show);
@@ -93,16 +191,23 @@ private:
 
     struct Command {
         CommandType type;
-        TrayInstance instance;
+        HWND explorer{};
         HWND tabBar{};
         bool show{};
+        bool fullList{};  // `tabs` replaces the list rather than `delta` updating it
+        qttabbar::TabList tabs;
+        qttabbar::TabListDelta delta;
     };
 
     static LRESULT CALLBACK TrayWndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
 
     void ThreadProc(std::promise<HWND> readySignal);
-    void Post(std::unique_ptr<Command> command);
+    void Post(Command command);
+    bool MergeQueued(Command& command);
+    void ProcessCommands();
     void ProcessCommand(Command& command);
+    void UpdateTabs(TrayInstance& instance, Command& command);
+    size_t CountInTray() const;
     void HandleTrayNotify(WPARAM wParam, LPARAM lParam);
     void HandleContextMenu();
     void HandleCommand(UINT commandId);
@@ -122,6 +227,12 @@ private:
     std::mutex m_mutex;
     std::unordered_map<HWND, TrayInstance> m_instances;
     std::unordered_map<UINT, std::pair<HWND, int>> m_tabSelectionMap;
+
+    // Commands wait here until the tray thread takes them all in one go, and
+    // updates for a window that is still waiting are merged into one.
+    std::mutex m_queueMutex;
+    std::vector<Command> m_queue;
+    std::vector<Command> m_processing;
 };
 
 void InstanceManager::TrayIconManager::EnsureThread() {
@@ -142,40 +253,86 @@ void InstanceManager::TrayIconManager::Shutdown() {
     m_threadId = 0;
 }
 
-void InstanceManager::TrayIconManager::AddOrUpdate(const TrayInstance& instance) {
-    auto command = std::make_unique<Command>();
-    command->type = CommandType::AddOrUpdate;
-    command->instance = instance;
+void InstanceManager::TrayIconManager::AddOrUpdate(HWND explorer, HWND tabBar, qttabbar::TabListDelta delta) {
+    Command command{CommandType::AddOrUpdate};
+    command.explorer = explorer;
+    command.tabBar = tabBar;
+    command.delta = std::move(delta);
+    Post(std::move(command));
+}
+
+void InstanceManager::TrayIconManager::AddOrUpdate(HWND explorer, HWND tabBar, qttabbar::TabList tabs) {
+    Command command{CommandType::AddOrUpdate};
+    command.explorer = explorer;
+    command.tabBar = tabBar;
+    command.fullList = true;
+    command.tabs = std::move(tabs);
     Post(std::move(command));
 }
 
 void InstanceManager::TrayIconManager::Remove(HWND tabBar) {
-    auto command = std::make_unique<Command>();
-    command->type = CommandType::Remove;
-    command->tabBar = tabBar;
+    Command command{CommandType::Remove};
+    command.tabBar = tabBar;
     Post(std::move(command));
 }
 
 void InstanceManager::TrayIconManager::RestoreAll() {
-    auto command = std::make_unique<Command>();
-    command->type = CommandType::RestoreAll;
-    Post(std::move(command));
+    Post(Command{CommandType::RestoreAll});
 }
 
 void InstanceManager::TrayIconManager::Show(HWND tabBar, bool show) {
-    auto command = std::make_unique<Command>();
-    command->type = CommandType::Show;
-    command->tabBar = tabBar;
-    command->show = show;
+    Command command{CommandType::Show};
+    command.tabBar = tabBar;
+    command.show = show;
     Post(std::move(command));
 }
 
-void InstanceManager::TrayIconManager::Post(std::unique_ptr<Command> command) {
+void InstanceManager::TrayIconManager::Post(Command command) {
     EnsureThread();
     if(!m_hwnd) {
         return;
     }
-    PostMessageW(m_hwnd, WM_TRAYCOMMAND, reinterpret_cast<WPARAM>(command.release()), 0);
+    std::lock_guard lock(m_queueMutex);
+    if(command.type == CommandType::AddOrUpdate && MergeQueued(command)) {
+        return;
+    }
+    bool wake = m_queue.empty();
+    m_queue.push_back(std::move(command));
+    if(wake && !PostMessageW(m_hwnd, WM_TRAYCOMMAND, 0, 0)) {
+        m_queue.clear();
+    }
+}
+
+// Folds an update into the last one queued for the same window, unless a
+// command in between has to see the window as it was. Caller holds m_queueMutex.
+bool InstanceManager::TrayIconManager::MergeQueued(Command& command) {
+    for(auto it = m_queue.rbegin(); it != m_queue.rend(); ++it) {
+        if(it->type == CommandType::RestoreAll) {
+            return false;
+        }
+        if(it->tabBar != command.tabBar) {
+            continue;
+        }
+        if(it->type != CommandType::AddOrUpdate) {
+            return false;
+        }
+        bool merged;
+        if(command.fullList) {
+            it->fullList = true;
+            it->tabs = std::move(command.tabs);
+            it->delta = {};
+            merged = true;
+        } else if(it->fullList) {
+            merged = qttabbar::ApplyTabListDelta(it->tabs, command.delta);
+        } else {
+            merged = qttabbar::AppendTabListDelta(it->delta, std::move(command.delta));
+        }
+        if(merged) {
+            it->explorer = command.explorer;
+        }
+        return merged;
+    }
+    return false;
 }
 
 void InstanceManager::TrayIconManager::ThreadProc(std::promise<HWND> readySignal) {
@@ -197,10 +354,7 @@ void InstanceManager::TrayIconManager::ThreadProc(std::promise<HWND> readySignal
     MSG msg{};
     while(GetMessageW(&msg, nullptr, 0, 0) > 0) {
         if(msg.message == WM_TRAYCOMMAND) {
-            std::unique_ptr<Command> command(reinterpret_cast<Command*>(msg.wParam));
-            if(command) {
-                ProcessCommand(*command);
-            }
+            ProcessCommands();
             continue;
         }
         TranslateMessage(&msg);
@@ -248,24 +402,47 @@ LRESULT CALLBACK InstanceManager::TrayIconManager::TrayWndProc(HWND hwnd, UINT m
     }
 }
 
+void InstanceManager::TrayIconManager::ProcessCommands() {
+    {
+        std::lock_guard lock(m_queueMutex);
+        m_processing.swap(m_queue);
+    }
+    for(Command& command : m_processing) {
+        ProcessCommand(command);
+    }
+    m_processing.clear();
+}
+
 void InstanceManager::TrayIconManager::ProcessCommand(Command& command) {
     std::lock_guard lock(m_mutex);
     switch(command.type) {
     case CommandType::AddOrUpdate: {
-        TrayInstance instance = command.instance;
+        // Restored windows are kept for their tab lists until they close.
+        for(auto it = m_instances.begin(); it != m_instances.end();) {
+            if(!it->second.inTray && it->first != command.tabBar && !::IsWindow(it->first)) {
+                it = m_instances.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        TrayInstance& instance = m_instances[command.tabBar];
+        instance.explorer = command.explorer;
+        instance.tabBar = command.tabBar;
+        UpdateTabs(instance, command);
         instance.showWindowCode = ::IsZoomed(instance.explorer) ? SW_MAXIMIZE : SW_SHOWNORMAL;
-        m_instances[instance.tabBar] = std::move(instance);
+        instance.inTray = true;
         EnsureIcon();
         UpdateIconVisibility();
         UpdateToolTip();
-        auto& stored = m_instances[command.instance.tabBar];
-        ShowExplorerWindow(stored, false);
+        ShowExplorerWindow(instance, false);
         break;
     }
     case CommandType::Remove: {
         auto it = m_instances.find(command.tabBar);
         if(it != m_instances.end()) {
-            ShowExplorerWindow(it->second, true);
+            if(it->second.inTray) {
+                ShowExplorerWindow(it->second, true);
+            }
             m_instances.erase(it);
             UpdateIconVisibility();
             UpdateToolTip();
@@ -274,9 +451,11 @@ void InstanceManager::TrayIconManager::ProcessCommand(Command& command) {
     }
     case CommandType::RestoreAll:
         for(auto& [_, instance] : m_instances) {
-            ShowExplorerWindow(instance, true);
+            if(instance.inTray) {
+                ShowExplorerWindow(instance, true);
+                instance.inTray = false;
+            }
         }
-        m_instances.clear();
         UpdateIconVisibility();
         UpdateToolTip();
         break;
@@ -284,17 +463,36 @@ void InstanceManager::TrayIconManager::ProcessCommand(Command& command) {
         auto it = m_instances.find(command.tabBar);
         if(it != m_instances.end()) {
             ShowExplorerWindow(it->second, command.show);
-            if(command.show) {
-                m_instances.erase(it);
-                UpdateIconVisibility();
-                UpdateToolTip();
-            }
+            it->second.inTray = !command.show;
+            UpdateIconVisibility();
+            UpdateToolTip();
         }
         break;
     }
     }
 }
 
+void InstanceManager::TrayIconManager::UpdateTabs(TrayInstance& instance, Command& command) {
+    if(command.fullList) {
+        instance.tabs = std::move(command.tabs);
+        return;
+    }
+    if(instance.tabs.version >= command.delta.version) {
+        // Already part of a list fetched to resynchronise.
+        return;
+    }
+    if(!qttabbar::ApplyTabListDelta(instance.tabs, command.delta)) {
+        // An earlier delta never arrived here; take the sender's whole list.
+        instance.tabs = {};
+        m_owner.CopyTrayTabList(command.tabBar, instance.tabs);
+    }
+}
+
+size_t InstanceManager::TrayIconManager::CountInTray() const {
+    return static_cast<size_t>(std::count_if(m_instances.begin(), m_instances.end(),
+        [](const auto& entry) { return entry.second.inTray; }));
+}
+
 void InstanceManager::TrayIconManager::HandleTrayNotify(WPARAM /*wParam*/, LPARAM lParam) {
     switch(lParam) {
     case WM_LBUTTONDBLCLK:
@@ -311,16 +509,18 @@ void InstanceManager::TrayIconManager::HandleTrayNotify(WPARAM /*wParam*/, LPARA
 
 void InstanceManager::TrayIconManager::HandleContextMenu() {
     std::vector<std::pair<HWND, TrayInstance>> entries;
-    entries.reserve(m_instances.size());
     {
         std::lock_guard lock(m_mutex);
-        if(m_instances.empty()) {
-            return;
-        }
+        entries.reserve(CountInTray());
         for(const auto& [tabBar, instance] : m_instances) {
-            entries.emplace_back(tabBar, instance);
+            if(instance.inTray) {
+                entries.emplace_back(tabBar, instance);
+            }
         }
     }
+    if(entries.empty()) {
+        return;
+    }
 
     POINT pt{};
     GetCursorPos(&pt);
@@ -334,13 +534,13 @@ void InstanceManager::TrayIconManager::HandleContextMenu() {
     std::unordered_map<UINT, std::pair<HWND, int>> commandMap;
     for(const auto& [tabBar, instance] : entries) {
         HMENU subMenu = CreatePopupMenu();
-        for(size_t i = 0; i < instance.tabNames.size(); ++i) {
-            const auto& name = instance.tabNames[i];
+        for(size_t i = 0; i < instance.tabs.tabNames.size(); ++i) {
+            const auto& name = instance.tabs.tabNames[i];
             AppendMenuW(subMenu, MF_STRING, currentId, name.c_str());
             commandMap[currentId] = {tabBar, static_cast<int>(i)};
             ++currentId;
         }
-        AppendMenuW(menu, MF_POPUP, reinterpret_cast<UINT_PTR>(subMenu), instance.currentPath.c_str());
+        AppendMenuW(menu, MF_POPUP, reinterpret_cast<UINT_PTR>(subMenu), instance.tabs.currentPath.c_str());
     }
 
     {
@@ -359,10 +559,14 @@ void InstanceManager::TrayIconManager::HandleCommand(UINT commandId) {
     }
     if(commandId == ID_CLOSE_ALL) {
         std::lock_guard lock(m_mutex);
-        for(const auto& [_, instance] : m_instances) {
-            PostMessageW(instance.explorer, WM_CLOSE, 0, 0);
+        for(auto it = m_instances.begin(); it != m_instances.end();) {
+            if(it->second.inTray) {
+                PostMessageW(it->second.explorer, WM_CLOSE, 0, 0);
+                it = m_instances.erase(it);
+            } else {
+                ++it;
+            }
         }
-        m_instances.clear();
         m_tabSelectionMap.clear();
         UpdateToolTip();
         UpdateIconVisibility();
@@ -403,7 +607,7 @@ void InstanceManager::TrayIconManager::UpdateIconVisibility() {
     if(!m_hwnd) {
         return;
     }
-    if(m_instances.empty()) {
+    if(CountInTray() == 0) {
         if(m_iconVisible) {
             Shell_NotifyIconW(NIM_DELETE, &m_nid);
             m_iconVisible = false;
@@ -424,7 +628,7 @@ void InstanceManager::TrayIconManager::UpdateToolTip() {
         return;
     }
     std::wstring tip;
-    size_t count = m_instances.size();
+    size_t count = CountInTray();
     if(count == 0) {
         tip = L"QTTabBar";
     } else if(count == 1) {
@@ -449,6 +653,16 @@ void InstanceManager::TrayIconManager::ShowExplorerWindow(TrayInstance& instance
 // Instance manager
 // -------------------------------------------------------------------------------------------------
 
+// A server pipe instance. At most one connect or read is outstanding on it, so
+// a client's frames are fed to its channel in order by one worker at a time.
+struct InstanceManager::PipeConnection {
+    OVERLAPPED overlapped{};
+    HANDLE pipe = INVALID_HANDLE_VALUE;  // Owned by the channel's transport
+    bool connected = false;
+    std::shared_ptr<qttabbar::MessageChannel> channel;
+    uint8_t buffer[kPipeReadBufferSize];
+};
+
 InstanceManager& InstanceManager::Instance() {
     static InstanceManager instance;
     return instance;
@@ -467,7 +681,7 @@ void InstanceManager::EnsureInitialized() {
                 ReleaseMutex(m_serverMutex);
             } else {
                 m_isServer = true;
-                StartServerThread();
+                StartPipeServer();
             }
         }
     });
@@ -476,23 +690,22 @@ void InstanceManager::EnsureInitialized() {
 void InstanceManager::Shutdown() {
     m_stopRequested = true;
     {
+        // Fails writes stuck on clients that stopped reading, so no worker stays busy.
         std::lock_guard lock(m_clientMutex);
         for(auto& client : m_clients) {
-            if(client->pipe != INVALID_HANDLE_VALUE) {
-                CancelIoEx(client->pipe, nullptr);
-                CloseHandle(client->pipe);
-                client->pipe = INVALID_HANDLE_VALUE;
-            }
+            client->Close();
         }
-        m_clients.clear();
     }
-    if(m_serverThread.joinable()) {
-        HANDLE pipe = CreateFileW(kPipeName, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
-        if(pipe != INVALID_HANDLE_VALUE) {
-            CloseHandle(pipe);
-        }
-        m_serverThread.join();
+    std::shared_ptr<qttabbar::MessageChannel> serverChannel;
+    {
+        std::lock_guard lock(m_serverChannelMutex);
+        serverChannel = std::move(m_serverChannel);
+    }
+    if(serverChannel) {
+        serverChannel->Close();
     }
+    StopPipeServer();
+    m_actionExecutor.Shutdown();
     if(m_serverMutex) {
         CloseHandle(m_serverMutex);
         m_serverMutex = nullptr;
@@ -503,127 +716,260 @@ void InstanceManager::Shutdown() {
     }
 }
 
-void InstanceManager::StartServerThread() {
-    if(m_serverThread.joinable()) {
+void InstanceManager::StartPipeServer() {
+    if(m_completionPort) {
+        return;
+    }
+    m_completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, kPipeWorkerCount);
+    if(!m_completionPort) {
+        Log(L"CreateIoCompletionPort failed: %lu", GetLastError());
         return;
     }
     m_stopRequested = false;
-    m_serverThread = std::thread(&InstanceManager::ServerThreadProc, this);
+    EnsureTray();
+    for(DWORD i = 0; i < kPipeWorkerCount; ++i) {
+        m_pipeWorkers.emplace_back(&InstanceManager::PipeWorkerProc, this);
+    }
+    for(int i = 0; i < kListeningPipes; ++i) {
+        ListenForClient();
+    }
 }
 
-void InstanceManager::ServerThreadProc() {
-    EnsureTray();
-    while(!m_stopRequested) {
-        HANDLE pipe = CreateNamedPipeW(kPipeName,
-            PIPE_ACCESS_DUPLEX,
-            PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT,
-            PIPE_UNLIMITED_INSTANCES,
-            16 * 1024,
-            16 * 1024,
-            0,
-            nullptr);
-        if(pipe == INVALID_HANDLE_VALUE) {
-            Log(L"CreateNamedPipe failed: %lu", GetLastError());
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
-            continue;
+void InstanceManager::StopPipeServer() {
+    if(!m_completionPort) {
+        return;
+    }
+    {
+        std::unique_lock lock(m_clientMutex);
+        m_stopRequested = true;
+        for(const auto& connection : m_connections) {
+            // Fails the pending connect or read; the worker then drops the connection.
+            CancelIoEx(connection->pipe, &connection->overlapped);
         }
-        BOOL connected = ConnectNamedPipe(pipe, nullptr);
-        if(!connected) {
-            DWORD error = GetLastError();
-            if(error != ERROR_PIPE_CONNECTED) {
-                CloseHandle(pipe);
-                continue;
+        // At process exit this runs from the static destructor after the
+        // workers were terminated, and nothing would ever empty the list.
+        auto deadline = std::chrono::steady_clock::now() + kPipeStopTimeout;
+        while(!m_connectionsChanged.wait_for(lock, kPipeStopPollInterval, [this]() { return m_connections.empty(); })) {
+            if(PipeWorkersExited() || std::chrono::steady_clock::now() >= deadline) {
+                break;
             }
         }
+    }
+    for(size_t i = 0; i < m_pipeWorkers.size(); ++i) {
+        PostQueuedCompletionStatus(m_completionPort, 0, 0, nullptr);
+    }
+    for(auto& worker : m_pipeWorkers) {
+        // Returns at once for a terminated thread.
+        worker.join();
+    }
+    m_pipeWorkers.clear();
 
-        auto context = std::make_unique<ClientContext>();
-        context->pipe = pipe;
-        context->connected = true;
+    // No worker runs any more, so whatever they left is closed here.
+    std::vector<std::unique_ptr<PipeConnection>> remaining;
+    {
+        std::lock_guard lock(m_clientMutex);
+        remaining.swap(m_connections);
+        m_clients.clear();
+    }
+    for(const auto& connection : remaining) {
+        // The cancelled I/O must have settled before its OVERLAPPED is freed.
+        DWORD transferred = 0;
+        GetOverlappedResult(connection->pipe, &connection->overlapped, &transferred, TRUE);
+        connection->channel->Close();
+    }
+    remaining.clear();
+    CloseHandle(m_completionPort);
+    m_completionPort = nullptr;
+}
 
-        {
-            std::lock_guard lock(m_clientMutex);
-            m_clients.push_back(std::move(context));
+bool InstanceManager::PipeWorkersExited() {
+    for(auto& worker : m_pipeWorkers) {
+        if(WaitForSingleObject(worker.native_handle(), 0) != WAIT_OBJECT_0) {
+            return false;
         }
+    }
+    return true;
+}
 
-        std::thread worker(&InstanceManager::HandleClient, this, pipe);
-        worker.detach();
+void InstanceManager::PipeWorkerProc() {
+    for(;;) {
+        DWORD transferred = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = nullptr;
+        BOOL succeeded = GetQueuedCompletionStatus(m_completionPort, &transferred, &key, &overlapped, INFINITE);
+        if(!overlapped) {
+            // Woken by StopPipeServer, or the port is gone.
+            return;
+        }
+        auto* connection = CONTAINING_RECORD(overlapped, PipeConnection, overlapped);
+        OnPipeCompletion(connection, succeeded != FALSE, transferred);
     }
 }
 
-void InstanceManager::HandleClient(HANDLE pipe) {
-    while(!m_stopRequested) {
-        PipeMessageHeader header{};
-        DWORD bytesRead = 0;
-        BOOL result = ReadFile(pipe, &header, sizeof(header), &bytesRead, nullptr);
-        if(!result || bytesRead == 0) {
-            break;
+bool InstanceManager::ListenForClient() {
+    HANDLE pipe = CreateNamedPipeW(kPipeName,
+        PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+        PIPE_UNLIMITED_INSTANCES,
+        16 * 1024,
+        16 * 1024,
+        0,
+        nullptr);
+    if(pipe == INVALID_HANDLE_VALUE) {
+        Log(L"CreateNamedPipe failed: %lu", GetLastError());
+        return false;
+    }
+    if(!CreateIoCompletionPort(pipe, m_completionPort, 0, 0)) {
+        Log(L"CreateIoCompletionPort failed: %lu", GetLastError());
+        CloseHandle(pipe);
+        return false;
+    }
+
+    // Clients keep their connection for the life of the process; requests
+    // are acknowledged once handled so synchronous callers can wait.
+    auto connection = std::make_unique<PipeConnection>();
+    connection->pipe = pipe;
+    connection->channel = std::make_shared<qttabbar::MessageChannel>(std::make_unique<PipeTransport>(pipe),
+        [this](qttabbar::MessageChannel& sender, qttabbar::FrameKind kind, uint64_t sequence, qttabbar::ByteSpan body) {
+            qttabbar::PipeMessageView message;
+            if(qttabbar::DecodePipeMessage(body, message)) {
+                HandlePipeMessage(message, body, &sender);
+            }
+            if(kind == qttabbar::FrameKind::Request) {
+                sender.Respond(sequence, {});
+            }
+        });
+
+    PipeConnection* listener = connection.get();
+    std::lock_guard lock(m_clientMutex);
+    if(m_stopRequested) {
+        return false;
+    }
+    m_connections.push_back(std::move(connection));
+    if(!ConnectNamedPipe(pipe, &listener->overlapped)) {
+        DWORD error = GetLastError();
+        if(error == ERROR_PIPE_CONNECTED) {
+            // The client got in before the connect was issued, so nothing is queued for it.
+            PostQueuedCompletionStatus(m_completionPort, 0, 0, &listener->overlapped);
+        } else if(error != ERROR_IO_PENDING) {
+            Log(L"ConnectNamedPipe failed: %lu", error);
+            m_connections.pop_back();
+            return false;
         }
-        if(bytesRead != sizeof(header) || header.magic != kPipeMagic) {
-            break;
+    }
+    return true;
+}
+
+void InstanceManager::OnPipeCompletion(PipeConnection* connection, bool succeeded, DWORD transferred) {
+    if(!connection->connected) {
+        if(!m_stopRequested) {
+            ListenForClient();
         }
-        std::vector<uint8_t> payload(header.payloadSize);
-        std::vector<uint8_t> binary(header.binarySize);
-        if(header.payloadSize > 0) {
-            DWORD payloadRead = 0;
-            if(!ReadFile(pipe, payload.data(), header.payloadSize, &payloadRead, nullptr)) {
-                break;
-            }
+        if(!succeeded) {
+            ClosePipeConnection(connection);
+            return;
         }
-        if(header.binarySize > 0) {
-            DWORD binaryRead = 0;
-            if(!ReadFile(pipe, binary.data(), header.binarySize, &binaryRead, nullptr)) {
-                break;
-            }
+        connection->connected = true;
+        {
+            std::lock_guard lock(m_clientMutex);
+            m_clients.push_back(connection->channel);
+        }
+        if(!ReadFromClient(connection)) {
+            ClosePipeConnection(connection);
         }
-        Message message = DeserializeMessage(header, payload, binary);
-        HandlePipeMessage(message, pipe);
+        return;
     }
 
+    if(!succeeded || transferred == 0
+       || !connection->channel->Feed(connection->buffer, transferred)
+       || !connection->channel->IsOpen()
+       || !ReadFromClient(connection)) {
+        ClosePipeConnection(connection);
+    }
+}
+
+bool InstanceManager::ReadFromClient(PipeConnection* connection) {
+    // Issued under the lock so a read can never slip in after StopPipeServer's cancel sweep.
+    std::lock_guard lock(m_clientMutex);
+    if(m_stopRequested) {
+        return false;
+    }
+    connection->overlapped = OVERLAPPED{};
+    return ReadFile(connection->pipe, connection->buffer, static_cast<DWORD>(sizeof(connection->buffer)), nullptr,
+               &connection->overlapped)
+        || GetLastError() == ERROR_IO_PENDING;
+}
+
+void InstanceManager::ClosePipeConnection(PipeConnection* connection) {
+    std::unique_ptr<PipeConnection> owned;
     {
         std::lock_guard lock(m_clientMutex);
-        auto it = std::remove_if(m_clients.begin(), m_clients.end(), [pipe](const std::unique_ptr<ClientContext>& ctx) {
-            return ctx->pipe == pipe;
-        });
-        m_clients.erase(it, m_clients.end());
+        m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), connection->channel), m_clients.end());
+        auto it = std::find_if(m_connections.begin(), m_connections.end(),
+            [connection](const std::unique_ptr<PipeConnection>& entry) { return entry.get() == connection; });
+        if(it != m_connections.end()) {
+            owned = std::move(*it);
+            m_connections.erase(it);
+        }
+        m_connectionsChanged.notify_all();
+    }
+    if(owned) {
+        // The pipe closes once broadcasts still holding the channel let go of it.
+        owned->channel->Close();
     }
-    CloseHandle(pipe);
 }
 
-void InstanceManager::HandlePipeMessage(const Message& message, HANDLE senderPipe) {
-    Publish(message);
-
-    switch(message.type) {
+void InstanceManager::HandlePipeMessage(const qttabbar::PipeMessageView& message, qttabbar::ByteSpan body,
+    qttabbar::MessageChannel* sender) {
+    // Subscribers take owning messages; unless one wants this topic, nothing is
+    // copied out of the frame.
+    auto type = static_cast<MessageType>(message.type);
+    std::wstring_view action;
+    if(type == MessageType::ExecuteAction || type == MessageType::Broadcast) {
+        action = AsWide(message.payload);
+    }
+    if(HasSubscribers(type, action)) {
+        Message owned;
+        owned.type = type;
+        owned.explorerHwnd = reinterpret_cast<HWND>(message.explorer);
+        owned.tabBarHwnd = reinterpret_cast<HWND>(message.tabBar);
+        owned.intValue = message.intValue;
+        owned.payload.assign(AsWide(message.payload));
+        owned.binaryPayload.assign(message.binary.data, message.binary.data + message.binary.size);
+        Publish(owned);
+    }
+
+    switch(type) {
     case MessageType::TabListChanged: {
-        TrayInstance instance;
-        instance.explorer = message.explorerHwnd;
-        instance.tabBar = message.tabBarHwnd;
-        instance.currentPath = message.payload;
-        if(!message.binaryPayload.empty()) {
-            const wchar_t* data = reinterpret_cast<const wchar_t*>(message.binaryPayload.data());
-            size_t total = message.binaryPayload.size() / sizeof(wchar_t);
-            size_t index = 0;
-            while(index < total) {
-                const wchar_t* namePtr = data + index;
-                size_t nameLen = wcslen(namePtr);
-                if(nameLen == 0) {
-                    break;
-                }
-                index += nameLen + 1;
-                if(index >= total) {
-                    break;
-                }
-                const wchar_t* pathPtr = data + index;
-                size_t pathLen = wcslen(pathPtr);
-                instance.tabNames.emplace_back(namePtr, nameLen);
-                instance.tabPaths.emplace_back(pathPtr, pathLen);
-                index += pathLen + 1;
+        // Windows of other processes are always sent whole.
+        qttabbar::TabList tabs;
+        tabs.currentPath.assign(AsWide(message.payload));
+        // name\0path\0... ending with an empty name.
+        std::u16string_view list(reinterpret_cast<const char16_t*>(message.binary.data),
+            message.binary.size / sizeof(char16_t));
+        while(!list.empty()) {
+            size_t nameLength = list.find(u'\0');
+            if(nameLength == 0 || nameLength == std::u16string_view::npos) {
+                break;
             }
+            std::u16string_view name = list.substr(0, nameLength);
+            list.remove_prefix(nameLength + 1);
+            if(list.empty()) {
+                break;
+            }
+            size_t pathLength = std::min(list.find(u'\0'), list.size());
+            tabs.tabNames.emplace_back(AsWide(name));
+            tabs.tabPaths.emplace_back(AsWide(list.substr(0, pathLength)));
+            list.remove_prefix(std::min(pathLength + 1, list.size()));
         }
-        UpdateTrayIcon([&](TrayIconManager& tray) { tray.AddOrUpdate(instance); });
+        UpdateTrayIcon([&](TrayIconManager& tray) {
+            tray.AddOrUpdate(reinterpret_cast<HWND>(message.explorer), reinterpret_cast<HWND>(message.tabBar),
+                std::move(tabs));
+        });
         break;
     }
     case MessageType::SelectionChanged:
-        NotifySelectionChanged(message.tabBarHwnd, message.intValue);
+        NotifySelectionChanged(reinterpret_cast<HWND>(message.tabBar), message.intValue);
         break;
     case MessageType::RegisterTabBar:
     case MessageType::UnregisterTabBar:
@@ -632,22 +978,38 @@ void InstanceManager::HandlePipeMessage(const Message& message, HANDLE senderPip
         break;
     case MessageType::ExecuteAction:
     case MessageType::Broadcast: {
+        // Handlers take owning strings, so they are filled from per-thread
+        // buffers that keep their capacity from one message to the next.
+        struct ActionBuffers {
+            std::wstring action;
+            std::wstring text;
+            std::vector<uint8_t> binary;
+            bool inUse = false;
+        };
+        thread_local ActionBuffers reused;
+        ActionBuffers nested;
+        ActionBuffers& buffers = reused.inUse ? nested : reused;
+
         ActionHandler handler;
+        buffers.action.assign(action);
         {
             std::lock_guard lock(m_actionMutex);
-            auto it = m_actionHandlers.find(message.payload);
+            auto it = m_actionHandlers.find(buffers.action);
             if(it != m_actionHandlers.end()) {
                 handler = it->second;
             }
         }
-        std::wstring textPayload;
-        std::vector<uint8_t> binary;
-        UnpackActionPayload(message.binaryPayload, textPayload, binary);
         if(handler) {
-            handler(textPayload, binary);
+            qttabbar::ActionArgumentsView arguments = qttabbar::DecodeActionArguments(message.binary);
+            buffers.text.assign(AsWide(arguments.text));
+            buffers.binary.assign(arguments.binary.data, arguments.binary.data + arguments.binary.size);
+            buffers.inUse = true;
+            handler(buffers.text, buffers.binary);
+            buffers.inUse = false;
         }
-        if(message.type == MessageType::Broadcast) {
-            BroadcastPipeMessage(message, senderPipe);
+        if(type == MessageType::Broadcast && m_isServer) {
+            // Forwarded exactly as received.
+            BroadcastPipeMessage(&body, 1, sender);
         }
         break;
     }
@@ -657,49 +1019,83 @@ void InstanceManager::HandlePipeMessage(const Message& message, HANDLE senderPip
     }
 }
 
-void InstanceManager::SendPipeMessage(HANDLE pipe, const Message& message) {
-    PipeMessageHeader header{};
-    header.magic = kPipeMagic;
-    header.version = kPipeVersion;
-    header.type = message.type;
-    header.explorerHwnd = reinterpret_cast<uint64_t>(message.explorerHwnd);
-    header.tabBarHwnd = reinterpret_cast<uint64_t>(message.tabBarHwnd);
-    header.intValue = message.intValue;
-    header.payloadSize = static_cast<uint32_t>(message.payload.size() * sizeof(wchar_t));
-    header.binarySize = static_cast<uint32_t>(message.binaryPayload.size());
-
-    DWORD written = 0;
-    WriteFile(pipe, &header, sizeof(header), &written, nullptr);
-    if(header.payloadSize > 0) {
-        WriteFile(pipe, message.payload.data(), header.payloadSize, &written, nullptr);
+void InstanceManager::BroadcastPipeMessage(const qttabbar::ByteSpan* segments, size_t count,
+    qttabbar::MessageChannel* sender) {
+    // Reused per thread so fanning out does not allocate; emptied before returning.
+    thread_local std::vector<std::shared_ptr<qttabbar::MessageChannel>> targets;
+    {
+        std::lock_guard lock(m_clientMutex);
+        for(const auto& client : m_clients) {
+            if(client.get() != sender) {
+                targets.push_back(client);
+            }
+        }
     }
-    if(header.binarySize > 0) {
-        WriteFile(pipe, message.binaryPayload.data(), header.binarySize, &written, nullptr);
+    for(const auto& target : targets) {
+        target->Post(segments, count);
     }
+    targets.clear();
 }
 
-void InstanceManager::BroadcastPipeMessage(const Message& message, HANDLE senderPipe) {
-    std::lock_guard lock(m_clientMutex);
-    for(auto& client : m_clients) {
-        if(client->pipe != senderPipe && client->pipe != INVALID_HANDLE_VALUE) {
-            SendPipeMessage(client->pipe, message);
+std::shared_ptr<qttabbar::MessageChannel> InstanceManager::GetServerChannel() {
+    std::shared_ptr<qttabbar::MessageChannel> stale;
+    std::shared_ptr<qttabbar::MessageChannel> channel;
+    {
+        std::lock_guard lock(m_serverChannelMutex);
+        if(m_serverChannel && m_serverChannel->IsOpen()) {
+            return m_serverChannel;
+        }
+        // The server went away or was replaced; whoever owns the pipe now gets a new connection.
+        stale = std::move(m_serverChannel);
+        if(!m_stopRequested) {
+            HANDLE pipe = CreateFileW(kPipeName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                FILE_FLAG_OVERLAPPED, nullptr);
+            if(pipe == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY
+               && WaitNamedPipeW(kPipeName, kPipeBusyWaitMs)) {
+                pipe = CreateFileW(kPipeName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                    FILE_FLAG_OVERLAPPED, nullptr);
+            }
+            if(pipe != INVALID_HANDLE_VALUE) {
+                // The server pushes broadcasts from other processes down the same connection.
+                channel = std::make_shared<qttabbar::MessageChannel>(std::make_unique<PipeTransport>(pipe),
+                    [this](qttabbar::MessageChannel&, qttabbar::FrameKind, uint64_t, qttabbar::ByteSpan body) {
+                        qttabbar::PipeMessageView message;
+                        if(qttabbar::DecodePipeMessage(body, message)) {
+                            HandlePipeMessage(message, body, nullptr);
+                        }
+                    });
+                channel->Start();
+                m_serverChannel = channel;
+            }
         }
     }
+    // Closing waits for the old reader, which may itself be waiting on the lock above.
+    if(stale) {
+        stale->Close();
+    }
+    return channel;
 }
 
-InstanceManager::Message InstanceManager::DeserializeMessage(const PipeMessageHeader& header,
-    const std::vector<uint8_t>& payload,
-    const std::vector<uint8_t>& binaryPayload) const {
-    Message message;
-    message.type = header.type;
-    message.explorerHwnd = reinterpret_cast<HWND>(header.explorerHwnd);
-    message.tabBarHwnd = reinterpret_cast<HWND>(header.tabBarHwnd);
-    message.intValue = header.intValue;
-    if(header.payloadSize > 0) {
-        message.payload.assign(reinterpret_cast<const wchar_t*>(payload.data()), payload.size() / sizeof(wchar_t));
+bool InstanceManager::SendToServer(const qttabbar::PipeMessageWriter& message, bool waitForReply) {
+    // A second attempt covers a connection that broke since it was last used.
+    for(int attempt = 0; attempt < 2; ++attempt) {
+        auto channel = GetServerChannel();
+        if(!channel) {
+            return false;
+        }
+        std::vector<uint8_t> reply;
+        bool sent = waitForReply
+            ? channel->Call(message.Segments(), message.SegmentCount(), reply, kServerCallTimeout)
+            : channel->Post(message.Segments(), message.SegmentCount());
+        if(sent) {
+            return true;
+        }
+        if(channel->IsOpen()) {
+            // Timed out; the server may still act on it, so do not send it twice.
+            return false;
+        }
     }
-    message.binaryPayload = binaryPayload;
-    return message;
+    return false;
 }
 
 void InstanceManager::RegisterTabHost(HWND explorerHwnd, QTTabBarClass* tabBar) {
@@ -801,16 +1197,30 @@ void InstanceManager::UnregisterAutoLoader(AutoLoaderNative* loader) {
 
 void InstanceManager::PushTabList(HWND explorerHwnd, HWND tabBarHwnd, const TabSnapshot& snapshot) {
     EnsureInitialized();
-    TrayInstance instance;
-    instance.explorer = explorerHwnd;
-    instance.tabBar = tabBarHwnd;
-    instance.currentPath = snapshot.currentPath;
-    instance.tabNames = snapshot.tabNames;
-    instance.tabPaths = snapshot.tabPaths;
-    UpdateTrayIcon([&](TrayIconManager& tray) { tray.AddOrUpdate(instance); });
+    if(m_isServer) {
+        // The tray is only sent what changed since this window last went there.
+        qttabbar::TabListDelta delta;
+        {
+            std::lock_guard lock(m_trayTabsMutex);
+            for(auto it = m_trayTabLists.begin(); it != m_trayTabLists.end();) {
+                if(it->first != tabBarHwnd && !::IsWindow(it->first)) {
+                    it = m_trayTabLists.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            qttabbar::TabList& sent = m_trayTabLists[tabBarHwnd];
+            delta = qttabbar::DiffTabLists(sent, snapshot);
+            qttabbar::ApplyTabListDelta(sent, delta);
+        }
+        UpdateTrayIcon([&](TrayIconManager& tray) { tray.AddOrUpdate(explorerHwnd, tabBarHwnd, std::move(delta)); });
+    }
 
     SetSelectedTabs(explorerHwnd, snapshot.tabPaths);
 
+    if(!HasSubscribers(MessageType::TabListChanged, {})) {
+        return;
+    }
     Message message;
     message.type = MessageType::TabListChanged;
     message.explorerHwnd = explorerHwnd;
@@ -863,31 +1273,32 @@ void InstanceManager::NotifySelectionChanged(HWND tabBarHwnd, int index) {
 }
 
 InstanceManager::SubscriptionId InstanceManager::Subscribe(MessageCallback callback) {
-    std::lock_guard lock(m_subscriptionMutex);
-    SubscriptionId id = m_nextSubscriptionId++;
-    m_subscribers.emplace_back(id, std::move(callback));
-    return id;
+    return m_subscriptions.Subscribe(kAnyMessageType, std::wstring(), std::move(callback));
+}
+
+InstanceManager::SubscriptionId InstanceManager::Subscribe(MessageType type, MessageCallback callback) {
+    return m_subscriptions.Subscribe(static_cast<uint32_t>(type), std::wstring(), std::move(callback));
+}
+
+InstanceManager::SubscriptionId InstanceManager::Subscribe(MessageType type, const std::wstring& action,
+    MessageCallback callback) {
+    return m_subscriptions.Subscribe(static_cast<uint32_t>(type), action, std::move(callback));
 }
 
 void InstanceManager::Unsubscribe(SubscriptionId token) {
-    std::lock_guard lock(m_subscriptionMutex);
-    m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(),
-        [token](const auto& entry) { return entry.first == token; }), m_subscribers.end());
+    m_subscriptions.Unsubscribe(token);
+}
+
+bool InstanceManager::HasSubscribers(MessageType type, std::wstring_view action) const {
+    return m_subscriptions.HasSubscribers(static_cast<uint32_t>(type), action);
 }
 
 void InstanceManager::Publish(const Message& message) {
-    std::vector<MessageCallback> callbacks;
-    {
-        std::lock_guard lock(m_subscriptionMutex);
-        for(const auto& [id, callback] : m_subscribers) {
-            if(callback) {
-                callbacks.push_back(callback);
-            }
-        }
-    }
-    for(auto& callback : callbacks) {
-        callback(message);
+    std::wstring_view action;
+    if(message.type == MessageType::ExecuteAction || message.type == MessageType::Broadcast) {
+        action = message.payload;
     }
+    m_subscriptions.Publish(static_cast<uint32_t>(message.type), action, message);
 }
 
 void InstanceManager::RegisterActionHandler(const std::wstring& action, ActionHandler handler) {
@@ -921,24 +1332,17 @@ bool InstanceManager::ExecuteOnMainProcess(const std::wstring& action, const std
                 handler(payload, binaryPayload);
             }
         };
-        if(doAsync) {
-            std::thread(std::move(invoke)).detach();
-        } else {
+        if(!doAsync || !m_actionExecutor.TrySubmit(invoke)) {
+            // A saturated executor runs the action on the caller rather than dropping it.
             invoke();
         }
         return true;
     }
 
-    HANDLE pipe = CreateFileW(kPipeName, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
-    if(pipe == INVALID_HANDLE_VALUE) {
-        return false;
-    }
-    Message message;
-    message.type = MessageType::ExecuteAction;
-    message.payload = action;
-    message.binaryPayload = PackActionPayload(payload, binaryPayload);
-    SendPipeMessage(pipe, message);
-    CloseHandle(pipe);
+    // Synchronous calls wait until the server has run the handler.
+    qttabbar::PipeMessageWriter message(static_cast<uint32_t>(MessageType::ExecuteAction),
+        AsUtf16(action), AsUtf16(payload), AsBytes(binaryPayload));
+    SendToServer(message, !doAsync);
     return false;
 }
 
@@ -949,34 +1353,27 @@ void InstanceManager::ExecuteOnServerProcess(const std::wstring& action, const s
         ExecuteOnMainProcess(action, payload, binaryPayload, doAsync);
         return;
     }
-    HANDLE pipe = CreateFileW(kPipeName, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
-    if(pipe == INVALID_HANDLE_VALUE) {
-        return;
-    }
-    Message message;
-    message.type = MessageType::ExecuteAction;
-    message.payload = action;
-    message.binaryPayload = PackActionPayload(payload, binaryPayload);
-    SendPipeMessage(pipe, message);
-    CloseHandle(pipe);
+    qttabbar::PipeMessageWriter message(static_cast<uint32_t>(MessageType::ExecuteAction),
+        AsUtf16(action), AsUtf16(payload), AsBytes(binaryPayload));
+    SendToServer(message, !doAsync);
 }
 
 void InstanceManager::Broadcast(const std::wstring& action, const std::wstring& payload,
     const std::vector<uint8_t>& binaryPayload) {
     EnsureInitialized();
-    Message message;
-    message.type = MessageType::Broadcast;
-    message.payload = action;
-    message.binaryPayload = PackActionPayload(payload, binaryPayload);
-    Publish(message);
+    if(HasSubscribers(MessageType::Broadcast, action)) {
+        Message local;
+        local.type = MessageType::Broadcast;
+        local.payload = action;
+        local.binaryPayload = PackActionPayload(payload, binaryPayload);
+        Publish(local);
+    }
+    qttabbar::PipeMessageWriter message(static_cast<uint32_t>(MessageType::Broadcast),
+        AsUtf16(action), AsUtf16(payload), AsBytes(binaryPayload));
     if(m_isServer) {
-        BroadcastPipeMessage(message, nullptr);
+        BroadcastPipeMessage(message.Segments(), message.SegmentCount(), nullptr);
     } else {
-        HANDLE pipe = CreateFileW(kPipeName, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
-        if(pipe != INVALID_HANDLE_VALUE) {
-            SendPipeMessage(pipe, message);
-            CloseHandle(pipe);
-        }
+        SendToServer(message, false);
     }
 }
 
@@ -1025,6 +1422,16 @@ void InstanceManager::UpdateTrayIcon(std::function<void(TrayIconManager&)> actio
     }
 }
 
+bool InstanceManager::CopyTrayTabList(HWND tabBarHwnd, qttabbar::TabList& tabs) const {
+    std::lock_guard lock(m_trayTabsMutex);
+    auto it = m_trayTabLists.find(tabBarHwnd);
+    if(it == m_trayTabLists.end()) {
+        return false;
+    }
+    tabs = it->second;
+    return true;
+}
+
 void InstanceManager::Log(const wchar_t* format, ...) const {
     wchar_t buffer[512];
     va_list args;
@@ -2,12 +2,20 @@
 
 #include <windows.h>
 
+#include "BoundedExecutor.h"
+#include "MessageChannel.h"
+#include "PipeMessageCodec.h"
+#include "TabListDelta.h"
+#include "TopicRegistry.h"
+
 #include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -22,11 +30,8 @@ class AutoLoaderNative;
 // through a lightweight named-pipe based pub/sub layer and owns the native tray icon.
 class InstanceManager {
 public:
-    struct TabSnapshot {
-        std::wstring currentPath;
-        std::vector<std::wstring> tabNames;
-        std::vector<std::wstring> tabPaths;
-    };
+    // PushTabList keeps its own versions; the one passed in is ignored.
+    using TabSnapshot = qttabbar::TabList;
 
     enum class MessageType : uint32_t {
         Subscribe = 1,
@@ -80,7 +85,12 @@ public:
     void NotifySelectionChanged(HWND tabBarHwnd, int index);
 
     // Cross-process coordination -------------------------------------------
+    // Subscribers run only for the topics they asked for; the first overload
+    // receives everything. Action names are carried by ExecuteAction and
+    // Broadcast messages.
     SubscriptionId Subscribe(MessageCallback callback);
+    SubscriptionId Subscribe(MessageType type, MessageCallback callback);
+    SubscriptionId Subscribe(MessageType type, const std::wstring& action, MessageCallback callback);
     void Unsubscribe(SubscriptionId token);
     void Publish(const Message& message);
 
@@ -103,22 +113,6 @@ public:
     void Log(const wchar_t* format, ...) const;
 
 private:
-    struct PipeMessageHeader {
-        uint32_t magic;
-        uint32_t version;
-        MessageType type;
-        uint64_t explorerHwnd;
-        uint64_t tabBarHwnd;
-        int32_t intValue;
-        uint32_t payloadSize;
-        uint32_t binarySize;
-    };
-
-    struct ClientContext {
-        HANDLE pipe = INVALID_HANDLE_VALUE;
-        std::atomic<bool> connected{false};
-    };
-
     struct TabRegistration {
         HWND explorer{};
         QTTabBarClass* tabBar{};
@@ -137,13 +131,14 @@ private:
         AutoLoaderNative* loader{};
     };
 
+    // Windows stay known to the tray after they are restored, so sending one
+    // back only carries what changed in between.
     struct TrayInstance {
         HWND explorer{};
         HWND tabBar{};
-        std::wstring currentPath;
-        std::vector<std::wstring> tabNames;
-        std::vector<std::wstring> tabPaths;
+        qttabbar::TabList tabs;
         int showWindowCode{};
+        bool inTray{};
     };
 
     class TrayIconManager;
@@ -154,25 +149,38 @@ private:
     InstanceManager(const InstanceManager&) = delete;
     InstanceManager& operator=(const InstanceManager&) = delete;
 
-    void StartServerThread();
-    void StopServerThread();
-    void ServerThreadProc();
-    void HandleClient(HANDLE pipe);
-    void HandlePipeMessage(const Message& message, HANDLE senderPipe);
-    void SendPipeMessage(HANDLE pipe, const Message& message);
-    void BroadcastPipeMessage(const Message& message, HANDLE senderPipe);
-
-    Message DeserializeMessage(const PipeMessageHeader& header, const std::vector<uint8_t>& payload,
-                               const std::vector<uint8_t>& binaryPayload) const;
+    // Server side: pipe instances served by a fixed pool of workers blocked on
+    // one completion port.
+    struct PipeConnection;
+    void StartPipeServer();
+    void StopPipeServer();
+    bool PipeWorkersExited();
+    void PipeWorkerProc();
+    bool ListenForClient();
+    void OnPipeCompletion(PipeConnection* connection, bool succeeded, DWORD transferred);
+    bool ReadFromClient(PipeConnection* connection);
+    void ClosePipeConnection(PipeConnection* connection);
+    // `body` is the encoded form of `message`, which views into it.
+    void HandlePipeMessage(const qttabbar::PipeMessageView& message, qttabbar::ByteSpan body,
+                           qttabbar::MessageChannel* sender);
+    void BroadcastPipeMessage(const qttabbar::ByteSpan* segments, size_t count, qttabbar::MessageChannel* sender);
+
+    // Client side: one connection to the server process, reopened on demand.
+    std::shared_ptr<qttabbar::MessageChannel> GetServerChannel();
+    bool SendToServer(const qttabbar::PipeMessageWriter& message, bool waitForReply);
+
+    bool HasSubscribers(MessageType type, std::wstring_view action) const;
 
     std::wstring FormatExplorerKey(HWND explorerHwnd) const;
 
     void UpdateTrayIcon(std::function<void(TrayIconManager&)> action);
+    // The tray's way back when it missed a delta for a window of this process.
+    bool CopyTrayTabList(HWND tabBarHwnd, qttabbar::TabList& tabs) const;
 
-    static constexpr uint32_t kPipeMagic = 0x51545442; // 'QTTB'
-    static constexpr uint32_t kPipeVersion = 1;
     static constexpr wchar_t kPipeName[] = L"\\\\.\\pipe\\QTTabBar_InstanceManager";
     static constexpr wchar_t kServerMutexName[] = L"Global\\QTTabBar_InstanceManager_Server";
+    static constexpr size_t kActionThreadCount = 4;
+    static constexpr size_t kActionQueueCapacity = 64;
 
     mutable std::shared_mutex m_tabLock;
     std::unordered_map<QTTabBarClass*, TabRegistration> m_tabRegistrations;
@@ -183,24 +191,36 @@ private:
     mutable std::shared_mutex m_selectionLock;
     std::unordered_map<std::wstring, std::vector<std::wstring>> m_selectedTabs;
 
-    mutable std::mutex m_subscriptionMutex;
-    std::vector<std::pair<SubscriptionId, MessageCallback>> m_subscribers;
-    SubscriptionId m_nextSubscriptionId = 1;
+    static constexpr uint32_t kAnyMessageType = qttabbar::TopicRegistry<Message>::kAnyType;
+    qttabbar::TopicRegistry<Message> m_subscriptions;
 
     mutable std::mutex m_actionMutex;
     std::unordered_map<std::wstring, ActionHandler> m_actionHandlers;
 
     mutable std::mutex m_clientMutex;
-    std::vector<std::unique_ptr<ClientContext>> m_clients;
+    std::vector<std::shared_ptr<qttabbar::MessageChannel>> m_clients;
+    // Every pipe instance, listening or connected.
+    std::vector<std::unique_ptr<PipeConnection>> m_connections;
+    std::condition_variable m_connectionsChanged;
+
+    std::mutex m_serverChannelMutex;
+    std::shared_ptr<qttabbar::MessageChannel> m_serverChannel;
 
     std::once_flag m_initOnce;
     HANDLE m_serverMutex = nullptr;
-    std::thread m_serverThread;
+    HANDLE m_completionPort = nullptr;
+    std::vector<std::thread> m_pipeWorkers;
     std::atomic<bool> m_stopRequested{false};
     bool m_isServer = false;
 
+    // What the tray was last sent per tab bar, for diffing the next push.
+    mutable std::mutex m_trayTabsMutex;
+    std::unordered_map<HWND, qttabbar::TabList> m_trayTabLists;
     std::unique_ptr<TrayIconManager> m_trayIconManager;
 
+    // Runs ExecuteOnMainProcess actions requested with doAsync.
+    qttabbar::BoundedExecutor m_actionExecutor{kActionThreadCount, kActionQueueCapacity};
+
     SelectionCallback m_selectionCallback;
     mutable std::mutex m_selectionCallbackMutex;
 
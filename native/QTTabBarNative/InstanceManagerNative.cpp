@@ -25,10 +25,10 @@ InstanceManagerNative::InstanceManagerNative() {
         OnSelectionRequested(tabBarHwnd, index);
     });
 
-    qttabbar::ConfigData config = qttabbar::LoadConfigFromRegistry();
+    auto config = qttabbar::GetConfigSnapshot();
     qttabbar::AppsManagerNative::Instance().Reload();
     SetDesktopApplications(qttabbar::AppsManagerNative::Instance().BuildDesktopApplications());
-    qttabbar::RecentFileHistoryNative::Instance().Reload(config.misc.fileHistoryCount);
+    qttabbar::RecentFileHistoryNative::Instance().Reload(config->value.misc.fileHistoryCount);
     SetDesktopRecentFiles(qttabbar::RecentFileHistoryNative::Instance().GetRecentFiles());
 }
 
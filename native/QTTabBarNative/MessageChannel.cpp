@@ -0,0 +1,277 @@
+#include "MessageChannel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// Receive buffers grown past this by an outsized frame are released afterwards.
+constexpr std::size_t kRetainedReceiveCapacity = 256 * 1024;
+
+} // namespace
+
+namespace qttabbar {
+
+static_assert(sizeof(FrameHeader) == 24, "FrameHeader is part of the wire format.");
+static_assert(sizeof(FrameHeader) % MessageChannel::kBodyAlignment == 0,
+    "Bodies follow their header and must stay aligned.");
+
+bool IChannelTransport::WriteGather(const ByteSpan* buffers, std::size_t count) {
+    for(std::size_t i = 0; i < count; ++i) {
+        if(!Write(buffers[i].data, buffers[i].size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+MessageChannel::MessageChannel(std::unique_ptr<IChannelTransport> transport, FrameHandler onFrame)
+    : m_transport(std::move(transport))
+    , m_onFrame(std::move(onFrame)) {
+}
+
+MessageChannel::~MessageChannel() {
+    Close();
+    if(m_thread.joinable()) {
+        // Only left joinable when the reading thread drops the last reference.
+        m_thread.detach();
+    }
+}
+
+void MessageChannel::Start() {
+    // The thread keeps the channel alive, so a handler may drop the owner's
+    // reference without pulling the channel out from under the read loop.
+    std::shared_ptr<MessageChannel> self = shared_from_this();
+    std::lock_guard lock(m_threadMutex);
+    m_thread = std::thread([self]() { self->Run(); });
+}
+
+void MessageChannel::Run() {
+    m_readerId = std::this_thread::get_id();
+    FrameHeader header{};
+    while(m_transport->Read(&header, sizeof(header))) {
+        if(!IsValidHeader(header)) {
+            break;
+        }
+        m_receiveBuffer.resize(header.length);
+        if(header.length > 0 && !m_transport->Read(m_receiveBuffer.data(), header.length)) {
+            break;
+        }
+        DispatchFrame(header, ByteSpan{m_receiveBuffer.data(), header.length});
+        ResetReceiveBuffer();
+    }
+    m_open = false;
+    m_transport->Shutdown();
+    FailPendingCalls();
+}
+
+bool MessageChannel::Feed(const void* data, std::size_t size) {
+    const auto* bytes = static_cast<const std::uint8_t*>(data);
+    // Calls made by the handler cannot be answered until Feed returns.
+    m_readerId = std::this_thread::get_id();
+    bool valid = true;
+    while(valid && size > 0) {
+        FrameHeader header{};
+        if(m_receiveBuffer.empty() && size >= sizeof(header)
+           && reinterpret_cast<std::uintptr_t>(bytes) % kBodyAlignment == 0) {
+            std::memcpy(&header, bytes, sizeof(header));
+            if(!IsValidHeader(header)) {
+                valid = false;
+                break;
+            }
+            std::size_t frameSize = sizeof(header) + header.length;
+            if(size >= frameSize) {
+                // Whole frames in the caller's buffer are dispatched where they lie.
+                DispatchFrame(header, ByteSpan{bytes + sizeof(header), header.length});
+                bytes += frameSize;
+                size -= frameSize;
+                continue;
+            }
+        }
+
+        // Anything else is assembled in the receive buffer, one frame at a time.
+        std::size_t wanted = sizeof(header);
+        if(m_receiveBuffer.size() >= sizeof(header)) {
+            std::memcpy(&header, m_receiveBuffer.data(), sizeof(header));
+            wanted += header.length;
+        }
+        std::size_t take = std::min(size, wanted - m_receiveBuffer.size());
+        m_receiveBuffer.insert(m_receiveBuffer.end(), bytes, bytes + take);
+        bytes += take;
+        size -= take;
+        if(m_receiveBuffer.size() < wanted) {
+            continue;
+        }
+        if(wanted == sizeof(header)) {
+            std::memcpy(&header, m_receiveBuffer.data(), sizeof(header));
+            if(!IsValidHeader(header)) {
+                valid = false;
+                break;
+            }
+            if(header.length > 0) {
+                continue;
+            }
+        }
+        DispatchFrame(header, ByteSpan{m_receiveBuffer.data() + sizeof(header), header.length});
+        ResetReceiveBuffer();
+    }
+    m_readerId = std::thread::id();
+    return valid;
+}
+
+void MessageChannel::Close() {
+    m_open = false;
+    m_transport->Shutdown();
+    FailPendingCalls();
+    if(OnReadingThread()) {
+        return;
+    }
+    std::lock_guard lock(m_threadMutex);
+    if(m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool MessageChannel::Post(const Body& body) {
+    ByteSpan segment{body.data(), body.size()};
+    return Post(&segment, 1);
+}
+
+bool MessageChannel::Post(const ByteSpan* segments, std::size_t count) {
+    return SendFrame(FrameKind::Post, m_nextSequence++, segments, count);
+}
+
+bool MessageChannel::Call(const Body& body, Body& reply, std::chrono::milliseconds timeout) {
+    ByteSpan segment{body.data(), body.size()};
+    return Call(&segment, 1, reply, timeout);
+}
+
+bool MessageChannel::Call(const ByteSpan* segments, std::size_t count, Body& reply,
+                          std::chrono::milliseconds timeout) {
+    reply.clear();
+    std::uint64_t sequence = m_nextSequence++;
+    if(OnReadingThread()) {
+        return SendFrame(FrameKind::Request, sequence, segments, count);
+    }
+
+    PendingCall call;
+    {
+        std::lock_guard lock(m_pendingMutex);
+        if(!m_open) {
+            return false;
+        }
+        m_pending.emplace_back(sequence, &call);
+    }
+
+    bool sent = SendFrame(FrameKind::Request, sequence, segments, count);
+
+    std::unique_lock lock(m_pendingMutex);
+    if(sent) {
+        m_pendingChanged.wait_for(lock, timeout, [&call]() { return call.done; });
+    }
+    m_pending.erase(std::find_if(m_pending.begin(), m_pending.end(),
+        [sequence](const auto& entry) { return entry.first == sequence; }));
+    if(!call.succeeded) {
+        return false;
+    }
+    reply = std::move(call.reply);
+    return true;
+}
+
+bool MessageChannel::Respond(std::uint64_t sequence, const Body& body) {
+    ByteSpan segment{body.data(), body.size()};
+    return SendFrame(FrameKind::Response, sequence, &segment, 1);
+}
+
+bool MessageChannel::IsValidHeader(const FrameHeader& header) {
+    return header.magic == kFrameMagic && header.length <= kMaxBodySize;
+}
+
+bool MessageChannel::SendFrame(FrameKind kind, std::uint64_t sequence, const ByteSpan* segments, std::size_t count) {
+    if(count > kMaxSegments) {
+        return false;
+    }
+    FrameHeader header{};
+    ByteSpan buffers[kMaxSegments + 1];
+    buffers[0] = ByteSpan{reinterpret_cast<const std::uint8_t*>(&header), sizeof(header)};
+    std::size_t used = 1;
+    std::size_t length = 0;
+    for(std::size_t i = 0; i < count; ++i) {
+        if(segments[i].size > 0) {
+            buffers[used++] = segments[i];
+            length += segments[i].size;
+        }
+    }
+    if(length > kMaxBodySize) {
+        return false;
+    }
+    header.magic = kFrameMagic;
+    header.kind = kind;
+    header.sequence = sequence;
+    header.length = static_cast<std::uint32_t>(length);
+
+    std::lock_guard lock(m_writeMutex);
+    if(!m_open) {
+        return false;
+    }
+    if(!m_transport->WriteGather(buffers, used)) {
+        // A partial frame leaves the stream unusable.
+        m_open = false;
+        m_transport->Shutdown();
+        return false;
+    }
+    return true;
+}
+
+void MessageChannel::DispatchFrame(const FrameHeader& header, ByteSpan body) {
+    switch(header.kind) {
+    case FrameKind::Response:
+        CompleteCall(header.sequence, body);
+        break;
+    case FrameKind::Post:
+    case FrameKind::Request:
+        if(m_onFrame) {
+            m_onFrame(*this, header.kind, header.sequence, body);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void MessageChannel::ResetReceiveBuffer() {
+    if(m_receiveBuffer.capacity() > kRetainedReceiveCapacity) {
+        Body().swap(m_receiveBuffer);
+    } else {
+        m_receiveBuffer.clear();
+    }
+}
+
+void MessageChannel::CompleteCall(std::uint64_t sequence, ByteSpan body) {
+    std::lock_guard lock(m_pendingMutex);
+    auto it = std::find_if(m_pending.begin(), m_pending.end(),
+        [sequence](const auto& entry) { return entry.first == sequence; });
+    if(it == m_pending.end()) {
+        // The caller gave up waiting.
+        return;
+    }
+    it->second->reply.assign(body.data, body.data + body.size);
+    it->second->succeeded = true;
+    it->second->done = true;
+    m_pendingChanged.notify_all();
+}
+
+void MessageChannel::FailPendingCalls() {
+    std::lock_guard lock(m_pendingMutex);
+    for(auto& [sequence, call] : m_pending) {
+        call->done = true;
+    }
+    m_pendingChanged.notify_all();
+}
+
+bool MessageChannel::OnReadingThread() const {
+    return m_readerId.load() == std::this_thread::get_id();
+}
+
+} // namespace qttabbar
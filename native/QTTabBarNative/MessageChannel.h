@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace qttabbar {
+
+// Non-owning view of a byte range.
+struct ByteSpan {
+    const std::uint8_t* data = nullptr;
+    std::size_t size = 0;
+};
+
+// Blocking, full-duplex byte stream a MessageChannel runs over. Reads happen
+// on one thread while writes may come from another.
+class IChannelTransport {
+public:
+    virtual ~IChannelTransport() = default;
+
+    // Writes all of `size` bytes; false once the stream is broken.
+    virtual bool Write(const void* data, std::size_t size) = 0;
+    // Writes the buffers back to back. The default issues one Write per buffer;
+    // transports that can hand a whole frame to the system at once override it.
+    virtual bool WriteGather(const ByteSpan* buffers, std::size_t count);
+    // Reads exactly `size` bytes; false at end of stream or on error.
+    virtual bool Read(void* data, std::size_t size) = 0;
+    // Makes blocked and later Read/Write calls fail. Callable from any thread.
+    virtual void Shutdown() = 0;
+};
+
+enum class FrameKind : std::uint32_t {
+    Post = 1,     // No reply expected
+    Request = 2,  // Answered by a Response carrying the same sequence
+    Response = 3,
+};
+
+struct FrameHeader {
+    std::uint32_t magic;
+    FrameKind kind;
+    std::uint64_t sequence;
+    std::uint32_t length;  // Body bytes that follow
+    std::uint32_t reserved;
+};
+
+// Length-prefixed frames over one long-lived connection. Requests are matched
+// to their responses by sequence number, so any number of threads can have
+// calls in flight while posts flow in both directions.
+//
+// Incoming posts and requests are handed to the frame handler on the reading
+// thread, in arrival order, as views into a buffer the channel reuses; once
+// warmed up, neither receiving nor sending a post allocates. Reading runs on a thread of the channel's own
+// (Start, which needs the channel to be owned by a shared_ptr), on the
+// caller's (Run), or is driven from outside by passing received bytes to Feed;
+// in that case the transport is only used for writing.
+class MessageChannel : public std::enable_shared_from_this<MessageChannel> {
+public:
+    using Body = std::vector<std::uint8_t>;
+    // Requests are answered with Respond, from the handler or later. `body` is
+    // only valid during the call and starts on a kBodyAlignment boundary.
+    using FrameHandler = std::function<void(MessageChannel& channel, FrameKind kind, std::uint64_t sequence, ByteSpan body)>;
+
+    static constexpr std::uint32_t kFrameMagic = 0x43465451; // 'QTFC'
+    static constexpr std::uint32_t kMaxBodySize = 64 * 1024 * 1024;
+    static constexpr std::size_t kBodyAlignment = 8;
+    // Bodies given as segments are sent with one gathered write.
+    static constexpr std::size_t kMaxSegments = 7;
+
+    MessageChannel(std::unique_ptr<IChannelTransport> transport, FrameHandler onFrame);
+    ~MessageChannel();
+
+    MessageChannel(const MessageChannel&) = delete;
+    MessageChannel& operator=(const MessageChannel&) = delete;
+
+    void Start();
+    // Reads until the connection ends or Close is called.
+    void Run();
+    // Consumes bytes received by the owner and dispatches every frame they
+    // complete. Calls must not overlap. Returns false on malformed input,
+    // after which the channel should be closed.
+    bool Feed(const void* data, std::size_t size);
+    // Ends the connection and fails calls in flight. Waits for the thread
+    // started by Start unless called on it.
+    void Close();
+    bool IsOpen() const { return m_open; }
+
+    bool Post(const Body& body);
+    bool Post(const ByteSpan* segments, std::size_t count);
+    // Sends a request and waits for its response. On the reading thread the
+    // reply could never be read, so the request is only sent and `reply` is
+    // left empty.
+    bool Call(const Body& body, Body& reply, std::chrono::milliseconds timeout);
+    bool Call(const ByteSpan* segments, std::size_t count, Body& reply, std::chrono::milliseconds timeout);
+    bool Respond(std::uint64_t sequence, const Body& body);
+
+private:
+    struct PendingCall {
+        bool done = false;
+        bool succeeded = false;
+        Body reply;
+    };
+
+    static bool IsValidHeader(const FrameHeader& header);
+
+    bool SendFrame(FrameKind kind, std::uint64_t sequence, const ByteSpan* segments, std::size_t count);
+    void DispatchFrame(const FrameHeader& header, ByteSpan body);
+    void ResetReceiveBuffer();
+    void CompleteCall(std::uint64_t sequence, ByteSpan body);
+    void FailPendingCalls();
+    bool OnReadingThread() const;
+
+    std::unique_ptr<IChannelTransport> m_transport;
+    FrameHandler m_onFrame;
+    std::atomic<bool> m_open{true};
+    std::atomic<std::uint64_t> m_nextSequence{1};
+    std::atomic<std::thread::id> m_readerId{};
+
+    std::mutex m_writeMutex;
+
+    // The frame being received: read into by Run, or assembled by Feed when a
+    // frame arrives in pieces or misaligned.
+    Body m_receiveBuffer;
+
+    std::mutex m_pendingMutex;
+    std::condition_variable m_pendingChanged;
+    // Only a handful of calls are ever in flight, and a vector keeps its
+    // capacity where a map would allocate a node per call.
+    std::vector<std::pair<std::uint64_t, PendingCall*>> m_pending;
+
+    std::mutex m_threadMutex;
+    std::thread m_thread;
+};
+
+} // namespace qttabbar
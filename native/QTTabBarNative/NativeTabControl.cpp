@@ -11,10 +11,12 @@
 #include <cwctype>
 #include <utility>
 
+#include "NaturalSort.h"
 #include "TabBarHost.h"
+#include "TabLayout.h"
 
 using qttabbar::ConfigData;
-using qttabbar::LoadConfigFromRegistry;
+using qttabbar::GetConfigSnapshot;
 using qttabbar::MouseChord;
 using qttabbar::MouseTarget;
 using qttabbar::WriteConfigToRegistry;
@@ -88,9 +90,10 @@ std::size_t NativeTabControl::AddTab(const std::wstring& path, bool makeActive,
         return m_tabs.size();
     }
 
-    auto matchesPath = [&](const TabItem& item) { return _wcsicmp(item.path.c_str(), normalized.c_str()) == 0; };
-    auto it = std::find_if(m_tabs.begin(), m_tabs.end(), matchesPath);
-    if(it == m_tabs.end() || allowDuplicate) {
+    auto existing = allowDuplicate ? std::nullopt : m_pathIndex.Find(normalized);
+    auto it = existing ? m_tabs.begin() + static_cast<std::ptrdiff_t>(*existing) : m_tabs.end();
+    std::size_t firstChanged = m_tabs.size();
+    if(it == m_tabs.end()) {
         TabItem item;
         item.path = normalized;
         item.title = ExtractTitle(normalized);
@@ -98,8 +101,9 @@ std::size_t NativeTabControl::AddTab(const std::wstring& path, bool makeActive,
         item.locked = false;
         EnsureIcon(item);
         m_tabs.push_back(std::move(item));
+        m_pathIndex.Append(normalized);
         it = std::prev(m_tabs.end());
-    } else if(it != m_tabs.end()) {
+    } else {
         EnsureIcon(*it);
     }
 
@@ -110,7 +114,7 @@ std::size_t NativeTabControl::AddTab(const std::wstring& path, bool makeActive,
         }
     }
 
-    LayoutTabs();
+    LayoutTabs(firstChanged);
     ::InvalidateRect(m_hWnd, nullptr, FALSE);
     return static_cast<std::size_t>(std::distance(m_tabs.begin(), it));
 }
@@ -153,13 +157,14 @@ std::optional<std::wstring> NativeTabControl::CloseTab(std::size_t index) {
     std::wstring path = m_tabs[index].path;
     DestroyIcon(m_tabs[index]);
     m_tabs.erase(m_tabs.begin() + static_cast<std::ptrdiff_t>(index));
+    m_pathIndex.Erase(index);
     if(m_activeIndex >= m_tabs.size()) {
         m_activeIndex = m_tabs.empty() ? 0 : m_tabs.size() - 1;
     }
     for(std::size_t i = 0; i < m_tabs.size(); ++i) {
         m_tabs[i].active = (i == m_activeIndex);
     }
-    LayoutTabs();
+    LayoutTabs(index);
     ::InvalidateRect(m_hWnd, nullptr, FALSE);
     return path;
 }
@@ -185,11 +190,8 @@ std::vector<std::wstring> NativeTabControl::CloseAllExcept(std::size_t index) {
             closed.push_back(*closedPath);
         }
     }
-    auto it = std::find_if(m_tabs.begin(), m_tabs.end(), [&](const TabItem& tab) {
-        return _wcsicmp(tab.path.c_str(), activePath.c_str()) == 0;
-    });
-    if(it != m_tabs.end()) {
-        m_activeIndex = static_cast<std::size_t>(std::distance(m_tabs.begin(), it));
+    if(auto found = m_pathIndex.Find(activePath)) {
+        m_activeIndex = *found;
         for(std::size_t i = 0; i < m_tabs.size(); ++i) {
             m_tabs[i].active = (i == m_activeIndex);
         }
@@ -211,11 +213,8 @@ std::vector<std::wstring> NativeTabControl::CloseTabsToLeft(std::size_t index) {
             closed.push_back(*closedPath);
         }
     }
-    auto it = std::find_if(m_tabs.begin(), m_tabs.end(), [&](const TabItem& tab) {
-        return _wcsicmp(tab.path.c_str(), activePath.c_str()) == 0;
-    });
-    if(it != m_tabs.end()) {
-        m_activeIndex = static_cast<std::size_t>(std::distance(m_tabs.begin(), it));
+    if(auto found = m_pathIndex.Find(activePath)) {
+        m_activeIndex = *found;
         for(std::size_t i = 0; i < m_tabs.size(); ++i) {
             m_tabs[i].active = (i == m_activeIndex);
         }
@@ -237,11 +236,8 @@ std::vector<std::wstring> NativeTabControl::CloseTabsToRight(std::size_t index)
             closed.push_back(*closedPath);
         }
     }
-    auto it = std::find_if(m_tabs.begin(), m_tabs.end(), [&](const TabItem& tab) {
-        return _wcsicmp(tab.path.c_str(), activePath.c_str()) == 0;
-    });
-    if(it != m_tabs.end()) {
-        m_activeIndex = static_cast<std::size_t>(std::distance(m_tabs.begin(), it));
+    if(auto found = m_pathIndex.Find(activePath)) {
+        m_activeIndex = *found;
         for(std::size_t i = 0; i < m_tabs.size(); ++i) {
             m_tabs[i].active = (i == m_activeIndex);
         }
@@ -276,6 +272,17 @@ std::wstring NativeTabControl::GetPath(std::size_t index) const {
     return m_tabs[index].path;
 }
 
+std::wstring NativeTabControl::GetAlias(std::size_t index) const {
+    if(index >= m_tabs.size()) {
+        return {};
+    }
+    return m_tabs[index].alias;
+}
+
+std::optional<std::size_t> NativeTabControl::FindTab(const std::wstring& path) const {
+    return m_pathIndex.Find(NormalizePath(path));
+}
+
 std::optional<RECT> NativeTabControl::GetTabBounds(std::size_t index) const {
     if(index >= m_tabs.size()) {
         return std::nullopt;
@@ -396,6 +403,35 @@ void NativeTabControl::SetAlias(std::size_t index, const std::wstring& alias) {
         return;
     }
     m_tabs[index].alias = alias;
+    LayoutTabs(index);
+    ::InvalidateRect(m_hWnd, nullptr, FALSE);
+}
+
+void NativeTabControl::SortTabs(bool byPath) {
+    if(m_tabs.size() < 2) {
+        return;
+    }
+    qttabbar::NaturalSortKeys keys;
+    for(const auto& tab : m_tabs) {
+        keys.Add(byPath ? tab.path : (tab.alias.empty() ? tab.title : tab.alias));
+    }
+    std::vector<TabItem> sorted;
+    sorted.reserve(m_tabs.size());
+    for(std::size_t index : keys.SortedOrder()) {
+        sorted.push_back(std::move(m_tabs[index]));
+    }
+    m_tabs.swap(sorted);
+
+    m_pathIndex.Clear();
+    for(std::size_t i = 0; i < m_tabs.size(); ++i) {
+        m_pathIndex.Append(m_tabs[i].path);
+        if(m_tabs[i].active) {
+            m_activeIndex = i;
+        }
+    }
+    m_hotIndex.reset();
+    m_pressedTab.reset();
+    m_pressedClose.reset();
     LayoutTabs();
     ::InvalidateRect(m_hWnd, nullptr, FALSE);
 }
@@ -431,6 +467,10 @@ void NativeTabControl::RefreshMetrics() {
         m_boldFont = nullptr;
     }
 
+    // The old handle values may be reused by GDI, so cached extents cannot be kept.
+    m_measureCache.Clear();
+    m_laidOutCount = 0;
+    m_dpiY = dpiY;
     m_font = CreateFontFromConfig(m_config.skin.tabTextFont, dpiY, false);
     bool bold = m_config.skin.activeTabInBold;
     if(bold) {
@@ -470,11 +510,8 @@ void NativeTabControl::NotifyExplorerPathChanged(const std::wstring& path) {
     if(path.empty()) {
         return;
     }
-    auto matchesPath = [&](const TabItem& item) { return _wcsicmp(item.path.c_str(), path.c_str()) == 0; };
-    auto it = std::find_if(m_tabs.begin(), m_tabs.end(), matchesPath);
-    if(it != m_tabs.end()) {
-        std::size_t index = static_cast<std::size_t>(std::distance(m_tabs.begin(), it));
-        ActivateTab(index);
+    if(auto found = m_pathIndex.Find(path)) {
+        ActivateTab(*found);
     } else {
         AddTab(path, true, true);
     }
@@ -482,8 +519,7 @@ void NativeTabControl::NotifyExplorerPathChanged(const std::wstring& path) {
 
 LRESULT NativeTabControl::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
     bHandled = TRUE;
-    ConfigData config = LoadConfigFromRegistry();
-    ApplyConfiguration(config);
+    ApplyConfiguration(GetConfigSnapshot()->value);
     return 0;
 }
 
@@ -493,6 +529,9 @@ LRESULT NativeTabControl::OnDestroy(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*l
         DestroyIcon(tab);
     }
     m_tabs.clear();
+    m_pathIndex.Clear();
+    m_hitIndex.Clear();
+    m_laidOutCount = 0;
     return 0;
 }
 
@@ -502,7 +541,8 @@ LRESULT NativeTabControl::OnSize(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM lParam
     int height = HIWORD(lParam);
     UNREFERENCED_PARAMETER(width);
     UNREFERENCED_PARAMETER(height);
-    LayoutTabs();
+    // A width change alters the flow parameters, which forces a full reflow.
+    LayoutTabs(m_tabs.size());
     return 0;
 }
 
@@ -718,52 +758,74 @@ LRESULT NativeTabControl::OnGetDlgCode(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM
     return DLGC_WANTARROWS | DLGC_WANTCHARS;
 }
 
-void NativeTabControl::LayoutTabs() {
+void NativeTabControl::LayoutTabs(std::size_t firstChanged) {
     if(m_hWnd == nullptr) {
         return;
     }
     RECT rc{};
     ::GetClientRect(m_hWnd, &rc);
-    int x = rc.left + 4;
-    int y = rc.top + 4;
     int rowHeight = m_tabHeight;
-    int available = rc.right - rc.left - 8;
-    int plusWidth = m_showPlusButton ? rowHeight : 0;
 
-    for(std::size_t i = 0; i < m_tabs.size(); ++i) {
+    qttabbar::TabFlowParams params;
+    params.originX = rc.left + 4;
+    params.originY = rc.top + 4;
+    params.wrapLimit = rc.right - 8;
+    params.rowHeight = rowHeight;
+    params.rowGap = 4;
+    params.spacing = m_spacing;
+    params.plusWidth = m_showPlusButton ? rowHeight : 0;
+    params.multiRow = m_config.tabs.multipleTabRows;
+    if(params != m_layoutParams) {
+        m_layoutParams = params;
+        firstChanged = 0;
+    }
+    // Positions before firstChanged are only reusable if an earlier pass produced them.
+    firstChanged = std::min({firstChanged, m_laidOutCount, m_tabs.size()});
+
+    m_layoutWidths.resize(m_tabs.size());
+    for(std::size_t i = firstChanged; i < m_tabs.size(); ++i) {
+        m_layoutWidths[i] = MeasureTabWidth(m_tabs[i]);
+    }
+    qttabbar::TabFlowCursor cursor = qttabbar::FlowTabRows(params, m_layoutWidths, firstChanged, m_layoutRects);
+    m_hitIndex.Update(m_layoutRects, firstChanged);
+    m_laidOutCount = m_tabs.size();
+
+    for(std::size_t i = firstChanged; i < m_tabs.size(); ++i) {
         TabItem& tab = m_tabs[i];
-        const std::wstring& display = tab.alias.empty() ? tab.title : tab.alias;
-        SIZE textSize = MeasureTitle(display);
-        int width = textSize.cx + m_horizontalPadding;
-        if(m_config.tabs.showFolderIcon) {
-            width += m_iconSize + 4;
-        }
-        width = std::clamp(width, m_tabMinWidth, m_tabMaxWidth);
-        if(m_config.tabs.multipleTabRows && (x + width + plusWidth > available + rc.left) && (x != rc.left + 4)) {
-            x = rc.left + 4;
-            y += rowHeight + 4;
-        }
-        tab.metrics.bounds = {x, y, x + width, y + rowHeight};
+        const qttabbar::TabRect& rect = m_layoutRects[i];
+        tab.metrics.bounds = {rect.left, rect.top, rect.right, rect.bottom};
         tab.metrics.closeButton = tab.metrics.bounds;
         tab.metrics.closeButton.left = tab.metrics.bounds.right - (rowHeight - 4);
         tab.metrics.closeButton.right = tab.metrics.bounds.right - 4;
         int closeHeight = rowHeight - 8;
         tab.metrics.closeButton.top = tab.metrics.bounds.top + (rowHeight - closeHeight) / 2;
         tab.metrics.closeButton.bottom = tab.metrics.closeButton.top + closeHeight;
-        x += width + m_spacing;
     }
 
     if(m_showPlusButton) {
+        int x = cursor.x;
         int plusSize = rowHeight - 4;
         if(x + plusSize > rc.right - 4) {
             x = rc.right - plusSize - 4;
         }
-        m_plusButtonRect = {x, y, x + plusSize, y + plusSize};
+        m_plusButtonRect = {x, cursor.y, x + plusSize, cursor.y + plusSize};
     } else {
         ::SetRectEmpty(&m_plusButtonRect);
     }
 }
 
+int NativeTabControl::MeasureTabWidth(const TabItem& tab) {
+    const std::wstring& display = tab.alias.empty() ? tab.title : tab.alias;
+    HFONT fontToUse = m_font ? m_font : static_cast<HFONT>(::GetStockObject(DEFAULT_GUI_FONT));
+    int textWidth = m_measureCache.Measure(reinterpret_cast<std::uintptr_t>(fontToUse), static_cast<unsigned>(m_dpiY),
+                                           display, [this](const std::wstring& text) { return MeasureTitle(text).cx; });
+    int width = textWidth + m_horizontalPadding;
+    if(m_config.tabs.showFolderIcon) {
+        width += m_iconSize + 4;
+    }
+    return std::clamp(width, m_tabMinWidth, m_tabMaxWidth);
+}
+
 void NativeTabControl::DrawControl(HDC hdc) const {
     RECT rc{};
     ::GetClientRect(m_hWnd, &rc);
@@ -923,10 +985,9 @@ void NativeTabControl::DestroyIcon(TabItem& tab) {
 }
 
 std::optional<std::size_t> NativeTabControl::HitTestTab(POINT clientPt) const {
-    for(std::size_t i = 0; i < m_tabs.size(); ++i) {
-        if(::PtInRect(&m_tabs[i].metrics.bounds, clientPt)) {
-            return i;
-        }
+    auto index = m_hitIndex.HitTest(clientPt.x, clientPt.y);
+    if(index && *index < m_tabs.size()) {
+        return index;
     }
     return std::nullopt;
 }
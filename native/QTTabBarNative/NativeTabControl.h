@@ -9,6 +9,8 @@
 #include <vector>
 
 #include "Config.h"
+#include "TabLayout.h"
+#include "TabPathIndex.h"
 
 class TabBarHost;
 
@@ -79,6 +81,8 @@ public:
     std::size_t GetActiveIndex() const noexcept;
     std::vector<std::wstring> GetTabPaths() const;
     std::wstring GetPath(std::size_t index) const;
+    std::wstring GetAlias(std::size_t index) const;
+    std::optional<std::size_t> FindTab(const std::wstring& path) const;
     std::vector<SwitchEntry> GetSwitchEntries();
     bool IsLocked(std::size_t index) const;
     bool CanCloseTab(std::size_t index) const;
@@ -87,6 +91,8 @@ public:
     bool HasClosableOtherTabs(std::size_t index) const;
     void SetLocked(std::size_t index, bool locked);
     void SetAlias(std::size_t index, const std::wstring& alias);
+    // Reorders tabs in natural order of their display names or paths.
+    void SortTabs(bool byPath);
     std::size_t GetCount() const noexcept { return m_tabs.size(); }
 
     std::optional<RECT> GetTabBounds(std::size_t index) const;
@@ -123,7 +129,10 @@ private:
     LRESULT OnMouseWheel(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnGetDlgCode(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 
-    void LayoutTabs();
+    // Re-measures tabs from firstChanged on and reflows them; earlier tabs keep
+    // their positions unless the strip geometry changed.
+    void LayoutTabs(std::size_t firstChanged = 0);
+    int MeasureTabWidth(const TabItem& tab);
     void DrawControl(HDC hdc) const;
     void DrawTab(HDC hdc, const TabItem& tab, bool hot) const;
     void DrawCloseButton(HDC hdc, const RECT& bounds, bool hot, bool pressed) const;
@@ -152,6 +161,7 @@ private:
 
     TabBarHost& m_owner;
     std::vector<TabItem> m_tabs;
+    qttabbar::TabPathIndex m_pathIndex;
     qttabbar::ConfigData m_config;
     HFONT m_font = nullptr;
     HFONT m_boldFont = nullptr;
@@ -163,6 +173,13 @@ private:
     int m_spacing = 6;
     bool m_showPlusButton = false;
     RECT m_plusButtonRect{};
+    int m_dpiY = 96;
+    qttabbar::TextMeasureCache m_measureCache;
+    qttabbar::TabFlowParams m_layoutParams;
+    std::vector<int> m_layoutWidths;
+    std::vector<qttabbar::TabRect> m_layoutRects;
+    qttabbar::TabHitIndex m_hitIndex;
+    std::size_t m_laidOutCount = 0;
 
     std::optional<std::size_t> m_hotIndex;
     std::optional<std::size_t> m_pressedTab;
@@ -0,0 +1,125 @@
+#include "NaturalSort.h"
+
+#include <algorithm>
+#include <cwctype>
+
+namespace {
+
+// Text characters become (folded char << 8). A digit run becomes a marker that
+// sits where '0' would, carrying the count of significant digits, followed by
+// one token per significant digit; comparing markers first orders numbers by
+// magnitude and the digits break ties between numbers of equal length.
+constexpr std::uint32_t kDigitMarker = static_cast<std::uint32_t>(L'0') << 8;
+constexpr std::size_t kMaxDigitLength = 0xFF;
+
+bool IsDigit(wchar_t ch) {
+    return ch >= L'0' && ch <= L'9';
+}
+
+template <typename Out>
+void AppendTokens(std::wstring_view text, Out&& out) {
+    std::size_t i = 0;
+    while(i < text.size()) {
+        wchar_t ch = text[i];
+        if(!IsDigit(ch)) {
+            out((static_cast<std::uint32_t>(std::towlower(ch)) & 0xFFFFFFu) << 8);
+            ++i;
+            continue;
+        }
+        std::size_t end = i;
+        while(end < text.size() && IsDigit(text[end])) {
+            ++end;
+        }
+        std::size_t first = i;
+        while(first < end && text[first] == L'0') {
+            ++first;
+        }
+        std::size_t length = std::min(end - first, kMaxDigitLength);
+        out(kDigitMarker | static_cast<std::uint32_t>(length));
+        for(std::size_t d = first; d < end; ++d) {
+            out(static_cast<std::uint32_t>(text[d]) << 8);
+        }
+        i = end;
+    }
+}
+
+int CompareTokens(const std::uint32_t* lhs, std::size_t lhsCount, const std::uint32_t* rhs, std::size_t rhsCount) {
+    std::size_t count = std::min(lhsCount, rhsCount);
+    for(std::size_t i = 0; i < count; ++i) {
+        if(lhs[i] != rhs[i]) {
+            return lhs[i] < rhs[i] ? -1 : 1;
+        }
+    }
+    if(lhsCount == rhsCount) {
+        return 0;
+    }
+    return lhsCount < rhsCount ? -1 : 1;
+}
+
+} // namespace
+
+namespace qttabbar {
+
+void NaturalSortKeys::Reserve(std::size_t count, std::size_t totalChars) {
+    m_records.reserve(count);
+    m_tokens.reserve(totalChars + count);
+}
+
+void NaturalSortKeys::Add(std::wstring_view text, std::uint32_t group) {
+    Record record;
+    record.group = group;
+    record.offset = static_cast<std::uint32_t>(m_tokens.size());
+    record.index = static_cast<std::uint32_t>(m_records.size());
+    AppendTokens(text, [this](std::uint32_t token) { m_tokens.push_back(token); });
+    record.length = static_cast<std::uint32_t>(m_tokens.size() - record.offset);
+    std::uint64_t first = record.length > 0 ? m_tokens[record.offset] : 0;
+    std::uint64_t second = record.length > 1 ? m_tokens[record.offset + 1] : 0;
+    record.prefix = (first << 32) | second;
+    m_records.push_back(record);
+}
+
+void NaturalSortKeys::Clear() {
+    m_tokens.clear();
+    m_records.clear();
+}
+
+bool NaturalSortKeys::Less(const Record& lhs, const Record& rhs) const {
+    if(lhs.group != rhs.group) {
+        return lhs.group < rhs.group;
+    }
+    if(lhs.prefix != rhs.prefix) {
+        return lhs.prefix < rhs.prefix;
+    }
+    if(lhs.length > 2 || rhs.length > 2) {
+        // Equal prefixes imply both keys share their first min(length, 2) tokens.
+        std::size_t skip = std::min<std::size_t>({2, lhs.length, rhs.length});
+        int order = CompareTokens(m_tokens.data() + lhs.offset + skip, lhs.length - skip,
+                                  m_tokens.data() + rhs.offset + skip, rhs.length - skip);
+        if(order != 0) {
+            return order < 0;
+        }
+    }
+    return lhs.index < rhs.index;
+}
+
+std::vector<std::size_t> NaturalSortKeys::SortedOrder() const {
+    std::vector<Record> records = m_records;
+    std::sort(records.begin(), records.end(), [this](const Record& lhs, const Record& rhs) { return Less(lhs, rhs); });
+
+    std::vector<std::size_t> order;
+    order.reserve(records.size());
+    for(const auto& record : records) {
+        order.push_back(record.index);
+    }
+    return order;
+}
+
+int CompareNatural(std::wstring_view lhs, std::wstring_view rhs) {
+    std::vector<std::uint32_t> left;
+    std::vector<std::uint32_t> right;
+    AppendTokens(lhs, [&](std::uint32_t token) { left.push_back(token); });
+    AppendTokens(rhs, [&](std::uint32_t token) { right.push_back(token); });
+    return CompareTokens(left.data(), left.size(), right.data(), right.size());
+}
+
+} // namespace qttabbar
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace qttabbar {
+
+// Natural-order sort keys: case is folded and each run of ASCII digits becomes a
+// single number token, so "file2" sorts before "file10" the way Explorer lists
+// them. Keys are built once per item into one shared token pool; sorting then
+// compares integers instead of re-folding both strings on every comparison.
+class NaturalSortKeys {
+public:
+    void Reserve(std::size_t count, std::size_t totalChars);
+    // Items with a lower group sort first regardless of text (e.g. folders before files).
+    void Add(std::wstring_view text, std::uint32_t group = 0);
+    std::size_t Size() const noexcept { return m_records.size(); }
+    void Clear();
+
+    // Permutation of the added items in natural order; equal keys keep insertion order.
+    std::vector<std::size_t> SortedOrder() const;
+
+private:
+    struct Record {
+        std::uint32_t group = 0;
+        // First two tokens packed, which settles most comparisons without the pool.
+        std::uint64_t prefix = 0;
+        std::uint32_t offset = 0;
+        std::uint32_t length = 0;
+        std::uint32_t index = 0;
+    };
+
+    bool Less(const Record& lhs, const Record& rhs) const;
+
+    std::vector<std::uint32_t> m_tokens;
+    std::vector<Record> m_records;
+};
+
+// Single natural-order comparison with the same ordering as NaturalSortKeys.
+int CompareNatural(std::wstring_view lhs, std::wstring_view rhs);
+
+} // namespace qttabbar
@@ -0,0 +1,133 @@
+#include "PipeMessageCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+using qttabbar::PipeMessageFormat;
+
+// Header field offsets; see PipeMessageFormat.
+constexpr std::size_t kMagicOffset = 0;
+constexpr std::size_t kVersionOffset = 4;
+constexpr std::size_t kTypeOffset = 8;
+constexpr std::size_t kExplorerOffset = 16;
+constexpr std::size_t kTabBarOffset = 24;
+constexpr std::size_t kIntValueOffset = 32;
+constexpr std::size_t kPayloadBytesOffset = 36;
+constexpr std::size_t kBinaryBytesOffset = 40;
+
+template<typename T>
+void Put(std::uint8_t* out, std::size_t offset, T value) {
+    std::memcpy(out + offset, &value, sizeof(value));
+}
+
+template<typename T>
+T Get(const std::uint8_t* in, std::size_t offset) {
+    T value{};
+    std::memcpy(&value, in + offset, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+namespace qttabbar {
+
+bool DecodePipeMessage(ByteSpan body, PipeMessageView& message) {
+    if(body.size < PipeMessageFormat::kHeaderSize
+       || reinterpret_cast<std::uintptr_t>(body.data) % alignof(char16_t) != 0) {
+        return false;
+    }
+    const std::uint8_t* header = body.data;
+    std::size_t bodyBytes = body.size - PipeMessageFormat::kHeaderSize;
+    auto payloadBytes = Get<std::uint32_t>(header, kPayloadBytesOffset);
+    auto binaryBytes = Get<std::uint32_t>(header, kBinaryBytesOffset);
+    // Compared without adding the two, which could wrap where size_t is 32 bits.
+    if(Get<std::uint32_t>(header, kMagicOffset) != PipeMessageFormat::kMagic
+       || Get<std::uint32_t>(header, kVersionOffset) != PipeMessageFormat::kVersion
+       || payloadBytes % sizeof(char16_t) != 0
+       || payloadBytes > bodyBytes
+       || binaryBytes != bodyBytes - payloadBytes) {
+        return false;
+    }
+    const std::uint8_t* payload = header + PipeMessageFormat::kHeaderSize;
+    message.type = Get<std::uint32_t>(header, kTypeOffset);
+    message.explorer = Get<std::uint64_t>(header, kExplorerOffset);
+    message.tabBar = Get<std::uint64_t>(header, kTabBarOffset);
+    message.intValue = Get<std::int32_t>(header, kIntValueOffset);
+    message.payload = std::u16string_view(reinterpret_cast<const char16_t*>(payload), payloadBytes / sizeof(char16_t));
+    message.binary = ByteSpan{payload + payloadBytes, binaryBytes};
+    return true;
+}
+
+ActionArgumentsView DecodeActionArguments(ByteSpan binary) {
+    ActionArgumentsView arguments;
+    if(binary.size < PipeMessageFormat::kActionPrefixSize) {
+        return arguments;
+    }
+    const std::uint8_t* text = binary.data + PipeMessageFormat::kActionPrefixSize;
+    std::size_t available = binary.size - PipeMessageFormat::kActionPrefixSize;
+    auto textBytes = static_cast<std::size_t>(std::min<std::uint64_t>(
+        static_cast<std::uint64_t>(Get<std::uint32_t>(binary.data, 0)) * sizeof(char16_t),
+        available - available % sizeof(char16_t)));
+    arguments.text = std::u16string_view(reinterpret_cast<const char16_t*>(text), textBytes / sizeof(char16_t));
+    arguments.binary = ByteSpan{text + textBytes, available - textBytes};
+    return arguments;
+}
+
+PipeMessageWriter::PipeMessageWriter(const PipeMessageView& message) {
+    WriteHeader(message, message.binary.size);
+    Add(message.payload.data(), message.payload.size() * sizeof(char16_t));
+    Add(message.binary.data, message.binary.size);
+}
+
+PipeMessageWriter::PipeMessageWriter(std::uint32_t type, std::u16string_view action, std::u16string_view text,
+                                     ByteSpan arguments) {
+    PipeMessageView message;
+    message.type = type;
+    message.payload = action;
+    std::size_t textBytes = text.size() * sizeof(char16_t);
+    WriteHeader(message, PipeMessageFormat::kActionPrefixSize + textBytes + arguments.size);
+    Put(m_actionPrefix, 0, static_cast<std::uint32_t>(text.size()));
+    Add(action.data(), action.size() * sizeof(char16_t));
+    Add(m_actionPrefix, sizeof(m_actionPrefix));
+    Add(text.data(), textBytes);
+    Add(arguments.data, arguments.size);
+}
+
+std::size_t PipeMessageWriter::Size() const noexcept {
+    std::size_t size = 0;
+    for(std::size_t i = 0; i < m_count; ++i) {
+        size += m_segments[i].size;
+    }
+    return size;
+}
+
+void PipeMessageWriter::AppendTo(std::vector<std::uint8_t>& out) const {
+    out.reserve(out.size() + Size());
+    for(std::size_t i = 0; i < m_count; ++i) {
+        out.insert(out.end(), m_segments[i].data, m_segments[i].data + m_segments[i].size);
+    }
+}
+
+void PipeMessageWriter::WriteHeader(const PipeMessageView& message, std::size_t binaryBytes) {
+    // Sizes beyond 32 bits cannot be framed; MessageChannel refuses such bodies.
+    std::memset(m_header, 0, sizeof(m_header));
+    Put(m_header, kMagicOffset, PipeMessageFormat::kMagic);
+    Put(m_header, kVersionOffset, PipeMessageFormat::kVersion);
+    Put(m_header, kTypeOffset, message.type);
+    Put(m_header, kExplorerOffset, message.explorer);
+    Put(m_header, kTabBarOffset, message.tabBar);
+    Put(m_header, kIntValueOffset, message.intValue);
+    Put(m_header, kPayloadBytesOffset, static_cast<std::uint32_t>(message.payload.size() * sizeof(char16_t)));
+    Put(m_header, kBinaryBytesOffset, static_cast<std::uint32_t>(binaryBytes));
+    Add(m_header, sizeof(m_header));
+}
+
+void PipeMessageWriter::Add(const void* data, std::size_t size) {
+    if(size > 0) {
+        m_segments[m_count++] = ByteSpan{static_cast<const std::uint8_t*>(data), size};
+    }
+}
+
+} // namespace qttabbar
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "MessageChannel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace qttabbar {
+
+// Wire layout of an instance manager message, carried as the body of one
+// MessageChannel frame. All integers are little-endian.
+//
+//   header  : u32 magic | u32 version | u32 type | u32 reserved | u64 explorer | u64 tabBar
+//             | i32 intValue | u32 payloadBytes | u32 binaryBytes | u32 reserved
+//   payload : UTF-16, payloadBytes long
+//   binary  : binaryBytes of message specific data
+//
+// Action messages carry the action name as payload and pack their arguments
+// into the binary part as u32 textUnits | text UTF-16 | argument bytes.
+struct PipeMessageFormat {
+    static constexpr std::uint32_t kMagic = 0x51545442; // 'QTTB'
+    static constexpr std::uint32_t kVersion = 2;
+    static constexpr std::size_t kHeaderSize = 48;
+    static constexpr std::size_t kActionPrefixSize = 4;
+};
+
+// A message viewed in place. The views point into the buffer it was decoded
+// from, or into the caller's strings when it is about to be encoded.
+struct PipeMessageView {
+    std::uint32_t type = 0;
+    std::uint64_t explorer = 0;
+    std::uint64_t tabBar = 0;
+    std::int32_t intValue = 0;
+    std::u16string_view payload;
+    ByteSpan binary;
+};
+
+struct ActionArgumentsView {
+    std::u16string_view text;
+    ByteSpan binary;
+};
+
+// Validates a message without copying it. `body` must start on a 2-byte
+// boundary, which MessageChannel guarantees for the frame bodies it delivers.
+bool DecodePipeMessage(ByteSpan body, PipeMessageView& message);
+
+// Splits the binary part of an action message. A text length that overruns the
+// buffer is clamped to what is there.
+ActionArgumentsView DecodeActionArguments(ByteSpan binary);
+
+// A message laid out for a gathered write. The fixed-size parts are stored
+// here and everything else is referenced, so encoding neither copies nor
+// allocates; the referenced data must outlive the writer.
+class PipeMessageWriter {
+public:
+    explicit PipeMessageWriter(const PipeMessageView& message);
+    // Packs the arguments behind the action name.
+    PipeMessageWriter(std::uint32_t type, std::u16string_view action, std::u16string_view text, ByteSpan arguments);
+
+    PipeMessageWriter(const PipeMessageWriter&) = delete;
+    PipeMessageWriter& operator=(const PipeMessageWriter&) = delete;
+
+    const ByteSpan* Segments() const noexcept { return m_segments; }
+    std::size_t SegmentCount() const noexcept { return m_count; }
+    std::size_t Size() const noexcept;
+
+    // Appends the encoded message, for callers that need it in one piece.
+    void AppendTo(std::vector<std::uint8_t>& out) const;
+
+private:
+    void WriteHeader(const PipeMessageView& message, std::size_t binaryBytes);
+    void Add(const void* data, std::size_t size);
+
+    std::uint8_t m_header[PipeMessageFormat::kHeaderSize];
+    std::uint8_t m_actionPrefix[PipeMessageFormat::kActionPrefixSize];
+    ByteSpan m_segments[5];
+    std::size_t m_count = 0;
+};
+
+} // namespace qttabbar
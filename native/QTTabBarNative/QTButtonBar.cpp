@@ -17,7 +17,7 @@
 #include "PluginContracts.h"
 
 using qttabbar::ConfigData;
-using qttabbar::LoadConfigFromRegistry;
+using qttabbar::GetConfigSnapshot;
 using qttabbar::plugins::PluginManagerNative;
 using qttabbar::plugins::PluginMetadataNative;
 using qttabbar::plugins::PluginMenuType;
@@ -231,7 +231,8 @@ void QTButtonBar::CreateToolbarButtons() {
     std::vector<TBBUTTON> buttons;
     buttons.reserve(32);
 
-    ConfigData config = LoadConfigFromRegistry();
+    auto snapshot = GetConfigSnapshot();
+    const ConfigData& config = snapshot->value;
     const auto& definitions = DefaultButtons();
     std::vector<int> order = config.bbar.buttonIndexes.empty() ? std::vector<int>() : config.bbar.buttonIndexes;
     if(order.empty()) {
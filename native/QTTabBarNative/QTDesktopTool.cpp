@@ -46,7 +46,7 @@ HRESULT QTDesktopTool::FinalConstruct() {
         return hr;
     }
 
-    m_settings = qttabbar::LoadConfigFromRegistry().desktop;
+    m_settings = qttabbar::GetConfigSnapshot()->value.desktop;
     InstanceManagerNative::Instance().RegisterDesktopTool(this);
     EnsureThreads();
     ScheduleMenuRebuild();
@@ -907,7 +907,7 @@ void QTDesktopTool::PersistDesktopSettings() {
         std::lock_guard guard(m_settingsMutex);
         snapshot = m_settings;
     }
-    qttabbar::ConfigData config = qttabbar::LoadConfigFromRegistry();
+    qttabbar::ConfigData config = qttabbar::GetConfigSnapshot()->value;
     config.desktop = snapshot;
     qttabbar::WriteConfigToRegistry(config, true);
 }
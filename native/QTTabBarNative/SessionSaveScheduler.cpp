@@ -0,0 +1,115 @@
+#include "SessionSaveScheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace qttabbar {
+
+const SteadySaveClock& SteadySaveClock::Instance() {
+    static SteadySaveClock instance;
+    return instance;
+}
+
+SaveCoalescer::SaveCoalescer(const ISaveClock& clock)
+    : SaveCoalescer(clock, Options{}) {
+}
+
+SaveCoalescer::SaveCoalescer(const ISaveClock& clock, Options options)
+    : m_clock(clock)
+    , m_options(options) {
+}
+
+void SaveCoalescer::Request() {
+    ++m_counters.requested;
+    m_lastRequest = m_clock.Now();
+    if(!m_dirty) {
+        m_dirty = true;
+        m_firstRequest = m_lastRequest;
+    }
+}
+
+bool SaveCoalescer::IsDue() const {
+    return m_dirty && m_clock.Now() >= Deadline();
+}
+
+std::optional<std::chrono::milliseconds> SaveCoalescer::TimeUntilDue() const {
+    if(!m_dirty) {
+        return std::nullopt;
+    }
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(Deadline() - m_clock.Now());
+    return std::max(remaining, std::chrono::milliseconds::zero());
+}
+
+void SaveCoalescer::MarkFlushed() {
+    if(m_dirty) {
+        ++m_counters.flushed;
+    }
+    m_dirty = false;
+}
+
+ISaveClock::TimePoint SaveCoalescer::Deadline() const {
+    return std::min(m_lastRequest + m_options.quietPeriod, m_firstRequest + m_options.maxDelay);
+}
+
+BackgroundSaveWriter::BackgroundSaveWriter(WriteFn write)
+    : m_write(std::move(write)) {
+}
+
+BackgroundSaveWriter::~BackgroundSaveWriter() {
+    WaitIdle();
+    if(m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+void BackgroundSaveWriter::Submit(std::filesystem::path target, std::vector<std::uint8_t> payload) {
+    std::lock_guard guard(m_mutex);
+    ++m_counters.submitted;
+    auto it = std::find_if(m_queue.begin(), m_queue.end(), [&](const Pending& pending) {
+        return pending.target == target;
+    });
+    if(it != m_queue.end()) {
+        it->payload = std::move(payload);
+        ++m_counters.superseded;
+    } else {
+        m_queue.push_back({std::move(target), std::move(payload)});
+    }
+    if(!m_running) {
+        // The previous worker has already cleared m_running and is only returning.
+        if(m_worker.joinable()) {
+            m_worker.join();
+        }
+        m_running = true;
+        m_worker = std::thread(&BackgroundSaveWriter::Run, this);
+    }
+}
+
+void BackgroundSaveWriter::WaitIdle() {
+    std::unique_lock lock(m_mutex);
+    m_idle.wait(lock, [this] { return !m_running; });
+}
+
+BackgroundSaveWriter::Counters BackgroundSaveWriter::GetCounters() const {
+    std::lock_guard guard(m_mutex);
+    return m_counters;
+}
+
+void BackgroundSaveWriter::Run() {
+    std::unique_lock lock(m_mutex);
+    while(!m_queue.empty()) {
+        Pending pending = std::move(m_queue.front());
+        m_queue.erase(m_queue.begin());
+        lock.unlock();
+        bool ok = m_write(pending.target, pending.payload);
+        lock.lock();
+        if(ok) {
+            ++m_counters.written;
+        } else {
+            ++m_counters.failed;
+        }
+    }
+    m_running = false;
+    m_idle.notify_all();
+}
+
+} // namespace qttabbar
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace qttabbar {
+
+class ISaveClock {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    virtual ~ISaveClock() = default;
+    virtual TimePoint Now() const = 0;
+};
+
+class SteadySaveClock final : public ISaveClock {
+public:
+    static const SteadySaveClock& Instance();
+    TimePoint Now() const override { return std::chrono::steady_clock::now(); }
+};
+
+// Clock that only moves when told to; lets coalescing be driven deterministically.
+class ManualSaveClock final : public ISaveClock {
+public:
+    TimePoint Now() const override { return m_now; }
+    void Advance(std::chrono::milliseconds delta) { m_now += delta; }
+
+private:
+    TimePoint m_now{};
+};
+
+// Tracks whether the session is dirty and when it should be flushed. A flush is
+// due once no request arrived for `quietPeriod`, or `maxDelay` after the first
+// unflushed request so a steady stream of changes cannot postpone it forever.
+class SaveCoalescer {
+public:
+    struct Options {
+        std::chrono::milliseconds quietPeriod{750};
+        std::chrono::milliseconds maxDelay{5000};
+    };
+
+    struct Counters {
+        std::uint64_t requested = 0;
+        std::uint64_t flushed = 0;
+    };
+
+    explicit SaveCoalescer(const ISaveClock& clock);
+    SaveCoalescer(const ISaveClock& clock, Options options);
+
+    void Request();
+    bool IsDirty() const noexcept { return m_dirty; }
+    bool IsDue() const;
+    // Time left until the pending flush is due; nullopt when nothing is pending.
+    std::optional<std::chrono::milliseconds> TimeUntilDue() const;
+    void MarkFlushed();
+    Counters GetCounters() const noexcept { return m_counters; }
+
+private:
+    ISaveClock::TimePoint Deadline() const;
+
+    const ISaveClock& m_clock;
+    Options m_options;
+    bool m_dirty = false;
+    ISaveClock::TimePoint m_firstRequest{};
+    ISaveClock::TimePoint m_lastRequest{};
+    Counters m_counters{};
+};
+
+// Single worker thread that writes payloads off the caller's thread. Only the
+// newest payload per target is kept, so a burst of submissions costs one write.
+// The thread is started on demand and leaves once the queue is empty.
+class BackgroundSaveWriter {
+public:
+    using WriteFn = std::function<bool(const std::filesystem::path&, const std::vector<std::uint8_t>&)>;
+
+    struct Counters {
+        std::uint64_t submitted = 0;
+        std::uint64_t superseded = 0;
+        std::uint64_t written = 0;
+        std::uint64_t failed = 0;
+    };
+
+    explicit BackgroundSaveWriter(WriteFn write);
+    ~BackgroundSaveWriter();
+
+    BackgroundSaveWriter(const BackgroundSaveWriter&) = delete;
+    BackgroundSaveWriter& operator=(const BackgroundSaveWriter&) = delete;
+
+    void Submit(std::filesystem::path target, std::vector<std::uint8_t> payload);
+    // Blocks until every submitted payload has been written.
+    void WaitIdle();
+    Counters GetCounters() const;
+
+private:
+    struct Pending {
+        std::filesystem::path target;
+        std::vector<std::uint8_t> payload;
+    };
+
+    void Run();
+
+    WriteFn m_write;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::vector<Pending> m_queue;
+    std::thread m_worker;
+    bool m_running = false;
+    Counters m_counters{};
+};
+
+} // namespace qttabbar
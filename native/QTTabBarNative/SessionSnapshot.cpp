@@ -0,0 +1,334 @@
+#include "SessionSnapshot.h"
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using qttabbar::SessionSnapshotFormat;
+
+constexpr std::size_t AlignUp(std::size_t value) {
+    return (value + 3) & ~static_cast<std::size_t>(3);
+}
+
+void PutU16(std::uint8_t* out, std::uint16_t value) {
+    std::memcpy(out, &value, sizeof(value));
+}
+
+void PutU32(std::uint8_t* out, std::uint32_t value) {
+    std::memcpy(out, &value, sizeof(value));
+}
+
+std::uint16_t GetU16(const std::uint8_t* in) {
+    std::uint16_t value = 0;
+    std::memcpy(&value, in, sizeof(value));
+    return value;
+}
+
+std::uint32_t GetU32(const std::uint8_t* in) {
+    std::uint32_t value = 0;
+    std::memcpy(&value, in, sizeof(value));
+    return value;
+}
+
+std::size_t RecordSize(std::size_t pathUnits, std::size_t aliasUnits) {
+    return AlignUp(SessionSnapshotFormat::kRecordHeaderSize + (pathUnits + aliasUnits) * sizeof(char16_t));
+}
+
+// A temp name no other writer uses, be it another window's writer or another
+// Explorer process, so concurrent saves never truncate each other's bytes.
+std::filesystem::path MakeTempPath(const std::filesystem::path& path) {
+    static std::atomic<std::uint32_t> counter{0};
+#if defined(_WIN32)
+    unsigned long processId = ::GetCurrentProcessId();
+#else
+    unsigned long processId = static_cast<unsigned long>(::getpid());
+#endif
+    std::filesystem::path temp = path;
+    temp += L"." + std::to_wstring(processId) + L"." + std::to_wstring(counter.fetch_add(1)) + L".tmp";
+    return temp;
+}
+
+} // namespace
+
+namespace qttabbar {
+
+std::u16string_view ToUtf16View(const std::wstring& value, std::u16string& scratch) {
+    if constexpr(sizeof(wchar_t) == sizeof(char16_t)) {
+        return std::u16string_view(reinterpret_cast<const char16_t*>(value.data()), value.size());
+    } else {
+        scratch.clear();
+        scratch.reserve(value.size());
+        for(wchar_t ch : value) {
+            auto codePoint = static_cast<std::uint32_t>(ch);
+            if(codePoint >= 0x10000) {
+                codePoint -= 0x10000;
+                scratch.push_back(static_cast<char16_t>(0xD800 + (codePoint >> 10)));
+                scratch.push_back(static_cast<char16_t>(0xDC00 + (codePoint & 0x3FF)));
+            } else {
+                scratch.push_back(static_cast<char16_t>(codePoint));
+            }
+        }
+        return scratch;
+    }
+}
+
+std::wstring FromUtf16(std::u16string_view value) {
+    if constexpr(sizeof(wchar_t) == sizeof(char16_t)) {
+        return std::wstring(reinterpret_cast<const wchar_t*>(value.data()), value.size());
+    } else {
+        std::wstring result;
+        result.reserve(value.size());
+        for(std::size_t i = 0; i < value.size(); ++i) {
+            std::uint32_t unit = value[i];
+            if(unit >= 0xD800 && unit < 0xDC00 && i + 1 < value.size() && value[i + 1] >= 0xDC00 &&
+               value[i + 1] < 0xE000) {
+                unit = 0x10000 + ((unit - 0xD800) << 10) + (value[i + 1] - 0xDC00);
+                ++i;
+            }
+            result.push_back(static_cast<wchar_t>(unit));
+        }
+        return result;
+    }
+}
+
+std::vector<std::uint8_t> EncodeSessionSnapshot(const std::vector<SessionTab>& tabs, std::size_t activeIndex) {
+    std::vector<std::u16string> scratch(tabs.size() * 2);
+    std::vector<std::pair<std::u16string_view, std::u16string_view>> views;
+    views.reserve(tabs.size());
+    std::size_t total = SessionSnapshotFormat::kHeaderSize;
+    for(std::size_t i = 0; i < tabs.size(); ++i) {
+        std::u16string_view path = ToUtf16View(tabs[i].path, scratch[i * 2]);
+        std::u16string_view alias = ToUtf16View(tabs[i].alias, scratch[i * 2 + 1]);
+        views.emplace_back(path, alias);
+        total += RecordSize(path.size(), alias.size());
+    }
+
+    std::vector<std::uint8_t> bytes(total, 0);
+    std::uint8_t* out = bytes.data();
+    std::memcpy(out, SessionSnapshotFormat::kMagic, sizeof(SessionSnapshotFormat::kMagic));
+    PutU16(out + 4, SessionSnapshotFormat::kVersion);
+    PutU16(out + 6, 0);
+    PutU32(out + 8, static_cast<std::uint32_t>(tabs.size()));
+    PutU32(out + 12, static_cast<std::uint32_t>(activeIndex < tabs.size() ? activeIndex : 0));
+
+    std::size_t offset = SessionSnapshotFormat::kHeaderSize;
+    for(std::size_t i = 0; i < tabs.size(); ++i) {
+        const auto& [path, alias] = views[i];
+        std::uint32_t flags = 0;
+        if(tabs[i].locked) {
+            flags |= SessionSnapshotFormat::kFlagLocked;
+        }
+        if(!alias.empty()) {
+            flags |= SessionSnapshotFormat::kFlagHasAlias;
+        }
+        std::uint8_t* record = out + offset;
+        PutU32(record, flags);
+        PutU32(record + 4, static_cast<std::uint32_t>(path.size()));
+        PutU32(record + 8, static_cast<std::uint32_t>(alias.size()));
+        std::uint8_t* text = record + SessionSnapshotFormat::kRecordHeaderSize;
+        std::memcpy(text, path.data(), path.size() * sizeof(char16_t));
+        std::memcpy(text + path.size() * sizeof(char16_t), alias.data(), alias.size() * sizeof(char16_t));
+        offset += RecordSize(path.size(), alias.size());
+    }
+    return bytes;
+}
+
+SessionSnapshotReader::SessionSnapshotReader(const std::uint8_t* data, std::size_t size)
+    : m_data(data)
+    , m_size(size) {
+    m_valid = Parse();
+    if(!m_valid) {
+        m_offsets.clear();
+        m_activeIndex = 0;
+    }
+}
+
+bool SessionSnapshotReader::Parse() {
+    if(m_data == nullptr || m_size < SessionSnapshotFormat::kHeaderSize) {
+        return false;
+    }
+    if(std::memcmp(m_data, SessionSnapshotFormat::kMagic, sizeof(SessionSnapshotFormat::kMagic)) != 0 ||
+       GetU16(m_data + 4) != SessionSnapshotFormat::kVersion) {
+        return false;
+    }
+    std::uint32_t count = GetU32(m_data + 8);
+    m_activeIndex = GetU32(m_data + 12);
+    // Every record needs at least its header, which bounds a corrupt count.
+    if(count > (m_size - SessionSnapshotFormat::kHeaderSize) / SessionSnapshotFormat::kRecordHeaderSize) {
+        return false;
+    }
+    m_offsets.reserve(count);
+    std::size_t offset = SessionSnapshotFormat::kHeaderSize;
+    for(std::uint32_t i = 0; i < count; ++i) {
+        if(m_size - offset < SessionSnapshotFormat::kRecordHeaderSize) {
+            return false;
+        }
+        std::size_t pathUnits = GetU32(m_data + offset + 4);
+        std::size_t aliasUnits = GetU32(m_data + offset + 8);
+        std::size_t available = (m_size - offset - SessionSnapshotFormat::kRecordHeaderSize) / sizeof(char16_t);
+        if(pathUnits > available || aliasUnits > available - pathUnits) {
+            return false;
+        }
+        m_offsets.push_back(offset);
+        offset += RecordSize(pathUnits, aliasUnits);
+        if(offset > m_size) {
+            offset = m_size;
+        }
+    }
+    if(m_activeIndex >= count) {
+        m_activeIndex = 0;
+    }
+    return true;
+}
+
+SessionTabView SessionSnapshotReader::At(std::size_t index) const {
+    SessionTabView view;
+    if(index >= m_offsets.size()) {
+        return view;
+    }
+    const std::uint8_t* record = m_data + m_offsets[index];
+    std::uint32_t flags = GetU32(record);
+    std::size_t pathUnits = GetU32(record + 4);
+    std::size_t aliasUnits = GetU32(record + 8);
+    const auto* text = reinterpret_cast<const char16_t*>(record + SessionSnapshotFormat::kRecordHeaderSize);
+    view.path = std::u16string_view(text, pathUnits);
+    if((flags & SessionSnapshotFormat::kFlagHasAlias) != 0) {
+        view.alias = std::u16string_view(text + pathUnits, aliasUnits);
+    }
+    view.locked = (flags & SessionSnapshotFormat::kFlagLocked) != 0;
+    return view;
+}
+
+std::vector<SessionTab> SessionSnapshotReader::Materialize() const {
+    std::vector<SessionTab> tabs;
+    tabs.reserve(m_offsets.size());
+    for(std::size_t i = 0; i < m_offsets.size(); ++i) {
+        SessionTabView view = At(i);
+        SessionTab tab;
+        tab.path = FromUtf16(view.path);
+        tab.alias = FromUtf16(view.alias);
+        tab.locked = view.locked;
+        tabs.push_back(std::move(tab));
+    }
+    return tabs;
+}
+
+MappedSessionFile::MappedSessionFile(const std::filesystem::path& path) {
+#if defined(_WIN32)
+    HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    LARGE_INTEGER size{};
+    if(!::GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        ::CloseHandle(file);
+        return;
+    }
+    HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping == nullptr) {
+        ::CloseHandle(file);
+        return;
+    }
+    void* view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(view == nullptr) {
+        ::CloseHandle(mapping);
+        ::CloseHandle(file);
+        return;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<const std::uint8_t*>(view);
+    m_size = static_cast<std::size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return;
+    }
+    struct stat info {};
+    if(::fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return;
+    }
+    void* view = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(view == MAP_FAILED) {
+        return;
+    }
+    m_data = static_cast<const std::uint8_t*>(view);
+    m_size = static_cast<std::size_t>(info.st_size);
+#endif
+}
+
+MappedSessionFile::~MappedSessionFile() {
+#if defined(_WIN32)
+    if(m_data != nullptr) {
+        ::UnmapViewOfFile(m_data);
+    }
+    if(m_mapping != nullptr) {
+        ::CloseHandle(m_mapping);
+    }
+    if(m_file != nullptr) {
+        ::CloseHandle(m_file);
+    }
+#else
+    if(m_data != nullptr) {
+        ::munmap(const_cast<std::uint8_t*>(m_data), m_size);
+    }
+#endif
+}
+
+bool WriteSessionSnapshotFile(const std::filesystem::path& path, const std::vector<std::uint8_t>& bytes) {
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::filesystem::path temp = MakeTempPath(path);
+    {
+        std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+        if(!stream) {
+            return false;
+        }
+        stream.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if(!stream.flush()) {
+            stream.close();
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp, path, ec);
+    if(ec) {
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+std::optional<std::vector<SessionTab>> ReadSessionSnapshotFile(const std::filesystem::path& path,
+                                                               std::size_t* activeIndex) {
+    MappedSessionFile file(path);
+    if(file.Data() == nullptr) {
+        return std::nullopt;
+    }
+    SessionSnapshotReader reader(file.Data(), file.Size());
+    if(!reader.IsValid()) {
+        return std::nullopt;
+    }
+    if(activeIndex != nullptr) {
+        *activeIndex = reader.GetActiveIndex();
+    }
+    return reader.Materialize();
+}
+
+} // namespace qttabbar
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qttabbar {
+
+// Binary layout of the tab session written by TabBarHost::SaveSessionState.
+// All integers are little-endian and every record starts on a 4-byte boundary so
+// the UTF-16 strings can be viewed in place from a memory map.
+//
+//   header : magic "QTSS" | u16 version | u16 reserved | u32 tabCount | u32 activeIndex
+//   record : u32 flags | u32 pathUnits | u32 aliasUnits | path UTF-16 | alias UTF-16 | pad to 4
+struct SessionSnapshotFormat {
+    static constexpr char kMagic[4] = {'Q', 'T', 'S', 'S'};
+    static constexpr std::uint16_t kVersion = 1;
+    static constexpr std::size_t kHeaderSize = 16;
+    static constexpr std::size_t kRecordHeaderSize = 12;
+
+    static constexpr std::uint32_t kFlagLocked = 0x1;
+    static constexpr std::uint32_t kFlagHasAlias = 0x2;
+};
+
+struct SessionTab {
+    std::wstring path;
+    std::wstring alias;
+    bool locked = false;
+};
+
+struct SessionTabView {
+    std::u16string_view path;
+    std::u16string_view alias;
+    bool locked = false;
+};
+
+std::u16string_view ToUtf16View(const std::wstring& value, std::u16string& scratch);
+std::wstring FromUtf16(std::u16string_view value);
+
+// Encodes the whole session into one exactly-sized buffer.
+std::vector<std::uint8_t> EncodeSessionSnapshot(const std::vector<SessionTab>& tabs, std::size_t activeIndex);
+
+// Validates a snapshot in place. Views returned by At() point into the caller's
+// buffer and stay valid for as long as it does.
+class SessionSnapshotReader {
+public:
+    SessionSnapshotReader(const std::uint8_t* data, std::size_t size);
+
+    bool IsValid() const noexcept { return m_valid; }
+    std::size_t GetCount() const noexcept { return m_offsets.size(); }
+    std::size_t GetActiveIndex() const noexcept { return m_activeIndex; }
+    SessionTabView At(std::size_t index) const;
+    std::vector<SessionTab> Materialize() const;
+
+private:
+    bool Parse();
+
+    const std::uint8_t* m_data;
+    std::size_t m_size;
+    std::size_t m_activeIndex = 0;
+    std::vector<std::size_t> m_offsets;
+    bool m_valid = false;
+};
+
+// Read-only memory map of a snapshot file.
+class MappedSessionFile {
+public:
+    explicit MappedSessionFile(const std::filesystem::path& path);
+    ~MappedSessionFile();
+
+    MappedSessionFile(const MappedSessionFile&) = delete;
+    MappedSessionFile& operator=(const MappedSessionFile&) = delete;
+
+    const std::uint8_t* Data() const noexcept { return m_data; }
+    std::size_t Size() const noexcept { return m_size; }
+
+private:
+    const std::uint8_t* m_data = nullptr;
+    std::size_t m_size = 0;
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+};
+
+// Writes the buffer to a sibling temp file with a single write and renames it
+// over `path`, so readers never observe a partial snapshot.
+bool WriteSessionSnapshotFile(const std::filesystem::path& path, const std::vector<std::uint8_t>& bytes);
+std::optional<std::vector<SessionTab>> ReadSessionSnapshotFile(const std::filesystem::path& path,
+                                                               std::size_t* activeIndex = nullptr);
+
+} // namespace qttabbar
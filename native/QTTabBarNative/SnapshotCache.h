@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace qttabbar {
+
+// A value loaded once and shared as an immutable snapshot until its source
+// changes. Every reload gets the next generation, so holders of a snapshot
+// can tell whether they have seen the current one.
+//
+// Get loads under a mutex: callers arriving during a reload wait for it
+// instead of loading again, so one change costs one load however many
+// windows ask. Snapshots already handed out stay valid and unchanged.
+template<typename T>
+class SnapshotCache {
+public:
+    struct Snapshot {
+        std::uint64_t generation;
+        T value;
+    };
+
+    using Loader = std::function<T()>;
+    // Asked on each Get whether the source changed since it was last asked.
+    using ChangeProbe = std::function<bool()>;
+
+    explicit SnapshotCache(Loader loader, ChangeProbe changed = {})
+        : m_loader(std::move(loader))
+        , m_changed(std::move(changed)) {}
+
+    SnapshotCache(const SnapshotCache&) = delete;
+    SnapshotCache& operator=(const SnapshotCache&) = delete;
+
+    std::shared_ptr<const Snapshot> Get() {
+        std::lock_guard lock(m_mutex);
+        // The probe runs even when a reload is due anyway, so the change it
+        // reports is consumed by this reload rather than causing another.
+        bool changed = m_changed && m_current && m_changed();
+        if(!m_current || m_stale || changed) {
+            m_current = std::make_shared<const Snapshot>(Snapshot{m_generation + 1, m_loader()});
+            ++m_generation;
+            m_stale = false;
+        }
+        return m_current;
+    }
+
+    // Makes the next Get load again, for changes made in this process.
+    void Invalidate() {
+        std::lock_guard lock(m_mutex);
+        m_stale = true;
+    }
+
+    // Generation of the last snapshot loaded; 0 before the first.
+    std::uint64_t Generation() const {
+        std::lock_guard lock(m_mutex);
+        return m_generation;
+    }
+
+private:
+    Loader m_loader;
+    ChangeProbe m_changed;
+    mutable std::mutex m_mutex;
+    std::shared_ptr<const Snapshot> m_current;
+    std::uint64_t m_generation = 0;
+    bool m_stale = false;
+};
+
+} // namespace qttabbar
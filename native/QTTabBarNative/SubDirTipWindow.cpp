@@ -4,9 +4,9 @@
 #include <Shlobj.h>
 #include <Shlwapi.h>
 #include <shellapi.h>
+#include <strsafe.h>
 
 #include <algorithm>
-#include <filesystem>
 
 #include "TabBarHost.h"
 #include "ThumbnailTooltipWindow.h"
@@ -17,16 +17,19 @@ namespace {
 constexpr int kListViewPadding = 12;
 constexpr int kDefaultWidth = 340;
 constexpr int kDefaultHeight = 260;
-constexpr UINT kListViewStyles = LVS_REPORT | LVS_SHOWSELALWAYS | LVS_AUTOARRANGE;
+constexpr UINT kListViewStyles = LVS_REPORT | LVS_SHOWSELALWAYS | LVS_AUTOARRANGE | LVS_OWNERDATA;
 constexpr DWORD kListViewExStyles = LVS_EX_DOUBLEBUFFER | LVS_EX_FULLROWSELECT | LVS_EX_INFOTIP | LVS_EX_LABELTIP;
 constexpr UINT kContextOpen = 1;
 constexpr UINT kContextOpenNewTab = 2;
 constexpr UINT kContextOpenNewWindow = 3;
 
-std::wstring FormatTimestamp(const FILETIME& ft) {
-    if(ft.dwLowDateTime == 0 && ft.dwHighDateTime == 0) {
+std::wstring FormatTimestamp(std::int64_t ticks) {
+    if(ticks == 0) {
         return {};
     }
+    FILETIME ft{};
+    ft.dwLowDateTime = static_cast<DWORD>(static_cast<std::uint64_t>(ticks) & 0xFFFFFFFFu);
+    ft.dwHighDateTime = static_cast<DWORD>(static_cast<std::uint64_t>(ticks) >> 32);
     SYSTEMTIME st{};
     if(!::FileTimeToSystemTime(&ft, &st)) {
         return {};
@@ -126,6 +129,11 @@ SubDirTipWindow::~SubDirTipWindow() {
 }
 
 void SubDirTipWindow::ApplyConfiguration(const qttabbar::ConfigData& config) {
+    // Cached listings were filtered with the old settings.
+    if(config.tips.subDirTipsFiles != m_config.tips.subDirTipsFiles || config.tips.textExt != m_config.tips.textExt ||
+       config.tips.imageExt != m_config.tips.imageExt) {
+        m_listingCache.Clear();
+    }
     m_config = config;
     if(m_thumbnailTooltip) {
         m_thumbnailTooltip->ApplyConfiguration(config.tips);
@@ -134,68 +142,65 @@ void SubDirTipWindow::ApplyConfiguration(const qttabbar::ConfigData& config) {
 }
 
 bool SubDirTipWindow::ShowForPath(const std::wstring& path, const POINT& anchor, bool /*byKeyboard*/) {
-    if(path.empty()) {
+    if(path.empty() || !EnsureTipWindow()) {
         return false;
     }
 
-    if(!IsWindow()) {
-        DWORD style = WS_POPUP | WS_CAPTION | WS_THICKFRAME;
-        DWORD exStyle = WS_EX_TOOLWINDOW | WS_EX_TOPMOST;
-        if(Create(nullptr, CWindow::rcDefault, L"", style, exStyle) == nullptr) {
+    // The tip appears once the first batch arrives (see OnListingReady), so a slow
+    // share or a huge folder never blocks the caller.
+    m_currentPath = path;
+    m_anchorPoint = anchor;
+    if(LoadItemsFromCache(path)) {
+        m_pendingShow = false;
+        if(m_items.empty()) {
+            HideTip();
             return false;
         }
-        EnsureListView();
+        PlaceWindow();
+        return true;
     }
-
-    ApplyConfiguration(m_config);
-
-    m_currentPath = path;
+    m_pendingShow = true;
     PopulateItems(path);
-    if(m_items.empty()) {
-        HideTip();
-        return false;
-    }
-
-    UpdateAnchorRect();
-    RECT workArea{};
-    ::SystemParametersInfoW(SPI_GETWORKAREA, 0, &workArea, 0);
-    int width = kDefaultWidth;
-    int height = std::min(static_cast<int>(std::max<std::size_t>(m_items.size(), 1u) * 22 + 60), kDefaultHeight * 2);
-    int x = anchor.x;
-    int y = anchor.y;
-    if(x + width > workArea.right) {
-        x = workArea.right - width;
-    }
-    if(y + height > workArea.bottom) {
-        y = anchor.y - height;
-    }
-    if(x < workArea.left) {
-        x = workArea.left;
-    }
-    if(y < workArea.top) {
-        y = workArea.top;
-    }
-
-    SetWindowPos(HWND_TOPMOST, x, y, width, height, SWP_SHOWWINDOW);
-    m_showing = true;
     return true;
 }
 
-bool SubDirTipWindow::ShowAndExecute(const std::wstring& path, const POINT& anchor, Command command, bool byKeyboard) {
-    if(!ShowForPath(path, anchor, byKeyboard)) {
+bool SubDirTipWindow::ShowAndExecute(const std::wstring& path, const POINT& anchor, Command command, bool /*byKeyboard*/) {
+    if(path.empty() || !EnsureTipWindow()) {
         return false;
     }
+    // The command needs the first sorted entry right away, so read the listing here.
+    m_currentPath = path;
+    m_anchorPoint = anchor;
+    m_pendingShow = false;
+    LoadItemsNow(path);
     if(m_items.empty()) {
+        HideTip();
         return false;
     }
+    PlaceWindow();
     std::vector<int> indices;
     indices.push_back(0);
     ExecuteCommand(indices, command);
     return true;
 }
 
+bool SubDirTipWindow::EnsureTipWindow() {
+    if(!IsWindow()) {
+        DWORD style = WS_POPUP | WS_CAPTION | WS_THICKFRAME;
+        DWORD exStyle = WS_EX_TOOLWINDOW | WS_EX_TOPMOST;
+        if(Create(nullptr, CWindow::rcDefault, L"", style, exStyle) == nullptr) {
+            return false;
+        }
+        EnsureListView();
+    }
+    ApplyConfiguration(m_config);
+    return true;
+}
+
 void SubDirTipWindow::HideTip() {
+    m_enumerator.Cancel();
     m_showing = false;
+    m_pendingShow = false;
     if(IsWindow()) {
         ShowWindow(SW_HIDE);
     }
@@ -218,6 +223,7 @@ LRESULT SubDirTipWindow::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lPa
 
 LRESULT SubDirTipWindow::OnDestroy(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
     bHandled = TRUE;
+    m_enumerator.Cancel();
     if(m_listView.IsWindow()) {
         m_listView.DestroyWindow();
     }
@@ -265,7 +271,10 @@ LRESULT SubDirTipWindow::OnNotify(UINT /*uMsg*/, WPARAM wParam, LPARAM lParam, B
         return 0;
     }
     NMHDR* header = reinterpret_cast<NMHDR*>(lParam);
-    if(header->code == LVN_ITEMACTIVATE) {
+    if(header->code == LVN_GETDISPINFOW) {
+        GetDisplayInfo(*reinterpret_cast<NMLVDISPINFOW*>(header));
+        bHandled = TRUE;
+    } else if(header->code == LVN_ITEMACTIVATE) {
         NMLISTVIEW* view = reinterpret_cast<NMLISTVIEW*>(header);
         std::vector<int> indices = {view->iItem};
         ExecuteCommand(indices, Command::Open);
@@ -306,6 +315,50 @@ LRESULT SubDirTipWindow::OnBeginDrag(UINT uMsg, WPARAM wParam, LPARAM lParam, BO
     return 0;
 }
 
+LRESULT SubDirTipWindow::OnListingReady(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
+    bHandled = TRUE;
+    bool complete = false;
+    std::vector<std::size_t> selected;
+    std::optional<std::size_t> focused;
+    for(auto& update : m_enumerator.TakeUpdates()) {
+        if(update.complete) {
+            // The final update is the sorted listing and replaces the streamed
+            // batches. Rows picked from those keep their items, not their indices.
+            std::vector<std::size_t> positions = GetSelectedPositions(focused);
+            if(focused) {
+                auto moved = qttabbar::MapEntryPositions(m_items, {*focused}, update.entries);
+                focused = moved.empty() ? std::nullopt : std::optional<std::size_t>(moved.front());
+            }
+            selected = qttabbar::MapEntryPositions(m_items, positions, update.entries);
+            m_items = std::move(update.entries);
+            complete = true;
+            if(!update.failed && update.stamp) {
+                m_listingCache.Store(m_currentPath, *update.stamp, m_items);
+            }
+        } else {
+            m_items.insert(m_items.end(), std::make_move_iterator(update.entries.begin()),
+                           std::make_move_iterator(update.entries.end()));
+        }
+    }
+    SetListItemCount();
+    if(complete) {
+        SelectPositions(selected, focused);
+        ::InvalidateRect(m_listView, nullptr, FALSE);
+    }
+
+    if(m_items.empty()) {
+        if(complete) {
+            HideTip();
+        }
+        return 0;
+    }
+    if(m_pendingShow || (complete && m_showing)) {
+        m_pendingShow = false;
+        PlaceWindow();
+    }
+    return 0;
+}
+
 void SubDirTipWindow::EnsureListView() {
     if(m_listView.IsWindow()) {
         return;
@@ -336,60 +389,146 @@ void SubDirTipWindow::PopulateItems(const std::wstring& path) {
     if(!m_listView.IsWindow()) {
         return;
     }
-    ListView_DeleteAllItems(m_listView);
     m_items.clear();
+    SetListItemCount();
+    HWND hwnd = m_hWnd;
+    m_enumerator.Start(path, MakeEntryFilter(), [hwnd]() { ::PostMessageW(hwnd, WM_APP_LISTING_READY, 0, 0); });
+}
 
-    namespace fs = std::filesystem;
-    std::error_code ec;
-    fs::directory_iterator it(path, fs::directory_options::skip_permission_denied, ec);
-    if(ec) {
+void SubDirTipWindow::LoadItemsNow(const std::wstring& path) {
+    if(LoadItemsFromCache(path)) {
         return;
     }
+    m_enumerator.Cancel();
+    m_items.clear();
+    std::optional<std::int64_t> stamp = qttabbar::ReadDirectoryStamp(path);
+    bool ok = qttabbar::EnumerateDirectory(path, MakeEntryFilter(), [this](Item&& item) {
+        m_items.push_back(std::move(item));
+        return true;
+    });
+    qttabbar::SortDirectoryEntries(m_items);
+    if(ok && stamp) {
+        m_listingCache.Store(path, *stamp, m_items);
+    }
+    SetListItemCount();
+}
 
-    for(const auto& entry : it) {
-        std::wstring name = entry.path().filename().wstring();
-        std::wstring fullPath = entry.path().wstring();
-        Item item{};
-        item.name = name;
-        item.path = fullPath;
-        item.isDirectory = entry.is_directory();
-        WIN32_FILE_ATTRIBUTE_DATA data{};
-        if(::GetFileAttributesExW(fullPath.c_str(), GetFileExInfoStandard, &data)) {
-            item.modified = data.ftLastWriteTime;
-        }
-        if(item.isDirectory || AllowFile(entry.path().extension().wstring(), m_config)) {
-            m_items.push_back(std::move(item));
-        }
+bool SubDirTipWindow::LoadItemsFromCache(const std::wstring& path) {
+    auto listing = m_listingCache.Lookup(path);
+    if(!listing) {
+        return false;
+    }
+    m_enumerator.Cancel();
+    m_items.assign(listing->begin(), listing->end());
+    SetListItemCount();
+    if(m_listView.IsWindow()) {
+        ::InvalidateRect(m_listView, nullptr, FALSE);
+    }
+    return true;
+}
+
+void SubDirTipWindow::SetListItemCount() {
+    if(!m_listView.IsWindow()) {
+        return;
+    }
+    ListView_SetItemCountEx(m_listView, static_cast<int>(m_items.size()), LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+}
+
+std::vector<std::size_t> SubDirTipWindow::GetSelectedPositions(std::optional<std::size_t>& focused) const {
+    std::vector<std::size_t> positions;
+    focused.reset();
+    if(!m_listView.IsWindow()) {
+        return positions;
+    }
+    for(int index = ListView_GetNextItem(m_listView, -1, LVNI_SELECTED); index >= 0;
+        index = ListView_GetNextItem(m_listView, index, LVNI_SELECTED)) {
+        positions.push_back(static_cast<std::size_t>(index));
+    }
+    int focus = ListView_GetNextItem(m_listView, -1, LVNI_FOCUSED);
+    if(focus >= 0) {
+        focused = static_cast<std::size_t>(focus);
+    }
+    return positions;
+}
+
+void SubDirTipWindow::SelectPositions(const std::vector<std::size_t>& positions, std::optional<std::size_t> focused) {
+    if(!m_listView.IsWindow()) {
+        return;
+    }
+    ListView_SetItemState(m_listView, -1, 0, LVIS_SELECTED | LVIS_FOCUSED);
+    for(std::size_t position : positions) {
+        ListView_SetItemState(m_listView, static_cast<int>(position), LVIS_SELECTED, LVIS_SELECTED);
     }
+    if(focused) {
+        ListView_SetItemState(m_listView, static_cast<int>(*focused), LVIS_FOCUSED, LVIS_FOCUSED);
+        ListView_EnsureVisible(m_listView, static_cast<int>(*focused), FALSE);
+    }
+}
 
-    std::sort(m_items.begin(), m_items.end(), [](const Item& lhs, const Item& rhs) {
-        if(lhs.isDirectory != rhs.isDirectory) {
-            return lhs.isDirectory && !rhs.isDirectory;
+void SubDirTipWindow::GetDisplayInfo(NMLVDISPINFOW& info) {
+    LVITEMW& lvi = info.item;
+    if(lvi.iItem < 0 || static_cast<std::size_t>(lvi.iItem) >= m_items.size()) {
+        return;
+    }
+    const Item& item = m_items[static_cast<std::size_t>(lvi.iItem)];
+    if((lvi.mask & LVIF_TEXT) != 0 && lvi.pszText != nullptr && lvi.cchTextMax > 0) {
+        std::wstring text;
+        switch(lvi.iSubItem) {
+        case 0:
+            text = item.name;
+            break;
+        case 1:
+            text = item.isDirectory ? L"Folder" : L"File";
+            break;
+        case 2:
+            text = FormatTimestamp(item.modified);
+            break;
+        default:
+            break;
         }
-        return _wcsicmp(lhs.name.c_str(), rhs.name.c_str()) < 0;
-    });
+        ::StringCchCopyW(lvi.pszText, static_cast<size_t>(lvi.cchTextMax), text.c_str());
+    }
+    if((lvi.mask & LVIF_IMAGE) != 0) {
+        // Icons are resolved only for rows the list view actually draws.
+        lvi.iImage = GetSmallIconIndex(item.path, item.isDirectory);
+    }
+}
 
-    for(std::size_t index = 0; index < m_items.size(); ++index) {
-        AddItemToList(index, m_items[index]);
-    }
-}
-
-void SubDirTipWindow::AddItemToList(std::size_t index, const Item& item) {
-    LVITEMW lvi{};
-    lvi.mask = LVIF_TEXT | LVIF_IMAGE | LVIF_PARAM;
-    lvi.iItem = static_cast<int>(index);
-    lvi.pszText = const_cast<wchar_t*>(item.name.c_str());
-    lvi.lParam = static_cast<LPARAM>(index);
-    lvi.iImage = GetSmallIconIndex(item.path, item.isDirectory);
-    int inserted = ListView_InsertItemW(m_listView, &lvi);
-    if(inserted >= 0) {
-        std::wstring typeText = item.isDirectory ? L"Folder" : L"File";
-        ListView_SetItemText(m_listView, inserted, 1, const_cast<wchar_t*>(typeText.c_str()));
-        std::wstring modified = FormatTimestamp(item.modified);
-        if(!modified.empty()) {
-            ListView_SetItemText(m_listView, inserted, 2, const_cast<wchar_t*>(modified.c_str()));
+qttabbar::DirectoryEntryFilter SubDirTipWindow::MakeEntryFilter() const {
+    qttabbar::ConfigData config = m_config;
+    return [config](const Item& item) {
+        if(item.isDirectory) {
+            return true;
         }
+        std::size_t dot = item.name.find_last_of(L'.');
+        std::wstring extension = dot == std::wstring::npos || dot == 0 ? std::wstring() : item.name.substr(dot);
+        return AllowFile(extension, config);
+    };
+}
+
+void SubDirTipWindow::PlaceWindow() {
+    UpdateAnchorRect();
+    RECT workArea{};
+    ::SystemParametersInfoW(SPI_GETWORKAREA, 0, &workArea, 0);
+    int width = kDefaultWidth;
+    int height = std::min(static_cast<int>(std::max<std::size_t>(m_items.size(), 1u) * 22 + 60), kDefaultHeight * 2);
+    int x = m_anchorPoint.x;
+    int y = m_anchorPoint.y;
+    if(x + width > workArea.right) {
+        x = workArea.right - width;
+    }
+    if(y + height > workArea.bottom) {
+        y = m_anchorPoint.y - height;
+    }
+    if(x < workArea.left) {
+        x = workArea.left;
     }
+    if(y < workArea.top) {
+        y = workArea.top;
+    }
+
+    SetWindowPos(HWND_TOPMOST, x, y, width, height, SWP_SHOWWINDOW);
+    m_showing = true;
 }
 
 void SubDirTipWindow::UpdateColumns() {
@@ -562,6 +701,18 @@ void SubDirTipWindow::UpdateThumbnailPreview(int hotItem) {
     ::ClientToScreen(m_listView, &bottomRight);
     RECT reference{topLeft.x, topLeft.y, bottomRight.x, bottomRight.y};
     m_thumbnailTooltip->ShowForPath(m_items[hotItem].path, reference, m_hWnd);
+
+    // Decode the neighbours too so moving up or down the list shows them at once.
+    constexpr int kPrefetchRadius = 3;
+    std::vector<std::wstring> neighbours;
+    for(int offset = 1; offset <= kPrefetchRadius; ++offset) {
+        for(int index : {hotItem + offset, hotItem - offset}) {
+            if(index >= 0 && static_cast<std::size_t>(index) < m_items.size() && !m_items[index].isDirectory) {
+                neighbours.push_back(m_items[index].path);
+            }
+        }
+    }
+    m_thumbnailTooltip->Prefetch(neighbours);
 }
 
 void SubDirTipWindow::UpdateAnchorRect() {
@@ -8,6 +8,8 @@
 #include <vector>
 
 #include "Config.h"
+#include "DirectoryEnumerator.h"
+#include "DirectoryListingCache.h"
 
 class TabBarHost;
 class ThumbnailTooltipWindow;
@@ -20,12 +22,7 @@ public:
         OpenNewWindow,
     };
 
-    struct Item {
-        std::wstring name;
-        std::wstring path;
-        bool isDirectory = false;
-        FILETIME modified{};
-    };
+    using Item = qttabbar::DirectoryEntry;
 
     DECLARE_WND_CLASS_EX(L"QTTabBarNative_SubDirTip", CS_DBLCLKS, COLOR_WINDOW);
 
@@ -40,6 +37,7 @@ public:
         MESSAGE_HANDLER(WM_KILLFOCUS, OnKillFocus)
         MESSAGE_HANDLER(WM_NOTIFY, OnNotify)
         MESSAGE_HANDLER(WM_LBUTTONDOWN, OnBeginDrag)
+        MESSAGE_HANDLER(WM_APP_LISTING_READY, OnListingReady)
     END_MSG_MAP()
 
     void ApplyConfiguration(const qttabbar::ConfigData& config);
@@ -56,10 +54,20 @@ private:
     LRESULT OnKillFocus(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnBeginDrag(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnListingReady(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 
+    bool EnsureTipWindow();
     void EnsureListView();
     void PopulateItems(const std::wstring& path);
-    void AddItemToList(std::size_t index, const Item& item);
+    void LoadItemsNow(const std::wstring& path);
+    bool LoadItemsFromCache(const std::wstring& path);
+    void SetListItemCount();
+    // Selected and focused rows, and the same selection applied to new rows.
+    std::vector<std::size_t> GetSelectedPositions(std::optional<std::size_t>& focused) const;
+    void SelectPositions(const std::vector<std::size_t>& positions, std::optional<std::size_t> focused);
+    void GetDisplayInfo(NMLVDISPINFOW& info);
+    qttabbar::DirectoryEntryFilter MakeEntryFilter() const;
+    void PlaceWindow();
     void UpdateColumns();
     void ExecuteCommand(const std::vector<int>& indices, Command command);
     void ShowContextMenu(const POINT& screenPoint);
@@ -67,6 +75,8 @@ private:
     void UpdateThumbnailPreview(int hotItem);
     void UpdateAnchorRect();
 
+    static constexpr UINT WM_APP_LISTING_READY = WM_APP + 0x40;
+
     TabBarHost& m_owner;
     qttabbar::ConfigData m_config{};
     CWindow m_listView;
@@ -75,6 +85,10 @@ private:
     std::wstring m_currentPath;
     std::unique_ptr<ThumbnailTooltipWindow> m_thumbnailTooltip;
     RECT m_anchorRect{};
+    POINT m_anchorPoint{};
+    qttabbar::AsyncDirectoryEnumerator m_enumerator;
+    qttabbar::DirectoryListingCache m_listingCache;
     bool m_showing = false;
+    bool m_pendingShow = false;
 };
 
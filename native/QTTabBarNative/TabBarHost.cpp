@@ -7,7 +7,6 @@
 #include <shobjidl.h>
 #include <shlobj.h>
 #include <VersionHelpers.h>
-#include <wincrypt.h>
 
 #include <algorithm>
 #include <array>
@@ -33,7 +32,9 @@
 #include "TextInputDialog.h"
 #include "Config.h"
 #include "ConfigEnums.h"
+#include "FileHashEngine.h"
 #include "TabSwitchOverlay.h"
+#include "SessionSnapshot.h"
 #include "SubDirTipWindow.h"
 
 using qttabbar::BindAction;
@@ -93,6 +94,33 @@ std::vector<std::wstring> SplitTabsString(const std::wstring& value) {
     return output;
 }
 
+std::filesystem::path ResolveSessionSnapshotPath() {
+    PWSTR folder = nullptr;
+    if(FAILED(::SHGetKnownFolderPath(FOLDERID_LocalAppData, KF_FLAG_DEFAULT, nullptr, &folder)) || folder == nullptr) {
+        return {};
+    }
+    std::filesystem::path path(folder);
+    ::CoTaskMemFree(folder);
+    path /= L"QTTabBar";
+    path /= L"Session.qts";
+    return path;
+}
+
+// Every window saves to the same file, so they share one writer: submissions
+// for the file coalesce instead of racing. Never destroyed, as joining its
+// thread during DLL unload could deadlock on the loader lock.
+qttabbar::BackgroundSaveWriter& SessionSnapshotWriter() {
+    static auto* writer = new qttabbar::BackgroundSaveWriter(
+        [](const std::filesystem::path& target, const std::vector<uint8_t>& bytes) {
+            if(!qttabbar::WriteSessionSnapshotFile(target, bytes)) {
+                InstanceManager::Instance().Log(L"SaveSessionState failed to write '%s'", target.c_str());
+                return false;
+            }
+            return true;
+        });
+    return *writer;
+}
+
 std::wstring ExtractLeafName(const std::wstring& path) {
     if(path.empty()) {
         return {};
@@ -205,6 +233,7 @@ void TabBarHost::ExecuteCommand(UINT commandId) {
                     RecordClosedEntry(path);
                 }
                 PersistClosedHistory();
+                ScheduleSessionSave();
             }
         }
         break;
@@ -216,6 +245,7 @@ void TabBarHost::ExecuteCommand(UINT commandId) {
                     RecordClosedEntry(path);
                 }
                 PersistClosedHistory();
+                ScheduleSessionSave();
             }
         }
         break;
@@ -227,6 +257,7 @@ void TabBarHost::ExecuteCommand(UINT commandId) {
                     RecordClosedEntry(path);
                 }
                 PersistClosedHistory();
+                ScheduleSessionSave();
             }
         }
         break;
@@ -331,45 +362,130 @@ void TabBarHost::ShowContextMenu(const POINT& screenPoint) {
     ::DestroyMenu(menu);
 }
 
-void TabBarHost::SaveSessionState() const {
-    std::vector<std::wstring> paths = m_tabControl ? m_tabControl->GetTabPaths() : std::vector<std::wstring>();
-    std::wstring serialized = JoinTabList(paths);
-    ATLTRACE(L"TabBarHost::SaveSessionState tabs='%s'\n", serialized.c_str());
+void TabBarHost::SaveSessionState() {
+    FlushSessionState(true);
+}
 
+void TabBarHost::ScheduleSessionSave() {
+    m_sessionSaves.Request();
+    if(m_hWnd == nullptr || !::IsWindow(m_hWnd)) {
+        return;
+    }
+    if(auto remaining = m_sessionSaves.TimeUntilDue()) {
+        m_sessionSaveTimer = ::SetTimer(m_hWnd, ID_TIMER_SAVESESSION, static_cast<UINT>(remaining->count()), nullptr);
+    }
+}
+
+void TabBarHost::FlushSessionState(bool wait) {
+    if(m_sessionSaveTimer) {
+        if(m_hWnd != nullptr) {
+            ::KillTimer(m_hWnd, ID_TIMER_SAVESESSION);
+        }
+        m_sessionSaveTimer = 0;
+    }
+    std::filesystem::path snapshotPath = ResolveSessionSnapshotPath();
+    if(snapshotPath.empty()) {
+        return;
+    }
+    qttabbar::BackgroundSaveWriter& writer = SessionSnapshotWriter();
+    writer.Submit(std::move(snapshotPath), CaptureSessionSnapshot());
+    m_sessionSaves.MarkFlushed();
+
+    // The managed build and the installer still exchange tabs through this value.
     CRegKey key;
     if(key.Create(HKEY_CURRENT_USER, kRegistryRoot) == ERROR_SUCCESS) {
+        std::wstring serialized = m_tabControl ? JoinTabList(m_tabControl->GetTabPaths()) : std::wstring();
         key.SetStringValue(kTabsValueName, serialized.c_str());
     }
+    if(wait) {
+        writer.WaitIdle();
+    }
+}
+
+std::vector<uint8_t> TabBarHost::CaptureSessionSnapshot() const {
+    std::vector<qttabbar::SessionTab> tabs;
+    std::size_t activeIndex = 0;
+    if(m_tabControl) {
+        std::size_t count = m_tabControl->GetCount();
+        tabs.reserve(count);
+        for(std::size_t i = 0; i < count; ++i) {
+            qttabbar::SessionTab tab;
+            tab.path = m_tabControl->GetPath(i);
+            if(tab.path.empty()) {
+                continue;
+            }
+            if(i == m_tabControl->GetActiveIndex()) {
+                activeIndex = tabs.size();
+            }
+            tab.alias = m_tabControl->GetAlias(i);
+            tab.locked = m_tabControl->IsLocked(i);
+            tabs.push_back(std::move(tab));
+        }
+    }
+    ATLTRACE(L"TabBarHost::CaptureSessionSnapshot tabs=%zu\n", tabs.size());
+    return qttabbar::EncodeSessionSnapshot(tabs, activeIndex);
 }
 
 void TabBarHost::RestoreSessionState() {
+    if(!m_tabControl) {
+        return;
+    }
+
+    std::filesystem::path snapshotPath = ResolveSessionSnapshotPath();
+    if(!snapshotPath.empty()) {
+        qttabbar::MappedSessionFile file(snapshotPath);
+        qttabbar::SessionSnapshotReader reader(file.Data(), file.Size());
+        if(reader.IsValid() && reader.GetCount() > 0) {
+            for(std::size_t i = 0; i < reader.GetCount(); ++i) {
+                qttabbar::SessionTabView view = reader.At(i);
+                std::wstring tabPath = qttabbar::FromUtf16(view.path);
+                if(tabPath.empty()) {
+                    continue;
+                }
+                std::size_t index = m_tabControl->AddTab(tabPath, false, true);
+                if(index >= m_tabControl->GetCount()) {
+                    continue;
+                }
+                if(view.locked) {
+                    m_tabControl->SetLocked(index, true);
+                }
+                if(!view.alias.empty()) {
+                    m_tabControl->SetAlias(index, qttabbar::FromUtf16(view.alias));
+                }
+            }
+            if(m_tabControl->GetCount() > 0) {
+                std::size_t active = std::min(reader.GetActiveIndex(), m_tabControl->GetCount() - 1);
+                m_currentPath = m_tabControl->ActivateTab(active);
+            }
+            LogTabsState(L"RestoreSessionState");
+            return;
+        }
+    }
+
+    // Without a snapshot, fall back to the ';'-joined registry value. It is left
+    // in place: the managed build and the installer read and write it too.
     CRegKey key;
     if(key.Open(HKEY_CURRENT_USER, kRegistryRoot, KEY_READ) != ERROR_SUCCESS) {
         return;
     }
-
     ULONG chars = 0;
     if(key.QueryStringValue(kTabsValueName, nullptr, &chars) != ERROR_SUCCESS || chars == 0) {
         return;
     }
-
     std::wstring buffer(chars, L'\0');
-    if(key.QueryStringValue(kTabsValueName, buffer.data(), &chars) == ERROR_SUCCESS) {
-        if(!buffer.empty() && buffer.back() == L'\0') {
-            buffer.pop_back();
-        }
-        auto restored = SplitTabsString(buffer);
-        if(m_tabControl) {
-            for(const auto& tabPath : restored) {
-                m_tabControl->AddTab(tabPath, false, true);
-            }
-            if(m_tabControl->GetCount() > 0) {
-                auto path = m_tabControl->ActivateTab(0);
-                m_currentPath = path;
-            }
-        }
-        LogTabsState(L"RestoreSessionState");
+    if(key.QueryStringValue(kTabsValueName, buffer.data(), &chars) != ERROR_SUCCESS) {
+        return;
+    }
+    if(!buffer.empty() && buffer.back() == L'\0') {
+        buffer.pop_back();
+    }
+    for(const auto& tabPath : SplitTabsString(buffer)) {
+        m_tabControl->AddTab(tabPath, false, true);
+    }
+    if(m_tabControl->GetCount() > 0) {
+        m_currentPath = m_tabControl->ActivateTab(0);
     }
+    LogTabsState(L"RestoreSessionState");
 }
 
 void TabBarHost::OnBandVisibilityChanged(bool visible) {
@@ -611,8 +727,14 @@ bool TabBarHost::ExecuteBindAction(BindAction action, bool isRepeat, std::option
         return false;
     case BindAction::SortTabsByName:
     case BindAction::SortTabsByPath:
+        if(!m_tabControl || m_tabControl->GetCount() < 2) {
+            return false;
+        }
+        m_tabControl->SortTabs(action == BindAction::SortTabsByPath);
+        ScheduleSessionSave();
+        return true;
     case BindAction::SortTabsByActive:
-        ATLTRACE(L"TabBarHost::ExecuteBindAction SortTabs not implemented\n");
+        ATLTRACE(L"TabBarHost::ExecuteBindAction SortTabsByActive not implemented\n");
         return false;
     case BindAction::SwitchToLastActivated:
         ATLTRACE(L"TabBarHost::ExecuteBindAction SwitchToLastActivated not implemented\n");
@@ -827,6 +949,15 @@ LRESULT TabBarHost::OnTimer(UINT /*uMsg*/, WPARAM wParam, LPARAM /*lParam*/, BOO
         if(m_pendingSubDirTipIndex) {
             ShowSubDirTip(*m_pendingSubDirTipIndex);
         }
+    } else if(wParam == ID_TIMER_SAVESESSION) {
+        ::KillTimer(m_hWnd, ID_TIMER_SAVESESSION);
+        m_sessionSaveTimer = 0;
+        if(m_sessionSaves.IsDue()) {
+            FlushSessionState(false);
+        } else if(auto remaining = m_sessionSaves.TimeUntilDue()) {
+            UINT delay = std::max(static_cast<UINT>(remaining->count()), kSessionSaveRetryMs);
+            m_sessionSaveTimer = ::SetTimer(m_hWnd, ID_TIMER_SAVESESSION, delay, nullptr);
+        }
     }
     return 0;
 }
@@ -1079,6 +1210,7 @@ void TabBarHost::AddTab(const std::wstring& path, bool makeActive, bool allowDup
     if(makeActive) {
         m_currentPath = path;
     }
+    ScheduleSessionSave();
 }
 
 void TabBarHost::ActivateTab(std::size_t index) {
@@ -1089,6 +1221,7 @@ void TabBarHost::ActivateTab(std::size_t index) {
     if(!path.empty()) {
         m_currentPath = path;
     }
+    ScheduleSessionSave();
     LogTabsState(L"ActivateTab");
 }
 
@@ -1100,6 +1233,7 @@ void TabBarHost::ActivateNextTab() {
     if(!path.empty()) {
         m_currentPath = path;
     }
+    ScheduleSessionSave();
 }
 
 void TabBarHost::ActivatePreviousTab() {
@@ -1110,6 +1244,7 @@ void TabBarHost::ActivatePreviousTab() {
     if(!path.empty()) {
         m_currentPath = path;
     }
+    ScheduleSessionSave();
 }
 
 void TabBarHost::ActivateFirstTab() {
@@ -1160,6 +1295,7 @@ void TabBarHost::CloseTabAt(std::size_t index) {
         m_currentPath.clear();
     }
     PersistClosedHistory();
+    ScheduleSessionSave();
     LogTabsState(L"CloseTabAt");
 }
 
@@ -1253,6 +1389,7 @@ void TabBarHost::ToggleLockAllTabs() {
     for(std::size_t i = 0; i < m_tabControl->GetCount(); ++i) {
         m_tabControl->SetLocked(i, anyUnlocked);
     }
+    ScheduleSessionSave();
 }
 
 void TabBarHost::CloseAllTabsExceptActive() {
@@ -1290,6 +1427,7 @@ void TabBarHost::CloseAllTabsExcept(std::size_t index) {
     if(auto active = m_tabControl->GetActivePath()) {
         m_currentPath = *active;
     }
+    ScheduleSessionSave();
     LogTabsState(L"CloseAllTabsExcept");
 }
 
@@ -1304,6 +1442,7 @@ void TabBarHost::CloseTabsToLeftOf(std::size_t index) {
     if(!closed.empty()) {
         PersistClosedHistory();
     }
+    ScheduleSessionSave();
     LogTabsState(L"CloseTabsToLeftOf");
 }
 
@@ -1318,6 +1457,7 @@ void TabBarHost::CloseTabsToRightOf(std::size_t index) {
     if(!closed.empty()) {
         PersistClosedHistory();
     }
+    ScheduleSessionSave();
     LogTabsState(L"CloseTabsToRightOf");
 }
 
@@ -1432,6 +1572,7 @@ void TabBarHost::ToggleLockTab(std::size_t index) {
     }
     bool locked = m_tabControl->IsLocked(index);
     m_tabControl->SetLocked(index, !locked);
+    ScheduleSessionSave();
 }
 
 void TabBarHost::SetTabAlias(std::size_t index, const std::wstring& alias) {
@@ -1439,6 +1580,7 @@ void TabBarHost::SetTabAlias(std::size_t index, const std::wstring& alias) {
         return;
     }
     m_tabControl->SetAlias(index, alias);
+    ScheduleSessionSave();
 }
 
 void TabBarHost::CopyPathToClipboard(const std::wstring& path) const {
@@ -2243,19 +2385,85 @@ bool TabBarHost::InvokeShellVerb(const wchar_t* verb) {
 }
 
 void TabBarHost::ShowFileHashDialog(const std::vector<std::wstring>& paths) const {
+    using qttabbar::HashAlgorithm;
+
+    std::vector<qttabbar::FileHashResult> results;
+    if(!paths.empty()) {
+        qttabbar::FileHashOptions options;
+        options.algorithms = HashAlgorithm::Md5 | HashAlgorithm::Sha1 | HashAlgorithm::Sha256;
+        qttabbar::FileHashJob job(paths, options);
+
+        // Progress dialog while the job runs; it closes itself once hashing is done.
+        TASKDIALOGCONFIG progressConfig{};
+        progressConfig.cbSize = sizeof(progressConfig);
+        progressConfig.hwndParent = m_owner.GetHostWindow();
+        progressConfig.dwFlags = TDF_ALLOW_DIALOG_CANCELLATION | TDF_SHOW_PROGRESS_BAR | TDF_CALLBACK_TIMER;
+        progressConfig.dwCommonButtons = TDCBF_CANCEL_BUTTON;
+        progressConfig.pszWindowTitle = L"QTTabBar";
+        progressConfig.pszMainInstruction = L"Computing checksums...";
+        progressConfig.pfCallback = [](HWND hwnd, UINT msg, WPARAM wParam, LPARAM, LONG_PTR refData) -> HRESULT {
+            auto* hashJob = reinterpret_cast<qttabbar::FileHashJob*>(refData);
+            switch(msg) {
+            case TDN_CREATED:
+                ::SendMessageW(hwnd, TDM_SET_PROGRESS_BAR_RANGE, 0, MAKELPARAM(0, 1000));
+                break;
+            case TDN_TIMER: {
+                if(hashJob->IsDone()) {
+                    // Cancel is the only button; the click below sees the job done.
+                    ::SendMessageW(hwnd, TDM_CLICK_BUTTON, IDCANCEL, 0);
+                    break;
+                }
+                auto progress = hashJob->GetProgress();
+                if(progress.bytesTotal > 0) {
+                    auto permille = static_cast<WPARAM>(progress.bytesDone * 1000 / progress.bytesTotal);
+                    ::SendMessageW(hwnd, TDM_SET_PROGRESS_BAR_POS, permille, 0);
+                }
+                break;
+            }
+            case TDN_BUTTON_CLICKED:
+                if(wParam == IDCANCEL && !hashJob->IsDone()) {
+                    hashJob->Cancel();
+                }
+                break;
+            default:
+                break;
+            }
+            return S_OK;
+        };
+        progressConfig.lpCallbackData = reinterpret_cast<LONG_PTR>(&job);
+        if(FAILED(::TaskDialogIndirect(&progressConfig, nullptr, nullptr, nullptr))) {
+            InstanceManager::Instance().Log(L"ShowFileHashDialog: progress dialog unavailable, hashing in foreground");
+        }
+        results = job.Wait();
+        // A cancel that came after the last file was hashed lost nothing.
+        bool cancelled = std::any_of(results.begin(), results.end(),
+            [](const qttabbar::FileHashResult& result) { return result.cancelled; });
+        if(cancelled) {
+            return;
+        }
+    }
+
     std::wstring content;
     if(paths.empty()) {
         content = L"No files selected.";
     } else {
-        for(size_t i = 0; i < paths.size(); ++i) {
-            content.append(paths[i]);
-            content.append(L"\n    ");
-            if(auto hash = ComputeFileHash(paths[i])) {
-                content.append(*hash);
+        constexpr std::array<HashAlgorithm, 3> shown{HashAlgorithm::Md5, HashAlgorithm::Sha1, HashAlgorithm::Sha256};
+        for(size_t i = 0; i < results.size(); ++i) {
+            const auto& result = results[i];
+            content.append(result.path);
+            if(result.ok) {
+                for(HashAlgorithm algorithm : shown) {
+                    content.append(L"\n    ");
+                    content.append(qttabbar::HashAlgorithmName(algorithm));
+                    content.append(L": ");
+                    content.append(result.Digest(algorithm));
+                }
             } else {
-                content.append(L"(error)");
+                InstanceManager::Instance().Log(L"ShowFileHashDialog: hashing failed for '%s' (err=%lu)",
+                                                result.path.c_str(), static_cast<unsigned long>(result.error));
+                content.append(L"\n    (error)");
             }
-            if(i + 1 < paths.size()) {
+            if(i + 1 < results.size()) {
                 content.append(L"\n\n");
             }
         }
@@ -2267,102 +2475,11 @@ void TabBarHost::ShowFileHashDialog(const std::vector<std::wstring>& paths) cons
     config.dwFlags = TDF_ALLOW_DIALOG_CANCELLATION;
     config.dwCommonButtons = TDCBF_OK_BUTTON;
     config.pszWindowTitle = L"QTTabBar";
-    config.pszMainInstruction = L"MD5 Checksum";
+    config.pszMainInstruction = L"File Checksums";
     config.pszContent = content.c_str();
     if(FAILED(::TaskDialogIndirect(&config, nullptr, nullptr, nullptr))) {
-        ::MessageBoxW(m_hWnd, content.c_str(), L"MD5 Checksum", MB_OK | MB_ICONINFORMATION);
-    }
-}
-
-std::optional<std::wstring> TabBarHost::ComputeFileHash(const std::wstring& path) const {
-    HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
-                                FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
-    if(file == INVALID_HANDLE_VALUE) {
-        DWORD error = ::GetLastError();
-        InstanceManager::Instance().Log(L"ComputeFileHash(CreateFile) failed for '%s' (err=%lu)",
-                                        path.c_str(), error);
-        return std::nullopt;
-    }
-
-    HCRYPTPROV provider = 0;
-    if(!::CryptAcquireContextW(&provider, nullptr, nullptr, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT)) {
-        DWORD error = ::GetLastError();
-        InstanceManager::Instance().Log(L"ComputeFileHash(CryptAcquireContext) failed for '%s' (err=%lu)",
-                                        path.c_str(), error);
-        ::CloseHandle(file);
-        return std::nullopt;
-    }
-
-    HCRYPTHASH hash = 0;
-    if(!::CryptCreateHash(provider, CALG_MD5, 0, 0, &hash)) {
-        DWORD error = ::GetLastError();
-        InstanceManager::Instance().Log(L"ComputeFileHash(CryptCreateHash) failed for '%s' (err=%lu)",
-                                        path.c_str(), error);
-        ::CryptReleaseContext(provider, 0);
-        ::CloseHandle(file);
-        return std::nullopt;
-    }
-
-    std::array<BYTE, 4096> buffer{};
-    DWORD read = 0;
-    bool failed = false;
-    while(true) {
-        if(!::ReadFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &read, nullptr)) {
-            DWORD error = ::GetLastError();
-            InstanceManager::Instance().Log(L"ComputeFileHash(ReadFile) failed for '%s' (err=%lu)",
-                                            path.c_str(), error);
-            failed = true;
-            break;
-        }
-        if(read == 0) {
-            break;
-        }
-        if(!::CryptHashData(hash, buffer.data(), read, 0)) {
-            failed = true;
-            DWORD error = ::GetLastError();
-            InstanceManager::Instance().Log(L"ComputeFileHash(CryptHashData) failed for '%s' (err=%lu)",
-                                            path.c_str(), error);
-            break;
-        }
-    }
-
-    std::wstring result;
-    if(!failed) {
-        DWORD hashSize = 0;
-        DWORD size = sizeof(hashSize);
-        if(::CryptGetHashParam(hash, HP_HASHSIZE, reinterpret_cast<BYTE*>(&hashSize), &size, 0) && hashSize > 0) {
-            std::vector<BYTE> digest(hashSize);
-            if(::CryptGetHashParam(hash, HP_HASHVAL, digest.data(), &hashSize, 0)) {
-                wchar_t chunk[3];
-                for(DWORD i = 0; i < hashSize; ++i) {
-                    swprintf_s(chunk, L"%02X", digest[i]);
-                    result.append(chunk);
-                }
-            } else {
-                DWORD error = ::GetLastError();
-                InstanceManager::Instance().Log(L"ComputeFileHash(CryptGetHashParam HASHVAL) failed for '%s' (err=%lu)",
-                                                path.c_str(), error);
-                failed = true;
-            }
-        } else {
-            DWORD error = ::GetLastError();
-            InstanceManager::Instance().Log(L"ComputeFileHash(CryptGetHashParam HASHSIZE) failed for '%s' (err=%lu)",
-                                            path.c_str(), error);
-            failed = true;
-        }
+        ::MessageBoxW(m_hWnd, content.c_str(), L"File Checksums", MB_OK | MB_ICONINFORMATION);
     }
-
-    ::CryptDestroyHash(hash);
-    ::CryptReleaseContext(provider, 0);
-    ::CloseHandle(file);
-
-    if(result.empty()) {
-        if(!failed) {
-            InstanceManager::Instance().Log(L"ComputeFileHash produced empty result for '%s'", path.c_str());
-        }
-        return std::nullopt;
-    }
-    return result;
 }
 
 std::vector<std::wstring> TabBarHost::GetSelectedPaths() const {
@@ -2730,8 +2847,10 @@ UINT TabBarHost::CurrentModifierMask() const {
 }
 
 void TabBarHost::ReloadConfiguration() {
-    qttabbar::ConfigData config = qttabbar::LoadConfigFromRegistry();
-    m_config = config;
+    m_config = qttabbar::GetConfigSnapshot()->value;
+    // Decoded from a copy: padding the shortcut list must not leave m_config
+    // different from what was loaded, or the next save would write it back.
+    qttabbar::ConfigData config = m_config;
     if(m_tabControl) {
         m_tabControl->ApplyConfiguration(m_config);
     }
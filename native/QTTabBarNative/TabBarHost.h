@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "Config.h"
+#include "SessionSaveScheduler.h"
 
 class SubDirTipWindow;
 
@@ -45,13 +46,14 @@ public:
     void ClearExplorer();
     void ExecuteCommand(UINT commandId);
     void ShowContextMenu(const POINT& screenPoint);
-    void SaveSessionState() const;
+    void SaveSessionState();
     void RestoreSessionState();
     void OnBandVisibilityChanged(bool visible);
     bool HandleAccelerator(MSG* pMsg);
     bool HandleMouseAction(qttabbar::MouseTarget target, qttabbar::MouseChord chord,
                            std::optional<std::size_t> tabIndex = std::nullopt);
     bool HasFocus() const noexcept { return m_hasFocus; }
+    qttabbar::SaveCoalescer::Counters GetSessionSaveCounters() const noexcept { return m_sessionSaves.GetCounters(); }
     void OnParentDestroyed();
 
     std::vector<std::wstring> GetOpenTabs() const;
@@ -110,6 +112,7 @@ private:
     static constexpr UINT kSelectTabTimerMs = 5000;
     static constexpr UINT kContextMenuTimerMs = 0x4B0; // 1200ms
     static constexpr UINT kSubDirTipTimerMs = 450;
+    static constexpr UINT kSessionSaveRetryMs = 50;
 
     static _ATL_FUNC_INFO kBeforeNavigate2Info;
     static _ATL_FUNC_INFO kNavigateComplete2Info;
@@ -145,6 +148,9 @@ private:
     void StopTimers();
     std::wstring VariantToString(const VARIANT* value) const;
     void UpdateActivePath(const std::wstring& path);
+    void ScheduleSessionSave();
+    void FlushSessionState(bool wait);
+    std::vector<uint8_t> CaptureSessionSnapshot() const;
     void AddTab(const std::wstring& path, bool makeActive, bool allowDuplicate);
     void ActivateTab(std::size_t index);
     void ActivateNextTab();
@@ -240,7 +246,6 @@ private:
     bool OpenSelectedInNewWindow();
     bool InvokeShellVerb(const wchar_t* verb);
     void ShowFileHashDialog(const std::vector<std::wstring>& paths) const;
-    std::optional<std::wstring> ComputeFileHash(const std::wstring& path) const;
     std::vector<std::wstring> GetSelectedPaths() const;
     std::vector<std::wstring> GetSelectedNames() const;
     std::optional<std::wstring> ResolveShortcutTarget(const std::wstring& path) const;
@@ -285,6 +290,8 @@ private:
     UINT_PTR m_subDirTipTimer = 0;
     std::optional<std::size_t> m_pendingSubDirTipIndex;
     POINT m_subDirTipAnchor{};
+    qttabbar::SaveCoalescer m_sessionSaves{qttabbar::SteadySaveClock::Instance()};
+    UINT_PTR m_sessionSaveTimer = 0;
     friend class NativeTabControl;
     friend class QTTabBarClass;
 };
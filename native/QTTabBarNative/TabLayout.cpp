@@ -0,0 +1,122 @@
+#include "TabLayout.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace qttabbar {
+
+bool TabFlowParams::operator==(const TabFlowParams& other) const noexcept {
+    return originX == other.originX && originY == other.originY && wrapLimit == other.wrapLimit &&
+           rowHeight == other.rowHeight && rowGap == other.rowGap && spacing == other.spacing &&
+           plusWidth == other.plusWidth && multiRow == other.multiRow;
+}
+
+TabFlowCursor FlowTabRows(const TabFlowParams& params, const std::vector<int>& widths, std::size_t firstChanged,
+                          std::vector<TabRect>& rects) {
+    rects.resize(widths.size());
+    firstChanged = std::min(firstChanged, widths.size());
+
+    TabFlowCursor cursor{params.originX, params.originY};
+    if(firstChanged > 0) {
+        const TabRect& previous = rects[firstChanged - 1];
+        cursor.x = previous.right + params.spacing;
+        cursor.y = previous.top;
+    }
+
+    for(std::size_t i = firstChanged; i < widths.size(); ++i) {
+        int width = widths[i];
+        if(params.multiRow && cursor.x + width + params.plusWidth > params.wrapLimit && cursor.x != params.originX) {
+            cursor.x = params.originX;
+            cursor.y += params.rowHeight + params.rowGap;
+        }
+        rects[i] = {cursor.x, cursor.y, cursor.x + width, cursor.y + params.rowHeight};
+        cursor.x += width + params.spacing;
+    }
+    return cursor;
+}
+
+void TabHitIndex::Update(const std::vector<TabRect>& rects, std::size_t firstChanged) {
+    firstChanged = std::min({firstChanged, rects.size(), m_rects.size()});
+    // Drop every row that reaches the first changed rect and rescan from its start.
+    while(!m_rows.empty() && m_rows.back().end > firstChanged) {
+        m_rows.pop_back();
+    }
+    std::size_t start = m_rows.empty() ? 0 : m_rows.back().end;
+    m_rects.assign(rects.begin(), rects.end());
+
+    for(std::size_t i = start; i < m_rects.size(); ++i) {
+        const TabRect& rect = m_rects[i];
+        if(m_rows.empty() || m_rows.back().end != i || rect.top != m_rows.back().top) {
+            m_rows.push_back({rect.top, rect.bottom, i, i + 1});
+        } else {
+            Row& row = m_rows.back();
+            row.bottom = std::max(row.bottom, rect.bottom);
+            row.end = i + 1;
+        }
+    }
+}
+
+void TabHitIndex::Clear() {
+    m_rects.clear();
+    m_rows.clear();
+}
+
+std::optional<std::size_t> TabHitIndex::HitTest(int x, int y) const {
+    auto row = std::upper_bound(m_rows.begin(), m_rows.end(), y, [](int value, const Row& candidate) {
+        return value < candidate.top;
+    });
+    if(row == m_rows.begin()) {
+        return std::nullopt;
+    }
+    --row;
+    if(y >= row->bottom) {
+        return std::nullopt;
+    }
+    auto first = m_rects.begin() + static_cast<std::ptrdiff_t>(row->first);
+    auto last = m_rects.begin() + static_cast<std::ptrdiff_t>(row->end);
+    auto tab = std::upper_bound(first, last, x, [](int value, const TabRect& candidate) {
+        return value < candidate.left;
+    });
+    if(tab == first) {
+        return std::nullopt;
+    }
+    --tab;
+    if(x >= tab->right || y < tab->top || y >= tab->bottom) {
+        return std::nullopt;
+    }
+    return static_cast<std::size_t>(tab - m_rects.begin());
+}
+
+TextMeasureCache::TextMeasureCache(std::size_t capacity)
+    : m_capacity(std::max<std::size_t>(capacity, 1)) {
+}
+
+int TextMeasureCache::Measure(std::uintptr_t font, unsigned dpi, const std::wstring& text, const MeasureFn& measure) {
+    Key key{font, dpi, text};
+    auto it = m_entries.find(key);
+    if(it != m_entries.end()) {
+        ++m_stats.hits;
+        return it->second;
+    }
+    ++m_stats.misses;
+    int width = measure(text);
+    if(m_entries.size() >= m_capacity) {
+        // Titles rarely churn; starting over is cheaper than tracking recency.
+        m_entries.clear();
+    }
+    m_entries.emplace(std::move(key), width);
+    return width;
+}
+
+void TextMeasureCache::Clear() {
+    m_entries.clear();
+}
+
+std::size_t TextMeasureCache::KeyHash::operator()(const Key& key) const noexcept {
+    std::size_t hash = std::hash<std::wstring>{}(key.text);
+    hash ^= std::hash<std::uintptr_t>{}(key.font) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<unsigned>{}(key.dpi) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+} // namespace qttabbar
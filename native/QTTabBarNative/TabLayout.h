@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace qttabbar {
+
+struct TabRect {
+    int left = 0;
+    int top = 0;
+    int right = 0;
+    int bottom = 0;
+};
+
+// Inputs of the tab strip flow, all in client pixels. A tab wraps to a new row
+// when multiRow is set and it would cross wrapLimit (leaving room for the plus
+// button) unless it is already the first tab of its row.
+struct TabFlowParams {
+    int originX = 0;
+    int originY = 0;
+    int wrapLimit = 0;
+    int rowHeight = 0;
+    int rowGap = 4;
+    int spacing = 0;
+    int plusWidth = 0;
+    bool multiRow = false;
+
+    bool operator==(const TabFlowParams& other) const noexcept;
+    bool operator!=(const TabFlowParams& other) const noexcept { return !(*this == other); }
+};
+
+struct TabFlowCursor {
+    int x = 0;
+    int y = 0;
+};
+
+// Lays out widths[firstChanged..] into rects, continuing from rects[firstChanged - 1].
+// Rects before firstChanged must come from an earlier call with the same params.
+// Returns where the next item (the plus button) would start.
+TabFlowCursor FlowTabRows(const TabFlowParams& params, const std::vector<int>& widths, std::size_t firstChanged,
+                          std::vector<TabRect>& rects);
+
+// Row/column index over flowed tab rects. Rows are found by binary search on
+// their y-range and tabs by binary search on x within the row, which relies on
+// FlowTabRows emitting rows top to bottom and tabs left to right.
+class TabHitIndex {
+public:
+    // Rebuilds the rows holding rects[firstChanged..]; earlier rows are kept.
+    void Update(const std::vector<TabRect>& rects, std::size_t firstChanged = 0);
+    void Clear();
+    // Same containment rule as PtInRect: left/top inclusive, right/bottom exclusive.
+    std::optional<std::size_t> HitTest(int x, int y) const;
+    std::size_t GetRowCount() const noexcept { return m_rows.size(); }
+
+private:
+    struct Row {
+        int top = 0;
+        int bottom = 0;
+        std::size_t first = 0;
+        std::size_t end = 0;
+    };
+
+    std::vector<TabRect> m_rects;
+    std::vector<Row> m_rows;
+};
+
+// Memoizes text extents keyed by (font, DPI, string). The owner clears it when
+// a font handle is destroyed, since GDI may hand the same value out again.
+class TextMeasureCache {
+public:
+    using MeasureFn = std::function<int(const std::wstring&)>;
+
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+    };
+
+    explicit TextMeasureCache(std::size_t capacity = 4096);
+
+    int Measure(std::uintptr_t font, unsigned dpi, const std::wstring& text, const MeasureFn& measure);
+    void Clear();
+    Stats GetStats() const noexcept { return m_stats; }
+
+private:
+    struct Key {
+        std::uintptr_t font = 0;
+        unsigned dpi = 0;
+        std::wstring text;
+
+        bool operator==(const Key& other) const noexcept {
+            return font == other.font && dpi == other.dpi && text == other.text;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const noexcept;
+    };
+
+    std::size_t m_capacity;
+    std::unordered_map<Key, int, KeyHash> m_entries;
+    Stats m_stats{};
+};
+
+} // namespace qttabbar
@@ -0,0 +1,350 @@
+#include "TabListDelta.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+using qttabbar::TabList;
+using qttabbar::TabListOp;
+using qttabbar::TabListOpKind;
+
+constexpr std::size_t kNone = static_cast<std::size_t>(-1);
+
+std::size_t TabCount(const TabList& list) {
+    return std::min(list.tabNames.size(), list.tabPaths.size());
+}
+
+bool SameTab(const TabList& left, std::size_t leftIndex, const TabList& right, std::size_t rightIndex) {
+    return left.tabPaths[leftIndex] == right.tabPaths[rightIndex]
+        && left.tabNames[leftIndex] == right.tabNames[rightIndex];
+}
+
+bool IsStructural(TabListOpKind kind) {
+    return kind == TabListOpKind::Insert || kind == TabListOpKind::Remove || kind == TabListOpKind::Move;
+}
+
+TabListOp MakeOp(TabListOpKind kind, std::size_t index, std::size_t target = 0) {
+    TabListOp op;
+    op.kind = kind;
+    op.index = static_cast<std::uint32_t>(index);
+    op.target = static_cast<std::uint32_t>(target);
+    return op;
+}
+
+// Marks the longest increasing run of `values`; those stay put while the
+// rest are moved around them.
+std::vector<bool> LongestIncreasing(const std::vector<std::size_t>& values) {
+    std::vector<std::size_t> tails;          // Index of the smallest tail per run length
+    std::vector<std::size_t> previous(values.size(), kNone);
+    for(std::size_t i = 0; i < values.size(); ++i) {
+        auto position = std::lower_bound(tails.begin(), tails.end(), values[i],
+            [&values](std::size_t index, std::size_t value) { return values[index] < value; });
+        if(position != tails.begin()) {
+            previous[i] = *(position - 1);
+        }
+        if(position == tails.end()) {
+            tails.push_back(i);
+        } else {
+            *position = i;
+        }
+    }
+    std::vector<bool> kept(values.size(), false);
+    for(std::size_t i = tails.empty() ? kNone : tails.back(); i != kNone; i = previous[i]) {
+        kept[i] = true;
+    }
+    return kept;
+}
+
+// Whether every op fits the list sizes it meets.
+bool Fits(const TabList& list, const std::vector<TabListOp>& ops) {
+    if(list.tabNames.size() != list.tabPaths.size()) {
+        return false;
+    }
+    std::size_t count = list.tabNames.size();
+    for(const TabListOp& op : ops) {
+        switch(op.kind) {
+        case TabListOpKind::Insert:
+            if(op.index > count) {
+                return false;
+            }
+            ++count;
+            break;
+        case TabListOpKind::Remove:
+            if(op.index >= count) {
+                return false;
+            }
+            --count;
+            break;
+        case TabListOpKind::Move:
+            if(op.index >= count || op.target >= count) {
+                return false;
+            }
+            break;
+        case TabListOpKind::Rename:
+        case TabListOpKind::Navigate:
+            if(op.index >= count) {
+                return false;
+            }
+            break;
+        case TabListOpKind::SetCurrentPath:
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+void MoveElement(std::vector<T>& items, std::size_t from, std::size_t to) {
+    if(from < to) {
+        std::rotate(items.begin() + from, items.begin() + from + 1, items.begin() + to + 1);
+    } else if(to < from) {
+        std::rotate(items.begin() + to, items.begin() + from, items.begin() + from + 1);
+    }
+}
+
+// Appends `op`, dropping what it makes redundant. Only ops since the last
+// insert, remove or move are looked at, as those are the ones whose indices
+// still name the same tabs.
+void Fold(std::vector<TabListOp>& ops, TabListOp op) {
+    if(op.kind == TabListOpKind::SetCurrentPath) {
+        ops.erase(std::remove_if(ops.begin(), ops.end(),
+            [](const TabListOp& existing) { return existing.kind == TabListOpKind::SetCurrentPath; }), ops.end());
+        ops.push_back(std::move(op));
+        return;
+    }
+    if(IsStructural(op.kind) && op.kind != TabListOpKind::Remove) {
+        ops.push_back(std::move(op));
+        return;
+    }
+
+    std::size_t start = ops.size();
+    while(start > 0 && !IsStructural(ops[start - 1].kind)) {
+        --start;
+    }
+    bool removing = op.kind == TabListOpKind::Remove;
+    bool laterTabChanged = false;
+    for(std::size_t i = ops.size(); i-- > start;) {
+        const TabListOp& existing = ops[i];
+        if(existing.kind == TabListOpKind::SetCurrentPath) {
+            continue;
+        }
+        if(existing.index == op.index && (removing || existing.kind == op.kind)) {
+            ops.erase(ops.begin() + i);
+        } else if(existing.index > op.index) {
+            laterTabChanged = true;
+        }
+    }
+
+    // A tab added in this batch takes its changes along, or is not added at all.
+    if(start > 0 && ops[start - 1].kind == TabListOpKind::Insert && ops[start - 1].index == op.index) {
+        TabListOp& insert = ops[start - 1];
+        switch(op.kind) {
+        case TabListOpKind::Rename:
+            insert.name = std::move(op.name);
+            return;
+        case TabListOpKind::Navigate:
+            insert.path = std::move(op.path);
+            return;
+        default:
+            if(!laterTabChanged) {
+                ops.erase(ops.begin() + (start - 1));
+                return;
+            }
+            break;
+        }
+    }
+    ops.push_back(std::move(op));
+}
+
+} // namespace
+
+namespace qttabbar {
+
+TabListDelta DiffTabLists(const TabList& from, const TabList& to) {
+    TabListDelta delta;
+    delta.baseVersion = from.version;
+    delta.version = from.version + 1;
+    auto& ops = delta.ops;
+
+    if(from.currentPath != to.currentPath) {
+        TabListOp op = MakeOp(TabListOpKind::SetCurrentPath, 0);
+        op.path = to.currentPath;
+        ops.push_back(std::move(op));
+    }
+
+    // Unchanged tabs at either end are left out.
+    std::size_t fromCount = TabCount(from);
+    std::size_t toCount = TabCount(to);
+    std::size_t prefix = 0;
+    while(prefix < fromCount && prefix < toCount && SameTab(from, prefix, to, prefix)) {
+        ++prefix;
+    }
+    std::size_t suffix = 0;
+    while(suffix < fromCount - prefix && suffix < toCount - prefix
+          && SameTab(from, fromCount - 1 - suffix, to, toCount - 1 - suffix)) {
+        ++suffix;
+    }
+    std::size_t oldCount = fromCount - prefix - suffix;
+    std::size_t newCount = toCount - prefix - suffix;
+    if(oldCount == 0 && newCount == 0) {
+        return delta;
+    }
+
+    // Pair the tabs in between by path, first come first served. Leftovers
+    // pair up in order as tabs that navigated; the rest are removed or added.
+    std::vector<std::size_t> targetOf(oldCount, kNone);
+    std::vector<std::size_t> sourceOf(newCount, kNone);
+    if(oldCount > 0 && newCount > 0) {
+        std::unordered_map<std::wstring_view, std::vector<std::size_t>> byPath;
+        for(std::size_t i = oldCount; i-- > 0;) {
+            byPath[from.tabPaths[prefix + i]].push_back(i);
+        }
+        for(std::size_t j = 0; j < newCount; ++j) {
+            auto found = byPath.find(to.tabPaths[prefix + j]);
+            if(found != byPath.end() && !found->second.empty()) {
+                sourceOf[j] = found->second.back();
+                targetOf[sourceOf[j]] = j;
+                found->second.pop_back();
+            }
+        }
+        std::size_t i = 0;
+        std::size_t j = 0;
+        while(true) {
+            while(i < oldCount && targetOf[i] != kNone) {
+                ++i;
+            }
+            while(j < newCount && sourceOf[j] != kNone) {
+                ++j;
+            }
+            if(i == oldCount || j == newCount) {
+                break;
+            }
+            targetOf[i] = j;
+            sourceOf[j] = i;
+        }
+    }
+
+    for(std::size_t i = oldCount; i-- > 0;) {
+        if(targetOf[i] == kNone) {
+            ops.push_back(MakeOp(TabListOpKind::Remove, prefix + i));
+        }
+    }
+
+    // What is left, by where each tab has to end up.
+    std::vector<std::size_t> order;
+    order.reserve(oldCount);
+    for(std::size_t i = 0; i < oldCount; ++i) {
+        if(targetOf[i] != kNone) {
+            order.push_back(targetOf[i]);
+        }
+    }
+    std::vector<bool> kept = LongestIncreasing(order);
+    std::vector<bool> placed(newCount, false);
+    std::vector<std::size_t> moving;
+    for(std::size_t k = 0; k < order.size(); ++k) {
+        if(kept[k]) {
+            placed[order[k]] = true;
+        } else {
+            moving.push_back(order[k]);
+        }
+    }
+    std::sort(moving.begin(), moving.end());
+    for(std::size_t target : moving) {
+        auto current = std::find(order.begin(), order.end(), target);
+        std::size_t fromIndex = static_cast<std::size_t>(current - order.begin());
+        order.erase(current);
+        // Right after the closest placed tab that precedes it.
+        std::size_t toIndex = 0;
+        for(std::size_t k = 0; k < order.size(); ++k) {
+            if(placed[order[k]] && order[k] < target) {
+                toIndex = k + 1;
+            }
+        }
+        order.insert(order.begin() + toIndex, target);
+        placed[target] = true;
+        if(fromIndex != toIndex) {
+            ops.push_back(MakeOp(TabListOpKind::Move, prefix + fromIndex, prefix + toIndex));
+        }
+    }
+
+    for(std::size_t j = 0; j < newCount; ++j) {
+        if(sourceOf[j] == kNone) {
+            TabListOp op = MakeOp(TabListOpKind::Insert, prefix + j);
+            op.name = to.tabNames[prefix + j];
+            op.path = to.tabPaths[prefix + j];
+            ops.push_back(std::move(op));
+        }
+    }
+
+    for(std::size_t j = 0; j < newCount; ++j) {
+        std::size_t i = sourceOf[j];
+        if(i == kNone) {
+            continue;
+        }
+        if(from.tabPaths[prefix + i] != to.tabPaths[prefix + j]) {
+            TabListOp op = MakeOp(TabListOpKind::Navigate, prefix + j);
+            op.path = to.tabPaths[prefix + j];
+            ops.push_back(std::move(op));
+        }
+        if(from.tabNames[prefix + i] != to.tabNames[prefix + j]) {
+            TabListOp op = MakeOp(TabListOpKind::Rename, prefix + j);
+            op.name = to.tabNames[prefix + j];
+            ops.push_back(std::move(op));
+        }
+    }
+    return delta;
+}
+
+bool ApplyTabListDelta(TabList& list, const TabListDelta& delta) {
+    if(list.version != delta.baseVersion || !Fits(list, delta.ops)) {
+        return false;
+    }
+    for(const TabListOp& op : delta.ops) {
+        switch(op.kind) {
+        case TabListOpKind::Insert:
+            list.tabNames.insert(list.tabNames.begin() + op.index, op.name);
+            list.tabPaths.insert(list.tabPaths.begin() + op.index, op.path);
+            break;
+        case TabListOpKind::Remove:
+            list.tabNames.erase(list.tabNames.begin() + op.index);
+            list.tabPaths.erase(list.tabPaths.begin() + op.index);
+            break;
+        case TabListOpKind::Move:
+            MoveElement(list.tabNames, op.index, op.target);
+            MoveElement(list.tabPaths, op.index, op.target);
+            break;
+        case TabListOpKind::Rename:
+            list.tabNames[op.index] = op.name;
+            break;
+        case TabListOpKind::Navigate:
+            list.tabPaths[op.index] = op.path;
+            break;
+        case TabListOpKind::SetCurrentPath:
+            list.currentPath = op.path;
+            break;
+        }
+    }
+    list.version = delta.version;
+    return true;
+}
+
+bool AppendTabListDelta(TabListDelta& into, TabListDelta&& next) {
+    if(into.version != next.baseVersion) {
+        return false;
+    }
+    into.ops.reserve(into.ops.size() + next.ops.size());
+    for(TabListOp& op : next.ops) {
+        Fold(into.ops, std::move(op));
+    }
+    into.version = next.version;
+    next.ops.clear();
+    return true;
+}
+
+} // namespace qttabbar
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace qttabbar {
+
+// The tabs of one Explorer window as the tray shows them. `version` counts the
+// deltas applied since the list was empty.
+struct TabList {
+    std::uint64_t version = 0;
+    std::wstring currentPath;
+    std::vector<std::wstring> tabNames;
+    std::vector<std::wstring> tabPaths;
+};
+
+enum class TabListOpKind : std::uint8_t {
+    Insert,          // name and path of a new tab, before `index`
+    Remove,          // the tab at `index`
+    Move,            // the tab at `index` to `target`, counted after taking it out
+    Rename,          // name = new name of the tab at `index`
+    Navigate,        // path = new path of the tab at `index`
+    SetCurrentPath,  // path = new current path
+};
+
+struct TabListOp {
+    TabListOpKind kind = TabListOpKind::Insert;
+    std::uint32_t index = 0;
+    std::uint32_t target = 0;
+    std::wstring name;
+    std::wstring path;
+};
+
+// Turns the list at `baseVersion` into the list at `version`. Ops apply in
+// order, each to the result of the one before.
+struct TabListDelta {
+    std::uint64_t baseVersion = 0;
+    std::uint64_t version = 0;
+    std::vector<TabListOp> ops;
+};
+
+// The ops that turn `from` into `to`, versioned from.version -> from.version + 1.
+// Only tabs that were added, renamed or navigated carry strings; tabs are
+// matched by path, so reordering becomes moves.
+TabListDelta DiffTabLists(const TabList& from, const TabList& to);
+
+// Applies `delta` when `list` is at its base version. Returns false, leaving
+// `list` untouched, when it is not or an op does not fit; the caller then has
+// to fetch the whole list again.
+bool ApplyTabListDelta(TabList& list, const TabListDelta& delta);
+
+// Folds `next` into `into` so that applying the result equals applying both.
+// Renames and navigations superseded by `next` are dropped. Returns false,
+// leaving both untouched, unless `next` starts where `into` ends.
+bool AppendTabListDelta(TabListDelta& into, TabListDelta&& next);
+
+} // namespace qttabbar
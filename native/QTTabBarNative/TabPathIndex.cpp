@@ -0,0 +1,158 @@
+#include "TabPathIndex.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <iterator>
+
+namespace qttabbar {
+
+std::wstring TabPathIndex::Fold(const std::wstring& path) {
+    std::wstring folded;
+    folded.resize(path.size());
+    std::transform(path.begin(), path.end(), folded.begin(),
+                   [](wchar_t ch) { return static_cast<wchar_t>(std::towlower(static_cast<std::wint_t>(ch))); });
+    return folded;
+}
+
+void TabPathIndex::Append(const std::wstring& path) {
+    m_keys.push_back(Fold(path));
+    if(!m_stale) {
+        m_positions[m_keys.back()].push_back(m_keys.size() - 1);
+    }
+}
+
+void TabPathIndex::Insert(std::size_t position, const std::wstring& path) {
+    if(position >= m_keys.size()) {
+        Append(path);
+        return;
+    }
+    m_keys.insert(m_keys.begin() + static_cast<std::ptrdiff_t>(position), Fold(path));
+    if(CanShift()) {
+        ShiftPositions(position, true);
+        AddPosition(position);
+    }
+}
+
+void TabPathIndex::Erase(std::size_t position) {
+    if(position >= m_keys.size()) {
+        return;
+    }
+    if(position + 1 == m_keys.size() && !m_stale) {
+        // Dropping the last tab leaves every other position intact.
+        auto it = m_positions.find(m_keys.back());
+        if(it != m_positions.end()) {
+            it->second.pop_back();
+            if(it->second.empty()) {
+                m_positions.erase(it);
+            }
+        }
+    } else if(CanShift()) {
+        RemovePosition(position);
+        ShiftPositions(position, false);
+    }
+    m_keys.erase(m_keys.begin() + static_cast<std::ptrdiff_t>(position));
+}
+
+void TabPathIndex::Move(std::size_t from, std::size_t to) {
+    if(from >= m_keys.size() || to >= m_keys.size() || from == to) {
+        return;
+    }
+    bool shift = CanShift();
+    if(shift) {
+        RemovePosition(from);
+        ShiftPositions(from, false);
+    }
+    std::wstring key = std::move(m_keys[from]);
+    m_keys.erase(m_keys.begin() + static_cast<std::ptrdiff_t>(from));
+    m_keys.insert(m_keys.begin() + static_cast<std::ptrdiff_t>(to), std::move(key));
+    if(shift) {
+        ShiftPositions(to, true);
+        AddPosition(to);
+    }
+}
+
+void TabPathIndex::Clear() {
+    m_keys.clear();
+    m_positions.clear();
+    m_stale = false;
+    m_shifts = 0;
+}
+
+std::optional<std::size_t> TabPathIndex::Find(const std::wstring& path) const {
+    if(m_stale) {
+        Rebuild();
+    }
+    m_shifts = 0;
+    auto it = m_positions.find(Fold(path));
+    if(it == m_positions.end() || it->second.empty()) {
+        return std::nullopt;
+    }
+    return it->second.front();
+}
+
+std::size_t TabPathIndex::Count(const std::wstring& path) const {
+    if(m_stale) {
+        Rebuild();
+    }
+    m_shifts = 0;
+    auto it = m_positions.find(Fold(path));
+    return it == m_positions.end() ? 0 : it->second.size();
+}
+
+bool TabPathIndex::CanShift() {
+    if(!m_stale && m_shifts < kMaxShiftsBetweenLookups) {
+        ++m_shifts;
+        return true;
+    }
+    m_stale = true;
+    return false;
+}
+
+// Moves every stored position at or after `from` one place up or down.
+void TabPathIndex::ShiftPositions(std::size_t from, bool up) {
+    for(auto& entry : m_positions) {
+        for(std::size_t& position : entry.second) {
+            if(position >= from) {
+                position = up ? position + 1 : position - 1;
+            }
+        }
+    }
+}
+
+// m_keys[position] must still hold the key being removed or added. Each
+// key's positions stay sorted, so Find can return the front one.
+void TabPathIndex::RemovePosition(std::size_t position) {
+    auto it = m_positions.find(m_keys[position]);
+    if(it == m_positions.end()) {
+        return;
+    }
+    auto& positions = it->second;
+    positions.erase(std::lower_bound(positions.begin(), positions.end(), position));
+    if(positions.empty()) {
+        m_positions.erase(it);
+    }
+}
+
+void TabPathIndex::AddPosition(std::size_t position) {
+    auto& positions = m_positions[m_keys[position]];
+    positions.insert(std::lower_bound(positions.begin(), positions.end(), position), position);
+}
+
+void TabPathIndex::Rebuild() const {
+    // Keeps the nodes of paths that are still open, so a rebuild after a close
+    // only hashes the keys instead of reallocating the whole map.
+    for(auto& entry : m_positions) {
+        entry.second.clear();
+    }
+    m_positions.reserve(m_keys.size());
+    for(std::size_t i = 0; i < m_keys.size(); ++i) {
+        m_positions[m_keys[i]].push_back(i);
+    }
+    for(auto it = m_positions.begin(); it != m_positions.end();) {
+        it = it->second.empty() ? m_positions.erase(it) : std::next(it);
+    }
+    m_stale = false;
+    m_shifts = 0;
+}
+
+} // namespace qttabbar
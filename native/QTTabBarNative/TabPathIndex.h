@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace qttabbar {
+
+// Case-folded path -> tab position index kept in step with NativeTabControl's
+// tab vector. Appends are O(1) and keep the index live. The first few inserts,
+// erases and moves between lookups shift the stored positions in place; past
+// that they only update the parallel key list and defer a rebuild to the next
+// lookup, so batch closes stay linear.
+class TabPathIndex {
+public:
+    static std::wstring Fold(const std::wstring& path);
+
+    void Append(const std::wstring& path);
+    void Insert(std::size_t position, const std::wstring& path);
+    void Erase(std::size_t position);
+    void Move(std::size_t from, std::size_t to);
+    void Clear();
+
+    // Position of the first tab showing `path`, compared case-insensitively.
+    std::optional<std::size_t> Find(const std::wstring& path) const;
+    bool Contains(const std::wstring& path) const { return Find(path).has_value(); }
+    std::size_t Count(const std::wstring& path) const;
+    std::size_t Size() const noexcept { return m_keys.size(); }
+
+private:
+    // Shifting walks every stored position without hashing; a rebuild hashes
+    // every key, so a few shifts are cheaper than one rebuild.
+    static constexpr std::size_t kMaxShiftsBetweenLookups = 8;
+
+    bool CanShift();
+    void ShiftPositions(std::size_t from, bool up);
+    void RemovePosition(std::size_t position);
+    void AddPosition(std::size_t position);
+    void Rebuild() const;
+
+    std::vector<std::wstring> m_keys;
+    mutable std::unordered_map<std::wstring, std::vector<std::size_t>> m_positions;
+    mutable bool m_stale = false;
+    mutable std::size_t m_shifts = 0;
+};
+
+} // namespace qttabbar
@@ -0,0 +1,573 @@
+#include "TextPreview.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <iconv.h>
+#include <unistd.h>
+
+#include <filesystem>
+#endif
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define QTTABBAR_TEXTPREVIEW_SSE2 1
+#endif
+
+namespace {
+
+using qttabbar::TextEncoding;
+
+// Length of the leading run of 7-bit bytes, 16 (or 8) bytes per step.
+std::size_t AsciiPrefix(const std::uint8_t* data, std::size_t size) {
+    std::size_t i = 0;
+#if defined(QTTABBAR_TEXTPREVIEW_SSE2)
+    for(; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(chunk);
+        if(mask != 0) {
+            for(int bit = 0; (mask & (1 << bit)) == 0; ++bit) {
+                ++i;
+            }
+            return i;
+        }
+    }
+#endif
+    for(; i + 8 <= size; i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if((word & 0x8080808080808080ULL) != 0) {
+            break;
+        }
+    }
+    while(i < size && data[i] < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+// Length of the UTF-8 sequence starting with `lead`, 0 for a byte that cannot start one.
+std::size_t Utf8SequenceLength(std::uint8_t lead) {
+    if(lead < 0x80) {
+        return 1;
+    }
+    if(lead >= 0xC2 && lead <= 0xDF) {
+        return 2;
+    }
+    if(lead >= 0xE0 && lead <= 0xEF) {
+        return 3;
+    }
+    if(lead >= 0xF0 && lead <= 0xF4) {
+        return 4;
+    }
+    return 0;
+}
+
+// Decodes one sequence at data[0..available). Returns the number of bytes it
+// spans (0 when it is cut off by the end of the buffer) and the code point, or
+// U+FFFD with length 1 for malformed input.
+std::size_t DecodeUtf8(const std::uint8_t* data, std::size_t available, char32_t& codePoint) {
+    std::uint8_t lead = data[0];
+    std::size_t length = Utf8SequenceLength(lead);
+    if(length == 1) {
+        codePoint = lead;
+        return 1;
+    }
+    if(length == 0) {
+        codePoint = 0xFFFD;
+        return 1;
+    }
+    if(available < length) {
+        // Check what is there so a malformed tail is not mistaken for a truncated one.
+        for(std::size_t k = 1; k < available; ++k) {
+            if((data[k] & 0xC0) != 0x80) {
+                codePoint = 0xFFFD;
+                return 1;
+            }
+        }
+        return 0;
+    }
+    char32_t value = lead & (0x7F >> length);
+    for(std::size_t k = 1; k < length; ++k) {
+        if((data[k] & 0xC0) != 0x80) {
+            codePoint = 0xFFFD;
+            return 1;
+        }
+        value = (value << 6) | (data[k] & 0x3F);
+    }
+    static constexpr char32_t kMinimum[] = {0, 0, 0x80, 0x800, 0x10000};
+    if(value < kMinimum[length] || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF)) {
+        codePoint = 0xFFFD;
+        return 1;
+    }
+    codePoint = value;
+    return length;
+}
+
+bool IsValidUtf8(const std::uint8_t* data, std::size_t size) {
+    std::size_t i = 0;
+    while(i < size) {
+        i += AsciiPrefix(data + i, size - i);
+        if(i >= size) {
+            break;
+        }
+        char32_t codePoint = 0;
+        std::size_t length = DecodeUtf8(data + i, size - i, codePoint);
+        if(length == 0) {
+            break; // cut off by the read limit
+        }
+        if(codePoint == 0xFFFD && length == 1) {
+            return false;
+        }
+        i += length;
+    }
+    return true;
+}
+
+struct DbcsScore {
+    std::size_t errors = 0;
+    std::size_t pairs = 0;
+    // Double-byte characters typical of the encoding and unusual in the other.
+    std::size_t signal = 0;
+};
+
+DbcsScore ScoreGbk(const std::uint8_t* data, std::size_t size) {
+    DbcsScore score;
+    std::size_t i = 0;
+    while(i < size) {
+        i += AsciiPrefix(data + i, size - i);
+        if(i >= size) {
+            break;
+        }
+        std::uint8_t lead = data[i];
+        if(lead < 0x81 || lead > 0xFE) {
+            ++score.errors;
+            ++i;
+            continue;
+        }
+        if(i + 1 >= size) {
+            break;
+        }
+        std::uint8_t trail = data[i + 1];
+        if(trail < 0x40 || trail > 0xFE || trail == 0x7F) {
+            ++score.errors;
+            ++i;
+            continue;
+        }
+        ++score.pairs;
+        // GB2312 hanzi rows, which Shift-JIS reads as half-width kana plus noise.
+        if(lead >= 0xB0 && lead <= 0xF7 && trail >= 0xA1) {
+            ++score.signal;
+        }
+        i += 2;
+    }
+    return score;
+}
+
+DbcsScore ScoreShiftJis(const std::uint8_t* data, std::size_t size) {
+    DbcsScore score;
+    std::size_t i = 0;
+    while(i < size) {
+        i += AsciiPrefix(data + i, size - i);
+        if(i >= size) {
+            break;
+        }
+        std::uint8_t lead = data[i];
+        if(lead >= 0xA1 && lead <= 0xDF) {
+            ++i; // half-width katakana
+            continue;
+        }
+        if(!((lead >= 0x81 && lead <= 0x9F) || (lead >= 0xE0 && lead <= 0xFC))) {
+            ++score.errors;
+            ++i;
+            continue;
+        }
+        if(i + 1 >= size) {
+            break;
+        }
+        std::uint8_t trail = data[i + 1];
+        if(trail < 0x40 || trail > 0xFC || trail == 0x7F) {
+            ++score.errors;
+            ++i;
+            continue;
+        }
+        ++score.pairs;
+        // Kana and level-1 kanji leads; GBK only uses them for rare extension hanzi.
+        if(lead <= 0x9F) {
+            ++score.signal;
+        }
+        i += 2;
+    }
+    return score;
+}
+
+// Largest prefix of data[0..size) that does not end inside a character.
+std::size_t CompletePrefix(const std::uint8_t* data, std::size_t size, TextEncoding encoding) {
+    switch(encoding) {
+    case TextEncoding::Utf8:
+    case TextEncoding::Utf8Bom: {
+        std::size_t start = size;
+        for(std::size_t back = 0; back < 4 && start > 0; ++back) {
+            --start;
+            if((data[start] & 0xC0) != 0x80) {
+                std::size_t length = Utf8SequenceLength(data[start]);
+                return (length != 0 && start + length > size) ? start : size;
+            }
+        }
+        return size;
+    }
+    case TextEncoding::Utf16Le:
+    case TextEncoding::Utf16Be: {
+        std::size_t even = size & ~static_cast<std::size_t>(1);
+        if(even >= 2) {
+            std::uint8_t high = encoding == TextEncoding::Utf16Le ? data[even - 1] : data[even - 2];
+            if(high >= 0xD8 && high <= 0xDB) {
+                even -= 2; // lone high surrogate
+            }
+        }
+        return even;
+    }
+    case TextEncoding::Gbk:
+    case TextEncoding::ShiftJis: {
+        std::size_t i = 0;
+        while(i < size) {
+            std::uint8_t lead = data[i];
+            bool doubleByte = encoding == TextEncoding::Gbk
+                                  ? lead >= 0x81 && lead <= 0xFE
+                                  : (lead >= 0x81 && lead <= 0x9F) || (lead >= 0xE0 && lead <= 0xFC);
+            if(doubleByte && i + 1 >= size) {
+                return i;
+            }
+            i += doubleByte ? 2 : 1;
+        }
+        return size;
+    }
+    default:
+        return size;
+    }
+}
+
+void AppendCodePoint(std::wstring& output, char32_t codePoint) {
+    if constexpr(sizeof(wchar_t) == 2) {
+        if(codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            output.push_back(static_cast<wchar_t>(0xD800 + (codePoint >> 10)));
+            output.push_back(static_cast<wchar_t>(0xDC00 + (codePoint & 0x3FF)));
+            return;
+        }
+    }
+    output.push_back(static_cast<wchar_t>(codePoint));
+}
+
+std::wstring DecodeUtf8Text(const std::uint8_t* data, std::size_t size) {
+    std::wstring output;
+    output.reserve(size);
+    std::size_t i = 0;
+    while(i < size) {
+        std::size_t ascii = AsciiPrefix(data + i, size - i);
+        output.append(data + i, data + i + ascii);
+        i += ascii;
+        if(i >= size) {
+            break;
+        }
+        char32_t codePoint = 0;
+        std::size_t length = DecodeUtf8(data + i, size - i, codePoint);
+        if(length == 0) {
+            break;
+        }
+        AppendCodePoint(output, codePoint);
+        i += length;
+    }
+    return output;
+}
+
+std::wstring DecodeUtf16Text(const std::uint8_t* data, std::size_t size, bool bigEndian) {
+    std::wstring output;
+    output.reserve(size / 2);
+    for(std::size_t i = 0; i + 1 < size; i += 2) {
+        char16_t unit = bigEndian ? static_cast<char16_t>((data[i] << 8) | data[i + 1])
+                                  : static_cast<char16_t>(data[i] | (data[i + 1] << 8));
+        if constexpr(sizeof(wchar_t) == 2) {
+            output.push_back(static_cast<wchar_t>(unit));
+        } else {
+            if(unit >= 0xD800 && unit <= 0xDBFF && i + 3 < size) {
+                char16_t low = bigEndian ? static_cast<char16_t>((data[i + 2] << 8) | data[i + 3])
+                                         : static_cast<char16_t>(data[i + 2] | (data[i + 3] << 8));
+                if(low >= 0xDC00 && low <= 0xDFFF) {
+                    AppendCodePoint(output, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                    i += 2;
+                    continue;
+                }
+            }
+            output.push_back(static_cast<wchar_t>(unit >= 0xD800 && unit <= 0xDFFF ? 0xFFFD : unit));
+        }
+    }
+    return output;
+}
+
+std::wstring DecodeCodePageText(const std::uint8_t* data, std::size_t size, TextEncoding encoding) {
+#if defined(_WIN32)
+    UINT codePage = encoding == TextEncoding::Gbk ? 936 : encoding == TextEncoding::ShiftJis ? 932 : CP_ACP;
+    const char* source = reinterpret_cast<const char*>(data);
+    int length = ::MultiByteToWideChar(codePage, 0, source, static_cast<int>(size), nullptr, 0);
+    if(length <= 0) {
+        return {};
+    }
+    std::wstring output(static_cast<std::size_t>(length), L'\0');
+    ::MultiByteToWideChar(codePage, 0, source, static_cast<int>(size), output.data(), length);
+    return output;
+#else
+    if(encoding == TextEncoding::Ansi) {
+        return std::wstring(data, data + size); // Latin-1
+    }
+    iconv_t converter = ::iconv_open("WCHAR_T", encoding == TextEncoding::Gbk ? "GBK" : "SHIFT_JIS");
+    if(converter == reinterpret_cast<iconv_t>(-1)) {
+        return {};
+    }
+    // Neither encoding produces more than one character per byte.
+    std::wstring output(size, L'\0');
+    char* in = reinterpret_cast<char*>(const_cast<std::uint8_t*>(data));
+    std::size_t inLeft = size;
+    char* out = reinterpret_cast<char*>(output.data());
+    std::size_t outLeft = output.size() * sizeof(wchar_t);
+    while(inLeft > 0) {
+        if(::iconv(converter, &in, &inLeft, &out, &outLeft) != static_cast<std::size_t>(-1)) {
+            break;
+        }
+        if(errno != EILSEQ || outLeft < sizeof(wchar_t)) {
+            break;
+        }
+        wchar_t replacement = 0xFFFD;
+        std::memcpy(out, &replacement, sizeof(replacement));
+        out += sizeof(replacement);
+        outLeft -= sizeof(replacement);
+        ++in;
+        --inLeft;
+    }
+    ::iconv_close(converter);
+    output.resize(output.size() - outLeft / sizeof(wchar_t));
+    return output;
+#endif
+}
+
+// Byte offset just past the maxLines-th line feed, or `size` if there are fewer.
+std::size_t FindLinesEnd(const std::uint8_t* data, std::size_t size, std::size_t maxLines, TextEncoding encoding,
+                         bool& moreLines) {
+    moreLines = false;
+    if(encoding == TextEncoding::Utf16Le || encoding == TextEncoding::Utf16Be) {
+        std::size_t lines = 0;
+        std::size_t lowOffset = encoding == TextEncoding::Utf16Le ? 0 : 1;
+        for(std::size_t i = 0; i + 1 < size; i += 2) {
+            if(data[i + lowOffset] == '\n' && data[i + (1 - lowOffset)] == 0 && ++lines == maxLines) {
+                moreLines = i + 2 < size;
+                return i + 2;
+            }
+        }
+        return size;
+    }
+    // 0x0A is never a trail byte in UTF-8, GBK or Shift-JIS.
+    const std::uint8_t* cursor = data;
+    const std::uint8_t* end = data + size;
+    for(std::size_t lines = 0; lines < maxLines; ++lines) {
+        const void* found = std::memchr(cursor, '\n', static_cast<std::size_t>(end - cursor));
+        if(!found) {
+            return size;
+        }
+        cursor = static_cast<const std::uint8_t*>(found) + 1;
+    }
+    moreLines = cursor < end;
+    return static_cast<std::size_t>(cursor - data);
+}
+
+} // namespace
+
+namespace qttabbar {
+
+const wchar_t* TextEncodingName(TextEncoding encoding) {
+    switch(encoding) {
+    case TextEncoding::Utf8:
+        return L"UTF-8";
+    case TextEncoding::Utf8Bom:
+        return L"UTF-8 (BOM)";
+    case TextEncoding::Utf16Le:
+        return L"UTF-16 LE";
+    case TextEncoding::Utf16Be:
+        return L"UTF-16 BE";
+    case TextEncoding::Gbk:
+        return L"GBK";
+    case TextEncoding::ShiftJis:
+        return L"Shift-JIS";
+    case TextEncoding::Ansi:
+        return L"ANSI";
+    default:
+        return L"Binary";
+    }
+}
+
+TextEncoding DetectTextEncoding(const std::uint8_t* data, std::size_t size) {
+    if(size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+        return TextEncoding::Utf8Bom;
+    }
+    if(size >= 2 && data[0] == 0xFF && data[1] == 0xFE) {
+        return TextEncoding::Utf16Le;
+    }
+    if(size >= 2 && data[0] == 0xFE && data[1] == 0xFF) {
+        return TextEncoding::Utf16Be;
+    }
+
+    std::size_t evenZeros = 0;
+    std::size_t oddZeros = 0;
+    for(std::size_t i = 0; i < size; ++i) {
+        if(data[i] == 0) {
+            ++((i & 1) ? oddZeros : evenZeros);
+        }
+    }
+    if(evenZeros + oddZeros > 0) {
+        // Latin text in UTF-16 has a zero in nearly every other byte.
+        std::size_t units = size / 2;
+        if(oddZeros * 4 >= units * 3 && evenZeros * 16 < units) {
+            return TextEncoding::Utf16Le;
+        }
+        if(evenZeros * 4 >= units * 3 && oddZeros * 16 < units) {
+            return TextEncoding::Utf16Be;
+        }
+        return TextEncoding::Binary;
+    }
+
+    if(IsValidUtf8(data, size)) {
+        return TextEncoding::Utf8;
+    }
+
+    DbcsScore gbk = ScoreGbk(data, size);
+    DbcsScore shiftJis = ScoreShiftJis(data, size);
+    auto plausible = [](const DbcsScore& score) { return score.pairs > 0 && score.errors * 32 <= score.pairs; };
+    bool gbkPlausible = plausible(gbk);
+    bool shiftJisPlausible = plausible(shiftJis);
+    if(gbkPlausible && shiftJisPlausible) {
+        if(gbk.errors != shiftJis.errors) {
+            return gbk.errors < shiftJis.errors ? TextEncoding::Gbk : TextEncoding::ShiftJis;
+        }
+        return shiftJis.signal > gbk.signal ? TextEncoding::ShiftJis : TextEncoding::Gbk;
+    }
+    if(gbkPlausible) {
+        return TextEncoding::Gbk;
+    }
+    if(shiftJisPlausible) {
+        return TextEncoding::ShiftJis;
+    }
+    return TextEncoding::Ansi;
+}
+
+TextPreview MakeTextPreview(const std::uint8_t* data, std::size_t size, const TextPreviewOptions& options) {
+    TextPreview preview;
+    preview.encoding = DetectTextEncoding(data, size);
+    if(preview.encoding == TextEncoding::Binary || size == 0) {
+        // An empty file may come with a null buffer, which memchr must not see.
+        return preview;
+    }
+
+    std::size_t bom = 0;
+    if(preview.encoding == TextEncoding::Utf8Bom) {
+        bom = 3;
+    } else if(size >= 2 && ((preview.encoding == TextEncoding::Utf16Le && data[0] == 0xFF && data[1] == 0xFE)
+                            || (preview.encoding == TextEncoding::Utf16Be && data[0] == 0xFE && data[1] == 0xFF))) {
+        bom = 2;
+    }
+    const std::uint8_t* body = data + bom;
+    std::size_t bodySize = size - bom;
+
+    bool moreLines = false;
+    std::size_t end = FindLinesEnd(body, bodySize, std::max<std::size_t>(options.maxLines, 1), preview.encoding,
+                                   moreLines);
+    if(end == bodySize) {
+        end = CompletePrefix(body, bodySize, preview.encoding);
+    }
+    preview.truncated = moreLines;
+
+    std::wstring decoded;
+    switch(preview.encoding) {
+    case TextEncoding::Utf8:
+    case TextEncoding::Utf8Bom:
+        decoded = DecodeUtf8Text(body, end);
+        break;
+    case TextEncoding::Utf16Le:
+    case TextEncoding::Utf16Be:
+        decoded = DecodeUtf16Text(body, end, preview.encoding == TextEncoding::Utf16Be);
+        break;
+    default:
+        decoded = DecodeCodePageText(body, end, preview.encoding);
+        break;
+    }
+
+    std::size_t lines = 0;
+    std::size_t start = 0;
+    preview.text.reserve(decoded.size() + options.maxLines * 2);
+    while(start < decoded.size() && lines < options.maxLines) {
+        std::size_t newline = decoded.find(L'\n', start);
+        std::size_t stop = newline == std::wstring::npos ? decoded.size() : newline;
+        std::size_t length = stop - start;
+        if(length > 0 && decoded[start + length - 1] == L'\r') {
+            --length;
+        }
+        if(length > options.maxLineChars) {
+            length = options.maxLineChars;
+            preview.truncated = true;
+        }
+        preview.text.append(decoded, start, length);
+        preview.text.append(L"\r\n");
+        ++lines;
+        start = newline == std::wstring::npos ? decoded.size() : newline + 1;
+    }
+    return preview;
+}
+
+std::optional<TextPreview> ReadTextPreview(const std::wstring& path, const TextPreviewOptions& options) {
+    std::vector<std::uint8_t> buffer(options.maxBytes);
+    std::size_t read = 0;
+#if defined(_WIN32)
+    HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE) {
+        return std::nullopt;
+    }
+    DWORD bytes = 0;
+    BOOL ok = ::ReadFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &bytes, nullptr);
+    ::CloseHandle(file);
+    if(!ok) {
+        return std::nullopt;
+    }
+    read = bytes;
+#else
+    int fd = ::open(std::filesystem::path(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return std::nullopt;
+    }
+    while(read < buffer.size()) {
+        ssize_t got = ::read(fd, buffer.data() + read, buffer.size() - read);
+        if(got < 0 && errno == EINTR) {
+            continue;
+        }
+        if(got <= 0) {
+            break;
+        }
+        read += static_cast<std::size_t>(got);
+    }
+    ::close(fd);
+#endif
+    TextPreview preview = MakeTextPreview(buffer.data(), read, options);
+    if(preview.encoding == TextEncoding::Binary || preview.text.empty()) {
+        return std::nullopt;
+    }
+    if(read == buffer.size()) {
+        preview.truncated = true;
+    }
+    return preview;
+}
+
+} // namespace qttabbar
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace qttabbar {
+
+enum class TextEncoding {
+    Binary,
+    Utf8,
+    Utf8Bom,
+    Utf16Le,
+    Utf16Be,
+    Gbk,
+    ShiftJis,
+    // Neither UTF-8 nor a plausible CJK double-byte text; decoded with the
+    // system ANSI code page (Windows-1252 off Windows).
+    Ansi,
+};
+
+const wchar_t* TextEncodingName(TextEncoding encoding);
+
+struct TextPreviewOptions {
+    // Only this much of the file is ever read, however long its lines are.
+    std::size_t maxBytes = 32u * 1024u;
+    std::size_t maxLines = 12;
+    std::size_t maxLineChars = 512;
+};
+
+struct TextPreview {
+    // Display lines, each terminated by "\r\n".
+    std::wstring text;
+    TextEncoding encoding = TextEncoding::Binary;
+    // True when lines or bytes were cut off.
+    bool truncated = false;
+};
+
+// Guesses the encoding of a file prefix. `data` may end in the middle of a
+// character; BOMs win, then UTF-16 by zero-byte pattern, then UTF-8 validity,
+// then the GBK / Shift-JIS byte grammar that fits best.
+TextEncoding DetectTextEncoding(const std::uint8_t* data, std::size_t size);
+
+// Builds the preview from a file prefix of at most options.maxBytes bytes.
+TextPreview MakeTextPreview(const std::uint8_t* data, std::size_t size, const TextPreviewOptions& options);
+
+// Reads the prefix with a single read and builds the preview. Returns nothing
+// when the file cannot be read or looks binary.
+std::optional<TextPreview> ReadTextPreview(const std::wstring& path, const TextPreviewOptions& options);
+
+} // namespace qttabbar
@@ -0,0 +1,281 @@
+#include "ThumbnailCache.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "TabPathIndex.h"
+
+namespace qttabbar {
+
+ThumbnailCache::ThumbnailCache(ThumbnailReleaseFn release)
+    : ThumbnailCache(Limits{}, std::move(release)) {
+}
+
+ThumbnailCache::ThumbnailCache(Limits limits, ThumbnailReleaseFn release)
+    : m_limits(limits)
+    , m_release(std::move(release)) {
+    m_limits.maxHandles = std::max<std::size_t>(m_limits.maxHandles, 1);
+}
+
+ThumbnailCache::~ThumbnailCache() {
+    Unpin();
+    Clear();
+}
+
+const Thumbnail* ThumbnailCache::Lookup(const std::wstring& path, std::int64_t stamp) {
+    auto found = m_slots.find(MakeKey(path));
+    if(found == m_slots.end()) {
+        ++m_stats.misses;
+        return nullptr;
+    }
+    if(found->second->thumbnail.stamp != stamp) {
+        ++m_stats.stale;
+        ++m_stats.misses;
+        Erase(found->second);
+        return nullptr;
+    }
+    ++m_stats.hits;
+    m_lru.splice(m_lru.begin(), m_lru, found->second);
+    return &m_lru.front().thumbnail;
+}
+
+bool ThumbnailCache::Contains(const std::wstring& path) const {
+    return m_slots.find(MakeKey(path)) != m_slots.end();
+}
+
+const Thumbnail* ThumbnailCache::Store(const std::wstring& path, Thumbnail thumbnail) {
+    Slot slot;
+    slot.key = MakeKey(path);
+    slot.bytes = EstimateBytes(thumbnail);
+    slot.thumbnail = thumbnail;
+
+    auto found = m_slots.find(slot.key);
+    if(found != m_slots.end()) {
+        Erase(found->second);
+    }
+    m_stats.bytes += slot.bytes;
+    m_lru.push_front(std::move(slot));
+    m_slots.emplace(m_lru.front().key, m_lru.begin());
+    m_stats.entries = m_lru.size();
+    Trim();
+    return &m_lru.front().thumbnail;
+}
+
+void ThumbnailCache::Pin(const std::wstring& path) {
+    ReleaseDetached();
+    m_pinnedKey = MakeKey(path);
+}
+
+void ThumbnailCache::Unpin() {
+    ReleaseDetached();
+    m_pinnedKey.clear();
+}
+
+void ThumbnailCache::Invalidate(const std::wstring& path) {
+    auto found = m_slots.find(MakeKey(path));
+    if(found != m_slots.end()) {
+        Erase(found->second);
+    }
+}
+
+void ThumbnailCache::Clear() {
+    while(!m_lru.empty()) {
+        Erase(std::prev(m_lru.end()));
+    }
+}
+
+std::size_t ThumbnailCache::EstimateBytes(const Thumbnail& thumbnail) {
+    // Thumbnails are 32bpp DIB sections.
+    return static_cast<std::size_t>(std::max(thumbnail.width, 0)) * static_cast<std::size_t>(std::max(thumbnail.height, 0)) * 4u;
+}
+
+std::wstring ThumbnailCache::MakeKey(const std::wstring& path) {
+#if defined(_WIN32)
+    return TabPathIndex::Fold(path);
+#else
+    return path;
+#endif
+}
+
+void ThumbnailCache::Erase(SlotList::iterator it) {
+    if(!m_pinnedKey.empty() && it->key == m_pinnedKey) {
+        // Still on screen; keep the bitmap alive until the pin moves.
+        ReleaseDetached();
+        m_detached = it->thumbnail;
+        m_pinnedKey.clear();
+    } else if(m_release && it->thumbnail.handle) {
+        m_release(it->thumbnail.handle);
+    }
+    m_stats.bytes -= it->bytes;
+    m_slots.erase(it->key);
+    m_lru.erase(it);
+    m_stats.entries = m_lru.size();
+}
+
+void ThumbnailCache::Trim() {
+    auto it = m_lru.end();
+    while(it != m_lru.begin() && (m_stats.bytes > m_limits.maxBytes || m_lru.size() > m_limits.maxHandles)) {
+        --it;
+        if(it == m_lru.begin()) {
+            break;
+        }
+        if(!m_pinnedKey.empty() && it->key == m_pinnedKey) {
+            continue;
+        }
+        auto victim = it++;
+        Erase(victim);
+        ++m_stats.evictions;
+    }
+}
+
+void ThumbnailCache::ReleaseDetached() {
+    if(m_detached) {
+        if(m_release && m_detached->handle) {
+            m_release(m_detached->handle);
+        }
+        m_detached.reset();
+    }
+}
+
+AsyncThumbnailDecoder::AsyncThumbnailDecoder(DecodeFn decode, ThumbnailReleaseFn release, NotifyFn notify)
+    : AsyncThumbnailDecoder(std::move(decode), std::move(release), std::move(notify), Options{}) {
+}
+
+AsyncThumbnailDecoder::AsyncThumbnailDecoder(DecodeFn decode, ThumbnailReleaseFn release, NotifyFn notify,
+                                             Options options)
+    : m_state(std::make_shared<State>()) {
+    m_state->decode = std::move(decode);
+    m_state->release = std::move(release);
+    m_state->notify = std::move(notify);
+    m_state->options = std::move(options);
+}
+
+AsyncThumbnailDecoder::~AsyncThumbnailDecoder() {
+    // A shell decode can take seconds on a slow share; leave it to finish on
+    // its own. The bumped generation makes the worker release its result and
+    // stop instead of notifying a window that may be gone.
+    Cancel();
+    if(m_worker.joinable()) {
+        m_worker.detach();
+    }
+}
+
+void AsyncThumbnailDecoder::Request(const std::wstring& path, int maxWidth, int maxHeight) {
+    std::lock_guard guard(m_state->mutex);
+    auto& queue = m_state->queue;
+    queue.erase(std::remove_if(queue.begin(), queue.end(), [&](const Job& job) { return job.path == path; }),
+                queue.end());
+    queue.push_front({path, maxWidth, maxHeight, false});
+    EnsureWorkerLocked();
+}
+
+void AsyncThumbnailDecoder::Prefetch(const std::vector<std::wstring>& paths, int maxWidth, int maxHeight) {
+    std::lock_guard guard(m_state->mutex);
+    auto& queue = m_state->queue;
+    queue.erase(std::remove_if(queue.begin(), queue.end(), [](const Job& job) { return job.prefetch; }), queue.end());
+    std::size_t added = 0;
+    for(const auto& path : paths) {
+        if(added >= m_state->options.maxPrefetch) {
+            break;
+        }
+        bool queued = path == m_state->decoding
+                      || std::any_of(queue.begin(), queue.end(), [&](const Job& job) { return job.path == path; });
+        if(!queued) {
+            queue.push_back({path, maxWidth, maxHeight, true});
+            ++added;
+        }
+    }
+    if(added > 0) {
+        EnsureWorkerLocked();
+    }
+}
+
+void AsyncThumbnailDecoder::Cancel() {
+    std::vector<Result> dropped;
+    {
+        std::lock_guard guard(m_state->mutex);
+        ++m_state->generation;
+        m_state->queue.clear();
+        dropped.swap(m_state->results);
+    }
+    ReleaseResults(*m_state, dropped);
+}
+
+std::vector<AsyncThumbnailDecoder::Result> AsyncThumbnailDecoder::TakeResults() {
+    std::lock_guard guard(m_state->mutex);
+    std::vector<Result> results;
+    results.swap(m_state->results);
+    return results;
+}
+
+void AsyncThumbnailDecoder::WaitIdle() {
+    std::unique_lock lock(m_state->mutex);
+    m_state->idle.wait(lock, [this] { return !m_state->running; });
+}
+
+void AsyncThumbnailDecoder::EnsureWorkerLocked() {
+    if(m_state->running) {
+        return;
+    }
+    // The previous worker has already cleared `running` and is only returning.
+    if(m_worker.joinable()) {
+        m_worker.join();
+    }
+    m_state->running = true;
+    m_worker = std::thread([state = m_state]() { Run(state); });
+}
+
+void AsyncThumbnailDecoder::Run(const std::shared_ptr<State>& state) {
+    if(state->options.threadStart) {
+        state->options.threadStart();
+    }
+    std::unique_lock lock(state->mutex);
+    while(!state->queue.empty()) {
+        Job job = std::move(state->queue.front());
+        state->queue.pop_front();
+        std::uint64_t generation = state->generation;
+        state->decoding = job.path;
+        lock.unlock();
+
+        Result result;
+        result.path = std::move(job.path);
+        result.prefetch = job.prefetch;
+        result.thumbnail = state->decode(result.path, job.maxWidth, job.maxHeight);
+
+        lock.lock();
+        state->decoding.clear();
+        if(generation != state->generation) {
+            lock.unlock();
+            if(result.thumbnail && state->release) {
+                state->release(result.thumbnail->handle);
+            }
+            lock.lock();
+            continue;
+        }
+        state->results.push_back(std::move(result));
+        lock.unlock();
+        if(state->notify) {
+            state->notify();
+        }
+        lock.lock();
+    }
+    state->running = false;
+    state->idle.notify_all();
+    lock.unlock();
+    // A new burst may already have joined this thread; it waits for this to return.
+    if(state->options.threadStop) {
+        state->options.threadStop();
+    }
+}
+
+void AsyncThumbnailDecoder::ReleaseResults(const State& state, std::vector<Result>& results) {
+    for(auto& result : results) {
+        if(result.thumbnail && state.release) {
+            state.release(result.thumbnail->handle);
+        }
+    }
+    results.clear();
+}
+
+} // namespace qttabbar
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace qttabbar {
+
+// A decoded preview image. `handle` is an opaque platform bitmap (an HBITMAP on
+// Windows) released through the owner's ThumbnailReleaseFn.
+struct Thumbnail {
+    std::uintptr_t handle = 0;
+    int width = 0;
+    int height = 0;
+    // Last write time of the source file when it was decoded (see ReadFileStamp).
+    std::int64_t stamp = 0;
+};
+
+using ThumbnailReleaseFn = std::function<void(std::uintptr_t)>;
+
+// LRU cache of decoded thumbnails bounded by total pixel bytes and by the number
+// of live bitmap handles. Entries are served only while the source file's stamp
+// still matches. One entry may be pinned while it is on screen: eviction skips
+// it, and if it is invalidated its bitmap is kept alive until the pin moves.
+// Not thread-safe; it belongs to the window that paints the thumbnails.
+class ThumbnailCache {
+public:
+    struct Limits {
+        std::size_t maxBytes = 64u * 1024u * 1024u;
+        std::size_t maxHandles = 256;
+    };
+
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t stale = 0;
+        std::uint64_t evictions = 0;
+        std::size_t entries = 0;
+        std::size_t bytes = 0;
+    };
+
+    explicit ThumbnailCache(ThumbnailReleaseFn release);
+    ThumbnailCache(Limits limits, ThumbnailReleaseFn release);
+    ~ThumbnailCache();
+
+    ThumbnailCache(const ThumbnailCache&) = delete;
+    ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+    // The returned pointer stays valid until the next Store, Invalidate or Clear.
+    const Thumbnail* Lookup(const std::wstring& path, std::int64_t stamp);
+    // Presence check for prefetch filtering; does not touch LRU order or stats.
+    bool Contains(const std::wstring& path) const;
+    // Takes ownership of the bitmap. The entry just stored is never evicted by its
+    // own insertion, so a single oversized thumbnail can still be shown.
+    const Thumbnail* Store(const std::wstring& path, Thumbnail thumbnail);
+    void Pin(const std::wstring& path);
+    void Unpin();
+    void Invalidate(const std::wstring& path);
+    void Clear();
+    Stats GetStats() const { return m_stats; }
+
+    static std::size_t EstimateBytes(const Thumbnail& thumbnail);
+
+private:
+    struct Slot {
+        std::wstring key;
+        Thumbnail thumbnail;
+        std::size_t bytes = 0;
+    };
+    using SlotList = std::list<Slot>;
+
+    static std::wstring MakeKey(const std::wstring& path);
+    void Erase(SlotList::iterator it);
+    void Trim();
+    void ReleaseDetached();
+
+    Limits m_limits;
+    ThumbnailReleaseFn m_release;
+    SlotList m_lru;
+    std::unordered_map<std::wstring, SlotList::iterator> m_slots;
+    std::wstring m_pinnedKey;
+    std::optional<Thumbnail> m_detached;
+    Stats m_stats{};
+};
+
+// Decodes thumbnails on a background thread. Explicit requests jump the queue;
+// prefetches of neighbouring items fill it behind them and are replaced by the
+// next prefetch batch. Results are handed back through TakeResults, typically
+// after NotifyFn has posted a message to the owning window. Destroying the
+// decoder does not wait for a decode in flight: the worker keeps the shared
+// state alive, releases that bitmap and exits without notifying.
+class AsyncThumbnailDecoder {
+public:
+    using DecodeFn = std::function<std::optional<Thumbnail>(const std::wstring& path, int maxWidth, int maxHeight)>;
+    // Invoked on the worker thread whenever a result is ready.
+    using NotifyFn = std::function<void()>;
+
+    struct Options {
+        std::size_t maxPrefetch = 8;
+        // Run on the worker thread around each burst of work (e.g. COM apartment setup).
+        std::function<void()> threadStart;
+        std::function<void()> threadStop;
+    };
+
+    struct Result {
+        std::wstring path;
+        // Empty when the file could not be decoded.
+        std::optional<Thumbnail> thumbnail;
+        bool prefetch = false;
+    };
+
+    AsyncThumbnailDecoder(DecodeFn decode, ThumbnailReleaseFn release, NotifyFn notify);
+    AsyncThumbnailDecoder(DecodeFn decode, ThumbnailReleaseFn release, NotifyFn notify, Options options);
+    ~AsyncThumbnailDecoder();
+
+    AsyncThumbnailDecoder(const AsyncThumbnailDecoder&) = delete;
+    AsyncThumbnailDecoder& operator=(const AsyncThumbnailDecoder&) = delete;
+
+    void Request(const std::wstring& path, int maxWidth, int maxHeight);
+    void Prefetch(const std::vector<std::wstring>& paths, int maxWidth, int maxHeight);
+    // Drops queued work and undelivered results; a decode in flight is discarded.
+    void Cancel();
+    // The caller owns the bitmaps of the returned results.
+    std::vector<Result> TakeResults();
+    void WaitIdle();
+
+private:
+    struct Job {
+        std::wstring path;
+        int maxWidth = 0;
+        int maxHeight = 0;
+        bool prefetch = false;
+    };
+
+    // Everything the worker touches, so that it can outlive the decoder.
+    struct State {
+        DecodeFn decode;
+        ThumbnailReleaseFn release;
+        NotifyFn notify;
+        Options options;
+        std::mutex mutex;
+        std::condition_variable idle;
+        std::deque<Job> queue;
+        std::vector<Result> results;
+        // Path of the job being decoded, so prefetch does not queue it a second time.
+        std::wstring decoding;
+        std::uint64_t generation = 0;
+        bool running = false;
+    };
+
+    static void Run(const std::shared_ptr<State>& state);
+    static void ReleaseResults(const State& state, std::vector<Result>& results);
+    void EnsureWorkerLocked();
+
+    std::shared_ptr<State> m_state;
+    std::thread m_worker;
+};
+
+} // namespace qttabbar
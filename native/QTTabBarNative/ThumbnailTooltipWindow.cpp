@@ -5,21 +5,21 @@
 #include <Shobjidl.h>
 
 #include <algorithm>
-#include <codecvt>
-#include <fstream>
 #include <iterator>
-#include <sstream>
-#include <locale>
-#include <cstring>
 
 #pragma comment(lib, "Shlwapi.lib")
 
+#include "DirectoryEnumerator.h"
+#include "TextPreview.h"
+
 namespace {
 constexpr COLORREF kTooltipBackground = RGB(32, 32, 32);
 constexpr COLORREF kTooltipBorder = RGB(96, 96, 96);
 constexpr COLORREF kTooltipText = RGB(240, 240, 240);
 constexpr UINT kTooltipPadding = 12;
 constexpr UINT kTooltipTextLines = 12;
+constexpr int kPlaceholderWidth = 160;
+constexpr int kPlaceholderHeight = 48;
 
 SIZE ClampSize(SIZE value, int maxWidth, int maxHeight) {
     value.cx = std::min(value.cx, maxWidth);
@@ -46,42 +46,78 @@ bool HasExtension(const std::wstring& extension, const qttabbar::StringList& lis
     return false;
 }
 
-bool ReadSmallTextFile(const std::wstring& path, std::wstring& output) {
-    std::wifstream stream(path);
-    if(!stream) {
-        return false;
+void ReleaseThumbnailBitmap(std::uintptr_t handle) {
+    ::DeleteObject(reinterpret_cast<HBITMAP>(handle));
+}
+
+// Runs on the decoder thread, which enters its own STA for the shell factories.
+std::optional<qttabbar::Thumbnail> DecodeThumbnail(const std::wstring& path, int maxWidth, int maxHeight) {
+    std::optional<std::int64_t> stamp = qttabbar::ReadFileStamp(path);
+    if(!stamp) {
+        return std::nullopt;
     }
-    stream.imbue(std::locale(stream.getloc(), new std::codecvt_utf8_utf16<wchar_t>()));
-    std::wostringstream buffer;
-    std::wstring line;
-    std::size_t lineCount = 0;
-    while(std::getline(stream, line)) {
-        buffer << line << L"\r\n";
-        if(++lineCount >= kTooltipTextLines) {
-            break;
+
+    CComPtr<IShellItem> item;
+    if(FAILED(::SHCreateItemFromParsingName(path.c_str(), nullptr, IID_PPV_ARGS(&item)))) {
+        return std::nullopt;
+    }
+
+    CComPtr<IShellItemImageFactory> factory;
+    if(FAILED(item->BindToHandler(nullptr, BHID_ThumbnailHandler, IID_PPV_ARGS(&factory)))) {
+        if(FAILED(item->BindToHandler(nullptr, BHID_SFUIObject, IID_PPV_ARGS(&factory)))) {
+            return std::nullopt;
         }
     }
-    output = buffer.str();
-    return !output.empty();
+
+    SIZE desired{maxWidth, maxHeight};
+    HBITMAP bitmap = nullptr;
+    HRESULT hr = factory->GetImage(desired, SIIGBF_RESIZETOFIT | SIIGBF_BIGGERSIZEOK, &bitmap);
+    if(FAILED(hr) || bitmap == nullptr) {
+        return std::nullopt;
+    }
+
+    qttabbar::Thumbnail thumbnail;
+    thumbnail.handle = reinterpret_cast<std::uintptr_t>(bitmap);
+    thumbnail.stamp = *stamp;
+    BITMAP bm{};
+    if(::GetObject(bitmap, sizeof(bm), &bm)) {
+        thumbnail.width = bm.bmWidth;
+        thumbnail.height = bm.bmHeight;
+    } else {
+        thumbnail.width = desired.cx;
+        thumbnail.height = desired.cy;
+    }
+    return thumbnail;
 }
 
 } // namespace
 
-ThumbnailTooltipWindow::ThumbnailTooltipWindow() noexcept = default;
+ThumbnailTooltipWindow::ThumbnailTooltipWindow() noexcept
+    : m_cache(&ReleaseThumbnailBitmap) {
+}
 
 ThumbnailTooltipWindow::~ThumbnailTooltipWindow() {
+    m_decoder.reset();
     ClearCache();
 }
 
 void ThumbnailTooltipWindow::ApplyConfiguration(const qttabbar::ConfigData::TipsSettings& settings) {
+    bool resized = settings.previewMaxWidth != m_settings.previewMaxWidth
+                   || settings.previewMaxHeight != m_settings.previewMaxHeight;
     m_settings = settings;
+    if(resized) {
+        // Cached thumbnails were decoded for the old bounds.
+        ClearCache();
+    }
 }
 
 void ThumbnailTooltipWindow::ClearCache() {
-    for(auto& kvp : m_cache) {
-        DestroyCacheEntry(kvp.second);
+    if(m_decoder) {
+        m_decoder->Cancel();
     }
-    m_cache.clear();
+    m_cache.Unpin();
+    m_cache.Clear();
+    m_currentPath.clear();
     m_bitmap = nullptr;
     m_bitmapSize = {0, 0};
     m_textPreview.clear();
@@ -93,6 +129,8 @@ void ThumbnailTooltipWindow::ClearCache() {
 
 void ThumbnailTooltipWindow::HideTooltip() {
     m_mode = Mode::None;
+    m_currentPath.clear();
+    m_cache.Unpin();
     m_bitmap = nullptr;
     m_textPreview.clear();
     if(IsWindow()) {
@@ -115,37 +153,37 @@ bool ThumbnailTooltipWindow::ShowForPath(const std::wstring& path, const RECT& r
     std::wstring extension = PathFindExtensionW(path.c_str());
     std::wstring lowered = ToLowerCopy(extension);
 
-    CacheEntry entry{};
-    auto it = m_cache.find(path);
-    if(it != m_cache.end()) {
-        entry = it->second;
-        WIN32_FILE_ATTRIBUTE_DATA data{};
-        if(::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) {
-            if(std::memcmp(&data.ftLastWriteTime, &entry.timestamp, sizeof(FILETIME)) != 0) {
-                CacheEntry refreshed{};
-                if(IsSupportedImageExtension(lowered, m_settings) && LoadImage(path, refreshed)) {
-                    DestroyCacheEntry(it->second);
-                    it->second = refreshed;
-                    entry = refreshed;
-                }
-            }
+    m_reference = reference;
+    if(IsSupportedImageExtension(lowered, m_settings)) {
+        std::optional<std::int64_t> stamp = qttabbar::ReadFileStamp(path);
+        const qttabbar::Thumbnail* cached = stamp ? m_cache.Lookup(path, *stamp) : nullptr;
+        if(cached) {
+            ShowThumbnail(path, *cached);
+            return true;
         }
-    } else if(IsSupportedImageExtension(lowered, m_settings)) {
-        CacheEntry loaded{};
-        if(LoadImage(path, loaded)) {
-            entry = loaded;
-            m_cache.emplace(path, loaded);
+        if(stamp && m_decoder) {
+            // Show a placeholder right away; OnThumbnailReady swaps in the image.
+            if(m_currentPath != path || m_mode != Mode::Pending) {
+                m_decoder->Request(path, m_settings.previewMaxWidth, m_settings.previewMaxHeight);
+            }
+            m_cache.Unpin();
+            m_currentPath = path;
+            m_mode = Mode::Pending;
+            m_bitmap = nullptr;
+            m_bitmapSize = {0, 0};
+            m_textPreview.clear();
+            UpdateWindowPlacement(reference);
+            ShowWindow(SW_SHOWNOACTIVATE);
+            Invalidate();
+            return true;
         }
     }
 
-    if(entry.bitmap) {
-        m_bitmap = entry.bitmap;
-        m_bitmapSize = entry.size;
-        m_mode = Mode::Image;
-        m_textPreview.clear();
-    } else if(IsSupportedTextExtension(lowered, m_settings)) {
+    if(IsSupportedTextExtension(lowered, m_settings)) {
         std::wstring text;
         if(LoadTextPreview(path, text)) {
+            m_cache.Unpin();
+            m_currentPath = path;
             m_mode = Mode::Text;
             m_textPreview = std::move(text);
             m_bitmap = nullptr;
@@ -161,9 +199,24 @@ bool ThumbnailTooltipWindow::ShowForPath(const std::wstring& path, const RECT& r
 
     UpdateWindowPlacement(reference);
     ShowWindow(SW_SHOWNOACTIVATE);
+    Invalidate();
     return true;
 }
 
+void ThumbnailTooltipWindow::Prefetch(const std::vector<std::wstring>& paths) {
+    if(!m_decoder) {
+        return;
+    }
+    std::vector<std::wstring> wanted;
+    for(const auto& path : paths) {
+        std::wstring lowered = ToLowerCopy(PathFindExtensionW(path.c_str()));
+        if(IsSupportedImageExtension(lowered, m_settings) && !m_cache.Contains(path)) {
+            wanted.push_back(path);
+        }
+    }
+    m_decoder->Prefetch(wanted, m_settings.previewMaxWidth, m_settings.previewMaxHeight);
+}
+
 bool ThumbnailTooltipWindow::IsSupportedImageExtension(const std::wstring& extension,
                                                        const qttabbar::ConfigData::TipsSettings& settings) {
     if(settings.imageExt.empty()) {
@@ -184,11 +237,19 @@ bool ThumbnailTooltipWindow::IsSupportedTextExtension(const std::wstring& extens
 LRESULT ThumbnailTooltipWindow::OnCreate(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
     bHandled = TRUE;
     SetWindowPos(HWND_TOPMOST, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    HWND hwnd = m_hWnd;
+    qttabbar::AsyncThumbnailDecoder::Options options;
+    options.threadStart = [] { ::CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE); };
+    options.threadStop = [] { ::CoUninitialize(); };
+    m_decoder = std::make_unique<qttabbar::AsyncThumbnailDecoder>(
+        &DecodeThumbnail, &ReleaseThumbnailBitmap,
+        [hwnd]() { ::PostMessageW(hwnd, WM_APP_THUMBNAIL_READY, 0, 0); }, std::move(options));
     return 0;
 }
 
 LRESULT ThumbnailTooltipWindow::OnDestroy(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
     bHandled = TRUE;
+    m_decoder.reset();
     ClearCache();
     return 0;
 }
@@ -225,6 +286,13 @@ LRESULT ThumbnailTooltipWindow::OnPaint(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM
         ::StretchBlt(hdc, x, y, destWidth, destHeight, memDC, 0, 0, bm.bmWidth, bm.bmHeight, SRCCOPY);
         ::SelectObject(memDC, oldBmp);
         ::DeleteDC(memDC);
+    } else if(m_mode == Mode::Pending) {
+        HFONT font = static_cast<HFONT>(::GetStockObject(DEFAULT_GUI_FONT));
+        HGDIOBJ oldFont = ::SelectObject(hdc, font);
+        ::SetBkMode(hdc, TRANSPARENT);
+        ::SetTextColor(hdc, kTooltipBorder);
+        ::DrawTextW(hdc, L"Loading preview...", -1, &rc, DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX);
+        ::SelectObject(hdc, oldFont);
     } else if(m_mode == Mode::Text) {
         HFONT font = static_cast<HFONT>(::GetStockObject(DEFAULT_GUI_FONT));
         HGDIOBJ oldFont = ::SelectObject(hdc, font);
@@ -253,52 +321,48 @@ bool ThumbnailTooltipWindow::EnsureWindow() {
     return hwnd != nullptr;
 }
 
-bool ThumbnailTooltipWindow::LoadImage(const std::wstring& path, CacheEntry& entry) {
-    CComPtr<IShellItem> item;
-    if(FAILED(::SHCreateItemFromParsingName(path.c_str(), nullptr, IID_PPV_ARGS(&item)))) {
-        return false;
+LRESULT ThumbnailTooltipWindow::OnThumbnailReady(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, BOOL& bHandled) {
+    bHandled = TRUE;
+    if(!m_decoder) {
+        return 0;
     }
-
-    CComPtr<IShellItemImageFactory> factory;
-    if(FAILED(item->BindToHandler(nullptr, BHID_ThumbnailHandler, IID_PPV_ARGS(&factory)))) {
-        if(FAILED(item->BindToHandler(nullptr, BHID_SFUIObject, IID_PPV_ARGS(&factory)))) {
-            return false;
+    for(auto& result : m_decoder->TakeResults()) {
+        bool current = m_mode == Mode::Pending && result.path == m_currentPath;
+        if(!result.thumbnail) {
+            if(current) {
+                HideTooltip();
+            }
+            continue;
+        }
+        const qttabbar::Thumbnail* stored = m_cache.Store(result.path, *result.thumbnail);
+        if(current) {
+            ShowThumbnail(result.path, *stored);
         }
     }
-
-    SIZE desired{m_settings.previewMaxWidth, m_settings.previewMaxHeight};
-    desired = ClampSize(desired, m_settings.previewMaxWidth, m_settings.previewMaxHeight);
-    HBITMAP bitmap = nullptr;
-    HRESULT hr = factory->GetImage(desired, SIIGBF_RESIZETOFIT | SIIGBF_BIGGERSIZEOK, &bitmap);
-    if(FAILED(hr) || bitmap == nullptr) {
-        return false;
-    }
-
-    entry.bitmap = bitmap;
-    BITMAP bm{};
-    if(::GetObject(bitmap, sizeof(bm), &bm)) {
-        entry.size.cx = bm.bmWidth;
-        entry.size.cy = bm.bmHeight;
-        entry.size = ClampSize(entry.size, m_settings.previewMaxWidth, m_settings.previewMaxHeight);
-    } else {
-        entry.size = desired;
-    }
-    WIN32_FILE_ATTRIBUTE_DATA data{};
-    if(::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) {
-        entry.timestamp = data.ftLastWriteTime;
-    }
-    return true;
+    return 0;
 }
 
-bool ThumbnailTooltipWindow::LoadTextPreview(const std::wstring& path, std::wstring& text) const {
-    return ReadSmallTextFile(path, text);
+void ThumbnailTooltipWindow::ShowThumbnail(const std::wstring& path, const qttabbar::Thumbnail& thumbnail) {
+    m_cache.Pin(path);
+    m_currentPath = path;
+    m_bitmap = reinterpret_cast<HBITMAP>(thumbnail.handle);
+    m_bitmapSize = ClampSize({thumbnail.width, thumbnail.height}, m_settings.previewMaxWidth, m_settings.previewMaxHeight);
+    m_mode = Mode::Image;
+    m_textPreview.clear();
+    UpdateWindowPlacement(m_reference);
+    ShowWindow(SW_SHOWNOACTIVATE);
+    Invalidate();
 }
 
-void ThumbnailTooltipWindow::DestroyCacheEntry(CacheEntry& entry) {
-    if(entry.bitmap) {
-        ::DeleteObject(entry.bitmap);
-        entry.bitmap = nullptr;
+bool ThumbnailTooltipWindow::LoadTextPreview(const std::wstring& path, std::wstring& text) const {
+    qttabbar::TextPreviewOptions options;
+    options.maxLines = kTooltipTextLines;
+    std::optional<qttabbar::TextPreview> preview = qttabbar::ReadTextPreview(path, options);
+    if(!preview) {
+        return false;
     }
+    text = std::move(preview->text);
+    return true;
 }
 
 void ThumbnailTooltipWindow::UpdateWindowPlacement(const RECT& reference) {
@@ -306,7 +370,10 @@ void ThumbnailTooltipWindow::UpdateWindowPlacement(const RECT& reference) {
     int width = static_cast<int>(m_settings.previewMaxWidth + 2 * kTooltipPadding);
     int height = static_cast<int>(m_settings.previewMaxHeight + 2 * kTooltipPadding);
 
-    if(m_mode == Mode::Text) {
+    if(m_mode == Mode::Pending) {
+        width = kPlaceholderWidth;
+        height = kPlaceholderHeight;
+    } else if(m_mode == Mode::Text) {
         width = static_cast<int>(m_settings.previewMaxWidth);
         height = static_cast<int>(m_settings.previewMaxHeight);
     } else if(m_mode == Mode::Image && m_bitmap) {
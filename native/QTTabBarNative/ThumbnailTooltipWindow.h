@@ -3,12 +3,13 @@
 #include <atlbase.h>
 #include <atlwin.h>
 
+#include <memory>
 #include <optional>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "Config.h"
+#include "ThumbnailCache.h"
 
 class ThumbnailTooltipWindow final : public CWindowImpl<ThumbnailTooltipWindow> {
 public:
@@ -21,12 +22,15 @@ public:
         MESSAGE_HANDLER(WM_CREATE, OnCreate)
         MESSAGE_HANDLER(WM_DESTROY, OnDestroy)
         MESSAGE_HANDLER(WM_PAINT, OnPaint)
+        MESSAGE_HANDLER(WM_APP_THUMBNAIL_READY, OnThumbnailReady)
     END_MSG_MAP()
 
     void ApplyConfiguration(const qttabbar::ConfigData::TipsSettings& settings);
     void ClearCache();
     void HideTooltip();
     bool ShowForPath(const std::wstring& path, const RECT& reference, HWND owner);
+    // Queues background decodes of images the user is likely to hover next.
+    void Prefetch(const std::vector<std::wstring>& paths);
 
     static bool IsSupportedImageExtension(const std::wstring& extension,
                                           const qttabbar::ConfigData::TipsSettings& settings);
@@ -34,26 +38,25 @@ public:
                                          const qttabbar::ConfigData::TipsSettings& settings);
 
 private:
-    enum class Mode { None, Image, Text };
+    enum class Mode { None, Pending, Image, Text };
 
-    struct CacheEntry {
-        HBITMAP bitmap = nullptr;
-        SIZE size{0, 0};
-        FILETIME timestamp{};
-    };
+    static constexpr UINT WM_APP_THUMBNAIL_READY = WM_APP + 0x41;
 
     LRESULT OnCreate(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnDestroy(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
     LRESULT OnPaint(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+    LRESULT OnThumbnailReady(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
 
     bool EnsureWindow();
-    bool LoadImage(const std::wstring& path, CacheEntry& entry);
+    void ShowThumbnail(const std::wstring& path, const qttabbar::Thumbnail& thumbnail);
     bool LoadTextPreview(const std::wstring& path, std::wstring& text) const;
-    void DestroyCacheEntry(CacheEntry& entry);
     void UpdateWindowPlacement(const RECT& reference);
 
     qttabbar::ConfigData::TipsSettings m_settings{};
-    std::unordered_map<std::wstring, CacheEntry> m_cache;
+    qttabbar::ThumbnailCache m_cache;
+    std::unique_ptr<qttabbar::AsyncThumbnailDecoder> m_decoder;
+    std::wstring m_currentPath;
+    RECT m_reference{};
     Mode m_mode = Mode::None;
     HBITMAP m_bitmap = nullptr;
     SIZE m_bitmapSize{0, 0};
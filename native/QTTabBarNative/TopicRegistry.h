@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace qttabbar {
+
+// Subscribers filtered by message type and, optionally, action name.
+//
+// Subscriptions live in an immutable snapshot that Subscribe and Unsubscribe
+// replace under a mutex. Publish only counts itself in as a reader and walks
+// the current snapshot, so it never locks or allocates and runs just the
+// subscribers whose topic matches. Replaced snapshots are freed once no
+// reader is active; under continuous publishing they wait for a quiet moment.
+template<typename Message>
+class TopicRegistry {
+public:
+    using Id = std::uint64_t;
+    using Callback = std::function<void(const Message&)>;
+
+    // Matches every type; an empty action matches every action.
+    static constexpr std::uint32_t kAnyType = UINT32_MAX;
+
+    TopicRegistry() : m_current(new Snapshot()) {}
+
+    ~TopicRegistry() {
+        delete m_current.load();
+        for(const Snapshot* snapshot : m_retired) {
+            delete snapshot;
+        }
+    }
+
+    TopicRegistry(const TopicRegistry&) = delete;
+    TopicRegistry& operator=(const TopicRegistry&) = delete;
+
+    Id Subscribe(std::uint32_t type, std::wstring action, Callback callback) {
+        std::lock_guard lock(m_writeMutex);
+        auto entry = std::make_shared<const Entry>(Entry{type, std::move(action), m_nextId++, std::move(callback)});
+        auto next = std::make_unique<Snapshot>(*m_current.load());
+        auto position = std::upper_bound(next->entries.begin(), next->entries.end(), entry,
+            [](const EntryPtr& left, const EntryPtr& right) {
+                return Topic(*left) < Topic(*right) || (Topic(*left) == Topic(*right) && left->id < right->id);
+            });
+        next->entries.insert(position, entry);
+        Replace(std::move(next));
+        return entry->id;
+    }
+
+    void Unsubscribe(Id id) {
+        std::lock_guard lock(m_writeMutex);
+        const Snapshot* current = m_current.load();
+        auto found = std::find_if(current->entries.begin(), current->entries.end(),
+            [id](const EntryPtr& entry) { return entry->id == id; });
+        if(found == current->entries.end()) {
+            return;
+        }
+        auto next = std::make_unique<Snapshot>(*current);
+        next->entries.erase(next->entries.begin() + (found - current->entries.begin()));
+        Replace(std::move(next));
+    }
+
+    // Whether Publish with this topic would run anyone.
+    bool HasSubscribers(std::uint32_t type, std::wstring_view action) const {
+        ReadScope scope(*this);
+        Matches matches(*scope.snapshot, type, action);
+        return !matches.Done();
+    }
+
+    // Runs the matching subscribers in the order they subscribed and returns
+    // how many ran. Callbacks may subscribe and unsubscribe; changes apply
+    // from the next publish on.
+    std::size_t Publish(std::uint32_t type, std::wstring_view action, const Message& message) const {
+        ReadScope scope(*this);
+        std::size_t count = 0;
+        for(Matches matches(*scope.snapshot, type, action); !matches.Done(); matches.Next()) {
+            const Entry& entry = matches.Current();
+            if(entry.callback) {
+                entry.callback(message);
+                ++count;
+            }
+        }
+        return count;
+    }
+
+private:
+    struct Entry {
+        std::uint32_t type;
+        std::wstring action;
+        Id id;
+        Callback callback;
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    // Sorted by topic, then by id within a topic.
+    struct Snapshot {
+        std::vector<EntryPtr> entries;
+    };
+
+    using TopicKey = std::pair<std::uint32_t, std::wstring_view>;
+
+    static TopicKey Topic(const Entry& entry) {
+        return {entry.type, entry.action};
+    }
+
+    using Iterator = typename std::vector<EntryPtr>::const_iterator;
+
+    // The up to four topics a publish matches (exact, any action, any type,
+    // any of both), merged by id so subscribers run in subscription order.
+    class Matches {
+    public:
+        Matches(const Snapshot& snapshot, std::uint32_t type, std::wstring_view action) {
+            Add(snapshot, type, {});
+            Add(snapshot, kAnyType, {});
+            if(!action.empty()) {
+                Add(snapshot, type, action);
+                Add(snapshot, kAnyType, action);
+            }
+            Next();
+        }
+
+        bool Done() const { return m_current == nullptr; }
+        const Entry& Current() const { return *m_current; }
+
+        void Next() {
+            m_current = nullptr;
+            std::size_t best = 0;
+            for(std::size_t i = 0; i < m_count; ++i) {
+                if(m_ranges[i].first != m_ranges[i].second
+                   && (!m_current || (*m_ranges[i].first)->id < m_current->id)) {
+                    m_current = m_ranges[i].first->get();
+                    best = i;
+                }
+            }
+            if(m_current) {
+                ++m_ranges[best].first;
+            }
+        }
+
+    private:
+        void Add(const Snapshot& snapshot, std::uint32_t type, std::wstring_view action) {
+            TopicKey key{type, action};
+            auto range = std::equal_range(snapshot.entries.begin(), snapshot.entries.end(), key, TopicLess());
+            if(range.first == range.second) {
+                return;
+            }
+            for(std::size_t i = 0; i < m_count; ++i) {
+                if(m_ranges[i].first == range.first) {
+                    // Publishing to kAnyType itself names the same topic twice.
+                    return;
+                }
+            }
+            m_ranges[m_count++] = range;
+        }
+
+        std::pair<Iterator, Iterator> m_ranges[4];
+        std::size_t m_count = 0;
+        const Entry* m_current = nullptr;
+    };
+
+    struct TopicLess {
+        bool operator()(const EntryPtr& entry, const TopicKey& key) const { return Topic(*entry) < key; }
+        bool operator()(const TopicKey& key, const EntryPtr& entry) const { return key < Topic(*entry); }
+    };
+
+    // Counts a publish in, so the snapshot it reads is not freed under it.
+    // Readers increment before loading and writers check after swapping, so
+    // a count of zero seen by a writer means no one holds a retired snapshot.
+    struct ReadScope {
+        explicit ReadScope(const TopicRegistry& registry) : registry(registry) {
+            registry.m_readers.fetch_add(1);
+            snapshot = registry.m_current.load();
+        }
+        ~ReadScope() {
+            if(registry.m_readers.fetch_sub(1) == 1 && registry.m_hasRetired.load()) {
+                registry.TryReclaim();
+            }
+        }
+
+        const TopicRegistry& registry;
+        const Snapshot* snapshot;
+    };
+
+    // Caller holds m_writeMutex.
+    void Replace(std::unique_ptr<Snapshot> next) {
+        m_retired.push_back(m_current.exchange(next.release()));
+        m_hasRetired = true;
+        ReclaimIfQuiet();
+    }
+
+    void TryReclaim() const {
+        std::unique_lock lock(m_writeMutex, std::try_to_lock);
+        if(lock) {
+            ReclaimIfQuiet();
+        }
+    }
+
+    void ReclaimIfQuiet() const {
+        if(m_readers.load() != 0) {
+            return;
+        }
+        for(const Snapshot* snapshot : m_retired) {
+            delete snapshot;
+        }
+        m_retired.clear();
+        m_hasRetired = false;
+    }
+
+    std::atomic<const Snapshot*> m_current;
+    mutable std::atomic<std::size_t> m_readers{0};
+    mutable std::atomic<bool> m_hasRetired{false};
+
+    mutable std::mutex m_writeMutex;
+    mutable std::vector<const Snapshot*> m_retired;
+    Id m_nextId = 1;
+};
+
+} // namespace qttabbar